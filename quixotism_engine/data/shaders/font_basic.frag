@@ -3,4 +3,13 @@ out vec4 FragColor;
 in vec3 TexCoord;
 in vec3 Color;
 uniform sampler2DArray tex_sampler;
-void main() { FragColor = vec4(Color, texture(tex_sampler, TexCoord)); }
\ No newline at end of file
+// 1 when the font texture stores signed distance fields (edge at 0.5)
+uniform int sdf;
+void main() {
+  float value = texture(tex_sampler, TexCoord).r;
+  if (sdf == 1) {
+    float width = fwidth(value);
+    value = smoothstep(0.5 - width, 0.5 + width, value);
+  }
+  FragColor = vec4(Color, value);
+}
@@ -1,6 +1,9 @@
 #version 330 core
-layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec3 aNormal;
+// position as snorm16 relative to the mesh bounding box, see
+// mesh/vertex_quantization.hpp
+layout(location = 0) in vec4 aPos;
+// octahedral snorm16 unit normal
+layout(location = 1) in vec2 aNormal;
 layout(location = 2) in vec2 aTexCoord;
 
 out vec3 Normal;
@@ -10,10 +13,22 @@ out vec2 TexCoord;
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform vec3 position_center;
+uniform vec3 position_half_extent;
+
+vec3 DecodeOctahedral(vec2 e) {
+  vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  if (v.z < 0.0) {
+    v.xy = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0,
+                                    e.y >= 0.0 ? 1.0 : -1.0);
+  }
+  return normalize(v);
+}
 
 void main() {
-  gl_Position = projection * view * model * vec4(aPos, 1.0);
-  FragPos = aPos;
+  vec3 pos = position_center + aPos.xyz * position_half_extent;
+  gl_Position = projection * view * model * vec4(pos, 1.0);
+  FragPos = pos;
   TexCoord = vec2(aTexCoord.x, aTexCoord.y);
-  Normal = aNormal;
-}
\ No newline at end of file
+  Normal = DecodeOctahedral(aNormal);
+}
@@ -1,9 +1,14 @@
 #include "bitmap/bitmap.hpp"
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
 #include <numeric>
 
+#include "bitmap/skyline_packer.hpp"
 #include "dbg_print.hpp"
+#include "enumerate.hpp"
 
 namespace quixotism {
 
@@ -15,6 +20,13 @@ i32 Bitmap::FormatChannelCount(BitmapFormat format) {
       return 3;
     case BitmapFormat::RGBA8:
       return 4;
+    case BitmapFormat::BC1:
+      return 3;
+    case BitmapFormat::BC3:
+    case BitmapFormat::BC7:
+      return 4;
+    case BitmapFormat::BC4:
+      return 1;
     case BitmapFormat::UNSPECIFIED:
       return 0;
     default:
@@ -31,18 +43,48 @@ i32 Bitmap::FormatBytesPerPixel(BitmapFormat format) {
     case BitmapFormat::RGBA8:
       return 4;
     case BitmapFormat::UNSPECIFIED:
+    case BitmapFormat::BC1:
+    case BitmapFormat::BC3:
+    case BitmapFormat::BC4:
+    case BitmapFormat::BC7:
       return 0;
     default:
       Assert(!"unreachable");
   }
 }
 
+bool Bitmap::IsBlockCompressed(BitmapFormat format) {
+  return FormatBlockBytes(format) != 0;
+}
+
+u32 Bitmap::FormatBlockBytes(BitmapFormat format) {
+  switch (format) {
+    case BitmapFormat::BC1:
+    case BitmapFormat::BC4:
+      return 8;
+    case BitmapFormat::BC3:
+    case BitmapFormat::BC7:
+      return 16;
+    default:
+      return 0;
+  }
+}
+
+size_t Bitmap::FormatDataSize(BitmapFormat format, u32 width, u32 height) {
+  if (IsBlockCompressed(format)) {
+    size_t blocks_x = (static_cast<size_t>(width) + 3) / 4;
+    size_t blocks_y = (static_cast<size_t>(height) + 3) / 4;
+    return blocks_x * blocks_y * FormatBlockBytes(format);
+  }
+  return static_cast<size_t>(width) * height * FormatBytesPerPixel(format);
+}
+
 Bitmap::Bitmap(u32 _width, u32 _height, BitmapFormat _format)
     : width{_width}, height{_height}, format{_format} {
-  data = std::make_unique<u8[]>(width * height * BytesPerPixel());
+  data = std::make_unique<u8[]>(GetDataSize());
 }
 
-[[no_discard]] std::expected<PackedBitmap, BitmapError> PackBitmaps(
+[[nodiscard]] std::expected<PackedBitmap, BitmapError> PackBitmaps(
     const std::vector<Bitmap> &bitmaps, const i32 padding,
     const i32 max_bitmap_dim) {
   if (bitmaps.empty()) return std::unexpected(BitmapError{});
@@ -51,117 +93,108 @@ Bitmap::Bitmap(u32 _width, u32 _height, BitmapFormat _format)
   std::iota(bitmap_indicies.begin(), bitmap_indicies.end(), 0);
   std::sort(bitmap_indicies.begin(), bitmap_indicies.end(),
             [&](const size_t a, const size_t b) {
-              return bitmaps[a].GetHeight() > bitmaps[b].GetHeight();
+              if (bitmaps[a].GetHeight() != bitmaps[b].GetHeight()) {
+                return bitmaps[a].GetHeight() > bitmaps[b].GetHeight();
+              }
+              return bitmaps[a].GetWidth() > bitmaps[b].GetWidth();
             });
 
-  // first compute what bitmap size we need to pack all bitmaps
-  u32 current_bitmap_dimension = 256;
-  while (current_bitmap_dimension <= max_bitmap_dim) {
-    bool finished = true;
-    u32 current_height =
-            bitmaps[bitmap_indicies[0]].GetHeight() + (2 * padding),
-        current_width = 0;
-    if (current_height > current_bitmap_dimension) {
-      current_bitmap_dimension <<= 1;
-      continue;
-    }
-    u32 prev_row_height = current_height;
-    for (auto idx : bitmap_indicies) {
-      const auto [width, height] = bitmaps[idx].GetDim();
-      current_width += width + (2 * padding);
-      if (current_width > current_bitmap_dimension) {
-        current_height += prev_row_height;
-        current_width = width + (2 * padding);
-        prev_row_height = height + (2 * padding);
-        if ((current_height > current_bitmap_dimension) ||
-            (current_width > current_bitmap_dimension)) {
-          finished = false;
-          break;
-        }
+  // first place all bitmaps, whenever one does not fit we grow the packing
+  // area (alternating between width and height, so the result does not have
+  // to be square), already placed bitmaps keep their spot
+  const u32 max_dim = static_cast<u32>(max_bitmap_dim);
+  u32 initial_dim = std::min(256U, max_dim);
+  SkylinePacker packer{initial_dim, initial_dim};
+  std::vector<PackerRect> rects(bitmaps.size());
+  for (const auto idx : bitmap_indicies) {
+    const auto [width, height] = bitmaps[idx].GetDim();
+    u32 padded_width = width + (2 * padding);
+    u32 padded_height = height + (2 * padding);
+    auto rect = packer.Insert(padded_width, padded_height);
+    while (!rect) {
+      auto packer_width = packer.GetWidth(), packer_height = packer.GetHeight();
+      if (packer_width >= max_dim && packer_height >= max_dim) {
+        // if that size is bigger than the allowed maximum dimension pixel
+        // size, return null
+        DBG_PRINT(
+            "could not pack bitmaps: packed texture would be bigger than the "
+            "max bitmap dimension");
+        return std::unexpected(BitmapError{});
+      }
+      if ((packer_width <= packer_height && packer_width < max_dim) ||
+          packer_height >= max_dim) {
+        packer_width = std::min(packer_width * 2, max_dim);
+      } else {
+        packer_height = std::min(packer_height * 2, max_dim);
       }
+      packer.Grow(packer_width, packer_height);
+      rect = packer.Insert(padded_width, padded_height);
     }
-    if (finished) break;
-    current_bitmap_dimension <<= 1;
-  }
-
-  // if that size is bigger than the allowed maximum dimension pixel size,
-  // return null
-  if (current_bitmap_dimension > max_bitmap_dim) {
-    DBG_PRINT(
-        "could not create font bitmap: baked texture would be too big (max "
-        "font bitmap is 4k)");
-    return std::unexpected(BitmapError{});
+    rects[idx] = *rect;
   }
 
-  PackedBitmap packed_font;
-  packed_font.bitmap =
-      Bitmap{current_bitmap_dimension, current_bitmap_dimension,
-             BitmapFormat::R8};
-  packed_font.coords.resize(bitmaps.size());
-
-  u32 current_height = padding, current_width = 0;
-  u32 prev_row_height = bitmaps[bitmap_indicies[0]].GetHeight();
-  for (const auto idx : bitmap_indicies) {
-    const auto &bitmap = bitmaps[idx];
+  const auto bitmap_width = packer.GetWidth();
+  const auto bitmap_height = packer.GetHeight();
+  PackedBitmap packed_bitmap;
+  packed_bitmap.bitmap =
+      Bitmap{bitmap_width, bitmap_height, bitmaps[0].GetBitmapFormat()};
+  packed_bitmap.coords.resize(bitmaps.size());
+  for (const auto &[idx, bitmap] : Enumerate(bitmaps)) {
     const auto [width, height] = bitmap.GetDim();
-    if ((current_width + width + (2 * padding)) > current_bitmap_dimension) {
-      current_width = 0;
-      current_height += (prev_row_height + (2 * padding));
-      prev_row_height = height;
-      Assert(current_width <= current_bitmap_dimension);
-      Assert(current_height <= current_bitmap_dimension);
-    }
-    current_width += padding;
+    u32 x = rects[idx].x + padding;
+    u32 y = rects[idx].y + padding;
     BitmapCoord coord;
-    coord.lower_left = Vec2{static_cast<r32>(current_width),
-                            static_cast<r32>(current_height)} /
-                       static_cast<r32>(current_bitmap_dimension);
-    coord.top_right = Vec2{static_cast<r32>(current_width + width),
-                           static_cast<r32>(current_height + height)} /
-                      static_cast<r32>(current_bitmap_dimension);
-    packed_font.coords[idx] = coord;
-    const auto *source = bitmap.GetBitmapPtr();
-    auto *dest_row = packed_font.bitmap.GetBitmapWritePtr() +
-                     (current_height * current_bitmap_dimension) +
-                     (current_width);
-    for (i32 y = 0; y < height; ++y) {
-      auto *dest = dest_row;
-      for (i32 x = 0; x < width; ++x) {
-        *dest++ = *source++;
-      }
-      dest_row += current_bitmap_dimension;
-    }
-    current_width += (width + padding);
+    coord.lower_left = Vec2{static_cast<r32>(x) / bitmap_width,
+                            static_cast<r32>(y) / bitmap_height};
+    coord.top_right = Vec2{static_cast<r32>(x + width) / bitmap_width,
+                           static_cast<r32>(y + height) / bitmap_height};
+    packed_bitmap.coords[idx] = coord;
+    CopyBitmap(bitmap, packed_bitmap.bitmap, x, y);
   }
 
-  return packed_font;
+  return packed_bitmap;
 }
 
 void CopyBitmap(const Bitmap &src_bitmap, Bitmap &dst_bitmap, u32 dst_xoffset,
                 u32 dst_yoffset) {
-  if (dst_xoffset || dst_yoffset) {
-    Assert(0);
-  }
-
-  Assert(src_bitmap.GetWidth() <= dst_bitmap.GetWidth() &&
-         src_bitmap.GetHeight() <= dst_bitmap.GetHeight());
+  Assert((dst_xoffset + src_bitmap.GetWidth()) <= dst_bitmap.GetWidth() &&
+         (dst_yoffset + src_bitmap.GetHeight()) <= dst_bitmap.GetHeight());
   Assert(src_bitmap.BytesPerPixel() == dst_bitmap.BytesPerPixel());
+  Assert(!src_bitmap.IsBlockCompressed());
 
-  auto [copy_width, copy_height] = src_bitmap.GetDim();
-  size_t copy_size = src_bitmap.BytesPerPixel();
-  size_t bytes_per_row = copy_size * dst_bitmap.GetWidth();
+  size_t bytes_per_pixel = src_bitmap.BytesPerPixel();
+  size_t src_pitch = bytes_per_pixel * src_bitmap.GetWidth();
+  size_t dst_pitch = bytes_per_pixel * dst_bitmap.GetWidth();
   auto src = src_bitmap.GetBitmapPtr();
-  auto dst = dst_bitmap.GetBitmapWritePtr();
-  auto row = dst;
-  for (u32 y = 0; y < copy_height; ++y) {
-    auto pixel = row;
-    for (u32 x = 0; x < copy_width; ++x) {
-      std::memcpy(pixel, src, copy_size);
-      src += copy_size;
-      pixel += copy_size;
+  auto dst = dst_bitmap.GetBitmapWritePtr() + (dst_yoffset * dst_pitch) +
+             (dst_xoffset * bytes_per_pixel);
+  for (u32 y = 0; y < src_bitmap.GetHeight(); ++y) {
+    std::memcpy(dst, src, src_pitch);
+    src += src_pitch;
+    dst += dst_pitch;
+  }
+}
+
+r64 ComputePSNR(const Bitmap &a, const Bitmap &b) {
+  Assert(a.GetWidth() == b.GetWidth() && a.GetHeight() == b.GetHeight());
+  Assert(!a.IsBlockCompressed() && !b.IsBlockCompressed());
+  size_t a_stride = a.BytesPerPixel();
+  size_t b_stride = b.BytesPerPixel();
+  size_t channels = std::min(a_stride, b_stride);
+  size_t pixel_count = static_cast<size_t>(a.GetWidth()) * a.GetHeight();
+  const u8 *a_pixels = a.GetBitmapPtr();
+  const u8 *b_pixels = b.GetBitmapPtr();
+  u64 squared_error = 0;
+  for (size_t idx = 0; idx < pixel_count; ++idx) {
+    for (size_t channel = 0; channel < channels; ++channel) {
+      i32 diff = static_cast<i32>(a_pixels[(idx * a_stride) + channel]) -
+                 b_pixels[(idx * b_stride) + channel];
+      squared_error += static_cast<u64>(diff * diff);
     }
-    row += bytes_per_row;
   }
+  if (squared_error == 0) return std::numeric_limits<r64>::infinity();
+  r64 mse = static_cast<r64>(squared_error) / (pixel_count * channels);
+  return 10.0 * std::log10((255.0 * 255.0) / mse);
 }
 
 }  // namespace quixotism
@@ -21,12 +21,24 @@ enum BitmapFormat {
   RG32F = 0x8230,
   RG8 = 0x822B,
   DEPTH24_STENCIL8 = 0x88F0,
+  // Block compressed formats, 4x4 texel blocks. BC1 holds opaque RGB, BC3
+  // RGBA with BC4 style alpha, BC4 a single channel.
+  BC1 = 0x83F0,
+  BC3 = 0x83F3,
+  BC4 = 0x8DBB,
+  BC7 = 0x8E8C,
 };
 
 class Bitmap {
  public:
   static i32 FormatChannelCount(BitmapFormat format);
   static i32 FormatBytesPerPixel(BitmapFormat format);
+  static bool IsBlockCompressed(BitmapFormat format);
+  // bytes per 4x4 block of a block compressed format
+  static u32 FormatBlockBytes(BitmapFormat format);
+  // bytes the pixels of a width x height bitmap take, partial blocks of
+  // compressed formats count as whole blocks
+  static size_t FormatDataSize(BitmapFormat format, u32 width, u32 height);
 
  public:
   Bitmap() : width{0}, height{0}, format{BitmapFormat::UNSPECIFIED} {}
@@ -40,7 +52,12 @@ class Bitmap {
 
   bool IsValid() const { return data != nullptr; }
 
+  // 0 for block compressed formats, use GetDataSize for those
   i32 BytesPerPixel() const { return Bitmap::FormatBytesPerPixel(format); }
+  bool IsBlockCompressed() const { return Bitmap::IsBlockCompressed(format); }
+  size_t GetDataSize() const {
+    return Bitmap::FormatDataSize(format, width, height);
+  }
   const u8 *GetBitmapPtr() const { return data.get(); }
   u8 *GetBitmapWritePtr() { return data.get(); }
 
@@ -76,4 +93,9 @@ std::expected<PackedBitmap, BitmapError> PackBitmaps(
 void CopyBitmap(const Bitmap &src, Bitmap &dst, u32 dst_xoffset = 0,
                 u32 dst_yoffset = 0);
 
+// Peak signal to noise ratio in dB of two uncompressed bitmaps of the same
+// size, over the channels both formats have (RGB8 against RGBA8 compares
+// RGB). Identical bitmaps give infinity.
+r64 ComputePSNR(const Bitmap &a, const Bitmap &b);
+
 }  // namespace quixotism
@@ -0,0 +1,763 @@
+#include "bitmap/block_compression.hpp"
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#include "thread_pool.hpp"
+
+namespace quixotism {
+
+// 4x4 texels expanded to RGBA, row by row
+struct PixelBlock {
+  alignas(16) u8 rgba[16 * 4];
+};
+
+static void LoadBlock(const Bitmap &bitmap, u32 block_x, u32 block_y,
+                      PixelBlock &block) {
+  u32 width = bitmap.GetWidth();
+  u32 height = bitmap.GetHeight();
+  u32 channels = static_cast<u32>(bitmap.BytesPerPixel());
+  const u8 *pixels = bitmap.GetBitmapPtr();
+  for (u32 y = 0; y < 4; ++y) {
+    u32 src_y = std::min((block_y * 4) + y, height - 1);
+    for (u32 x = 0; x < 4; ++x) {
+      u32 src_x = std::min((block_x * 4) + x, width - 1);
+      const u8 *src =
+          pixels + (((static_cast<size_t>(src_y) * width) + src_x) * channels);
+      u8 *dest = block.rgba + (((y * 4) + x) * 4);
+      switch (channels) {
+        case 1:
+          dest[0] = dest[1] = dest[2] = src[0];
+          dest[3] = 255;
+          break;
+        case 3:
+          std::memcpy(dest, src, 3);
+          dest[3] = 255;
+          break;
+        default:
+          std::memcpy(dest, src, 4);
+          break;
+      }
+    }
+  }
+}
+
+// Writes the texels of the block that lie inside the bitmap, keeping the
+// first 'channels' channels
+static void StoreBlock(const PixelBlock &block, u32 block_x, u32 block_y,
+                       Bitmap &bitmap) {
+  u32 width = bitmap.GetWidth();
+  u32 height = bitmap.GetHeight();
+  u32 channels = static_cast<u32>(bitmap.BytesPerPixel());
+  u8 *pixels = bitmap.GetBitmapWritePtr();
+  for (u32 y = 0; y < 4 && (block_y * 4) + y < height; ++y) {
+    for (u32 x = 0; x < 4 && (block_x * 4) + x < width; ++x) {
+      size_t dest_idx = (static_cast<size_t>((block_y * 4) + y) * width) +
+                        (block_x * 4) + x;
+      std::memcpy(pixels + (dest_idx * channels),
+                  block.rgba + (((y * 4) + x) * 4), channels);
+    }
+  }
+}
+
+/**
+ * Picks the closest palette entry for every texel of the block by squared
+ * RGBA distance (alpha only counts with use_alpha), returns the summed error.
+ *
+ * Texels are widened to 16 bit lanes, two per register, so one madd gives the
+ * squared distances of two channel pairs. Four texels are compared against
+ * a palette entry at a time.
+ */
+static u32 FitPalette(const PixelBlock &block, const u8 (*palette)[4],
+                      u32 palette_count, bool use_alpha, u8 *indices) {
+  const auto zero = _mm_setzero_si128();
+  const auto channel_mask = use_alpha
+                                ? _mm_set1_epi16(-1)
+                                : _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+  __m128i texels[8];
+  for (u32 idx = 0; idx < 4; ++idx) {
+    auto packed = _mm_load_si128(
+        reinterpret_cast<const __m128i *>(block.rgba + (idx * 16)));
+    texels[2 * idx] =
+        _mm_and_si128(_mm_unpacklo_epi8(packed, zero), channel_mask);
+    texels[(2 * idx) + 1] =
+        _mm_and_si128(_mm_unpackhi_epi8(packed, zero), channel_mask);
+  }
+
+  __m128i best_error[4], best_index[4];
+  for (u32 group = 0; group < 4; ++group) {
+    best_error[group] = _mm_set1_epi32(0x7FFFFFFF);
+    best_index[group] = zero;
+  }
+  for (u32 entry = 0; entry < palette_count; ++entry) {
+    const u8 *color = palette[entry];
+    auto entry_color = _mm_and_si128(
+        _mm_set_epi16(color[3], color[2], color[1], color[0], color[3],
+                      color[2], color[1], color[0]),
+        channel_mask);
+    auto entry_index = _mm_set1_epi32(static_cast<i32>(entry));
+    for (u32 group = 0; group < 4; ++group) {
+      auto diff_lo = _mm_sub_epi16(texels[2 * group], entry_color);
+      auto diff_hi = _mm_sub_epi16(texels[(2 * group) + 1], entry_color);
+      // [rg, ba] sums of two texels each
+      auto sums_lo = _mm_castsi128_ps(_mm_madd_epi16(diff_lo, diff_lo));
+      auto sums_hi = _mm_castsi128_ps(_mm_madd_epi16(diff_hi, diff_hi));
+      auto error = _mm_add_epi32(
+          _mm_castps_si128(
+              _mm_shuffle_ps(sums_lo, sums_hi, _MM_SHUFFLE(2, 0, 2, 0))),
+          _mm_castps_si128(
+              _mm_shuffle_ps(sums_lo, sums_hi, _MM_SHUFFLE(3, 1, 3, 1))));
+      auto better = _mm_cmplt_epi32(error, best_error[group]);
+      best_error[group] =
+          _mm_or_si128(_mm_and_si128(better, error),
+                       _mm_andnot_si128(better, best_error[group]));
+      best_index[group] =
+          _mm_or_si128(_mm_and_si128(better, entry_index),
+                       _mm_andnot_si128(better, best_index[group]));
+    }
+  }
+
+  alignas(16) u32 errors[16];
+  alignas(16) u32 best[16];
+  for (u32 group = 0; group < 4; ++group) {
+    _mm_store_si128(reinterpret_cast<__m128i *>(errors + (group * 4)),
+                    best_error[group]);
+    _mm_store_si128(reinterpret_cast<__m128i *>(best + (group * 4)),
+                    best_index[group]);
+  }
+  u32 total_error = 0;
+  for (u32 idx = 0; idx < 16; ++idx) {
+    indices[idx] = static_cast<u8>(best[idx]);
+    total_error += errors[idx];
+  }
+  return total_error;
+}
+
+// Mean and principal axis (unit length) of the first channel_count channels
+// of the texels, the axis comes from power iteration on the covariance
+static void PrincipalAxis(const PixelBlock &block, u32 channel_count,
+                          r32 *mean, r32 *axis) {
+  for (u32 channel = 0; channel < channel_count; ++channel) {
+    r32 sum = 0.0F;
+    for (u32 idx = 0; idx < 16; ++idx) sum += block.rgba[(idx * 4) + channel];
+    mean[channel] = sum / 16.0F;
+  }
+  r32 covariance[4][4] = {};
+  for (u32 idx = 0; idx < 16; ++idx) {
+    r32 diff[4];
+    for (u32 channel = 0; channel < channel_count; ++channel) {
+      diff[channel] = block.rgba[(idx * 4) + channel] - mean[channel];
+    }
+    for (u32 row = 0; row < channel_count; ++row) {
+      for (u32 col = row; col < channel_count; ++col) {
+        covariance[row][col] += diff[row] * diff[col];
+      }
+    }
+  }
+  for (u32 row = 0; row < channel_count; ++row) {
+    for (u32 col = 0; col < row; ++col) {
+      covariance[row][col] = covariance[col][row];
+    }
+  }
+
+  // start from the channel with the largest variance
+  u32 largest = 0;
+  for (u32 channel = 1; channel < channel_count; ++channel) {
+    if (covariance[channel][channel] > covariance[largest][largest]) {
+      largest = channel;
+    }
+  }
+  for (u32 channel = 0; channel < channel_count; ++channel) {
+    axis[channel] = covariance[largest][channel];
+  }
+  for (u32 iteration = 0; iteration < 8; ++iteration) {
+    r32 next[4] = {};
+    r32 max_component = 0.0F;
+    for (u32 row = 0; row < channel_count; ++row) {
+      for (u32 col = 0; col < channel_count; ++col) {
+        next[row] += covariance[row][col] * axis[col];
+      }
+      max_component = std::max(max_component, std::abs(next[row]));
+    }
+    if (max_component == 0.0F) break;
+    for (u32 channel = 0; channel < channel_count; ++channel) {
+      axis[channel] = next[channel] / max_component;
+    }
+  }
+  r32 length_sq = 0.0F;
+  for (u32 channel = 0; channel < channel_count; ++channel) {
+    length_sq += axis[channel] * axis[channel];
+  }
+  r32 inv_length = (length_sq > 0.0F) ? (1.0F / std::sqrt(length_sq)) : 0.0F;
+  for (u32 channel = 0; channel < channel_count; ++channel) {
+    axis[channel] *= inv_length;
+  }
+}
+
+// Endpoints at the extreme projections of the texels on the principal axis
+static void AxisEndpoints(const PixelBlock &block, u32 channel_count,
+                          r32 *end0, r32 *end1) {
+  r32 mean[4], axis[4];
+  PrincipalAxis(block, channel_count, mean, axis);
+  r32 min_t = 0.0F, max_t = 0.0F;
+  for (u32 idx = 0; idx < 16; ++idx) {
+    r32 t = 0.0F;
+    for (u32 channel = 0; channel < channel_count; ++channel) {
+      t += (block.rgba[(idx * 4) + channel] - mean[channel]) * axis[channel];
+    }
+    min_t = std::min(min_t, t);
+    max_t = std::max(max_t, t);
+  }
+  for (u32 channel = 0; channel < channel_count; ++channel) {
+    end0[channel] =
+        std::clamp(mean[channel] + (max_t * axis[channel]), 0.0F, 255.0F);
+    end1[channel] =
+        std::clamp(mean[channel] + (min_t * axis[channel]), 0.0F, 255.0F);
+  }
+}
+
+// Least squares endpoints for fixed indices, weights[index] is how much of
+// end1 the palette entry holds. Returns false if the indices do not pin down
+// two endpoints (all texels use the same weight).
+static bool LeastSquaresEndpoints(const PixelBlock &block, u32 channel_count,
+                                  const u8 *indices, const r32 *weights,
+                                  r32 *end0, r32 *end1) {
+  r32 aa = 0.0F, ab = 0.0F, bb = 0.0F;
+  r32 ax[4] = {}, bx[4] = {};
+  for (u32 idx = 0; idx < 16; ++idx) {
+    r32 b = weights[indices[idx]];
+    r32 a = 1.0F - b;
+    aa += a * a;
+    ab += a * b;
+    bb += b * b;
+    for (u32 channel = 0; channel < channel_count; ++channel) {
+      ax[channel] += a * block.rgba[(idx * 4) + channel];
+      bx[channel] += b * block.rgba[(idx * 4) + channel];
+    }
+  }
+  r32 det = (aa * bb) - (ab * ab);
+  if (std::abs(det) < 1e-6F) return false;
+  r32 inv_det = 1.0F / det;
+  for (u32 channel = 0; channel < channel_count; ++channel) {
+    end0[channel] = std::clamp(
+        ((bb * ax[channel]) - (ab * bx[channel])) * inv_det, 0.0F, 255.0F);
+    end1[channel] = std::clamp(
+        ((aa * bx[channel]) - (ab * ax[channel])) * inv_det, 0.0F, 255.0F);
+  }
+  return true;
+}
+
+//
+// BC1 (and the color half of BC3)
+//
+
+static u16 PackRGB565(const r32 *color) {
+  u32 r = static_cast<u32>((color[0] * (31.0F / 255.0F)) + 0.5F);
+  u32 g = static_cast<u32>((color[1] * (63.0F / 255.0F)) + 0.5F);
+  u32 b = static_cast<u32>((color[2] * (31.0F / 255.0F)) + 0.5F);
+  return static_cast<u16>((r << 11) | (g << 5) | b);
+}
+
+static void UnpackRGB565(u16 color, u8 *rgba) {
+  u32 r = (color >> 11) & 0x1F;
+  u32 g = (color >> 5) & 0x3F;
+  u32 b = color & 0x1F;
+  rgba[0] = static_cast<u8>((r << 3) | (r >> 2));
+  rgba[1] = static_cast<u8>((g << 2) | (g >> 4));
+  rgba[2] = static_cast<u8>((b << 3) | (b >> 2));
+  rgba[3] = 255;
+}
+
+// four color mode for c0 > c1, three colors and black otherwise
+static void BC1Palette(u16 c0, u16 c1, u8 (*palette)[4]) {
+  UnpackRGB565(c0, palette[0]);
+  UnpackRGB565(c1, palette[1]);
+  for (u32 channel = 0; channel < 3; ++channel) {
+    u32 a = palette[0][channel];
+    u32 b = palette[1][channel];
+    if (c0 > c1) {
+      palette[2][channel] = static_cast<u8>(((2 * a) + b) / 3);
+      palette[3][channel] = static_cast<u8>((a + (2 * b)) / 3);
+    } else {
+      palette[2][channel] = static_cast<u8>((a + b) / 2);
+      palette[3][channel] = 0;
+    }
+  }
+  palette[2][3] = 255;
+  palette[3][3] = (c0 > c1) ? 255 : 0;
+}
+
+// share of c1 in the four color palette entries
+static constexpr r32 bc1_weights[4] = {0.0F, 1.0F, 1.0F / 3.0F, 2.0F / 3.0F};
+
+struct BC1Fit {
+  u16 c0;
+  u16 c1;
+  u8 indices[16];
+  u32 error;
+};
+
+// Only ever uses the four color mode (or a single color), which is the only
+// mode the color half of BC3 has
+static BC1Fit FitBC1Endpoints(const PixelBlock &block, const r32 *end0,
+                              const r32 *end1) {
+  BC1Fit fit;
+  fit.c0 = PackRGB565(end0);
+  fit.c1 = PackRGB565(end1);
+  if (fit.c0 < fit.c1) std::swap(fit.c0, fit.c1);
+  u8 palette[4][4];
+  BC1Palette(fit.c0, fit.c1, palette);
+  fit.error = FitPalette(block, palette, (fit.c0 == fit.c1) ? 1 : 4, false,
+                         fit.indices);
+  return fit;
+}
+
+// Endpoint pairs whose 1/3 blend hits every 8 bit value as close as possible,
+// solid blocks come out a lot more accurate than with plain 565 rounding
+struct SingleColorMatch {
+  u8 end0;
+  u8 end1;
+};
+
+static std::array<SingleColorMatch, 256> BuildSingleColorTable(u32 bits) {
+  std::array<SingleColorMatch, 256> table{};
+  u32 levels = 1U << bits;
+  auto expand = [bits](u32 value) {
+    return (value << (8 - bits)) | (value >> ((2 * bits) - 8));
+  };
+  for (u32 value = 0; value < 256; ++value) {
+    i32 best_error = 256;
+    for (u32 end0 = 0; end0 < levels; ++end0) {
+      for (u32 end1 = 0; end1 < levels; ++end1) {
+        i32 blended = static_cast<i32>(((2 * expand(end0)) + expand(end1)) / 3);
+        i32 error = std::abs(blended - static_cast<i32>(value));
+        if (error < best_error) {
+          best_error = error;
+          table[value] = {static_cast<u8>(end0), static_cast<u8>(end1)};
+        }
+      }
+    }
+  }
+  return table;
+}
+
+static BC1Fit FitBC1SingleColor(const PixelBlock &block) {
+  static const auto match5 = BuildSingleColorTable(5);
+  static const auto match6 = BuildSingleColorTable(6);
+  const u8 *color = block.rgba;
+  BC1Fit fit;
+  fit.c0 = static_cast<u16>((match5[color[0]].end0 << 11) |
+                            (match6[color[1]].end0 << 5) |
+                            match5[color[2]].end0);
+  fit.c1 = static_cast<u16>((match5[color[0]].end1 << 11) |
+                            (match6[color[1]].end1 << 5) |
+                            match5[color[2]].end1);
+  // the blend is entry 2 with c0 first, entry 3 once they are swapped
+  u8 index = 2;
+  if (fit.c0 < fit.c1) {
+    std::swap(fit.c0, fit.c1);
+    index = 3;
+  } else if (fit.c0 == fit.c1) {
+    index = 0;
+  }
+  std::memset(fit.indices, index, sizeof(fit.indices));
+  u8 palette[4][4];
+  BC1Palette(fit.c0, fit.c1, palette);
+  fit.error = FitPalette(block, palette + index, 1, false, fit.indices);
+  std::memset(fit.indices, index, sizeof(fit.indices));
+  return fit;
+}
+
+static void EncodeBC1Block(const PixelBlock &block, u8 *dest) {
+  bool solid = true;
+  for (u32 idx = 1; idx < 16 && solid; ++idx) {
+    solid = std::memcmp(block.rgba, block.rgba + (idx * 4), 3) == 0;
+  }
+
+  BC1Fit best;
+  if (solid) {
+    best = FitBC1SingleColor(block);
+  } else {
+    r32 end0[4], end1[4];
+    AxisEndpoints(block, 3, end0, end1);
+    best = FitBC1Endpoints(block, end0, end1);
+    for (u32 iteration = 0; iteration < 2 && best.error > 0; ++iteration) {
+      if (!LeastSquaresEndpoints(block, 3, best.indices, bc1_weights, end0,
+                                 end1)) {
+        break;
+      }
+      auto refined = FitBC1Endpoints(block, end0, end1);
+      if (refined.error >= best.error) break;
+      best = refined;
+    }
+  }
+
+  u32 packed_indices = 0;
+  for (u32 idx = 0; idx < 16; ++idx) {
+    packed_indices |= static_cast<u32>(best.indices[idx]) << (2 * idx);
+  }
+  dest[0] = static_cast<u8>(best.c0);
+  dest[1] = static_cast<u8>(best.c0 >> 8);
+  dest[2] = static_cast<u8>(best.c1);
+  dest[3] = static_cast<u8>(best.c1 >> 8);
+  std::memcpy(dest + 4, &packed_indices, sizeof(packed_indices));
+}
+
+static void DecodeBC1Block(const u8 *src, bool force_four_colors,
+                           PixelBlock &block) {
+  u16 c0 = static_cast<u16>(src[0] | (src[1] << 8));
+  u16 c1 = static_cast<u16>(src[2] | (src[3] << 8));
+  u8 palette[4][4];
+  BC1Palette(c0, c1, palette);
+  if (force_four_colors && c0 <= c1) {
+    for (u32 channel = 0; channel < 3; ++channel) {
+      u32 a = palette[0][channel];
+      u32 b = palette[1][channel];
+      palette[2][channel] = static_cast<u8>(((2 * a) + b) / 3);
+      palette[3][channel] = static_cast<u8>((a + (2 * b)) / 3);
+    }
+    palette[3][3] = 255;
+  }
+  u32 packed_indices;
+  std::memcpy(&packed_indices, src + 4, sizeof(packed_indices));
+  for (u32 idx = 0; idx < 16; ++idx) {
+    std::memcpy(block.rgba + (idx * 4),
+                palette[(packed_indices >> (2 * idx)) & 0x3], 3);
+  }
+}
+
+//
+// BC4 (and the alpha half of BC3)
+//
+
+// eight value mode for a0 > a1, six values plus 0 and 255 otherwise
+static void BC4Palette(u8 a0, u8 a1, u8 *palette) {
+  palette[0] = a0;
+  palette[1] = a1;
+  if (a0 > a1) {
+    for (u32 idx = 2; idx < 8; ++idx) {
+      palette[idx] = static_cast<u8>(
+          (((8 - idx) * a0) + ((idx - 1) * a1) + 3) / 7);
+    }
+  } else {
+    for (u32 idx = 2; idx < 6; ++idx) {
+      palette[idx] = static_cast<u8>(
+          (((6 - idx) * a0) + ((idx - 1) * a1) + 2) / 5);
+    }
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+}
+
+// Encodes one channel of the block, 'channel' picks it from the RGBA texels
+static void EncodeBC4Block(const PixelBlock &block, u32 channel, u8 *dest) {
+  u8 min_value = 255, max_value = 0;
+  for (u32 idx = 0; idx < 16; ++idx) {
+    min_value = std::min(min_value, block.rgba[(idx * 4) + channel]);
+    max_value = std::max(max_value, block.rgba[(idx * 4) + channel]);
+  }
+  u8 palette[8];
+  BC4Palette(max_value, min_value, palette);
+  u32 palette_count = (max_value > min_value) ? 8 : 1;
+  u64 packed_indices = 0;
+  for (u32 idx = 0; idx < 16; ++idx) {
+    i32 value = block.rgba[(idx * 4) + channel];
+    u32 best_entry = 0;
+    i32 best_error = 256;
+    for (u32 entry = 0; entry < palette_count; ++entry) {
+      i32 error = std::abs(value - palette[entry]);
+      if (error < best_error) {
+        best_error = error;
+        best_entry = entry;
+      }
+    }
+    packed_indices |= static_cast<u64>(best_entry) << (3 * idx);
+  }
+  dest[0] = max_value;
+  dest[1] = min_value;
+  for (u32 byte = 0; byte < 6; ++byte) {
+    dest[2 + byte] = static_cast<u8>(packed_indices >> (8 * byte));
+  }
+}
+
+static void DecodeBC4Block(const u8 *src, u32 channel, PixelBlock &block) {
+  u8 palette[8];
+  BC4Palette(src[0], src[1], palette);
+  u64 packed_indices = 0;
+  for (u32 byte = 0; byte < 6; ++byte) {
+    packed_indices |= static_cast<u64>(src[2 + byte]) << (8 * byte);
+  }
+  for (u32 idx = 0; idx < 16; ++idx) {
+    block.rgba[(idx * 4) + channel] =
+        palette[(packed_indices >> (3 * idx)) & 0x7];
+  }
+}
+
+//
+// BC7 mode 6: one subset, 7 bit RGBA endpoints with a shared low bit (p-bit)
+// per endpoint, 4 bit indices
+//
+
+static constexpr u8 bc7_weights4[16] = {0,  4,  9,  13, 17, 21, 26, 30,
+                                        34, 38, 43, 47, 51, 55, 60, 64};
+
+static constexpr r32 bc7_fit_weights[16] = {
+    0 / 64.0F,  4 / 64.0F,  9 / 64.0F,  13 / 64.0F, 17 / 64.0F, 21 / 64.0F,
+    26 / 64.0F, 30 / 64.0F, 34 / 64.0F, 38 / 64.0F, 43 / 64.0F, 47 / 64.0F,
+    51 / 64.0F, 55 / 64.0F, 60 / 64.0F, 64 / 64.0F};
+
+struct BC7Endpoint {
+  // 7 bit values
+  u8 quantized[4];
+  u8 p_bit;
+};
+
+// Picks the p-bit with the smaller rounding error over all four channels
+static BC7Endpoint QuantizeBC7Endpoint(const r32 *color) {
+  BC7Endpoint best = {};
+  r32 best_error = -1.0F;
+  for (u8 p_bit = 0; p_bit < 2; ++p_bit) {
+    BC7Endpoint endpoint = {};
+    endpoint.p_bit = p_bit;
+    r32 error = 0.0F;
+    for (u32 channel = 0; channel < 4; ++channel) {
+      i32 quantized = static_cast<i32>(
+          std::floor(((color[channel] - p_bit) * 0.5F) + 0.5F));
+      quantized = std::clamp(quantized, 0, 127);
+      endpoint.quantized[channel] = static_cast<u8>(quantized);
+      r32 diff = static_cast<r32>((quantized << 1) | p_bit) - color[channel];
+      error += diff * diff;
+    }
+    if (best_error < 0.0F || error < best_error) {
+      best_error = error;
+      best = endpoint;
+    }
+  }
+  return best;
+}
+
+static void BC7Palette(const BC7Endpoint &end0, const BC7Endpoint &end1,
+                       u8 (*palette)[4]) {
+  for (u32 channel = 0; channel < 4; ++channel) {
+    u32 a = (end0.quantized[channel] << 1) | end0.p_bit;
+    u32 b = (end1.quantized[channel] << 1) | end1.p_bit;
+    for (u32 idx = 0; idx < 16; ++idx) {
+      u32 weight = bc7_weights4[idx];
+      palette[idx][channel] =
+          static_cast<u8>((((64 - weight) * a) + (weight * b) + 32) >> 6);
+    }
+  }
+}
+
+struct BC7Fit {
+  BC7Endpoint end0;
+  BC7Endpoint end1;
+  u8 indices[16];
+  u32 error;
+};
+
+static BC7Fit FitBC7Endpoints(const PixelBlock &block, const r32 *end0,
+                              const r32 *end1) {
+  BC7Fit fit;
+  fit.end0 = QuantizeBC7Endpoint(end0);
+  fit.end1 = QuantizeBC7Endpoint(end1);
+  u8 palette[16][4];
+  BC7Palette(fit.end0, fit.end1, palette);
+  fit.error = FitPalette(block, palette, 16, true, fit.indices);
+  return fit;
+}
+
+// LSB first writer for a 128 bit block
+class BlockBitWriter {
+ public:
+  explicit BlockBitWriter(u8 *_dest) : dest{_dest} { std::memset(dest, 0, 16); }
+
+  void WriteBits(u32 value, u32 count) {
+    for (u32 bit = 0; bit < count; ++bit, ++bit_pos) {
+      u32 bit_value = (value >> bit) & 1;
+      dest[bit_pos >> 3] |= static_cast<u8>(bit_value << (bit_pos & 7));
+    }
+  }
+
+ private:
+  u8 *dest;
+  u32 bit_pos = 0;
+};
+
+static void EncodeBC7Block(const PixelBlock &block, u8 *dest) {
+  r32 end0[4], end1[4];
+  AxisEndpoints(block, 4, end0, end1);
+  auto best = FitBC7Endpoints(block, end0, end1);
+  for (u32 iteration = 0; iteration < 2 && best.error > 0; ++iteration) {
+    if (!LeastSquaresEndpoints(block, 4, best.indices, bc7_fit_weights, end0,
+                               end1)) {
+      break;
+    }
+    auto refined = FitBC7Endpoints(block, end0, end1);
+    if (refined.error >= best.error) break;
+    best = refined;
+  }
+
+  // the first index is stored with one bit less, its top bit has to be 0
+  if (best.indices[0] & 0x8) {
+    std::swap(best.end0, best.end1);
+    for (auto &index : best.indices) index = static_cast<u8>(15 - index);
+  }
+
+  BlockBitWriter writer{dest};
+  writer.WriteBits(1 << 6, 7);
+  for (u32 channel = 0; channel < 4; ++channel) {
+    writer.WriteBits(best.end0.quantized[channel], 7);
+    writer.WriteBits(best.end1.quantized[channel], 7);
+  }
+  writer.WriteBits(best.end0.p_bit, 1);
+  writer.WriteBits(best.end1.p_bit, 1);
+  writer.WriteBits(best.indices[0], 3);
+  for (u32 idx = 1; idx < 16; ++idx) writer.WriteBits(best.indices[idx], 4);
+}
+
+static bool DecodeBC7Block(const u8 *src, PixelBlock &block) {
+  // mode n is stored as n zero bits followed by a one
+  if ((src[0] & 0x7F) != 0x40) return false;
+  u32 bit_pos = 7;
+  auto read_bits = [&](u32 count) {
+    u32 value = 0;
+    for (u32 bit = 0; bit < count; ++bit, ++bit_pos) {
+      value |= ((src[bit_pos >> 3] >> (bit_pos & 7)) & 1U) << bit;
+    }
+    return value;
+  };
+  BC7Endpoint end0, end1;
+  for (u32 channel = 0; channel < 4; ++channel) {
+    end0.quantized[channel] = static_cast<u8>(read_bits(7));
+    end1.quantized[channel] = static_cast<u8>(read_bits(7));
+  }
+  end0.p_bit = static_cast<u8>(read_bits(1));
+  end1.p_bit = static_cast<u8>(read_bits(1));
+  u8 palette[16][4];
+  BC7Palette(end0, end1, palette);
+  for (u32 idx = 0; idx < 16; ++idx) {
+    u32 index = read_bits(idx ? 4 : 3);
+    std::memcpy(block.rgba + (idx * 4), palette[index], 4);
+  }
+  return true;
+}
+
+//
+// Bitmaps
+//
+
+static bool IsEncodableSource(BitmapFormat format) {
+  return format == BitmapFormat::R8 || format == BitmapFormat::RGB8 ||
+         format == BitmapFormat::RGBA8;
+}
+
+std::expected<Bitmap, BitmapError> CompressBitmap(const Bitmap &bitmap,
+                                                  BitmapFormat format) {
+  if (!bitmap.IsValid() || !IsEncodableSource(bitmap.GetBitmapFormat()) ||
+      !Bitmap::IsBlockCompressed(format)) {
+    return std::unexpected(BitmapError{});
+  }
+  Bitmap result{bitmap.GetWidth(), bitmap.GetHeight(), format};
+  u32 blocks_x = (bitmap.GetWidth() + 3) / 4;
+  u32 blocks_y = (bitmap.GetHeight() + 3) / 4;
+  u32 block_bytes = Bitmap::FormatBlockBytes(format);
+  u8 *dest = result.GetBitmapWritePtr();
+
+  ThreadPool::GetThreadPool().ParallelForBatched(
+      blocks_y, 1, [&](size_t begin, size_t end, u32) {
+        PixelBlock block;
+        for (size_t block_y = begin; block_y < end; ++block_y) {
+          for (u32 block_x = 0; block_x < blocks_x; ++block_x) {
+            LoadBlock(bitmap, block_x, static_cast<u32>(block_y), block);
+            u8 *out =
+                dest + (((block_y * blocks_x) + block_x) * block_bytes);
+            switch (format) {
+              case BitmapFormat::BC1:
+                EncodeBC1Block(block, out);
+                break;
+              case BitmapFormat::BC3:
+                EncodeBC4Block(block, 3, out);
+                EncodeBC1Block(block, out + 8);
+                break;
+              case BitmapFormat::BC4:
+                EncodeBC4Block(block, 0, out);
+                break;
+              default:
+                EncodeBC7Block(block, out);
+                break;
+            }
+          }
+        }
+      });
+  return result;
+}
+
+std::expected<Bitmap, BitmapError> DecompressBitmap(const Bitmap &bitmap) {
+  auto format = bitmap.GetBitmapFormat();
+  if (!bitmap.IsValid() || !bitmap.IsBlockCompressed()) {
+    return std::unexpected(BitmapError{});
+  }
+  BitmapFormat result_format = (format == BitmapFormat::BC1)   ? RGB8
+                               : (format == BitmapFormat::BC4) ? R8
+                                                               : RGBA8;
+  Bitmap result{bitmap.GetWidth(), bitmap.GetHeight(), result_format};
+  u32 blocks_x = (bitmap.GetWidth() + 3) / 4;
+  u32 blocks_y = (bitmap.GetHeight() + 3) / 4;
+  u32 block_bytes = Bitmap::FormatBlockBytes(format);
+  const u8 *src = bitmap.GetBitmapPtr();
+
+  std::atomic<bool> valid = true;
+  ThreadPool::GetThreadPool().ParallelForBatched(
+      blocks_y, 1, [&](size_t begin, size_t end, u32) {
+        PixelBlock block;
+        std::memset(block.rgba, 255, sizeof(block.rgba));
+        for (size_t block_y = begin; block_y < end; ++block_y) {
+          for (u32 block_x = 0; block_x < blocks_x; ++block_x) {
+            const u8 *in =
+                src + (((block_y * blocks_x) + block_x) * block_bytes);
+            switch (format) {
+              case BitmapFormat::BC1:
+                DecodeBC1Block(in, false, block);
+                break;
+              case BitmapFormat::BC3:
+                DecodeBC4Block(in, 3, block);
+                DecodeBC1Block(in + 8, true, block);
+                break;
+              case BitmapFormat::BC4:
+                DecodeBC4Block(in, 0, block);
+                break;
+              default:
+                if (!DecodeBC7Block(in, block)) valid = false;
+                break;
+            }
+            StoreBlock(block, block_x, static_cast<u32>(block_y), result);
+          }
+        }
+      });
+  if (!valid) return std::unexpected(BitmapError{});
+  return result;
+}
+
+std::expected<std::vector<Bitmap>, BitmapError> CompressMipChain(
+    const Bitmap &bitmap, BitmapFormat format, const MipOptions &mip_options) {
+  auto base = CompressBitmap(bitmap, format);
+  if (!base) return std::unexpected(base.error());
+  auto mips = GenerateMips(bitmap, mip_options);
+  std::vector<Bitmap> levels;
+  levels.reserve(mips.size() + 1);
+  levels.push_back(std::move(base.value()));
+  for (const auto &mip : mips) {
+    auto level = CompressBitmap(mip, format);
+    if (!level) return std::unexpected(level.error());
+    levels.push_back(std::move(level.value()));
+  }
+  return levels;
+}
+
+}  // namespace quixotism
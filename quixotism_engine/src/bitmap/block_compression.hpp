@@ -0,0 +1,32 @@
+#pragma once
+#include <expected>
+#include <vector>
+
+#include "bitmap/bitmap.hpp"
+#include "bitmap/mipmap.hpp"
+#include "quixotism_c.hpp"
+
+namespace quixotism {
+
+// Encodes an R8, RGB8 or RGBA8 bitmap into a block compressed format:
+//  BC1 - RGB, 8 bytes per block, alpha is dropped
+//  BC3 - RGBA, 16 bytes per block
+//  BC4 - the first channel, 8 bytes per block
+//  BC7 - RGBA, 16 bytes per block. Only mode 6 (a single endpoint pair with
+//        16 index levels) is used, the usual fast BC7 mode.
+// Gray bitmaps are RGB with equal channels. Partial blocks at the right and
+// bottom edge repeat the edge texels. Rows of blocks are encoded in parallel.
+std::expected<Bitmap, BitmapError> CompressBitmap(const Bitmap &bitmap,
+                                                  BitmapFormat format);
+
+// Decodes a block compressed bitmap: BC1 to RGB8, BC3 and BC7 to RGBA8, BC4 to
+// R8. Fails for BC7 blocks in other modes than the one CompressBitmap writes.
+std::expected<Bitmap, BitmapError> DecompressBitmap(const Bitmap &bitmap);
+
+// Full mip chain of the bitmap (level 0 first) with every level compressed,
+// the levels are filtered from the uncompressed bitmap
+std::expected<std::vector<Bitmap>, BitmapError> CompressMipChain(
+    const Bitmap &bitmap, BitmapFormat format,
+    const MipOptions &mip_options = {});
+
+}  // namespace quixotism
@@ -0,0 +1,440 @@
+#include "bitmap/mipmap.hpp"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <span>
+
+#include "cpu_features.hpp"
+#include "thread_pool.hpp"
+
+namespace quixotism {
+
+static constexpr u32 MAX_TAPS = 6;
+
+// Separable 2x decimation kernel, destination texel x is filtered from the
+// source texels 2x + first_offset to 2x + first_offset + tap_count - 1
+// (clamped to the edge)
+struct MipKernel {
+  i32 first_offset;
+  u32 tap_count;
+  r32 weights[MAX_TAPS];
+};
+
+static constexpr MipKernel box_kernel = {0, 2, {0.5F, 0.5F}};
+// axes that are already down to a single texel only get copied
+static constexpr MipKernel copy_kernel = {0, 1, {1.0F}};
+
+static const MipKernel &KaiserKernel() {
+  static const MipKernel kernel = [] {
+    // sinc windowed by a Kaiser window with a radius of 3 source texels
+    constexpr r64 radius = 1.5;
+    constexpr r64 beta = 4.0;
+    constexpr r64 pi = 3.14159265358979323846;
+    auto bessel_i0 = [](r64 x) {
+      r64 sum = 1.0, term = 1.0;
+      for (u32 k = 1; k < 20; ++k) {
+        term *= x / (2.0 * k);
+        sum += term * term;
+      }
+      return sum;
+    };
+    MipKernel result = {-2, MAX_TAPS, {}};
+    r64 weights[MAX_TAPS];
+    r64 weight_sum = 0.0;
+    for (u32 tap = 0; tap < MAX_TAPS; ++tap) {
+      // distance to the destination texel center in destination texels
+      r64 t = (static_cast<r64>(tap) - 2.5) * 0.5;
+      r64 sinc = std::sin(pi * t) / (pi * t);
+      r64 r = t / radius;
+      r64 window = bessel_i0(beta * std::sqrt(1.0 - (r * r))) / bessel_i0(beta);
+      weights[tap] = sinc * window;
+      weight_sum += weights[tap];
+    }
+    for (u32 tap = 0; tap < MAX_TAPS; ++tap) {
+      result.weights[tap] = static_cast<r32>(weights[tap] / weight_sum);
+    }
+    return result;
+  }();
+  return kernel;
+}
+
+//
+// Color conversion
+//
+
+// linear values are quantized to this many steps to look up their sRGB byte,
+// that is finer than one byte step even at the steep dark end of the curve
+static constexpr u32 SRGB_ENCODE_STEPS = 4096;
+
+struct ColorTables {
+  r32 to_linear[256];
+  u8 to_srgb[SRGB_ENCODE_STEPS + 1];
+};
+
+static const ColorTables &GetColorTables() {
+  static const ColorTables tables = [] {
+    ColorTables result;
+    for (u32 value = 0; value < 256; ++value) {
+      r64 srgb = value / 255.0;
+      result.to_linear[value] = static_cast<r32>(
+          (srgb <= 0.04045) ? (srgb / 12.92)
+                            : std::pow((srgb + 0.055) / 1.055, 2.4));
+    }
+    for (u32 step = 0; step <= SRGB_ENCODE_STEPS; ++step) {
+      r64 linear = static_cast<r64>(step) / SRGB_ENCODE_STEPS;
+      r64 srgb = (linear <= 0.0031308)
+                     ? (linear * 12.92)
+                     : ((1.055 * std::pow(linear, 1.0 / 2.4)) - 0.055);
+      result.to_srgb[step] = static_cast<u8>((srgb * 255.0) + 0.5);
+    }
+    return result;
+  }();
+  return tables;
+}
+
+// Float copies keep one value per texel for R8 and four (RGB padded) for the
+// other formats, so a texel fills exactly one SSE register
+static u32 FloatStride(u32 channels) { return (channels == 1) ? 1 : 4; }
+
+struct FloatLevel {
+  u32 width = 0;
+  u32 height = 0;
+  std::vector<r32> texels;
+};
+
+// bitmap row -> linear, alpha weighted floats
+static void DecodeRow(const u8 *src, u32 width, u32 channels, bool srgb,
+                      r32 *dest) {
+  const auto &tables = GetColorTables();
+  auto color = [&](u8 value) {
+    return srgb ? tables.to_linear[value] : (value * (1.0F / 255.0F));
+  };
+  switch (channels) {
+    case 1:
+      for (u32 x = 0; x < width; ++x) dest[x] = color(src[x]);
+      break;
+    case 3:
+      for (u32 x = 0; x < width; ++x, src += 3, dest += 4) {
+        dest[0] = color(src[0]);
+        dest[1] = color(src[1]);
+        dest[2] = color(src[2]);
+        dest[3] = 1.0F;
+      }
+      break;
+    default:
+      for (u32 x = 0; x < width; ++x, src += 4, dest += 4) {
+        r32 alpha = src[3] * (1.0F / 255.0F);
+        dest[0] = color(src[0]) * alpha;
+        dest[1] = color(src[1]) * alpha;
+        dest[2] = color(src[2]) * alpha;
+        dest[3] = alpha;
+      }
+      break;
+  }
+}
+
+// floats -> bitmap row, the inverse of DecodeRow
+static void EncodeRow(const r32 *src, u32 width, u32 channels, bool srgb,
+                      u8 *dest) {
+  const auto &tables = GetColorTables();
+  // Kaiser lobes can over and undershoot
+  auto color = [&](r32 value) {
+    value = std::clamp(value, 0.0F, 1.0F);
+    return srgb ? tables.to_srgb[static_cast<u32>(
+                      (value * SRGB_ENCODE_STEPS) + 0.5F)]
+                : static_cast<u8>((value * 255.0F) + 0.5F);
+  };
+  switch (channels) {
+    case 1:
+      for (u32 x = 0; x < width; ++x) dest[x] = color(src[x]);
+      break;
+    case 3:
+      for (u32 x = 0; x < width; ++x, src += 4, dest += 3) {
+        dest[0] = color(src[0]);
+        dest[1] = color(src[1]);
+        dest[2] = color(src[2]);
+      }
+      break;
+    default:
+      for (u32 x = 0; x < width; ++x, src += 4, dest += 4) {
+        r32 alpha = std::clamp(src[3], 0.0F, 1.0F);
+        r32 inv_alpha = (alpha > 0.0F) ? (1.0F / alpha) : 0.0F;
+        dest[0] = color(src[0] * inv_alpha);
+        dest[1] = color(src[1] * inv_alpha);
+        dest[2] = color(src[2] * inv_alpha);
+        dest[3] = static_cast<u8>((alpha * 255.0F) + 0.5F);
+      }
+      break;
+  }
+}
+
+//
+// Filter passes
+//
+
+// dest[i] = sum of weights[tap] * rows[tap][i]
+static void VerticalPass(const r32 *const *rows, const r32 *weights,
+                         u32 tap_count, r32 *dest, size_t count) {
+  size_t idx = 0;
+  for (; idx + 4 <= count; idx += 4) {
+    auto sum = _mm_mul_ps(_mm_loadu_ps(rows[0] + idx), _mm_set1_ps(weights[0]));
+    for (u32 tap = 1; tap < tap_count; ++tap) {
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[tap] + idx),
+                                       _mm_set1_ps(weights[tap])));
+    }
+    _mm_storeu_ps(dest + idx, sum);
+  }
+  for (; idx < count; ++idx) {
+    r32 sum = 0.0F;
+    for (u32 tap = 0; tap < tap_count; ++tap) {
+      sum += rows[tap][idx] * weights[tap];
+    }
+    dest[idx] = sum;
+  }
+}
+
+TARGET_AVX2 static void VerticalPassAVX2(const r32 *const *rows,
+                                         const r32 *weights, u32 tap_count,
+                                         r32 *dest, size_t count) {
+  size_t idx = 0;
+  for (; idx + 8 <= count; idx += 8) {
+    auto sum = _mm256_mul_ps(_mm256_loadu_ps(rows[0] + idx),
+                             _mm256_set1_ps(weights[0]));
+    for (u32 tap = 1; tap < tap_count; ++tap) {
+      sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(rows[tap] + idx),
+                                             _mm256_set1_ps(weights[tap])));
+    }
+    _mm256_storeu_ps(dest + idx, sum);
+  }
+  _mm256_zeroupper();
+  const r32 *rest[MAX_TAPS];
+  for (u32 tap = 0; tap < tap_count; ++tap) rest[tap] = rows[tap] + idx;
+  VerticalPass(rest, weights, tap_count, dest + idx, count - idx);
+}
+
+// Filters and decimates a row horizontally. src needs 8 floats of readable
+// slack past its end.
+static void HorizontalPass(const r32 *src, u32 src_width, u32 stride,
+                           const MipKernel &kernel, r32 *dest,
+                           u32 dest_width) {
+  auto src_x = [&](u32 x, u32 tap) {
+    i32 pos = static_cast<i32>(2 * x) + kernel.first_offset +
+              static_cast<i32>(tap);
+    return static_cast<u32>(
+        std::clamp(pos, 0, static_cast<i32>(src_width) - 1));
+  };
+
+  if (stride == 4) {
+    for (u32 x = 0; x < dest_width; ++x) {
+      auto sum = _mm_setzero_ps();
+      for (u32 tap = 0; tap < kernel.tap_count; ++tap) {
+        auto texel = _mm_loadu_ps(src + (src_x(x, tap) * 4));
+        sum = _mm_add_ps(sum,
+                         _mm_mul_ps(texel, _mm_set1_ps(kernel.weights[tap])));
+      }
+      _mm_storeu_ps(dest + (x * 4), sum);
+    }
+    return;
+  }
+
+  auto filter_scalar = [&](u32 x) {
+    r32 sum = 0.0F;
+    for (u32 tap = 0; tap < kernel.tap_count; ++tap) {
+      sum += src[src_x(x, tap)] * kernel.weights[tap];
+    }
+    dest[x] = sum;
+  };
+  i32 last_tap = kernel.first_offset + static_cast<i32>(kernel.tap_count) - 1;
+  u32 x = 0;
+  // clamped taps on the left edge
+  for (; x < dest_width && (static_cast<i32>(2 * x) + kernel.first_offset) < 0;
+       ++x) {
+    filter_scalar(x);
+  }
+  // 4 texels at a time, each tap gathers every second source value
+  for (; x + 4 <= dest_width &&
+         static_cast<i32>(2 * x) + 6 + last_tap < static_cast<i32>(src_width);
+       x += 4) {
+    auto sum = _mm_setzero_ps();
+    for (u32 tap = 0; tap < kernel.tap_count; ++tap) {
+      const r32 *base = src + (2 * x) + kernel.first_offset + tap;
+      auto even = _mm_shuffle_ps(_mm_loadu_ps(base), _mm_loadu_ps(base + 4),
+                                 _MM_SHUFFLE(2, 0, 2, 0));
+      sum = _mm_add_ps(sum, _mm_mul_ps(even, _mm_set1_ps(kernel.weights[tap])));
+    }
+    _mm_storeu_ps(dest + x, sum);
+  }
+  for (; x < dest_width; ++x) filter_scalar(x);
+}
+
+//
+// Levels
+//
+
+struct MipLevelJob {
+  // the base bitmap for level 1, the float copy of the level above after that
+  const Bitmap *src_bitmap;
+  const FloatLevel *src_level;
+  u32 src_width;
+  u32 src_height;
+  // float copy for the next level, nullptr for the last level
+  FloatLevel *dest_level;
+  Bitmap *dest_bitmap;
+};
+
+struct MipScratch {
+  // decoded rows of the base bitmap, one per vertical tap
+  std::vector<r32> tap_rows;
+  std::vector<r32> vertical;
+  std::vector<r32> dest_row;
+};
+
+static void FilterRow(const MipLevelJob &job, u32 y, u32 channels,
+                      const MipKernel &kernel, bool srgb,
+                      MipScratch &scratch) {
+  static const bool use_avx2 = GetCPUFeatures().avx2;
+  u32 stride = FloatStride(channels);
+  size_t src_row_size = static_cast<size_t>(job.src_width) * stride;
+  u32 dest_width = job.dest_bitmap->GetWidth();
+  const auto &vertical_kernel = (job.src_height > 1) ? kernel : copy_kernel;
+  const auto &horizontal_kernel = (job.src_width > 1) ? kernel : copy_kernel;
+
+  const r32 *rows[MAX_TAPS];
+  for (u32 tap = 0; tap < vertical_kernel.tap_count; ++tap) {
+    i32 src_y = std::clamp(static_cast<i32>(2 * y) +
+                               vertical_kernel.first_offset +
+                               static_cast<i32>(tap),
+                           0, static_cast<i32>(job.src_height) - 1);
+    if (job.src_level) {
+      rows[tap] = job.src_level->texels.data() + (src_y * src_row_size);
+    } else {
+      r32 *row = scratch.tap_rows.data() + (tap * src_row_size);
+      DecodeRow(job.src_bitmap->GetBitmapPtr() +
+                    (static_cast<size_t>(src_y) * job.src_width * channels),
+                job.src_width, channels, srgb, row);
+      rows[tap] = row;
+    }
+  }
+  if (use_avx2) {
+    VerticalPassAVX2(rows, vertical_kernel.weights, vertical_kernel.tap_count,
+                     scratch.vertical.data(), src_row_size);
+  } else {
+    VerticalPass(rows, vertical_kernel.weights, vertical_kernel.tap_count,
+                 scratch.vertical.data(), src_row_size);
+  }
+
+  size_t dest_row_size = static_cast<size_t>(dest_width) * stride;
+  r32 *dest_row = job.dest_level
+                      ? job.dest_level->texels.data() + (y * dest_row_size)
+                      : scratch.dest_row.data();
+  HorizontalPass(scratch.vertical.data(), job.src_width, stride,
+                 horizontal_kernel, dest_row, dest_width);
+  EncodeRow(dest_row, dest_width, channels, srgb,
+            job.dest_bitmap->GetBitmapWritePtr() +
+                (static_cast<size_t>(y) * dest_width * channels));
+}
+
+// Builds the chains of bitmaps that share size and format level by level,
+// the rows of all of them go through the thread pool together
+static void GenerateMipChains(std::span<const Bitmap *const> bitmaps,
+                              const MipOptions &options,
+                              std::span<std::vector<Bitmap>> chains) {
+  u32 width = bitmaps[0]->GetWidth(), height = bitmaps[0]->GetHeight();
+  auto format = bitmaps[0]->GetBitmapFormat();
+  u32 channels = static_cast<u32>(Bitmap::FormatChannelCount(format));
+  Assert(channels == 1 || channels == 3 || channels == 4);
+  u32 stride = FloatStride(channels);
+  const auto &kernel =
+      (options.filter == MipFilter::KAISER) ? KaiserKernel() : box_kernel;
+
+  auto &pool = ThreadPool::GetThreadPool();
+  std::vector<MipScratch> scratch(pool.GetThreadCount());
+  std::vector<FloatLevel> src_levels(bitmaps.size());
+  std::vector<FloatLevel> dest_levels(bitmaps.size());
+  std::vector<MipLevelJob> jobs(bitmaps.size());
+
+  u32 level_count = MipLevelCount(width, height);
+  for (const auto *bitmap : bitmaps) {
+    Assert(bitmap->GetWidth() == width && bitmap->GetHeight() == height);
+    Assert(bitmap->GetBitmapFormat() == format);
+  }
+  for (auto &chain : chains) chain.reserve(level_count - 1);
+
+  u32 src_width = width, src_height = height;
+  for (u32 level = 1; level < level_count; ++level) {
+    u32 dest_width = std::max(src_width / 2, 1U);
+    u32 dest_height = std::max(src_height / 2, 1U);
+    bool last_level = (level + 1 == level_count);
+    size_t src_row_size = static_cast<size_t>(src_width) * stride;
+
+    for (u32 idx = 0; idx < bitmaps.size(); ++idx) {
+      chains[idx].emplace_back(dest_width, dest_height, format);
+      auto &dest_level = dest_levels[idx];
+      if (!last_level) {
+        dest_level.width = dest_width;
+        dest_level.height = dest_height;
+        dest_level.texels.resize(static_cast<size_t>(dest_width) *
+                                 dest_height * stride);
+      }
+      jobs[idx] = {(level == 1) ? bitmaps[idx] : nullptr,
+                   (level == 1) ? nullptr : &src_levels[idx],
+                   src_width,
+                   src_height,
+                   last_level ? nullptr : &dest_level,
+                   &chains[idx].back()};
+    }
+    for (auto &thread_scratch : scratch) {
+      if (level == 1) {
+        thread_scratch.tap_rows.resize(MAX_TAPS * src_row_size);
+      }
+      // HorizontalPass reads a little past the end
+      thread_scratch.vertical.resize(src_row_size + 8);
+      thread_scratch.dest_row.resize(static_cast<size_t>(dest_width) * stride);
+    }
+
+    size_t min_batch = std::max<size_t>(1, Kilobytes(16) / dest_width);
+    pool.ParallelForBatched(
+        bitmaps.size() * dest_height, min_batch,
+        [&](size_t begin, size_t end, u32 thread_idx) {
+          for (size_t row = begin; row < end; ++row) {
+            FilterRow(jobs[row / dest_height],
+                      static_cast<u32>(row % dest_height), channels, kernel,
+                      options.srgb, scratch[thread_idx]);
+          }
+        });
+
+    std::swap(src_levels, dest_levels);
+    src_width = dest_width;
+    src_height = dest_height;
+  }
+}
+
+u32 MipLevelCount(u32 width, u32 height) {
+  return static_cast<u32>(std::bit_width(std::max({width, height, 1U})));
+}
+
+std::vector<Bitmap> GenerateMips(const Bitmap &bitmap,
+                                 const MipOptions &options) {
+  std::vector<Bitmap> chain;
+  if (!bitmap.IsValid()) return chain;
+  const Bitmap *bitmaps[] = {&bitmap};
+  GenerateMipChains(bitmaps, options, {&chain, 1});
+  return chain;
+}
+
+std::array<std::vector<Bitmap>, 6> GenerateCubeMips(
+    const CubeBitmap &faces, const MipOptions &options) {
+  std::array<std::vector<Bitmap>, 6> chains;
+  const Bitmap *bitmaps[6];
+  for (u32 face = 0; face < 6; ++face) {
+    if (!faces[face].IsValid()) return chains;
+    bitmaps[face] = &faces[face];
+  }
+  GenerateMipChains(bitmaps, options, chains);
+  return chains;
+}
+
+}  // namespace quixotism
@@ -0,0 +1,43 @@
+#pragma once
+#include <array>
+#include <vector>
+
+#include "bitmap/bitmap.hpp"
+#include "quixotism_c.hpp"
+
+namespace quixotism {
+
+enum class MipFilter {
+  // 2x2 average, the fastest
+  BOX,
+  // 6x6 Kaiser windowed sinc, keeps the smaller levels sharper than the box
+  // filter without letting fine detail alias
+  KAISER,
+};
+
+struct MipOptions {
+  MipFilter filter = MipFilter::BOX;
+  // Color channels hold sRGB encoded values and get filtered in linear space,
+  // turn this off for data textures (normal maps, masks...). Alpha is always
+  // linear, and colors of RGBA bitmaps are weighted by it so transparent
+  // texels do not bleed into their neighbours.
+  bool srgb = true;
+};
+
+// Levels of a full mip chain for the size, the base level included
+u32 MipLevelCount(u32 width, u32 height);
+
+// Generates levels 1 to MipLevelCount() - 1 of the mip chain of an R8, RGB8 or
+// RGBA8 bitmap, level 0 is the bitmap itself. Each level halves the size
+// (rounding down, like GL) and is filtered from a linear float copy of the
+// level above it, so rounding errors do not add up along the chain. The rows
+// of a level are spread over the thread pool.
+std::vector<Bitmap> GenerateMips(const Bitmap &bitmap,
+                                 const MipOptions &options = {});
+
+// GenerateMips for the six faces of a cube map, all faces of a level are
+// filtered in one parallel pass
+std::array<std::vector<Bitmap>, 6> GenerateCubeMips(
+    const CubeBitmap &faces, const MipOptions &options = {});
+
+}  // namespace quixotism
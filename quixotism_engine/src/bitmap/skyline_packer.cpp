@@ -0,0 +1,117 @@
+#include "bitmap/skyline_packer.hpp"
+
+#include <algorithm>
+
+namespace quixotism {
+
+void SkylinePacker::Reset(u32 _width, u32 _height) {
+  width = _width;
+  height = _height;
+  used_area = 0;
+  skyline.clear();
+  skyline.push_back({0, 0, width});
+}
+
+void SkylinePacker::Grow(u32 new_width, u32 new_height) {
+  Assert(new_width >= width && new_height >= height);
+  if (new_width > width) {
+    // the new columns are empty, so they extend the skyline at the floor
+    if (skyline.back().y == 0) {
+      skyline.back().width += new_width - width;
+    } else {
+      skyline.push_back({width, 0, new_width - width});
+    }
+  }
+  width = new_width;
+  height = new_height;
+}
+
+std::optional<PackerRect> SkylinePacker::Insert(u32 rect_width,
+                                                u32 rect_height) {
+  if (rect_width == 0 || rect_height == 0) {
+    return PackerRect{0, 0, rect_width, rect_height};
+  }
+
+  size_t best_idx = skyline.size();
+  u32 best_y = 0, best_top = ~0U;
+  u64 best_waste = ~0ULL;
+  for (size_t idx = 0; idx < skyline.size(); ++idx) {
+    auto y = Fit(idx, rect_width, rect_height);
+    if (!y) continue;
+    auto top = *y + rect_height;
+    if (top > best_top) continue;
+    auto waste = WastedArea(idx, rect_width, *y);
+    if (top < best_top || waste < best_waste) {
+      best_idx = idx;
+      best_y = *y;
+      best_top = top;
+      best_waste = waste;
+    }
+  }
+  if (best_idx == skyline.size()) return std::nullopt;
+
+  PackerRect rect{skyline[best_idx].x, best_y, rect_width, rect_height};
+  AddSegment(best_idx, rect);
+  used_area += static_cast<u64>(rect_width) * rect_height;
+  return rect;
+}
+
+std::optional<u32> SkylinePacker::Fit(size_t segment_idx, u32 rect_width,
+                                      u32 rect_height) const {
+  if (skyline[segment_idx].x + rect_width > width) return std::nullopt;
+
+  // the rect rests on the highest segment below it
+  u32 y = 0;
+  u32 width_left = rect_width;
+  for (size_t idx = segment_idx; width_left > 0; ++idx) {
+    Assert(idx < skyline.size());
+    y = std::max(y, skyline[idx].y);
+    if (y + rect_height > height) return std::nullopt;
+    if (skyline[idx].width >= width_left) break;
+    width_left -= skyline[idx].width;
+  }
+  return y;
+}
+
+u64 SkylinePacker::WastedArea(size_t segment_idx, u32 rect_width,
+                              u32 y) const {
+  u64 waste = 0;
+  u32 width_left = rect_width;
+  for (size_t idx = segment_idx; width_left > 0; ++idx) {
+    auto covered = std::min(width_left, skyline[idx].width);
+    waste += static_cast<u64>(y - skyline[idx].y) * covered;
+    width_left -= covered;
+  }
+  return waste;
+}
+
+void SkylinePacker::AddSegment(size_t segment_idx, const PackerRect &rect) {
+  Segment segment{rect.x, rect.y + rect.height, rect.width};
+  skyline.insert(skyline.begin() + segment_idx, segment);
+
+  // cut away the parts of the following segments the rect now covers
+  auto right = segment.x + segment.width;
+  auto idx = segment_idx + 1;
+  while (idx < skyline.size() && skyline[idx].x < right) {
+    auto overlap = right - skyline[idx].x;
+    if (skyline[idx].width <= overlap) {
+      skyline.erase(skyline.begin() + idx);
+    } else {
+      skyline[idx].x += overlap;
+      skyline[idx].width -= overlap;
+      break;
+    }
+  }
+
+  // merge neighbours at the same height
+  for (idx = 1; idx < skyline.size();) {
+    if (skyline[idx - 1].y == skyline[idx].y) {
+      skyline[idx - 1].width += skyline[idx].width;
+      skyline.erase(skyline.begin() + idx);
+    } else {
+      ++idx;
+    }
+  }
+}
+
+}  // namespace quixotism
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include "quixotism_c.hpp"
+
+namespace quixotism {
+
+struct PackerRect {
+  u32 x, y;
+  u32 width, height;
+};
+
+/**
+ * Skyline rectangle packer (bottom-left heuristic).
+ *
+ * The packer keeps the upper contour ("skyline") of everything packed so far
+ * as a list of horizontal segments. A new rect is placed on top of the
+ * skyline where its top edge ends up lowest, ties go to the spot that wastes
+ * the least area below the rect.
+ *
+ * Insertion is incremental: rects never move once placed, and growing the
+ * packing area keeps every existing placement valid, so adding items to an
+ * atlas never requires a full repack. The area does not have to be square.
+ */
+class SkylinePacker {
+ public:
+  SkylinePacker() = default;
+  SkylinePacker(u32 width, u32 height) { Reset(width, height); }
+
+  void Reset(u32 width, u32 height);
+  // Grows the packing area, existing placements stay where they are
+  void Grow(u32 new_width, u32 new_height);
+
+  // Returns the placement of a width x height rect, or nullopt if it does not
+  // fit anymore
+  std::optional<PackerRect> Insert(u32 width, u32 height);
+
+  u32 GetWidth() const { return width; }
+  u32 GetHeight() const { return height; }
+  u64 GetUsedArea() const { return used_area; }
+  // fraction of the packing area covered by rects
+  r32 GetOccupancy() const {
+    return static_cast<r32>(static_cast<r64>(used_area) /
+                            (static_cast<r64>(width) * height));
+  }
+
+ private:
+  struct Segment {
+    u32 x, y, width;
+  };
+
+  // y the rect would sit at if its left edge was at segment_idx, nullopt if
+  // it does not fit there
+  std::optional<u32> Fit(size_t segment_idx, u32 rect_width,
+                         u32 rect_height) const;
+  u64 WastedArea(size_t segment_idx, u32 rect_width, u32 y) const;
+  void AddSegment(size_t segment_idx, const PackerRect &rect);
+
+  std::vector<Segment> skyline;
+  u32 width = 0;
+  u32 height = 0;
+  u64 used_area = 0;
+};
+
+}  // namespace quixotism
@@ -0,0 +1,99 @@
+#include "bitmap/texture_atlas.hpp"
+
+#include "dbg_print.hpp"
+#include "math/basic.hpp"
+
+namespace quixotism {
+
+TextureAtlas::TextureAtlas(BitmapFormat _format, u32 _layer_width,
+                           u32 _layer_height, u32 _max_layers, u32 _padding)
+    : format{_format},
+      layer_width{_layer_width},
+      layer_height{_layer_height},
+      max_layers{_max_layers},
+      padding{_padding} {
+  Assert(Bitmap::FormatBytesPerPixel(format) > 0);
+  Assert(max_layers > 0);
+}
+
+std::expected<AtlasEntry, BitmapError> TextureAtlas::Add(const Bitmap &bitmap) {
+  if (bitmap.GetBitmapFormat() != format) {
+    DBG_PRINT("texture atlas: bitmap format does not match the atlas format");
+    return std::unexpected(BitmapError{});
+  }
+
+  const auto [width, height] = bitmap.GetDim();
+  u32 padded_width = width + (2 * padding);
+  u32 padded_height = height + (2 * padding);
+  if (padded_width > layer_width || padded_height > layer_height) {
+    DBG_PRINT("texture atlas: bitmap is bigger than an atlas layer");
+    return std::unexpected(BitmapError{});
+  }
+
+  // first fit over the layers, older layers are usually the fuller ones so
+  // this keeps the newest layer free for big bitmaps
+  std::optional<PackerRect> rect;
+  u32 layer_idx = 0;
+  for (; layer_idx < layers.size(); ++layer_idx) {
+    rect = layers[layer_idx].packer.Insert(padded_width, padded_height);
+    if (rect) break;
+  }
+  if (!rect) {
+    if (!AddLayer()) {
+      DBG_PRINT("texture atlas: out of layers");
+      return std::unexpected(BitmapError{});
+    }
+    layer_idx = GetLayerCount() - 1;
+    rect = layers[layer_idx].packer.Insert(padded_width, padded_height);
+    Assert(rect);
+  }
+
+  auto &layer = layers[layer_idx];
+  u32 x = rect->x + padding;
+  u32 y = rect->y + padding;
+  CopyBitmap(bitmap, layer.packed.bitmap, x, y);
+  layer.dirty_min_x = Min(layer.dirty_min_x, x);
+  layer.dirty_min_y = Min(layer.dirty_min_y, y);
+  layer.dirty_max_x = Max(layer.dirty_max_x, x + width);
+  layer.dirty_max_y = Max(layer.dirty_max_y, y + height);
+
+  AtlasEntry entry;
+  entry.layer = layer_idx;
+  entry.coord.lower_left = Vec2{static_cast<r32>(x) / layer_width,
+                                static_cast<r32>(y) / layer_height};
+  entry.coord.top_right = Vec2{static_cast<r32>(x + width) / layer_width,
+                               static_cast<r32>(y + height) / layer_height};
+  layer.packed.coords.push_back(entry.coord);
+  return entry;
+}
+
+TextureAtlas::Region TextureAtlas::GetDirtyRegion(u32 layer_idx) const {
+  const auto &layer = layers[layer_idx];
+  return {layer.dirty_min_x, layer.dirty_min_y,
+          layer.dirty_max_x - layer.dirty_min_x,
+          layer.dirty_max_y - layer.dirty_min_y};
+}
+
+void TextureAtlas::ClearDirtyRegion(u32 layer_idx) {
+  auto &layer = layers[layer_idx];
+  layer.dirty_min_x = layer_width;
+  layer.dirty_min_y = layer_height;
+  layer.dirty_max_x = layer.dirty_max_y = 0;
+}
+
+bool TextureAtlas::AddLayer() {
+  if (layers.size() >= max_layers) return false;
+
+  Layer layer;
+  layer.packed.bitmap = Bitmap{layer_width, layer_height, format};
+  layer.packer.Reset(layer_width, layer_height);
+  // the whole layer is uploaded once so the texture does not keep undefined
+  // texels in the padding between bitmaps
+  layer.dirty_min_x = layer.dirty_min_y = 0;
+  layer.dirty_max_x = layer_width;
+  layer.dirty_max_y = layer_height;
+  layers.push_back(std::move(layer));
+  return true;
+}
+
+}  // namespace quixotism
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <expected>
+#include <vector>
+
+#include "bitmap/bitmap.hpp"
+#include "bitmap/skyline_packer.hpp"
+#include "quixotism_c.hpp"
+
+namespace quixotism {
+
+struct AtlasEntry {
+  // layer of the array texture the bitmap got packed into
+  u32 layer;
+  BitmapCoord coord;
+};
+
+/**
+ * Incrementally built atlas for many small runtime bitmaps (sprites, icons,
+ * small material textures).
+ *
+ * Bitmaps get packed into fixed size layers (one SkylinePacker per layer),
+ * when a bitmap does not fit into any existing layer a new one is opened, up
+ * to max_layers. Already packed bitmaps never move, so handed out UV rects
+ * stay valid for the lifetime of the atlas.
+ *
+ * This only does the packing and the CPU side composition, every layer keeps
+ * track of the region that changed since the last upload so the renderer can
+ * update the matching array texture layer (see UploadTextureAtlas).
+ */
+class TextureAtlas {
+ public:
+  static constexpr u32 DEFAULT_LAYER_DIM = 2048;
+  static constexpr u32 DEFAULT_MAX_LAYERS = 8;
+
+  struct Region {
+    u32 x, y, width, height;
+  };
+
+  CLASS_DELETE_COPY(TextureAtlas);
+  CLASS_DEFAULT_MOVE(TextureAtlas);
+  explicit TextureAtlas(BitmapFormat format,
+                        u32 layer_width = DEFAULT_LAYER_DIM,
+                        u32 layer_height = DEFAULT_LAYER_DIM,
+                        u32 max_layers = DEFAULT_MAX_LAYERS, u32 padding = 2);
+
+  // Packs the bitmap and copies it into its layer. Fails if the format does
+  // not match or the atlas is full.
+  std::expected<AtlasEntry, BitmapError> Add(const Bitmap &bitmap);
+
+  BitmapFormat GetFormat() const { return format; }
+  u32 GetLayerWidth() const { return layer_width; }
+  u32 GetLayerHeight() const { return layer_height; }
+  u32 GetMaxLayers() const { return max_layers; }
+  u32 GetLayerCount() const { return static_cast<u32>(layers.size()); }
+  // coords of every bitmap in the layer, in the order they were added
+  const PackedBitmap &GetLayer(u32 layer) const { return layers[layer].packed; }
+  r32 GetLayerOccupancy(u32 layer) const {
+    return layers[layer].packer.GetOccupancy();
+  }
+
+  bool HasDirtyRegion(u32 layer) const {
+    return layers[layer].dirty_max_x > layers[layer].dirty_min_x;
+  }
+  Region GetDirtyRegion(u32 layer) const;
+  void ClearDirtyRegion(u32 layer);
+
+ private:
+  struct Layer {
+    PackedBitmap packed;
+    SkylinePacker packer;
+    u32 dirty_min_x, dirty_min_y, dirty_max_x, dirty_max_y;
+  };
+
+  bool AddLayer();
+
+  BitmapFormat format;
+  u32 layer_width;
+  u32 layer_height;
+  u32 max_layers;
+  u32 padding;
+  std::vector<Layer> layers;
+};
+
+}  // namespace quixotism
@@ -52,7 +52,7 @@ class BucketArray {
     }
   }
 
-  [[no_discard]] T* Get(const IdType id) {
+  [[nodiscard]] T* Get(const IdType id) {
     if (Exists(id)) {
       return &elements[id];
     } else {
@@ -60,7 +60,7 @@ class BucketArray {
     }
   }
 
-  [[no_discard]] const T* Get(const IdType id) const {
+  [[nodiscard]] const T* Get(const IdType id) const {
     if (Exists(id)) {
       return &elements[id];
     } else {
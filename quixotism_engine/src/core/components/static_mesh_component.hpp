@@ -14,8 +14,8 @@ class StaticMeshComponent : public Component {
       : sm_id{_sm_id}, mat_id{_mat_id} {}
   static ComponentType Type() { return ComponentType::STATIC_MESH; }
 
-  [[no_discard]] StaticMeshId GetStaticMeshId() const { return sm_id; }
-  [[no_discard]] MaterialID GetMaterialID() const { return mat_id; }
+  [[nodiscard]] StaticMeshId GetStaticMeshId() const { return sm_id; }
+  [[nodiscard]] MaterialID GetMaterialID() const { return mat_id; }
 
  private:
   StaticMeshId sm_id;
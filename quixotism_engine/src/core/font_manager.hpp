@@ -18,7 +18,7 @@ class FontManager : public BucketArray<FontSet> {
 
     u32 idx = 0;
     r32 diff = Abs(scale - font_set->fonts[idx].GetScale());
-    for (u32 i = 1; i < ArrayCount(FontSet::font_sizes); ++i) {
+    for (u32 i = 1; i < font_set->font_count; ++i) {
         auto new_diff = Abs(scale - font_set->fonts[i].GetScale());
         if (new_diff < diff) {
             diff = new_diff;
@@ -35,7 +35,7 @@ class FontManager : public BucketArray<FontSet> {
 
     u32 idx = 0;
     r32 diff = Abs(size - font_set->font_sizes[idx]);
-    for (u32 i = 1; i < ArrayCount(FontSet::font_sizes); ++i) {
+    for (u32 i = 1; i < font_set->font_count; ++i) {
       auto new_diff = Abs(size - font_set->font_sizes[i]);
       if (new_diff < diff) {
         diff = new_diff;
@@ -52,7 +52,7 @@ class FontManager : public BucketArray<FontSet> {
 
     u32 idx = 0;
     r32 diff = Abs(scale - font_set->fonts[idx].GetScale());
-    for (u32 i = 1; i < ArrayCount(FontSet::font_sizes); ++i) {
+    for (u32 i = 1; i < font_set->font_count; ++i) {
       auto new_diff = Abs(scale - font_set->fonts[i].GetScale());
       if (new_diff < diff) {
         diff = new_diff;
@@ -12,7 +12,7 @@ class Material {
   Material() = default;
   Material(ShaderID _shader_id) : shader_id{_shader_id} {}
 
-  [[no_discard]] u32 GetShaderId() const { return shader_id; }
+  [[nodiscard]] u32 GetShaderId() const { return shader_id; }
 
   TextureID diffuse = 0;
   TextureID specular = 0;
@@ -0,0 +1,76 @@
+#include "core/meshlet_culler.hpp"
+
+namespace quixotism {
+
+// relative difference of the axis scales below which a transform counts as
+// scaling uniformly
+static constexpr r32 MESHLET_UNIFORM_SCALE_TOLERANCE = 1e-3f;
+
+MeshletCullStats CullMeshlets(const MeshletMesh &meshlets,
+                              const FrustumDesc &frustum,
+                              const Mat4 &transform,
+                              std::vector<u32> &indices) {
+  MeshletCullStats stats;
+  indices.clear();
+  // room for every triangle, a vector kept across frames allocates once
+  indices.reserve(meshlets.triangles.size());
+
+  const Vec3 axes[] = {(transform * Vec4(1, 0, 0, 0)).xyz,
+                       (transform * Vec4(0, 1, 0, 0)).xyz,
+                       (transform * Vec4(0, 0, 1, 0)).xyz};
+  const r32 scales[] = {axes[0].Length(), axes[1].Length(),
+                        axes[2].Length()};
+  const r32 max_scale = Max(scales[0], Max(scales[1], scales[2]));
+  const r32 min_scale = Min(scales[0], Min(scales[1], scales[2]));
+  const bool test_cones =
+      max_scale - min_scale <= MESHLET_UNIFORM_SCALE_TOLERANCE * max_scale;
+
+  // outward normals of the side planes, which all go through the camera
+  Vec3 side_normals[] = {
+      {0.0, frustum.near_plane, frustum.near_half_height},   // top plane
+      {0.0, -frustum.near_plane, frustum.near_half_height},  // bottom plane
+      {frustum.near_plane, 0.0, frustum.near_half_width},    // right plane
+      {-frustum.near_plane, 0.0, frustum.near_half_width}};  // left plane
+  for (auto &normal : side_normals) normal.Normalize();
+
+  for (const auto &meshlet : meshlets.meshlets) {
+    const Vec3 center = (transform * Vec4(meshlet.center, 1)).xyz;
+    const r32 radius = meshlet.radius * max_scale;
+    bool outside = center.z - radius > -frustum.near_plane ||
+                   center.z + radius < -frustum.far_plane;
+    for (const auto &normal : side_normals) {
+      outside = outside || Dot(normal, center) > radius;
+    }
+    if (outside) {
+      ++stats.frustum_culled;
+      continue;
+    }
+
+    // the camera sits at the origin
+    if (test_cones && meshlet.cone_cutoff <= 1.0f) {
+      // the axis is scaled by max_scale like everything else
+      Vec3 apex = (transform * Vec4(meshlet.cone_apex, 1)).xyz;
+      Vec3 axis = (transform * Vec4(meshlet.cone_axis, 0)).xyz;
+      const r32 apex_length = apex.Length();
+      if (apex_length > 0 && Dot(apex, axis) >= meshlet.cone_cutoff *
+                                                    apex_length * max_scale) {
+        ++stats.backface_culled;
+        continue;
+      }
+    }
+
+    ++stats.visible;
+    const u32 *vertices = meshlets.vertices.data() + meshlet.vertex_offset;
+    const u8 *triangles =
+        meshlets.triangles.data() + size_t{meshlet.triangle_offset} * 3;
+    const size_t first = indices.size();
+    indices.resize(first + size_t{meshlet.triangle_count} * 3);
+    u32 *out = indices.data() + first;
+    for (u32 i = 0; i < meshlet.triangle_count * 3; ++i) {
+      out[i] = vertices[triangles[i]];
+    }
+  }
+  return stats;
+}
+
+}  // namespace quixotism
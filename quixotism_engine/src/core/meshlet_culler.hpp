@@ -0,0 +1,27 @@
+#pragma once
+#include <vector>
+
+#include "core/components/camera_component.hpp"
+#include "math/qmath.hpp"
+#include "mesh/meshlet_builder.hpp"
+#include "quixotism_c.hpp"
+
+namespace quixotism {
+
+struct MeshletCullStats {
+  u32 visible = 0;
+  u32 frustum_culled = 0;
+  u32 backface_culled = 0;
+};
+
+// Culls the meshlets of a mesh against the frustum (bounding spheres) and the
+// camera position (normal cones) and writes the triangles of the visible ones
+// to indices, ready for a dynamic index buffer. transform is the model view
+// matrix, the camera looks down the negative z-axis. Cones are only tested
+// while the transform scales uniformly, otherwise normals do not transform
+// like directions.
+MeshletCullStats CullMeshlets(const MeshletMesh &meshlets,
+                              const FrustumDesc &frustum,
+                              const Mat4 &transform, std::vector<u32> &indices);
+
+}  // namespace quixotism
@@ -10,6 +10,12 @@ struct ReadFileResult {
   size_t size = 0;
 };
 
+// A read-only view of a whole file, pages are loaded on first touch
+struct MappedFile {
+  const u8 *data = nullptr;
+  size_t size = 0;
+};
+
 struct FileMetadata {
   bool found;
   u64 last_write_time;
@@ -17,12 +23,16 @@ struct FileMetadata {
 
 using ReadFileFunPtr = ReadFileResult (*)(const char *);
 using WriteFileFunPtr = bool (*)(const char *, u8 *, size_t);
+using MapFileFunPtr = MappedFile (*)(const char *);
+using UnmapFileFunPtr = void (*)(MappedFile &);
 using GetFileMetadataFunPtr = FileMetadata (*)(const char *);
 using GetWorldTimestampFunPtr = u64 (*)();
 
 struct PlatformServices {
   ReadFileFunPtr read_file;
   WriteFileFunPtr write_file;
+  MapFileFunPtr map_file;
+  UnmapFileFunPtr unmap_file;
   GetFileMetadataFunPtr get_file_metadata;
   GetWorldTimestampFunPtr get_world_timestamp;
 };
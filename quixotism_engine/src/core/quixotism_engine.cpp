@@ -1,12 +1,15 @@
 #include "quixotism_engine.hpp"
 
+#include "bitmap/block_compression.hpp"
 #include "core/constants.hpp"
 #include "core/gui_interactive.hpp"
+#include "core/meshlet_culler.hpp"
 #include "core/texture.hpp"
 #include "dbg_print.hpp"
 #include "enumerate.hpp"
 #include "file_processing/obj_parser/obj_parser.hpp"
 #include "file_processing/png_parser/png_parser.hpp"
+#include "mesh/cooked_mesh.hpp"
 #include "renderer/quixotism_renderer.hpp"
 
 namespace quixotism {
@@ -320,6 +323,74 @@ static bool SATFrustumCulling(const FrustumDesc& frustum, const Mat4& transform,
   return true;
 }
 
+// The full mesh is drawn while its bounds cover at least this share of the
+// screen height, each further level of detail halves the size
+static constexpr r32 LOD0_SCREEN_SIZE = 0.5f;
+
+// Picks the level of detail from the projected size of the sphere around the
+// transformed bounding box, transform is the model view matrix
+static u32 SelectLod(const FrustumDesc& frustum, const Mat4& transform,
+                     const AABB& bb, u32 lod_count) {
+  Vec3 min_corner = (transform * Vec4(bb.min, 1)).xyz;
+  Vec3 max_corner = (transform * Vec4(bb.max, 1)).xyz;
+  Vec3 center = 0.5f * (min_corner + max_corner);
+  r32 radius = 0.5f * (max_corner - min_corner).Length();
+  // the camera looks down the negative z-axis
+  r32 distance = -center.z;
+  if (distance <= radius) return 0;
+
+  // projected diameter over the screen height
+  r32 screen_size =
+      (radius * frustum.near_plane) / (distance * frustum.near_half_height);
+  u32 lod = 0;
+  for (r32 size = LOD0_SCREEN_SIZE; lod + 1 < lod_count && screen_size < size;
+       size *= 0.5f) {
+    ++lod;
+  }
+  return lod;
+}
+
+StaticMeshId QuixotismEngine::LoadStaticMesh(const char* obj_path,
+                                             const char* cooked_path) {
+  auto& renderer = QuixotismRenderer::GetRenderer();
+  auto obj_metadata = services.get_file_metadata(obj_path);
+  auto cooked_metadata = services.get_file_metadata(cooked_path);
+  // a cooked mesh older than its OBJ file is stale and gets cooked again
+  if (cooked_metadata.found &&
+      (!obj_metadata.found ||
+       cooked_metadata.last_write_time >= obj_metadata.last_write_time)) {
+    auto cooked_file = services.map_file(cooked_path);
+    auto cooked = ReadCookedMesh(cooked_file.data, cooked_file.size);
+    if (cooked) {
+      auto mesh_id = static_mesh_mgr.Add(StaticMesh{*cooked});
+      bool uploaded = renderer.MakeDrawableStaticMesh(mesh_id, *cooked);
+      services.unmap_file(cooked_file);
+      if (uploaded) return mesh_id;
+      static_mesh_mgr.Remove(mesh_id);
+    } else {
+      services.unmap_file(cooked_file);
+    }
+    DBG_PRINT(std::format("cooked mesh '{}' is unusable, cooking it again",
+                          cooked_path));
+  }
+
+  auto obj_data = services.read_file(obj_path);
+  auto meshes = ParseOBJ(obj_data.data.get(), obj_data.size);
+  Assert(!meshes.empty());
+  auto mesh_id = static_mesh_mgr.Add(StaticMesh{std::move(meshes[0])});
+  renderer.MakeDrawableStaticMesh(mesh_id);
+
+  auto* sm = static_mesh_mgr.Get(mesh_id);
+  const auto& layout = renderer.vertex_array_mgr.Get(renderer.vao_id)->layout;
+  auto cooked_data = CookMesh(sm->GetMeshData(), sm->GetIndexedMesh(),
+                              sm->GetMeshlets(), layout);
+  if (!services.write_file(cooked_path, cooked_data.data(),
+                           cooked_data.size())) {
+    DBG_PRINT(std::format("could not write cooked mesh '{}'", cooked_path));
+  }
+  return mesh_id;
+}
+
 void QuixotismEngine::Init(const PlatformServices& init_services,
                            const WindowDim& dim) {
   services = init_services;
@@ -343,8 +414,14 @@ void QuixotismEngine::Init(const PlatformServices& init_services,
       "D:/QuixotismEngine/quixotism_engine/data/textures/container.png");
   auto img = ParsePNG(png_data.data.get(), png_data.size);
   if (img) {
-    Texture texture{std::move(img.value())};
-    texture.glid = CreateTexture2D(std::get<Bitmap>(texture.bitmap));
+    // opaque, BC1 keeps an eighth of the RGBA8 memory
+    auto levels = CompressMipChain(img.value(), BitmapFormat::BC1);
+    Assert(levels);
+    auto glid = CreateTexture2D(std::span<const Bitmap>{*levels});
+    // the diffuse map keeps a small level of the chain around for CPU side
+    // previews
+    Texture texture{std::move(*levels), TextureResidency::KEEP_LOW_MIP};
+    texture.glid = std::move(glid);
     tex_id = texture_mgr.Add(std::move(texture));
   }
 
@@ -353,43 +430,54 @@ void QuixotismEngine::Init(const PlatformServices& init_services,
       "container_specular.png");
   img = ParsePNG(png_data.data.get(), png_data.size);
   if (img) {
-    Texture texture{std::move(img.value())};
-    texture.glid = CreateTexture2D(std::get<Bitmap>(texture.bitmap));
+    // specular intensities are data, not sRGB colors
+    auto levels = CompressMipChain(img.value(), BitmapFormat::BC1,
+                                   MipOptions{.srgb = false});
+    Assert(levels);
+    auto glid = CreateTexture2D(std::span<const Bitmap>{*levels});
+    Texture texture{std::move(levels->front()), TextureResidency::DISCARD};
+    texture.glid = std::move(glid);
     stex_id = texture_mgr.Add(std::move(texture));
   }
 
-  CubeBitmap cube_bitmaps;
-  for (auto [i, bitmap] : Enumerate(cube_bitmaps)) {
-    auto png_data = QuixotismEngine::GetEngine().services.read_file(
+  // the cube faces are independent, decode them in parallel
+  std::array<ReadFileResult, 6> cube_files;
+  for (auto [i, file] : Enumerate(cube_files)) {
+    file = QuixotismEngine::GetEngine().services.read_file(
         ("D:/QuixotismEngine/quixotism_engine/data/textures/yokohama/" +
          std::to_string(i) + ".png")
             .c_str());
-    auto img = ParsePNG(png_data.data.get(), png_data.size);
-    if (img) {
-      bitmap = std::move(img.value());
+  }
+  auto cube_images = ParsePNGBatch(cube_files);
+  CubeBitmap cube_bitmaps;
+  for (auto [i, bitmap] : Enumerate(cube_bitmaps)) {
+    if (cube_images[i]) {
+      bitmap = std::move(cube_images[i].value());
     } else {
       Assert(!"could not load image");
     }
   }
-  Texture texture{std::move(cube_bitmaps)};
-  texture.glid = CreateCubeTexture(std::get<CubeBitmap>(texture.bitmap));
+  std::array<std::vector<Bitmap>, 6> cube_levels;
+  for (auto [i, levels] : Enumerate(cube_levels)) {
+    auto compressed = CompressMipChain(cube_bitmaps[i], BitmapFormat::BC1);
+    Assert(compressed);
+    levels = std::move(compressed.value());
+  }
+  auto cube_glid = CreateCubeTexture(cube_levels);
+  for (auto [i, bitmap] : Enumerate(cube_bitmaps)) {
+    bitmap = std::move(cube_levels[i].front());
+  }
+  Texture texture{std::move(cube_bitmaps), TextureResidency::DISCARD};
+  texture.glid = std::move(cube_glid);
   ctex_id = texture_mgr.Add(std::move(texture));
+  DBG_PRINT(FormatTextureMemoryReport(texture_mgr.GetMemoryReport()));
 
-  auto obj_data = QuixotismEngine::GetEngine().services.read_file(
-      "D:/QuixotismEngine/quixotism_engine/data/meshes/box.obj");
-  auto meshes = ParseOBJ(obj_data.data.get(), obj_data.size);
-
-  StaticMesh smesh{std::move(meshes[0])};
-  auto mesh_id = static_mesh_mgr.Add(std::move(smesh));
-  QuixotismRenderer::GetRenderer().MakeDrawableStaticMesh(mesh_id);
-
-  obj_data = QuixotismEngine::GetEngine().services.read_file(
-      "D:/QuixotismEngine/quixotism_engine/data/meshes/sphere64.obj");
-  meshes = ParseOBJ(obj_data.data.get(), obj_data.size);
-
-  smesh = StaticMesh{std::move(meshes[0])};
-  auto s_mesh_id = static_mesh_mgr.Add(std::move(smesh));
-  QuixotismRenderer::GetRenderer().MakeDrawableStaticMesh(s_mesh_id);
+  auto mesh_id = LoadStaticMesh(
+      "D:/QuixotismEngine/quixotism_engine/data/meshes/box.obj",
+      "D:/QuixotismEngine/quixotism_engine/data/meshes/box.qmesh");
+  auto s_mesh_id = LoadStaticMesh(
+      "D:/QuixotismEngine/quixotism_engine/data/meshes/sphere64.obj",
+      "D:/QuixotismEngine/quixotism_engine/data/meshes/sphere64.qmesh");
 
   Material mat1{QuixotismRenderer::GetRenderer().shader_mgr.GetByName("model")};
   mat1.diffuse = tex_id;
@@ -415,6 +503,7 @@ void QuixotismEngine::UpdateAndRender(InputState& input, r32 delta_t) {
   auto& renderer = QuixotismRenderer::GetRenderer();
   renderer.InitOffscreenFramebuffer();
   rendered_entities_count = 0;
+  rendered_triangle_count = 0;
   auto& transform = entity_mgr.Get(camera_id)->transform;
 
   auto speed = 50.0F;  // m/s
@@ -608,8 +697,15 @@ void QuixotismEngine::UpdateAndRender(InputState& input, r32 delta_t) {
   renderer.ClearFramebuffer();
   DrawText("Hello Text!", -0.98, 0.8f, 0.03448);
   DrawEntities();
-  DrawText("entity draw count: " + std::to_string(rendered_entities_count),
-           -0.98, 0.7f, 0.009);
+  DrawTextF(-0.98, 0.7f, 0.009, 0,
+            "entity draw count: {} triangles: {} meshlets: {} (culled {})",
+            rendered_entities_count, rendered_triangle_count,
+            rendered_meshlet_count, culled_meshlet_count);
+  const auto& text_stats = renderer.GetTextStats();
+  DrawTextF(-0.98, 0.65f, 0.009, 0,
+            "text buffer growths: {} (total {}) arena: {}/{}B",
+            text_stats.frame_buffer_growths, text_stats.total_buffer_growths,
+            text_arena.GetHighWaterMark(), text_arena.GetCapacity());
   renderer.DrawSkybox();
   renderer.DrawText(0);
   renderer.DrawXYZAxesOverlay();
@@ -621,6 +717,7 @@ void QuixotismEngine::UpdateAndRender(InputState& input, r32 delta_t) {
   }
 
   renderer.ClearTextBuffer();
+  text_arena.Reset();
 
   if (selected_entities) {
     renderer.DrawOutline();
@@ -637,17 +734,41 @@ void QuixotismEngine::DrawEntities() {
   auto& transform = entity_mgr.Get(camera_id)->transform;
   auto view = transform.GetTransformMatrix();
   QuixotismRenderer::GetRenderer().PrepareDrawStaticMeshes();
+  rendered_entities_count = 0;
+  rendered_triangle_count = 0;
+  rendered_meshlet_count = 0;
+  culled_meshlet_count = 0;
   for (auto& entity : entity_mgr) {
     auto* sm_comp = entity.GetComponent<StaticMeshComponent>();
     if (!sm_comp) continue;
     auto* sm = static_mesh_mgr.Get(sm_comp->GetStaticMeshId());
     auto transform = view * entity.transform.GetTransformMatrix();
-    if (SATFrustumCulling(camera->GetFrustumDescription(), transform,
-                          sm->GetMeshData().bbox)) {
+    const auto& frustum = camera->GetFrustumDescription();
+    const auto& bbox = sm->GetMeshData().bbox;
+    if (SATFrustumCulling(frustum, transform, bbox)) {
+      const auto& indexed = sm->GetIndexedMesh();
+      auto lod = SelectLod(frustum, transform, bbox, indexed.LodCount());
+      const auto& meshlets = sm->GetMeshlets();
+      bool selected = entity.GetId() == selected_entities;
+      // the full mesh of dense meshes is culled meshlet by meshlet
+      if (lod == 0 && meshlets.MeshletCount() > 0) {
+        auto stats =
+            CullMeshlets(meshlets, frustum, transform, culled_mesh_indices);
+        rendered_meshlet_count += stats.visible;
+        culled_meshlet_count += stats.frustum_culled + stats.backface_culled;
+        if (culled_mesh_indices.empty()) continue;
+        QuixotismRenderer::GetRenderer().DrawStaticMeshTriangles(
+            sm_comp->GetStaticMeshId(), sm_comp->GetMaterialID(),
+            entity.transform, selected, culled_mesh_indices);
+        ++rendered_entities_count;
+        rendered_triangle_count += culled_mesh_indices.size() / 3;
+        continue;
+      }
       QuixotismRenderer::GetRenderer().DrawStaticMesh(
           sm_comp->GetStaticMeshId(), sm_comp->GetMaterialID(),
-          entity.transform, entity.GetId() == selected_entities);
+          entity.transform, selected, lod);
       ++rendered_entities_count;
+      rendered_triangle_count += indexed.lods[lod].index_count / 3;
     }
   }
   if (show_bb) {
@@ -663,8 +784,14 @@ void QuixotismEngine::DrawEntities() {
 void QuixotismEngine::InitTextFonts() {
   auto ttf_file = services.read_file("C:/Windows/Fonts/cour.ttf");
   if (ttf_file.data) {
-    if (auto _font = TTFMakeASCIIFont(ttf_file.data.get(), ttf_file.size);
+    if (auto _font = TTFMakeASCIIFont(ttf_file.data.get(), ttf_file.size,
+                                      FontRasterMode::SDF);
         _font.has_value()) {
+      // the baked ASCII atlas only covers '!'..'~', the glyph cache takes
+      // the font file and draws every other codepoint the font has
+      _font->glyph_cache = std::make_unique<GlyphCache>(
+          std::move(ttf_file.data), FontSet::SDF_FONT_SIZE,
+          FontRasterMode::SDF);
       font_mgr.Add(std::move(*_font));
     } else {
       DBG_PRINT("fialed to load font...");
@@ -672,16 +799,18 @@ void QuixotismEngine::InitTextFonts() {
   }
 }
 
-void QuixotismEngine::DrawText(std::string text, r32 x, r32 y, r32 scale,
+void QuixotismEngine::DrawText(std::string_view text, r32 x, r32 y, r32 scale,
                                u32 layer, u64 font_id) {
-  QuixotismRenderer::GetRenderer().PushText(std::move(text), Vec2{x, y}, scale,
-                                            layer, font_id);
+  if (!text_arena.Owns(text)) text = text_arena.Push(text);
+  QuixotismRenderer::GetRenderer().PushText(text, Vec2{x, y}, scale, layer,
+                                            font_id);
 }
 
-void QuixotismEngine::DrawText(std::string text, r32 x, r32 y, Vec3 color,
+void QuixotismEngine::DrawText(std::string_view text, r32 x, r32 y, Vec3 color,
                                r32 scale, u32 layer, u64 font_id) {
-  QuixotismRenderer::GetRenderer().PushText(std::move(text), Vec2{x, y}, color,
-                                            scale, layer, font_id);
+  if (!text_arena.Owns(text)) text = text_arena.Push(text);
+  QuixotismRenderer::GetRenderer().PushText(text, Vec2{x, y}, color, scale,
+                                            layer, font_id);
 }
 
 }  // namespace quixotism
@@ -1,6 +1,8 @@
 #pragma once
 
-#include <string>
+#include <format>
+#include <string_view>
+#include <vector>
 
 #include "core/entity_manager.hpp"
 #include "core/font_manager.hpp"
@@ -9,6 +11,7 @@
 #include "core/platform_services.hpp"
 #include "core/static_mesh_manager.hpp"
 #include "core/terminal.hpp"
+#include "core/text_arena.hpp"
 #include "core/texture_manager.hpp"
 
 namespace quixotism {
@@ -38,11 +41,26 @@ class QuixotismEngine {
   EntityId GetCamera() const { return camera_id; }
   EntityId GetCamera2() const { return camera_id2; }
 
-  void DrawText(std::string text, float x, float y, r32 scale, u32 layer = 0,
-                u64 font_id = 0);
-  void DrawText(std::string text, r32 x, r32 y, Vec3 color, r32 scale,
+  void DrawText(std::string_view text, float x, float y, r32 scale,
+                u32 layer = 0, u64 font_id = 0);
+  void DrawText(std::string_view text, r32 x, r32 y, Vec3 color, r32 scale,
                 u32 layer, u64 font_id = 0);
 
+  // Formats the text straight into the per-frame text arena, so drawing
+  // formatted text (counters, debug info...) does not touch the heap
+  template <typename... Args>
+  void DrawTextF(r32 x, r32 y, r32 scale, u32 layer,
+                 std::format_string<Args...> fmt, Args&&... args) {
+    DrawText(text_arena.Format(fmt, std::forward<Args>(args)...), x, y, scale,
+             layer);
+  }
+  template <typename... Args>
+  void DrawTextF(r32 x, r32 y, Vec3 color, r32 scale, u32 layer,
+                 std::format_string<Args...> fmt, Args&&... args) {
+    DrawText(text_arena.Format(fmt, std::forward<Args>(args)...), x, y, color,
+             scale, layer);
+  }
+
   void DrawEntities();
 
   void SetElementFocus(GUI_Interactive* element) { focused_element = element; }
@@ -59,8 +77,12 @@ class QuixotismEngine {
   bool show_bb = false;
   u32 show_terminal = 0;
   Terminal terminal;
+  TextArena text_arena;
 
   size_t rendered_entities_count;
+  size_t rendered_triangle_count;
+  size_t rendered_meshlet_count;
+  size_t culled_meshlet_count;
   EntityId selected_entities = 0;
 
   StaticMesh screen_quad_mesh;
@@ -71,8 +93,14 @@ class QuixotismEngine {
   GUI_Interactive* focused_element;
 
   EntityId camera_id, camera_id2, box_id;
+  // the triangles of the visible meshlets of the mesh being drawn, kept
+  // around so the capacity is reused every frame
+  std::vector<u32> culled_mesh_indices;
 
   void InitTextFonts();
+  // Loads the cooked mesh if it is there and up to date, otherwise parses the
+  // OBJ file and writes the cooked mesh for the next start
+  StaticMeshId LoadStaticMesh(const char* obj_path, const char* cooked_path);
 
   WindowDim window_dim{};
 };
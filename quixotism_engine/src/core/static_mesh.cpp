@@ -0,0 +1,78 @@
+#include "core/static_mesh.hpp"
+
+#include <cstring>
+#include <format>
+
+#include "dbg_print.hpp"
+#include "mesh/cooked_mesh.hpp"
+#include "mesh/mesh_optimizer.hpp"
+#include "mesh/mesh_simplifier.hpp"
+#include "mesh/meshlet_builder.hpp"
+#include "mesh/vertex_quantization.hpp"
+
+namespace quixotism {
+
+StaticMesh::StaticMesh(const CookedMeshView& cooked) {
+  const auto& header = *cooked.header;
+  // positions are the first element of every cooked layout
+  Assert(header.layout_element_count > 0);
+  const auto encoding = static_cast<VertexEncoding>(header.layout[0].encoding);
+  mesh.ObjectName = cooked.name;
+  mesh.bbox = cooked.bbox;
+  const auto box = MakeQuantizationBox(mesh.bbox);
+  mesh.VertexPosData.resize(header.vertex_count);
+  for (u32 i = 0; i < header.vertex_count; ++i) {
+    const auto* src =
+        cooked.vertex_data.data() + size_t{i} * header.vertex_stride;
+    if (encoding == VertexEncoding::BOX_SNORM16) {
+      i16 encoded[3];
+      std::memcpy(encoded, src, sizeof(encoded));
+      mesh.VertexPosData[i] = DecodeBoxSnorm16(encoded, box);
+    } else {
+      Assert(encoding == VertexEncoding::FLOAT && header.layout[0].count == 3);
+      std::memcpy(&mesh.VertexPosData[i], src, sizeof(VertexPos));
+    }
+  }
+  const auto& lod0 = cooked.lods.front();
+  auto lod0_indices =
+      cooked.indices.subspan(lod0.first_index, lod0.index_count);
+  mesh.VertexTriangleIndicies.PosIdx.assign(lod0_indices.begin(),
+                                            lod0_indices.end());
+  indexed.lods.assign(cooked.lods.begin(), cooked.lods.end());
+  meshlets.meshlets.assign(cooked.meshlets.begin(), cooked.meshlets.end());
+  meshlets.vertices.assign(cooked.meshlet_vertices.begin(),
+                           cooked.meshlet_vertices.end());
+  meshlets.triangles.assign(cooked.meshlet_triangles.begin(),
+                            cooked.meshlet_triangles.end());
+}
+
+void StaticMesh::BuildIndexedMesh() {
+  indexed = WeldVertices(mesh);
+  if (indexed.indices.empty()) return;
+
+  auto before = AnalyzeVertexCache(indexed.indices, indexed.VertexCount());
+  OptimizeIndexedMesh(indexed, mesh);
+  auto after = AnalyzeVertexCache(indexed.indices, indexed.VertexCount());
+  DBG_PRINT(std::format(
+      "static mesh '{}': {} triangles, {} vertices, ACMR {:.3f} -> {:.3f}, "
+      "ATVR {:.3f} -> {:.3f}",
+      mesh.ObjectName, indexed.IndexCount() / 3, indexed.VertexCount(),
+      before.acmr, after.acmr, before.atvr, after.atvr));
+
+  // meshlets of the full mesh, if it is dense enough to cull them one by one
+  if (indexed.IndexCount() / 3 >= MESHLET_MIN_MESH_TRIANGLES) {
+    meshlets = BuildMeshlets(indexed.indices, indexed.vertices.PosIdx,
+                             mesh.VertexPosData);
+    DBG_PRINT(std::format("static mesh '{}': {} meshlets", mesh.ObjectName,
+                          meshlets.MeshletCount()));
+  }
+
+  BuildLodChain(indexed, mesh);
+  for (u32 lod = 1; lod < indexed.LodCount(); ++lod) {
+    DBG_PRINT(std::format("static mesh '{}': LOD {} has {} triangles",
+                          mesh.ObjectName, lod,
+                          indexed.lods[lod].index_count / 3));
+  }
+}
+
+}  // namespace quixotism
@@ -1,12 +1,16 @@
 #pragma once
 
 #include "file_processing/obj_parser/obj_parser.hpp"
+#include "mesh/indexed_mesh.hpp"
+#include "mesh/meshlet_builder.hpp"
 #include "quixotism_c.hpp"
 #include "renderer/gl_buffer_manager.hpp"
 #include "renderer/vertex_array_manager.hpp"
 
 namespace quixotism {
 
+struct CookedMeshView;
+
 class StaticMesh {
  public:
   StaticMesh() = default;
@@ -16,13 +20,22 @@ class StaticMesh {
     vao_id = other.vao_id;
     bb_vbo_id = other.bb_vbo_id;
     mesh = std::move(other.mesh);
+    indexed = std::move(other.indexed);
+    meshlets = std::move(other.meshlets);
     other.vbo_id = 0;
     other.ebo_id = 0;
     other.vao_id = 0;
     other.bb_vbo_id = 0;
     other.mesh = Mesh{};
+    other.indexed = IndexedMesh{};
+    other.meshlets = MeshletMesh{};
   }
   StaticMesh(Mesh&& sm) noexcept { mesh = std::move(sm); }
+  // Takes the name, bounding box, levels of detail, meshlets and the
+  // positions (for picking) of a cooked mesh. The vertex and index buffers
+  // stay in the cooked data and get uploaded from there, so BuildIndexedMesh
+  // is not needed.
+  explicit StaticMesh(const CookedMeshView& cooked);
 
   StaticMesh& operator=(StaticMesh&& other) noexcept {
     vbo_id = other.vbo_id;
@@ -30,21 +43,37 @@ class StaticMesh {
     vao_id = other.vao_id;
     bb_vbo_id = other.bb_vbo_id;
     mesh = std::move(other.mesh);
+    indexed = std::move(other.indexed);
+    meshlets = std::move(other.meshlets);
     other.vbo_id = 0;
     other.ebo_id = 0;
     other.vao_id = 0;
     other.bb_vbo_id = 0;
     other.mesh = Mesh{};
+    other.indexed = IndexedMesh{};
+    other.meshlets = MeshletMesh{};
     return *this;
   }
 
   Mesh& GetMeshData() { return mesh; }
 
+  // Welds the face corners of the mesh into shared vertices, orders the
+  // triangles and vertices for the GPU and builds the levels of detail, see
+  // mesh/mesh_optimizer.hpp and mesh/mesh_simplifier.hpp, and the meshlets of
+  // the full mesh
+  void BuildIndexedMesh();
+  IndexedMesh& GetIndexedMesh() { return indexed; }
+  // meshlets of the full mesh, none for meshes under
+  // MESHLET_MIN_MESH_TRIANGLES triangles
+  const MeshletMesh& GetMeshlets() const { return meshlets; }
+
   GLBufferID vbo_id, ebo_id, bb_vbo_id;
   VertexArrayID vao_id;
 
  private:
   Mesh mesh;
+  IndexedMesh indexed;
+  MeshletMesh meshlets;
 };
 
 }  // namespace quixotism
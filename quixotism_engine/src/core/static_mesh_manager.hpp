@@ -13,6 +13,15 @@ class StaticMeshManager : public BucketArray<StaticMesh> {
   CLASS_DELETE_COPY(StaticMeshManager);
   StaticMeshManager() = default;
 
+  // Meshes get their optimized index buffer on the way in, unless they come
+  // cooked with one
+  IdType Add(StaticMesh&& static_mesh) {
+    if (static_mesh.GetIndexedMesh().lods.empty()) {
+      static_mesh.BuildIndexedMesh();
+    }
+    return BucketArray<StaticMesh>::Add(std::move(static_mesh));
+  }
+
  private:
 };
 using StaticMeshId = StaticMeshManager::IdType;
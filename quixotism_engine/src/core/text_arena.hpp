@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstring>
+#include <format>
+#include <memory>
+#include <string_view>
+
+#include "math/basic.hpp"
+#include "quixotism_c.hpp"
+
+namespace quixotism {
+
+/**
+ * Frame scoped linear storage for text that is submitted for drawing.
+ *
+ * All text pushed during a frame lives in one fixed buffer that is allocated
+ * once, text views handed out by the arena stay valid until Reset() is called
+ * (once per frame, after the text got rendered). If the arena runs out of
+ * space the text gets truncated instead of falling back to the heap, the
+ * truncation is counted so we notice that the capacity needs bumping.
+ */
+class TextArena {
+ public:
+  static constexpr size_t DEFAULT_CAPACITY = Kilobytes(64);
+
+  CLASS_DELETE_COPY(TextArena);
+  CLASS_DEFAULT_MOVE(TextArena);
+  explicit TextArena(size_t _capacity = DEFAULT_CAPACITY)
+      : buffer{std::make_unique<char[]>(_capacity)}, capacity{_capacity} {}
+
+  std::string_view Push(std::string_view text) {
+    auto size = Min(text.size(), Remaining());
+    if (size < text.size()) ++truncated_count;
+    auto *dest = buffer.get() + used;
+    std::memcpy(dest, text.data(), size);
+    used += size;
+    return {dest, size};
+  }
+
+  template <typename... Args>
+  std::string_view Format(std::format_string<Args...> fmt, Args &&...args) {
+    auto *dest = buffer.get() + used;
+    auto remaining = Remaining();
+    auto result = std::format_to_n(dest, remaining, fmt,
+                                   std::forward<Args>(args)...);
+    auto size = static_cast<size_t>(result.size);
+    if (size > remaining) {
+      ++truncated_count;
+      size = remaining;
+    }
+    used += size;
+    return {dest, size};
+  }
+
+  // Checks if the text view points into this arena (so we can skip copying
+  // text that was already formatted into the arena)
+  bool Owns(std::string_view text) const {
+    return text.data() >= buffer.get() &&
+           text.data() + text.size() <= buffer.get() + used;
+  }
+
+  void Reset() {
+    high_water_mark = Max(high_water_mark, used);
+    used = 0;
+  }
+
+  size_t Remaining() const { return capacity - used; }
+  size_t GetUsed() const { return used; }
+  size_t GetCapacity() const { return capacity; }
+  size_t GetHighWaterMark() const { return high_water_mark; }
+  u64 GetTruncatedCount() const { return truncated_count; }
+
+ private:
+  std::unique_ptr<char[]> buffer;
+  size_t capacity = 0;
+  size_t used = 0;
+  size_t high_water_mark = 0;
+  u64 truncated_count = 0;
+};
+
+}  // namespace quixotism
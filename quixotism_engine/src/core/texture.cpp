@@ -0,0 +1,127 @@
+#include "core/texture.hpp"
+
+#include <format>
+
+#include "bitmap/block_compression.hpp"
+#include "bitmap/mipmap.hpp"
+#include "core/texture_manager.hpp"
+
+namespace quixotism {
+
+// bytes of the full mip chain of the bitmap
+static size_t MipChainBytes(const Bitmap &bitmap) {
+  auto format = bitmap.GetBitmapFormat();
+  u32 width = bitmap.GetWidth();
+  u32 height = bitmap.GetHeight();
+  size_t bytes = 0;
+  for (u32 level = 0; level < MipLevelCount(width, height); ++level) {
+    bytes += Bitmap::FormatDataSize(format, std::max(width >> level, 1U),
+                                    std::max(height >> level, 1U));
+  }
+  return bytes;
+}
+
+static bool FitsLowMip(const Bitmap &bitmap) {
+  return std::max(bitmap.GetWidth(), bitmap.GetHeight()) <=
+         TEXTURE_LOW_MIP_MAX_DIM;
+}
+
+// The first level of the chain that fits TEXTURE_LOW_MIP_MAX_DIM, compressed
+// bitmaps are decoded first
+static Bitmap LowMip(Bitmap &&bitmap) {
+  if (bitmap.IsBlockCompressed()) {
+    auto decoded = DecompressBitmap(bitmap);
+    if (!decoded) return {};
+    bitmap = std::move(decoded.value());
+  }
+  if (FitsLowMip(bitmap)) return std::move(bitmap);
+  // textures made from a single bitmap have no chain to take the level from,
+  // previews are of color textures
+  auto mips = GenerateMips(bitmap);
+  for (auto &mip : mips) {
+    if (FitsLowMip(mip)) return std::move(mip);
+  }
+  return {};
+}
+
+static void ApplyResidencyToBitmap(TextureResidency residency,
+                                   Bitmap &bitmap) {
+  switch (residency) {
+    case TextureResidency::KEEP:
+      break;
+    case TextureResidency::DISCARD:
+      bitmap = {};
+      break;
+    case TextureResidency::KEEP_LOW_MIP:
+      bitmap = LowMip(std::move(bitmap));
+      break;
+  }
+}
+
+Texture::Texture(std::vector<Bitmap> &&levels, TextureResidency _residency)
+    : is_cube{false}, residency{_residency} {
+  Assert(!levels.empty());
+  bitmap = std::move(levels.front());
+  if (residency != TextureResidency::KEEP_LOW_MIP) return;
+  if (FitsLowMip(std::get<Bitmap>(bitmap))) return;
+  for (size_t level = 1; level < levels.size(); ++level) {
+    if (FitsLowMip(levels[level])) {
+      low_mip = std::move(levels[level]);
+      break;
+    }
+  }
+}
+
+void Texture::ApplyResidency() {
+  if (is_cube) {
+    auto &faces = std::get<CubeBitmap>(bitmap);
+    gpu_bytes = faces[0].IsValid() ? (6 * MipChainBytes(faces[0])) : 0;
+    for (auto &face : faces) ApplyResidencyToBitmap(residency, face);
+  } else {
+    auto &base = std::get<Bitmap>(bitmap);
+    gpu_bytes = base.IsValid() ? MipChainBytes(base) : 0;
+    if (residency == TextureResidency::KEEP_LOW_MIP && low_mip.IsValid()) {
+      base = std::move(low_mip);
+      low_mip = {};
+    }
+    ApplyResidencyToBitmap(residency, base);
+  }
+}
+
+size_t Texture::CPUBytes() const {
+  if (is_cube) {
+    size_t bytes = 0;
+    for (const auto &face : std::get<CubeBitmap>(bitmap)) {
+      if (face.IsValid()) bytes += face.GetDataSize();
+    }
+    return bytes;
+  }
+  const auto &base = std::get<Bitmap>(bitmap);
+  return base.IsValid() ? base.GetDataSize() : 0;
+}
+
+TextureMemoryReport TextureManager::GetMemoryReport() {
+  TextureMemoryReport report;
+  for (const auto &texture : *this) {
+    ++report.texture_count;
+    ++report.residency_count[static_cast<u32>(texture.residency)];
+    report.cpu_bytes += texture.CPUBytes();
+    report.gpu_bytes += texture.GPUBytes();
+  }
+  return report;
+}
+
+std::string FormatTextureMemoryReport(const TextureMemoryReport &report) {
+  return std::format(
+      "textures: {} ({} kept, {} discarded, {} low mip), CPU {:.2f} MB, "
+      "GPU {:.2f} MB",
+      report.texture_count,
+      report.residency_count[static_cast<u32>(TextureResidency::KEEP)],
+      report.residency_count[static_cast<u32>(TextureResidency::DISCARD)],
+      report.residency_count[static_cast<u32>(
+          TextureResidency::KEEP_LOW_MIP)],
+      report.cpu_bytes / (1024.0 * 1024.0),
+      report.gpu_bytes / (1024.0 * 1024.0));
+}
+
+}  // namespace quixotism
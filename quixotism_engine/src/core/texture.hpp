@@ -1,6 +1,7 @@
 #pragma once
 
 #include <variant>
+#include <vector>
 
 #include "bitmap/bitmap.hpp"
 #include "quixotism_c.hpp"
@@ -8,17 +9,52 @@
 
 namespace quixotism {
 
+// What happens to the CPU copy of a texture once it is on the GPU
+enum class TextureResidency {
+  // the full bitmap stays in memory
+  KEEP,
+  // the bitmap is freed, only the GPU texture remains
+  DISCARD,
+  // a small uncompressed mip level stays for CPU side lookups and previews
+  KEEP_LOW_MIP,
+};
+
+// largest side of the level TextureResidency::KEEP_LOW_MIP keeps
+static constexpr u32 TEXTURE_LOW_MIP_MAX_DIM = 64;
+
 class Texture {
  public:
   Texture() = default;
-  Texture(Bitmap &&_bitmap) : bitmap{std::move(_bitmap)}, is_cube{false} {}
-  Texture(CubeBitmap &&_bitmap) : bitmap{std::move(_bitmap)}, is_cube{true} {}
+  Texture(Bitmap &&_bitmap,
+          TextureResidency _residency = TextureResidency::KEEP)
+      : is_cube{false}, residency{_residency}, bitmap{std::move(_bitmap)} {}
+  Texture(CubeBitmap &&_bitmap,
+          TextureResidency _residency = TextureResidency::KEEP)
+      : is_cube{true}, residency{_residency}, bitmap{std::move(_bitmap)} {}
+  // Takes the mip chain that was uploaded, base level first. KEEP_LOW_MIP
+  // keeps the first level of the chain that fits instead of filtering the
+  // base level down again.
+  Texture(std::vector<Bitmap> &&levels,
+          TextureResidency _residency = TextureResidency::KEEP);
+
+  // Applies the residency policy, called by TextureManager::Add once glid
+  // holds the uploaded texture. The GPU size is taken from the bitmap before
+  // it goes, assuming a full mip chain.
+  void ApplyResidency();
+
+  // bytes the CPU copy currently takes
+  size_t CPUBytes() const;
+  size_t GPUBytes() const { return gpu_bytes; }
 
   bool is_cube = false;
+  TextureResidency residency = TextureResidency::KEEP;
   std::variant<Bitmap, CubeBitmap> bitmap;
   GLTexture glid;
 
  private:
+  size_t gpu_bytes = 0;
+  // the level of the chain KEEP_LOW_MIP keeps, if we got a chain
+  Bitmap low_mip;
 };
 
 }  // namespace quixotism
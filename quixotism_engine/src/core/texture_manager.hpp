@@ -1,6 +1,7 @@
 #pragma once
 
 #include <queue>
+#include <string>
 
 #include "containers/bucket_array.hpp"
 #include "core/texture.hpp"
@@ -8,12 +9,32 @@
 
 namespace quixotism {
 
+struct TextureMemoryReport {
+  u32 texture_count = 0;
+  // textures per TextureResidency value
+  u32 residency_count[3] = {};
+  size_t cpu_bytes = 0;
+  size_t gpu_bytes = 0;
+};
+
 class TextureManager : public BucketArray<Texture> {
  public:
   CLASS_DELETE_COPY(TextureManager);
   TextureManager() = default;
 
+  // Textures are added after their upload, their residency policy is applied
+  // on the way in
+  IdType Add(Texture &&texture) {
+    texture.ApplyResidency();
+    return BucketArray<Texture>::Add(std::move(texture));
+  }
+
+  TextureMemoryReport GetMemoryReport();
+
  private:
 };
 using TextureID = TextureManager::IdType;
+
+std::string FormatTextureMemoryReport(const TextureMemoryReport &report);
+
 }  // namespace quixotism
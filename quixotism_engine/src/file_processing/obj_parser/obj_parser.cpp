@@ -1,66 +1,138 @@
 #include "obj_parser.hpp"
 
-#include <cctype>
+#include <algorithm>
+#include <bit>
 #include <charconv>
+#include <cstring>
+#include <span>
 #include <vector>
 
+#include "thread_pool.hpp"
+
 namespace quixotism {
 
+// smaller chunks are not worth a job of their own
+static constexpr size_t OBJ_MIN_CHUNK_SIZE = Kilobytes(256);
+
+// face corners without a texture coordinate or normal index get this one
+// until the stitch gives them a generated attribute
+static constexpr u32 OBJ_MISSING_INDEX = 0xFFFFFFFF;
+// face corners with an index that points at no vertex of their object get
+// this one, the stitch drops the triangles that use them
+static constexpr u32 OBJ_INVALID_INDEX = 0xFFFFFFFE;
+// Largest index magnitude accepted from a file. Keeping indices (and vertex
+// counts) below 2^31 lets a relative index that points in front of the file
+// wrap to a value that is out of range for every object.
+static constexpr i64 OBJ_MAX_INDEX = 0x7FFFFFFF;
+
+static FORCE_INLINE bool IsBlank(char C) { return C == ' ' || C == '\t'; }
+
 template <class VEC_TYPE>
-static VEC_TYPE ParseVecDataFromString(const char *&StartP,
-                                       i32 MaxPrecision = 6) {
+static VEC_TYPE ParseVecDataFromString(const char *&StartP, const char *EndP) {
   VEC_TYPE result{};
   for (auto &P : result.e)  // NOLINT
   {
-    const auto *EndP = StartP;
-    while (*EndP != ' ' && *EndP != '\n') {
-      ++EndP;
-    }
-    std::from_chars(StartP, EndP, P);
-    if (*EndP == ' ') ++EndP;
-    StartP = EndP;
+    while (StartP != EndP && IsBlank(*StartP)) ++StartP;
+    // from_chars stops at the delimiter itself, no separate scan for it
+    StartP = std::from_chars(StartP, EndP, P).ptr;
   }
-  while (*StartP != '\n') ++StartP;
   return result;
 }
 
-static void ParseFaceIndices(TriangleIndices &Indices, i32 PosIdxOffset,
-                             i32 TexCoordIdxOffset, i32 NormalIdxOffset,
-                             const char *&Pos) {
-  i32 Index = 0;
-
-  while (Index < 3) {
-    i32 IndexVal = 0;
-    while (*Pos != '/') {
-      Assert(isdigit(*Pos));
-      IndexVal = (IndexVal * 10) + *Pos - '0';
-      ++Pos;
+/**
+ * Parses an optionally negative decimal integer, 0 if there are no digits.
+ *
+ * Up to 8 digits are found and converted at once: a byte is a digit if its
+ * high nibble is 3 and adding 6 keeps it there. The digits get shifted to the
+ * top of the word, so the missing ones read as leading zeros, and three
+ * multiply-add steps combine pairs, quads and then the two halves. Near the
+ * end of the chunk, and for the 9th digit on, digits are read one at a time.
+ */
+static i64 ParseIndex(const char *&Pos, const char *EndP) {
+  bool Negative = (Pos != EndP) && (*Pos == '-');
+  Pos += Negative;
+  i64 Value = 0;
+  if (EndP - Pos >= 8) {
+    u64 Chars;
+    std::memcpy(&Chars, Pos, sizeof(Chars));
+    u64 Classes = (Chars & 0xF0F0F0F0F0F0F0F0ULL) |
+                  (((Chars + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >>
+                   4);
+    u64 NonDigits = Classes ^ 0x3333333333333333ULL;
+    u32 DigitCount =
+        NonDigits ? (static_cast<u32>(std::countr_zero(NonDigits)) >> 3) : 8;
+    if (DigitCount) {
+      u64 Digits = (Chars - 0x3030303030303030ULL) << ((8 - DigitCount) * 8);
+      Digits = (Digits * 10) + (Digits >> 8);
+      Digits = (((Digits & 0x000000FF000000FFULL) *
+                 (100 + (1000000ULL << 32))) +
+                (((Digits >> 16) & 0x000000FF000000FFULL) *
+                 (1 + (10000ULL << 32)))) >>
+               32;
+      Value = static_cast<i64>(Digits);
+      Pos += DigitCount;
     }
+    if (DigitCount < 8) return Negative ? -Value : Value;
+  }
+  // saturates, anything past OBJ_MAX_INDEX gets rejected anyway
+  while (Pos != EndP && static_cast<u8>(*Pos - '0') < 10) {
+    Value = std::min<i64>((Value * 10) + (*Pos - '0'), OBJ_MAX_INDEX + 1);
     ++Pos;
-    Indices.PosIdx.push_back(IndexVal - PosIdxOffset - 1);
+  }
+  return Negative ? -Value : Value;
+}
 
-    IndexVal = 0;
-    while (*Pos != '/') {
-      Assert(isdigit(*Pos));
-      IndexVal = (IndexVal * 10) + *Pos - '0';
-      ++Pos;
-    }
-    ++Pos;
-    Indices.TexCoordIdx.push_back(IndexVal - TexCoordIdxOffset - 1);
+struct OBJFaceCorner {
+  // position, texture coordinate and normal index
+  u32 Idx[3];
+  // bit i is set if Idx[i] is negative in the file (relative to the last
+  // vertex), those are kept relative to the segment until the stitch
+  u32 RelativeMask;
+};
+
+// 1 based (or negative, relative) index from the file to a 0 based one.
+// Only the magnitude can be checked here, a relative index may point into an
+// earlier chunk and the vertex data in front of the chunk is not known yet.
+// A relative index is kept as Count + Value, which is negative (as i32) if it
+// points in front of the segment. The stitch checks every index against its
+// object.
+static FORCE_INLINE u32 ResolveIndex(i64 Value, size_t Count, u32 Attrib,
+                                     u32 &RelativeMask) {
+  if (Value > OBJ_MAX_INDEX || Value < -OBJ_MAX_INDEX) {
+    return OBJ_INVALID_INDEX;
+  }
+  if (Value > 0) return static_cast<u32>(Value - 1);
+  if (Value == 0) return OBJ_MISSING_INDEX;
+  RelativeMask |= 1U << Attrib;
+  return static_cast<u32>(static_cast<i64>(Count) + Value);
+}
 
-    IndexVal = 0;
-    while (*Pos != ' ') {
-      Assert(isdigit(*Pos));
-      IndexVal = (IndexVal * 10) + *Pos - '0';
+// Parses one 'v', 'v/vt', 'v//vn' or 'v/vt/vn' corner, false if there is
+// none left on the line or it has no position
+static bool ParseFaceCorner(const char *&Pos, const char *EndP,
+                            const size_t (&Counts)[3],
+                            OBJFaceCorner &Corner) {
+  while (Pos != EndP && IsBlank(*Pos)) ++Pos;
+  i64 Values[3] = {ParseIndex(Pos, EndP), 0, 0};
+  if (Pos != EndP && *Pos == '/') {
+    ++Pos;
+    Values[1] = ParseIndex(Pos, EndP);
+    if (Pos != EndP && *Pos == '/') {
       ++Pos;
+      Values[2] = ParseIndex(Pos, EndP);
     }
-    ++Pos;
-    Indices.NormalIdx.push_back(IndexVal - NormalIdxOffset - 1);
-    ++Index;
   }
+  Corner.RelativeMask = 0;
+  for (u32 Attrib = 0; Attrib < 3; ++Attrib) {
+    Corner.Idx[Attrib] = ResolveIndex(Values[Attrib], Counts[Attrib], Attrib,
+                                      Corner.RelativeMask);
+  }
+  // skip whatever is left of a malformed corner
+  while (Pos != EndP && !IsBlank(*Pos) && *Pos != '\r' && *Pos != '\n') ++Pos;
+  return Corner.Idx[0] != OBJ_MISSING_INDEX;
 }
 
-void UpdateBounds(AABB &bounds, VertexPos &vert) {
+void UpdateBounds(AABB &bounds, const VertexPos &vert) {
   auto &min = bounds.min;
   auto &max = bounds.max;
   min.x = Min(min.x, vert.x);
@@ -71,111 +143,502 @@ void UpdateBounds(AABB &bounds, VertexPos &vert) {
   max.z = Max(max.z, vert.z);
 }
 
-std::vector<Mesh> ParseOBJ(const void *ObjFileData, size_t FileSize) {
-  std::vector<Mesh> Objects;
-  // Sanity check, that we actaully got some data to parse...
-  if (!ObjFileData || FileSize == 0) {
-    return Objects;
+// Consecutive lines of a chunk that belong to the same object for sure
+struct OBJSegment {
+  // the segment starts at an 'o' line, which names the current object
+  bool HasName = false;
+  std::string ObjectName;
+  // the first line is the first vertex line after an 'o' line (or the first
+  // one of the chunk), which is where a new object can start
+  bool StartsWithVertex = false;
+  std::vector<VertexPos> VertexPosData;
+  std::vector<VertexNormal> VertexNormalData;
+  std::vector<VertexTexCoords> VertexTexCoordData;
+  AABB bbox;
+  // Indices are 0 based and relative to the whole file, they become relative
+  // to their object once the chunks are stitched together. Negative indices
+  // from the file are relative to the segment's vertex data instead, the
+  // Relative arrays list where they are.
+  TriangleIndices VertexTriangleIndicies;
+  std::vector<u32> RelativePosIdx;
+  std::vector<u32> RelativeTexCoordIdx;
+  std::vector<u32> RelativeNormalIdx;
+  // some face corners have no texture coordinate or normal index
+  bool MissingTexCoords = false;
+  bool MissingNormals = false;
+};
+
+// Where the data of a segment goes in the output
+struct OBJSegmentPlacement {
+  size_t MeshIdx;
+  size_t PosOffset;
+  size_t NormalOffset;
+  size_t TexCoordOffset;
+  size_t FaceOffset;
+  // vertex data of the file in front of the segment's object
+  u32 PosIdxOffset;
+  u32 NormalIdxOffset;
+  u32 TexCoordIdxOffset;
+  // vertex data of the file in front of the segment
+  u32 PosBase;
+  u32 NormalBase;
+  u32 TexCoordBase;
+  // vertex data of the segment's object, which its face indices have to stay
+  // below
+  u32 PosCount;
+  u32 NormalCount;
+  u32 TexCoordCount;
+  // the segment holds all of its object's data of that kind, which gets
+  // moved over instead of copied
+  bool MovePos = false;
+  bool MoveNormal = false;
+  bool MoveTexCoord = false;
+  bool MoveFaces = false;
+};
+
+static void AddFaceCorner(OBJSegment &Segment, const OBJFaceCorner &Corner) {
+  auto &Indices = Segment.VertexTriangleIndicies;
+  if (Corner.RelativeMask) {
+    auto Position = static_cast<u32>(Indices.PosIdx.size());
+    if (Corner.RelativeMask & 1) Segment.RelativePosIdx.push_back(Position);
+    if (Corner.RelativeMask & 2) {
+      Segment.RelativeTexCoordIdx.push_back(Position);
+    }
+    if (Corner.RelativeMask & 4) Segment.RelativeNormalIdx.push_back(Position);
   }
+  Indices.PosIdx.push_back(Corner.Idx[0]);
+  Indices.TexCoordIdx.push_back(Corner.Idx[1]);
+  Indices.NormalIdx.push_back(Corner.Idx[2]);
+}
 
-  auto *CurrentP = static_cast<const char *>(ObjFileData);
-  auto *EndP = CurrentP + FileSize;
+// Polygons are split into a fan of triangles around their first corner
+static void ParseFaceLine(OBJSegment &Segment, const char *&Pos,
+                          const char *EndP) {
+  const size_t Counts[3] = {Segment.VertexPosData.size(),
+                            Segment.VertexTexCoordData.size(),
+                            Segment.VertexNormalData.size()};
+  OBJFaceCorner First, Previous, Corner;
+  if (!ParseFaceCorner(Pos, EndP, Counts, First) ||
+      !ParseFaceCorner(Pos, EndP, Counts, Previous)) {
+    return;
+  }
+  // checked once per line, the segment's flags get set when a triangle uses
+  // the corners
+  bool MissingTexCoord = First.Idx[1] == OBJ_MISSING_INDEX;
+  bool MissingNormal = First.Idx[2] == OBJ_MISSING_INDEX;
+  bool AnyTriangle = false;
+  while (ParseFaceCorner(Pos, EndP, Counts, Corner)) {
+    AddFaceCorner(Segment, First);
+    AddFaceCorner(Segment, Previous);
+    AddFaceCorner(Segment, Corner);
+    MissingTexCoord |= (Previous.Idx[1] == OBJ_MISSING_INDEX) |
+                       (Corner.Idx[1] == OBJ_MISSING_INDEX);
+    MissingNormal |= (Previous.Idx[2] == OBJ_MISSING_INDEX) |
+                     (Corner.Idx[2] == OBJ_MISSING_INDEX);
+    AnyTriangle = true;
+    Previous = Corner;
+  }
+  if (AnyTriangle) {
+    Segment.MissingTexCoords |= MissingTexCoord;
+    Segment.MissingNormals |= MissingNormal;
+  }
+}
 
-  i32 PosIdxOffset = 0;
-  i32 NormalIdxOffset = 0;
-  i32 TexCoordIdxOffset = 0;
-  Mesh CurrentObject;
-  bool first_vert = true;
-  bool NewObject = true;
+static bool IsEmptySegment(const OBJSegment &Segment) {
+  return Segment.VertexPosData.empty() && Segment.VertexNormalData.empty() &&
+         Segment.VertexTexCoordData.empty() &&
+         Segment.VertexTriangleIndicies.PosIdx.empty();
+}
 
-  // keep looping until we get to the file end
-  while (CurrentP != EndP) {
+// Parses whole lines in [CurrentP, EndP). A new segment starts at every
+// object name and at the first vertex line after it.
+static void ParseOBJChunk(const char *CurrentP, const char *EndP,
+                          std::vector<OBJSegment> &Segments) {
+  auto *Segment = &Segments.emplace_back();
+  // whether an earlier chunk left a new object pending is not known here
+  bool VertexSinceName = false;
+  while (CurrentP < EndP) {
+    while (CurrentP != EndP && IsBlank(*CurrentP)) ++CurrentP;
+    if (CurrentP == EndP) break;
     // check the first character of the line
     switch (*CurrentP) {
       case 'v': {
         // got vertex data
-        if (NewObject) {
-          if (!CurrentObject.VertexPosData.empty()) {
-            PosIdxOffset += CurrentObject.VertexPosData.size();
-            NormalIdxOffset += CurrentObject.VertexNormalData.size();
-            TexCoordIdxOffset += CurrentObject.VertexTexCoordData.size();
-            Objects.push_back(std::move(CurrentObject));
-            CurrentObject = Mesh();
-          }
-          CurrentObject.VertexPosData.reserve(1024);
-          CurrentObject.VertexNormalData.reserve(1024);
-          CurrentObject.VertexTexCoordData.reserve(1024);
-          CurrentObject.VertexTriangleIndicies.PosIdx.reserve(1024);
-          CurrentObject.VertexTriangleIndicies.NormalIdx.reserve(1024);
-          CurrentObject.VertexTriangleIndicies.TexCoordIdx.reserve(1024);
-          first_vert = true;
-          NewObject = false;
+        if (!VertexSinceName) {
+          if (!IsEmptySegment(*Segment)) Segment = &Segments.emplace_back();
+          Segment->StartsWithVertex = true;
+          VertexSinceName = true;
         }
-        // advance to next character
         ++CurrentP;
+        if (CurrentP == EndP) break;
         switch (*CurrentP) {
-          case ' ': {
+          case ' ':
+          case '\t': {
             // got vertex positions
-            // skip past white-spcae
-            CurrentP += 2;
-            auto vert = ParseVecDataFromString<VertexPos>(CurrentP);
-            if (first_vert) {
-              first_vert = false;
-              CurrentObject.bbox.min = vert;
-              CurrentObject.bbox.max = vert;
+            auto vert = ParseVecDataFromString<VertexPos>(CurrentP, EndP);
+            if (Segment->VertexPosData.empty()) {
+              Segment->bbox.min = vert;
+              Segment->bbox.max = vert;
             } else {
-              UpdateBounds(CurrentObject.bbox, vert);
+              UpdateBounds(Segment->bbox, vert);
             }
-            CurrentObject.VertexPosData.push_back(vert);
+            Segment->VertexPosData.push_back(vert);
           } break;
           case 't': {
             // got vertex textuure coordinates
-            CurrentP += 2;
-            CurrentObject.VertexTexCoordData.emplace_back(
-                ParseVecDataFromString<VertexTexCoords>(CurrentP));
+            ++CurrentP;
+            Segment->VertexTexCoordData.emplace_back(
+                ParseVecDataFromString<VertexTexCoords>(CurrentP, EndP));
           } break;
           case 'n': {
             // got vertex normals
-            CurrentP += 2;
-            CurrentObject.VertexNormalData.emplace_back(
-                ParseVecDataFromString<VertexNormal>(CurrentP));
-          } break;
-          default: {
-            Assert(!"IMPOSSIBLE CODE PATH");
+            ++CurrentP;
+            Segment->VertexNormalData.emplace_back(
+                ParseVecDataFromString<VertexNormal>(CurrentP, EndP));
           } break;
+          default:
+            // parameter space vertices ('vp') are not used
+            break;
         }
       } break;
       case 'f': {
         // got face data
-        CurrentP += 2;
-        ParseFaceIndices(CurrentObject.VertexTriangleIndicies, PosIdxOffset,
-                         TexCoordIdxOffset, NormalIdxOffset, CurrentP);
+        ++CurrentP;
+        if (CurrentP != EndP && IsBlank(*CurrentP)) {
+          ParseFaceLine(*Segment, CurrentP, EndP);
+        }
       } break;
       case 'o': {
         // got object name
-        NewObject = true;
-        CurrentP += 2;
-        auto NameEnd = CurrentP;
-        while (*NameEnd != '\n') {
-          ++NameEnd;
+        ++CurrentP;
+        while (CurrentP != EndP && IsBlank(*CurrentP)) ++CurrentP;
+        const auto *LineEnd = CurrentP;
+        while (LineEnd != EndP && *LineEnd != '\n') {
+          ++LineEnd;
         }
-        CurrentObject.ObjectName = std::string(CurrentP, NameEnd);
-        CurrentP = NameEnd;
-      } break;
-      default: {
-        // first character of the line did not match any exected character, skip
-        // to the next line character
-        while (*CurrentP != '\n') {
-          ++CurrentP;
+        // trailing blanks and the '\r' of CRLF files are not part of it
+        const auto *NameEnd = LineEnd;
+        while (NameEnd != CurrentP &&
+               (IsBlank(NameEnd[-1]) || NameEnd[-1] == '\r')) {
+          --NameEnd;
         }
+        Segment = &Segments.emplace_back();
+        Segment->HasName = true;
+        Segment->ObjectName = std::string(CurrentP, NameEnd);
+        VertexSinceName = false;
+        CurrentP = LineEnd;
       } break;
+      default:
+        break;
+    }
+    // skip what is left of the line, then the new line character
+    while (CurrentP < EndP && *CurrentP != '\n') {
+      ++CurrentP;
     }
-    // advance to next character
     ++CurrentP;
   }
-  Objects.push_back(std::move(CurrentObject));
+}
+
+// Returns false if some face index is out of range for the object, those are
+// set to OBJ_INVALID_INDEX
+static bool CopySegment(OBJSegment &Segment,
+                        const OBJSegmentPlacement &Placement, Mesh &Object) {
+  // Segments without data of a kind must not touch the object's array, the
+  // one segment holding all of it may be moving it in on another thread
+  auto Place = [](auto &Src, auto &Dst, size_t Offset, bool Move) {
+    if (Src.empty()) return;
+    if (Move) {
+      Dst = std::move(Src);
+    } else {
+      std::ranges::copy(Src, Dst.begin() + Offset);
+    }
+  };
+  Place(Segment.VertexPosData, Object.VertexPosData, Placement.PosOffset,
+        Placement.MovePos);
+  Place(Segment.VertexNormalData, Object.VertexNormalData,
+        Placement.NormalOffset, Placement.MoveNormal);
+  Place(Segment.VertexTexCoordData, Object.VertexTexCoordData,
+        Placement.TexCoordOffset, Placement.MoveTexCoord);
+  bool Valid = true;
+  // Indices in front of the object wrap around when IdxOffset gets
+  // subtracted, so one compare catches those, the ones past the object and
+  // OBJ_INVALID_INDEX
+  auto PlaceIndices = [&](std::vector<u32> &Src,
+                          const std::vector<u32> &Relative, u32 Base,
+                          std::vector<u32> &Dst, u32 IdxOffset,
+                          u32 ObjectCount, bool MayBeMissing) {
+    if (Src.empty()) return;
+    for (auto Position : Relative) {
+      auto Idx = static_cast<i64>(Base) + static_cast<i32>(Src[Position]);
+      Src[Position] = (Idx >= 0) ? static_cast<u32>(Idx) : OBJ_INVALID_INDEX;
+    }
+    auto Count = Src.size();
+    Place(Src, Dst, Placement.FaceOffset, Placement.MoveFaces);
+    auto Placed = std::span{Dst}.subspan(Placement.FaceOffset, Count);
+    bool AnyInvalid = false;
+    for (auto &Idx : Placed) {
+      if (MayBeMissing && Idx == OBJ_MISSING_INDEX) continue;
+      u32 Local = Idx - IdxOffset;
+      AnyInvalid |= Local >= ObjectCount;
+      Idx = (Local < ObjectCount) ? Local : OBJ_INVALID_INDEX;
+    }
+    Valid &= !AnyInvalid;
+  };
+  auto &Src = Segment.VertexTriangleIndicies;
+  auto &Dst = Object.VertexTriangleIndicies;
+  PlaceIndices(Src.PosIdx, Segment.RelativePosIdx, Placement.PosBase,
+               Dst.PosIdx, Placement.PosIdxOffset, Placement.PosCount, false);
+  PlaceIndices(Src.TexCoordIdx, Segment.RelativeTexCoordIdx,
+               Placement.TexCoordBase, Dst.TexCoordIdx,
+               Placement.TexCoordIdxOffset, Placement.TexCoordCount,
+               Segment.MissingTexCoords);
+  PlaceIndices(Src.NormalIdx, Segment.RelativeNormalIdx, Placement.NormalBase,
+               Dst.NormalIdx, Placement.NormalIdxOffset, Placement.NormalCount,
+               Segment.MissingNormals);
+  return Valid;
+}
+
+// Removes the triangles with a corner that got OBJ_INVALID_INDEX
+static void DropInvalidFaces(Mesh &Object) {
+  auto &Indices = Object.VertexTriangleIndicies;
+  size_t Kept = 0;
+  for (size_t Corner = 0; Corner + 2 < Indices.PosIdx.size(); Corner += 3) {
+    bool Invalid = false;
+    for (size_t Idx = Corner; Idx < Corner + 3; ++Idx) {
+      Invalid |= (Indices.PosIdx[Idx] == OBJ_INVALID_INDEX) |
+                 (Indices.TexCoordIdx[Idx] == OBJ_INVALID_INDEX) |
+                 (Indices.NormalIdx[Idx] == OBJ_INVALID_INDEX);
+    }
+    if (Invalid) continue;
+    for (size_t Idx = 0; Idx < 3; ++Idx) {
+      Indices.PosIdx[Kept + Idx] = Indices.PosIdx[Corner + Idx];
+      Indices.TexCoordIdx[Kept + Idx] = Indices.TexCoordIdx[Corner + Idx];
+      Indices.NormalIdx[Kept + Idx] = Indices.NormalIdx[Corner + Idx];
+    }
+    Kept += 3;
+  }
+  Indices.PosIdx.resize(Kept);
+  Indices.TexCoordIdx.resize(Kept);
+  Indices.NormalIdx.resize(Kept);
+}
+
+// Corners without a texture coordinate all get a (0, 0) one, corners without
+// a normal get the flat normal of their triangle
+static void FillMissingAttributes(Mesh &Object, bool TexCoords, bool Normals) {
+  auto &Indices = Object.VertexTriangleIndicies;
+  if (TexCoords) {
+    auto Default = static_cast<u32>(Object.VertexTexCoordData.size());
+    Object.VertexTexCoordData.push_back(VertexTexCoords{0.0f, 0.0f});
+    std::ranges::replace(Indices.TexCoordIdx, OBJ_MISSING_INDEX, Default);
+  }
+  if (Normals) {
+    const auto &Positions = Object.VertexPosData;
+    for (size_t Corner = 0; Corner + 2 < Indices.NormalIdx.size();
+         Corner += 3) {
+      u32 *Normal = &Indices.NormalIdx[Corner];
+      if (Normal[0] != OBJ_MISSING_INDEX && Normal[1] != OBJ_MISSING_INDEX &&
+          Normal[2] != OBJ_MISSING_INDEX) {
+        continue;
+      }
+      // positions are in range, the stitch dropped the faces that are not
+      const u32 *Pos = &Indices.PosIdx[Corner];
+      VertexNormal FaceNormal{0.0f, 0.0f, 1.0f};
+      auto Perpendicular = Cross(Positions[Pos[1]] - Positions[Pos[0]],
+                                 Positions[Pos[2]] - Positions[Pos[0]]);
+      if (Perpendicular.LengthSqr() > 0.0f) {
+        FaceNormal = Perpendicular.Normalize();
+      }
+      auto FaceNormalIdx = static_cast<u32>(Object.VertexNormalData.size());
+      Object.VertexNormalData.push_back(FaceNormal);
+      for (u32 Idx = 0; Idx < 3; ++Idx) {
+        if (Normal[Idx] == OBJ_MISSING_INDEX) Normal[Idx] = FaceNormalIdx;
+      }
+    }
+  }
+}
+
+/**
+ * The file is cut into chunks at line boundaries and the chunks are parsed in
+ * parallel into segments (see OBJSegment). Face indices are kept relative to
+ * the file until every chunk is done.
+ *
+ * A serial pass over the segments then assigns them to objects the way a
+ * single pass over the lines would: after an 'o' line the next vertex line
+ * starts a new object if the current one has vertex positions. The name goes
+ * to the current object while it has no faces yet (3ds Max writes it between
+ * an object's vertices and its faces), otherwise to the next one (Blender
+ * writes it first). Prefix sums of the segment sizes give each segment its
+ * place in its object's arrays and the amount of vertex data in front of the
+ * object, which is subtracted from the face indices (so indices stay relative
+ * to their own object, like before). The copies into the final arrays run in
+ * parallel again.
+ *
+ * Faces can be any polygon (triangulated as a fan) with 'v', 'v/vt', 'v//vn'
+ * or 'v/vt/vn' corners and negative (relative) indices; lines may end in
+ * CRLF. Missing texture coordinates and normals get generated ones, so the
+ * three index arrays always line up. Triangles with an index outside of their
+ * object's vertex data are dropped, so every index of the result is in range.
+ */
+std::vector<Mesh> ParseOBJ(const void *ObjFileData, size_t FileSize) {
+  std::vector<Mesh> Objects;
+  // Sanity check, that we actaully got some data to parse...
+  if (!ObjFileData || FileSize == 0) {
+    return Objects;
+  }
+
+  const auto *FileStart = static_cast<const char *>(ObjFileData);
+  const auto *FileEnd = FileStart + FileSize;
+  auto &Pool = ThreadPool::GetThreadPool();
+
+  size_t ChunkCount = std::clamp<size_t>(FileSize / OBJ_MIN_CHUNK_SIZE, 1,
+                                         Pool.GetThreadCount() * 4);
+  std::vector<const char *> ChunkStarts{FileStart};
+  for (size_t Chunk = 1; Chunk < ChunkCount; ++Chunk) {
+    const auto *Start = std::max(ChunkStarts.back(),
+                                 FileStart + (FileSize * Chunk / ChunkCount));
+    const auto *LineEnd = static_cast<const char *>(
+        std::memchr(Start, '\n', FileEnd - Start));
+    if (!LineEnd) break;
+    ChunkStarts.push_back(LineEnd + 1);
+  }
+  ChunkStarts.push_back(FileEnd);
+
+  std::vector<std::vector<OBJSegment>> ChunkSegments(ChunkStarts.size() - 1);
+  Pool.ParallelFor(ChunkSegments.size(), [&](size_t Chunk, u32) {
+    ParseOBJChunk(ChunkStarts[Chunk], ChunkStarts[Chunk + 1],
+                  ChunkSegments[Chunk]);
+  });
+
+  std::vector<OBJSegment *> Segments;
+  std::vector<OBJSegmentPlacement> Placements;
+  size_t PosCount = 0;
+  size_t NormalCount = 0;
+  size_t TexCoordCount = 0;
+  OBJSegmentPlacement Current{};
+  bool NewObject = true;
+  std::string PendingName;
+  size_t ObjectFirstSegment = 0;
+  // Once the last segment of the object is known, arrays that come from a
+  // single segment are marked to be moved and the others are sized for the
+  // copies. Big objects mostly sit in one chunk, so copies are rare.
+  auto FinishObject = [&]() {
+    size_t PosSources = 0;
+    size_t NormalSources = 0;
+    size_t TexCoordSources = 0;
+    size_t FaceSources = 0;
+    for (size_t Idx = ObjectFirstSegment; Idx < Segments.size(); ++Idx) {
+      PosSources += !Segments[Idx]->VertexPosData.empty();
+      NormalSources += !Segments[Idx]->VertexNormalData.empty();
+      TexCoordSources += !Segments[Idx]->VertexTexCoordData.empty();
+      FaceSources += !Segments[Idx]->VertexTriangleIndicies.PosIdx.empty();
+    }
+    for (size_t Idx = ObjectFirstSegment; Idx < Segments.size(); ++Idx) {
+      const auto &Segment = *Segments[Idx];
+      auto &Placement = Placements[Idx];
+      Placement.PosCount = static_cast<u32>(Current.PosOffset);
+      Placement.NormalCount = static_cast<u32>(Current.NormalOffset);
+      Placement.TexCoordCount = static_cast<u32>(Current.TexCoordOffset);
+      Placement.MovePos = PosSources == 1 && !Segment.VertexPosData.empty();
+      Placement.MoveNormal =
+          NormalSources == 1 && !Segment.VertexNormalData.empty();
+      Placement.MoveTexCoord =
+          TexCoordSources == 1 && !Segment.VertexTexCoordData.empty();
+      Placement.MoveFaces =
+          FaceSources == 1 && !Segment.VertexTriangleIndicies.PosIdx.empty();
+    }
+    auto &Object = Objects.back();
+    if (PosSources > 1) Object.VertexPosData.resize(Current.PosOffset);
+    if (NormalSources > 1) Object.VertexNormalData.resize(Current.NormalOffset);
+    if (TexCoordSources > 1) {
+      Object.VertexTexCoordData.resize(Current.TexCoordOffset);
+    }
+    if (FaceSources > 1) {
+      Object.VertexTriangleIndicies.PosIdx.resize(Current.FaceOffset);
+      Object.VertexTriangleIndicies.TexCoordIdx.resize(Current.FaceOffset);
+      Object.VertexTriangleIndicies.NormalIdx.resize(Current.FaceOffset);
+    }
+    ObjectFirstSegment = Segments.size();
+  };
+  struct MissingAttributes {
+    bool TexCoords = false;
+    bool Normals = false;
+  };
+  std::vector<MissingAttributes> ObjectMissing;
+  Objects.emplace_back();
+  ObjectMissing.emplace_back();
+  for (auto &Chunk : ChunkSegments) {
+    for (auto &Segment : Chunk) {
+      if (Segment.HasName) {
+        if (Current.FaceOffset == 0) {
+          Objects.back().ObjectName = Segment.ObjectName;
+        } else {
+          PendingName = Segment.ObjectName;
+        }
+        NewObject = true;
+      }
+      if (Segment.StartsWithVertex && NewObject) {
+        if (Current.PosOffset != 0) {
+          FinishObject();
+          Objects.emplace_back();
+          ObjectMissing.emplace_back();
+          Current = {};
+          Current.MeshIdx = Objects.size() - 1;
+          Current.PosIdxOffset = static_cast<u32>(PosCount);
+          Current.NormalIdxOffset = static_cast<u32>(NormalCount);
+          Current.TexCoordIdxOffset = static_cast<u32>(TexCoordCount);
+        }
+        if (!PendingName.empty()) {
+          Objects.back().ObjectName = std::move(PendingName);
+          PendingName.clear();
+        }
+        NewObject = false;
+      }
+      if (!Segment.VertexPosData.empty()) {
+        auto &bbox = Objects.back().bbox;
+        if (Current.PosOffset == 0) {
+          bbox = Segment.bbox;
+        } else {
+          UpdateBounds(bbox, Segment.bbox.min);
+          UpdateBounds(bbox, Segment.bbox.max);
+        }
+      }
+      Current.PosBase = static_cast<u32>(PosCount);
+      Current.NormalBase = static_cast<u32>(NormalCount);
+      Current.TexCoordBase = static_cast<u32>(TexCoordCount);
+      ObjectMissing.back().TexCoords |= Segment.MissingTexCoords;
+      ObjectMissing.back().Normals |= Segment.MissingNormals;
+      Segments.push_back(&Segment);
+      Placements.push_back(Current);
+      Current.PosOffset += Segment.VertexPosData.size();
+      Current.NormalOffset += Segment.VertexNormalData.size();
+      Current.TexCoordOffset += Segment.VertexTexCoordData.size();
+      Current.FaceOffset += Segment.VertexTriangleIndicies.PosIdx.size();
+      PosCount += Segment.VertexPosData.size();
+      NormalCount += Segment.VertexNormalData.size();
+      TexCoordCount += Segment.VertexTexCoordData.size();
+    }
+  }
+  FinishObject();
+
+  // not a vector<bool>, the copies set their flags in parallel
+  std::vector<u8> SegmentValid(Segments.size());
+  Pool.ParallelFor(Segments.size(), [&](size_t Idx, u32) {
+    SegmentValid[Idx] = CopySegment(*Segments[Idx], Placements[Idx],
+                                    Objects[Placements[Idx].MeshIdx]);
+  });
+  std::vector<u8> ObjectValid(Objects.size(), true);
+  for (size_t Idx = 0; Idx < Segments.size(); ++Idx) {
+    if (!SegmentValid[Idx]) ObjectValid[Placements[Idx].MeshIdx] = false;
+  }
+  Pool.ParallelFor(Objects.size(), [&](size_t Idx, u32) {
+    if (!ObjectValid[Idx]) DropInvalidFaces(Objects[Idx]);
+    if (ObjectMissing[Idx].TexCoords || ObjectMissing[Idx].Normals) {
+      FillMissingAttributes(Objects[Idx], ObjectMissing[Idx].TexCoords,
+                            ObjectMissing[Idx].Normals);
+    }
+  });
 
   return Objects;
 }
 
-}  // namespace quixotism
\ No newline at end of file
+}  // namespace quixotism
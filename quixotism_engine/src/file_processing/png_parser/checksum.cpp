@@ -0,0 +1,194 @@
+#include "checksum.hpp"
+
+#include <emmintrin.h>
+#include <immintrin.h>
+#include <wmmintrin.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include "cpu_features.hpp"
+
+namespace quixotism {
+
+//
+// CRC32
+//
+
+// Slice-by-8 tables, table[k][b] is the CRC of byte b followed by k zero
+// bytes
+static constexpr auto crc_tables = [] {
+  std::array<std::array<u32, 256>, 8> tables = {};
+  for (u32 byte = 0; byte < 256; ++byte) {
+    u32 crc = byte;
+    for (u32 bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320U : 0);
+    }
+    tables[0][byte] = crc;
+  }
+  for (u32 byte = 0; byte < 256; ++byte) {
+    for (u32 k = 1; k < 8; ++k) {
+      u32 prev = tables[k - 1][byte];
+      tables[k][byte] = (prev >> 8) ^ tables[0][prev & 0xFF];
+    }
+  }
+  return tables;
+}();
+
+// Works on the inverted CRC state
+static u32 CRC32Scalar(const u8 *data, size_t size, u32 state) {
+  while (size >= 8) {
+    u32 lo, hi;
+    std::memcpy(&lo, data, sizeof(lo));
+    std::memcpy(&hi, data + 4, sizeof(hi));
+    lo ^= state;
+    state = crc_tables[7][lo & 0xFF] ^ crc_tables[6][(lo >> 8) & 0xFF] ^
+            crc_tables[5][(lo >> 16) & 0xFF] ^ crc_tables[4][lo >> 24] ^
+            crc_tables[3][hi & 0xFF] ^ crc_tables[2][(hi >> 8) & 0xFF] ^
+            crc_tables[1][(hi >> 16) & 0xFF] ^ crc_tables[0][hi >> 24];
+    data += 8;
+    size -= 8;
+  }
+  while (size--) {
+    state = (state >> 8) ^ crc_tables[0][(state ^ *data++) & 0xFF];
+  }
+  return state;
+}
+
+// Folds 'x' 128 (or 512, depending on the constants) bits forward onto 'next'
+TARGET_PCLMUL static FORCE_INLINE __m128i CRCFold(__m128i x, __m128i k,
+                                                  __m128i next) {
+  auto lo = _mm_clmulepi64_si128(x, k, 0x00);
+  auto hi = _mm_clmulepi64_si128(x, k, 0x11);
+  return _mm_xor_si128(_mm_xor_si128(hi, lo), next);
+}
+
+// Folding with carry-less multiplication ("Fast CRC Computation for Generic
+// Polynomials Using PCLMULQDQ Instruction", Intel 2009), constants are x^n mod
+// P for the reflected CRC-32 polynomial. Works on the inverted CRC state, size
+// has to be a multiple of 16 and at least 64.
+TARGET_PCLMUL static u32 CRC32PCLMUL(const u8 *data, size_t size,
+                                     u32 state) {
+  const auto k1k2 = _mm_set_epi64x(0x01C6E41596, 0x0154442BD4);
+  const auto k3k4 = _mm_set_epi64x(0x00CCAA009E, 0x01751997D0);
+  const auto k5 = _mm_set_epi64x(0, 0x0163CD6124);
+  const auto poly = _mm_set_epi64x(0x01F7011641, 0x01DB710641);
+  const auto mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+  auto load = [](const u8 *ptr) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr));
+  };
+
+  // four independent 128 bit lanes hide the multiplication latency
+  auto x0 =
+      _mm_xor_si128(load(data), _mm_cvtsi32_si128(static_cast<int>(state)));
+  auto x1 = load(data + 16);
+  auto x2 = load(data + 32);
+  auto x3 = load(data + 48);
+  data += 64;
+  size -= 64;
+  while (size >= 64) {
+    x0 = CRCFold(x0, k1k2, load(data));
+    x1 = CRCFold(x1, k1k2, load(data + 16));
+    x2 = CRCFold(x2, k1k2, load(data + 32));
+    x3 = CRCFold(x3, k1k2, load(data + 48));
+    data += 64;
+    size -= 64;
+  }
+
+  // fold the lanes into one, then the remaining 16 byte blocks
+  x0 = CRCFold(x0, k3k4, x1);
+  x0 = CRCFold(x0, k3k4, x2);
+  x0 = CRCFold(x0, k3k4, x3);
+  while (size >= 16) {
+    x0 = CRCFold(x0, k3k4, load(data));
+    data += 16;
+    size -= 16;
+  }
+
+  // 128 -> 64 bits
+  auto t = _mm_clmulepi64_si128(x0, k3k4, 0x10);
+  x0 = _mm_xor_si128(_mm_srli_si128(x0, 8), t);
+  t = _mm_srli_si128(x0, 4);
+  x0 = _mm_clmulepi64_si128(_mm_and_si128(x0, mask32), k5, 0x00);
+  x0 = _mm_xor_si128(x0, t);
+
+  // Barrett reduction to 32 bits
+  t = _mm_clmulepi64_si128(_mm_and_si128(x0, mask32), poly, 0x10);
+  t = _mm_clmulepi64_si128(_mm_and_si128(t, mask32), poly, 0x00);
+  x0 = _mm_xor_si128(x0, t);
+  return static_cast<u32>(_mm_cvtsi128_si32(_mm_srli_si128(x0, 4)));
+}
+
+u32 CRC32(const u8 *data, size_t size, u32 crc) {
+  static const bool use_pclmul =
+      GetCPUFeatures().pclmul && GetCPUFeatures().sse41;
+  u32 state = ~crc;
+  if (use_pclmul && size >= 64) {
+    size_t fold_size = size & ~size_t{15};
+    state = CRC32PCLMUL(data, fold_size, state);
+    data += fold_size;
+    size -= fold_size;
+  }
+  return ~CRC32Scalar(data, size, state);
+}
+
+//
+// Adler32
+//
+
+static constexpr u32 ADLER_MOD = 65521;
+// Most bytes that can be summed before s2 could overflow 32 bits (zlib's
+// NMAX), rounded down to whole 16 byte vectors
+static constexpr size_t ADLER_BLOCK_SIZE = 5552 & ~size_t{15};
+
+u32 Adler32(const u8 *data, size_t size, u32 adler) {
+  u32 s1 = adler & 0xFFFF;
+  u32 s2 = adler >> 16;
+
+  // per 16 byte vector: s2 += 16 * s1 + sum((16 - i) * byte[i]),
+  // s1 += sum(byte[i]). The s1 term is accumulated separately per vector and
+  // multiplied once at the end of a block.
+  const auto zero = _mm_setzero_si128();
+  const auto weights_lo = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+  const auto weights_hi = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+  while (size >= 16) {
+    size_t block_size = std::min(size, ADLER_BLOCK_SIZE) & ~size_t{15};
+    auto v_s1 = zero;
+    auto v_s1_sum = zero;
+    auto v_s2 = zero;
+    for (size_t offset = 0; offset < block_size; offset += 16) {
+      auto bytes =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + offset));
+      v_s1_sum = _mm_add_epi32(v_s1_sum, v_s1);
+      v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes, zero));
+      auto lo = _mm_madd_epi16(_mm_unpacklo_epi8(bytes, zero), weights_lo);
+      auto hi = _mm_madd_epi16(_mm_unpackhi_epi8(bytes, zero), weights_hi);
+      v_s2 = _mm_add_epi32(v_s2, _mm_add_epi32(lo, hi));
+    }
+
+    auto horizontal_sum = [](__m128i v) {
+      v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0x4E));
+      v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0xB1));
+      return static_cast<u64>(static_cast<u32>(_mm_cvtsi128_si32(v)));
+    };
+    u64 block_s1 = horizontal_sum(v_s1);
+    u64 block_s2 = (static_cast<u64>(s1) * block_size) +
+                   (horizontal_sum(v_s1_sum) * 16) + horizontal_sum(v_s2);
+    s1 = static_cast<u32>((s1 + block_s1) % ADLER_MOD);
+    s2 = static_cast<u32>((s2 + block_s2) % ADLER_MOD);
+    data += block_size;
+    size -= block_size;
+  }
+
+  for (size_t idx = 0; idx < size; ++idx) {
+    s1 += data[idx];
+    s2 += s1;
+  }
+  s1 %= ADLER_MOD;
+  s2 %= ADLER_MOD;
+  return (s2 << 16) | s1;
+}
+
+}  // namespace quixotism
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "quixotism_c.hpp"
+
+namespace quixotism {
+
+// CRC-32 as used by PNG chunks and gzip (reflected polynomial 0xEDB88320).
+// Pass the result of a previous call as 'crc' to continue a checksum over
+// multiple buffers. Uses carry-less multiplication folding on CPUs with
+// PCLMULQDQ.
+u32 CRC32(const u8 *data, size_t size, u32 crc = 0);
+
+// Adler-32 as used by the zlib stream trailer, continues from 'adler' the same
+// way CRC32 does
+u32 Adler32(const u8 *data, size_t size, u32 adler = 1);
+
+}  // namespace quixotism
@@ -0,0 +1,732 @@
+#include "deflate.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+
+#include "checksum.hpp"
+
+namespace quixotism {
+
+static constexpr u32 END_OF_BLOCK = 256;
+static constexpr u32 FIRST_LENGTH_SYMBOL = 257;
+static constexpr u32 LIT_LEN_SYMBOLS = 286;
+// the fixed code also assigns codes to the two unused symbols 286 and 287
+static constexpr u32 FIXED_LIT_LEN_SYMBOLS = 288;
+static constexpr u32 DIST_SYMBOLS = 30;
+static constexpr u32 CODE_LENGTH_SYMBOLS = 19;
+static constexpr u32 MAX_CODE_LENGTH = 15;
+static constexpr u32 MAX_CODE_LENGTH_CODE_LENGTH = 7;
+static constexpr u32 MAX_MATCH_LENGTH = 258;
+static constexpr u32 MAX_STORED_BLOCK_SIZE = 65535;
+static constexpr u32 WINDOW_SIZE = 32768;
+static constexpr u32 WINDOW_MASK = WINDOW_SIZE - 1;
+// Matches are found through a hash of their first 4 bytes, so the shortest
+// match this finds is 4 bytes long. 3 byte matches barely pay off anyway.
+static constexpr u32 HASH_LENGTH = 4;
+static constexpr u32 HASH_BITS = 15;
+// symbols collected before a block gets written
+static constexpr u32 BLOCK_SYMBOLS = 1 << 15;
+
+static constexpr u16 length_base[] = {
+    3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static constexpr u8 length_extra_bits[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                           1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                           4, 4, 4, 4, 5, 5, 5, 5, 0};
+static constexpr u16 dist_base[] = {
+    1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+    33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145,  8193,  12289, 16385, 24577};
+static constexpr u8 dist_extra_bits[] = {0, 0, 0,  0,  1,  1,  2,  2,
+                                         3, 3, 4,  4,  5,  5,  6,  6,
+                                         7, 7, 8,  8,  9,  9,  10, 10,
+                                         11, 11, 12, 12, 13, 13};
+static constexpr u8 code_length_order[CODE_LENGTH_SYMBOLS] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// match length -> length code (symbol - FIRST_LENGTH_SYMBOL)
+static constexpr auto length_codes = [] {
+  std::array<u8, MAX_MATCH_LENGTH + 1> table{};
+  for (u32 code = 0; code < ArrayCount(length_base); ++code) {
+    u32 count = 1U << length_extra_bits[code];
+    for (u32 idx = 0; idx < count; ++idx) {
+      u32 length = length_base[code] + idx;
+      // 258 has its own code, code 284 would cover it too
+      if (length <= MAX_MATCH_LENGTH) table[length] = static_cast<u8>(code);
+    }
+  }
+  return table;
+}();
+
+// distance - 1 -> distance code, distances above 256 are looked up by
+// (distance - 1) >> 7 in the second half
+static constexpr auto dist_codes = [] {
+  std::array<u8, 512> table{};
+  for (u32 code = 0; code < ArrayCount(dist_base); ++code) {
+    u32 count = 1U << dist_extra_bits[code];
+    u32 first = dist_base[code] - 1U;
+    if (first < 256) {
+      for (u32 idx = 0; idx < count; ++idx) {
+        table[first + idx] = static_cast<u8>(code);
+      }
+    } else {
+      for (u32 idx = 0; idx < count; idx += 128) {
+        table[256 + ((first + idx) >> 7)] = static_cast<u8>(code);
+      }
+    }
+  }
+  return table;
+}();
+
+static FORCE_INLINE u32 DistCode(u32 dist) {
+  return (dist <= 256) ? dist_codes[dist - 1]
+                       : dist_codes[256 + ((dist - 1) >> 7)];
+}
+
+inline static constexpr u32 ReverseBits(u32 value, u32 bit_count) {
+  u32 result = 0;
+  for (u32 bit_idx = 0; bit_idx < bit_count; ++bit_idx) {
+    result = (result << 1) | ((value >> bit_idx) & 0x1);
+  }
+  return result;
+}
+
+//
+// Output
+//
+
+// LSB first bit writer, the counterpart of BitReader
+class BitWriter {
+ public:
+  explicit BitWriter(std::vector<u8> &_out) : out{_out} {}
+
+  // value has to fit in count bits, count <= 32
+  FORCE_INLINE void WriteBits(u32 value, u32 count) {
+    bit_buffer |= static_cast<u64>(value) << bit_count;
+    bit_count += count;
+    if (bit_count >= 32) {
+      u8 bytes[4];
+      u32 word = static_cast<u32>(bit_buffer);
+      std::memcpy(bytes, &word, sizeof(bytes));
+      out.insert(out.end(), bytes, bytes + sizeof(bytes));
+      bit_buffer >>= 32;
+      bit_count -= 32;
+    }
+  }
+
+  // Pads to the next byte boundary with zero bits and flushes the buffer
+  void AlignToByte() {
+    while (bit_count > 0) {
+      out.push_back(static_cast<u8>(bit_buffer));
+      bit_buffer >>= 8;
+      bit_count = (bit_count > 8) ? bit_count - 8 : 0;
+    }
+  }
+
+  void WriteBytes(const u8 *data, size_t size) {
+    Assert(bit_count == 0);
+    out.insert(out.end(), data, data + size);
+  }
+
+ private:
+  std::vector<u8> &out;
+  u64 bit_buffer = 0;
+  u32 bit_count = 0;
+};
+
+static void WriteStoredBlocks(BitWriter &writer, const u8 *data, size_t size,
+                              bool final) {
+  do {
+    u32 block_size =
+        static_cast<u32>(std::min<size_t>(size, MAX_STORED_BLOCK_SIZE));
+    bool last = (block_size == size);
+    writer.WriteBits((final && last) ? 1 : 0, 1);
+    writer.WriteBits(0, 2);
+    writer.AlignToByte();
+    u8 lengths[4] = {static_cast<u8>(block_size),
+                     static_cast<u8>(block_size >> 8),
+                     static_cast<u8>(~block_size),
+                     static_cast<u8>(~block_size >> 8)};
+    writer.WriteBytes(lengths, sizeof(lengths));
+    writer.WriteBytes(data, block_size);
+    data += block_size;
+    size -= block_size;
+  } while (size > 0);
+}
+
+static size_t StoredBlocksBits(size_t size) {
+  size_t block_count =
+      std::max<size_t>(1, (size + MAX_STORED_BLOCK_SIZE - 1) /
+                              MAX_STORED_BLOCK_SIZE);
+  // header bits get padded to a byte boundary, then LEN and NLEN
+  return (size + block_count * 5) * 8;
+}
+
+//
+// Huffman codes
+//
+
+struct HuffmanCode {
+  // bit reversed, ready for the LSB first writer
+  u16 codes[FIXED_LIT_LEN_SYMBOLS];
+  u8 lengths[FIXED_LIT_LEN_SYMBOLS];
+};
+
+// Assigns canonical codes to the code lengths
+static void AssignCodes(HuffmanCode &code, u32 count) {
+  u32 length_counts[MAX_CODE_LENGTH + 1] = {};
+  for (u32 symbol = 0; symbol < count; ++symbol) {
+    ++length_counts[code.lengths[symbol]];
+  }
+  length_counts[0] = 0;
+  u32 next_code[MAX_CODE_LENGTH + 1] = {};
+  u32 value = 0;
+  for (u32 length = 1; length <= MAX_CODE_LENGTH; ++length) {
+    value = (value + length_counts[length - 1]) << 1;
+    next_code[length] = value;
+  }
+  for (u32 symbol = 0; symbol < count; ++symbol) {
+    u32 length = code.lengths[symbol];
+    code.codes[symbol] =
+        length ? static_cast<u16>(ReverseBits(next_code[length]++, length))
+               : 0;
+  }
+}
+
+/**
+ * Builds huffman code lengths of at most max_length bits for the symbol
+ * frequencies.
+ *
+ * The tree is built with the two queue method over the leaves sorted by
+ * frequency. Lengths over the limit are clamped and the code is made complete
+ * again by moving leaves down from the shorter levels, like miniz and zlib
+ * do. Codes always get at least two symbols, some inflaters reject a code
+ * with a single one.
+ */
+static void BuildCodeLengths(const u32 *freqs, u32 count, u32 max_length,
+                             HuffmanCode &code) {
+  struct Leaf {
+    u32 freq;
+    u16 symbol;
+  };
+  Leaf leaves[FIXED_LIT_LEN_SYMBOLS];
+  u32 leaf_count = 0;
+  for (u32 symbol = 0; symbol < count; ++symbol) {
+    if (freqs[symbol]) {
+      leaves[leaf_count++] = {freqs[symbol], static_cast<u16>(symbol)};
+    }
+  }
+  for (u16 symbol = 0; leaf_count < 2; ++symbol) {
+    if (!freqs[symbol]) leaves[leaf_count++] = {1, symbol};
+  }
+  std::sort(leaves, leaves + leaf_count, [](const Leaf &a, const Leaf &b) {
+    return (a.freq != b.freq) ? (a.freq < b.freq) : (a.symbol < b.symbol);
+  });
+
+  // node ids: leaves first, internal nodes after them in creation order
+  u32 weights[FIXED_LIT_LEN_SYMBOLS];
+  u16 parents[2 * FIXED_LIT_LEN_SYMBOLS];
+  u32 node_count = 0;
+  u32 next_leaf = 0, next_node = 0;
+  auto weight = [&](u32 node) {
+    return (node < leaf_count) ? leaves[node].freq
+                               : weights[node - leaf_count];
+  };
+  auto take_smallest = [&]() -> u32 {
+    if (next_leaf < leaf_count &&
+        (next_node == node_count ||
+         leaves[next_leaf].freq <= weights[next_node])) {
+      return next_leaf++;
+    }
+    return leaf_count + next_node++;
+  };
+  for (; node_count < leaf_count - 1;) {
+    u32 a = take_smallest();
+    u32 b = take_smallest();
+    weights[node_count] = weight(a) + weight(b);
+    parents[a] = parents[b] = static_cast<u16>(leaf_count + node_count);
+    ++node_count;
+  }
+
+  // parents come after their children, so one backwards pass sets all depths
+  u32 depths[2 * FIXED_LIT_LEN_SYMBOLS];
+  u32 root = leaf_count + node_count - 1;
+  depths[root] = 0;
+  u32 length_counts[MAX_CODE_LENGTH + 1] = {};
+  for (u32 node = root; node-- > 0;) {
+    depths[node] = depths[parents[node]] + 1;
+    if (node < leaf_count) ++length_counts[std::min(depths[node], max_length)];
+  }
+
+  u32 kraft_sum = 0;
+  for (u32 length = 1; length <= max_length; ++length) {
+    kraft_sum += length_counts[length] << (max_length - length);
+  }
+  while (kraft_sum > (1U << max_length)) {
+    --length_counts[max_length];
+    for (u32 length = max_length - 1; length > 0; --length) {
+      if (length_counts[length]) {
+        --length_counts[length];
+        length_counts[length + 1] += 2;
+        break;
+      }
+    }
+    --kraft_sum;
+  }
+
+  // least frequent symbols get the longest codes
+  std::memset(code.lengths, 0, count);
+  u32 leaf_idx = 0;
+  for (u32 length = max_length; length > 0; --length) {
+    for (u32 n = length_counts[length]; n > 0; --n) {
+      code.lengths[leaves[leaf_idx++].symbol] = static_cast<u8>(length);
+    }
+  }
+}
+
+static const HuffmanCode &FixedLitLenCode() {
+  static const HuffmanCode code = [] {
+    HuffmanCode result = {};
+    for (u32 symbol = 0; symbol < FIXED_LIT_LEN_SYMBOLS; ++symbol) {
+      result.lengths[symbol] = (symbol < 144)   ? 8
+                               : (symbol < 256) ? 9
+                               : (symbol < 280) ? 7
+                                                : 8;
+    }
+    AssignCodes(result, FIXED_LIT_LEN_SYMBOLS);
+    return result;
+  }();
+  return code;
+}
+
+static const HuffmanCode &FixedDistCode() {
+  static const HuffmanCode code = [] {
+    HuffmanCode result = {};
+    std::memset(result.lengths, 5, DIST_SYMBOLS);
+    AssignCodes(result, DIST_SYMBOLS);
+    return result;
+  }();
+  return code;
+}
+
+// Code lengths of a dynamic block header, run length encoded with the
+// repeat symbols 16-18
+struct CodeLengthSymbol {
+  u8 symbol;
+  u8 extra;
+};
+
+static u32 RunLengthEncode(const u8 *lengths, u32 count,
+                           CodeLengthSymbol *out) {
+  u32 out_count = 0;
+  for (u32 idx = 0; idx < count;) {
+    u8 length = lengths[idx];
+    u32 run = 1;
+    while (idx + run < count && lengths[idx + run] == length) ++run;
+    idx += run;
+    if (length == 0) {
+      while (run >= 11) {
+        u32 repeat = std::min(run, 138U);
+        out[out_count++] = {18, static_cast<u8>(repeat - 11)};
+        run -= repeat;
+      }
+      if (run >= 3) {
+        out[out_count++] = {17, static_cast<u8>(run - 3)};
+        run = 0;
+      }
+    } else {
+      out[out_count++] = {length, 0};
+      --run;
+      while (run >= 3) {
+        u32 repeat = std::min(run, 6U);
+        out[out_count++] = {16, static_cast<u8>(repeat - 3)};
+        run -= repeat;
+      }
+    }
+    for (; run > 0; --run) out[out_count++] = {length, 0};
+  }
+  return out_count;
+}
+
+static constexpr u8 code_length_extra_bits[CODE_LENGTH_SYMBOLS] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 3, 7};
+
+//
+// LZ77
+//
+
+struct LevelConfig {
+  // hash chain entries searched per position
+  u32 max_chain;
+  // searches that already have a match this long only walk a quarter of
+  // the chain
+  u32 good_length;
+  // a match at least this long ends the search
+  u32 nice_length;
+  // Lazy matching looks for a longer match at the next position unless the
+  // current match is at least this long. 0 for greedy matching.
+  u32 lazy_length;
+};
+
+// roughly zlib's configuration table
+static constexpr LevelConfig level_configs[DEFLATE_MAX_LEVEL + 1] = {
+    {0, 0, 0, 0},            // 0, stored
+    {4, 4, 8, 0},            // 1
+    {8, 4, 16, 0},           // 2
+    {32, 4, 32, 0},          // 3
+    {16, 4, 16, 4},          // 4
+    {32, 8, 32, 16},         // 5
+    {128, 8, 128, 16},       // 6
+    {256, 8, 128, 32},       // 7
+    {1024, 32, 258, 128},    // 8
+    {4096, 32, 258, 258},    // 9
+};
+
+struct LZMatch {
+  u32 length = 0;
+  u32 dist = 0;
+};
+
+struct LZSymbol {
+  // literal byte or match length
+  u16 value;
+  // match distance, 0 for literals
+  u16 dist;
+};
+
+static FORCE_INLINE u32 Hash4(const u8 *ptr) {
+  u32 value;
+  std::memcpy(&value, ptr, sizeof(value));
+  return (value * 0x9E3779B1U) >> (32 - HASH_BITS);
+}
+
+static FORCE_INLINE u32 MatchLength(const u8 *a, const u8 *b,
+                                    u32 max_length) {
+  u32 length = 0;
+  while (length + 8 <= max_length) {
+    u64 word_a, word_b;
+    std::memcpy(&word_a, a + length, sizeof(word_a));
+    std::memcpy(&word_b, b + length, sizeof(word_b));
+    u64 diff = word_a ^ word_b;
+    if (diff) return length + (std::countr_zero(diff) >> 3);
+    length += 8;
+  }
+  while (length < max_length && a[length] == b[length]) ++length;
+  return length;
+}
+
+/**
+ * Hash chain LZ77 over the whole input, which is in memory anyway for the
+ * PNG encoder so positions are plain offsets into it.
+ *
+ * head holds the latest position for every hash, prev links each position of
+ * the last 32K to the previous one with the same hash. Symbols are collected
+ * per block together with their frequencies, then the block is written with
+ * the cheapest of the three block types.
+ */
+class DeflateEncoder {
+ public:
+  DeflateEncoder(const u8 *_data, size_t _size, u32 level,
+                 BitWriter &_writer)
+      : data{_data},
+        size{_size},
+        config{level_configs[level]},
+        writer{_writer},
+        head(1U << HASH_BITS, -1),
+        prev(WINDOW_SIZE, -1),
+        symbols(BLOCK_SYMBOLS) {
+    Assert(size < (1ULL << 31));
+  }
+  CLASS_DELETE_COPY(DeflateEncoder);
+
+  void Compress() {
+    if (config.lazy_length) {
+      CompressLazy();
+    } else {
+      CompressGreedy();
+    }
+    FlushBlock(true);
+  }
+
+ private:
+  FORCE_INLINE void Insert(size_t pos) {
+    if (pos + HASH_LENGTH > size) return;
+    u32 hash = Hash4(data + pos);
+    prev[pos & WINDOW_MASK] = head[hash];
+    head[hash] = static_cast<i32>(pos);
+  }
+
+  // Longest match at pos that is longer than min_length, has to be called
+  // before pos gets inserted
+  FORCE_INLINE LZMatch FindMatch(size_t pos, u32 min_length) {
+    LZMatch best;
+    u32 max_length =
+        static_cast<u32>(std::min<size_t>(MAX_MATCH_LENGTH, size - pos));
+    if (max_length < HASH_LENGTH) return best;
+    u32 best_length = std::max(min_length, HASH_LENGTH - 1);
+    if (best_length >= max_length) return best;
+
+    const u8 *current = data + pos;
+    i32 candidate = head[Hash4(current)];
+    u32 chain = config.max_chain;
+    if (min_length >= config.good_length) chain >>= 2;
+    for (; chain > 0; --chain) {
+      if (candidate < 0 || pos - candidate > WINDOW_SIZE) break;
+      const u8 *match = data + candidate;
+      // most candidates fail on the byte that would make the match longer
+      if (match[best_length] == current[best_length]) {
+        u32 length = MatchLength(match, current, max_length);
+        if (length > best_length) {
+          best_length = length;
+          best = {length, static_cast<u32>(pos - candidate)};
+          if (length >= config.nice_length || length == max_length) break;
+        }
+      }
+      i32 next = prev[candidate & WINDOW_MASK];
+      if (next >= candidate) break;
+      candidate = next;
+    }
+    return best;
+  }
+
+  void CompressGreedy() {
+    size_t pos = 0;
+    while (pos < size) {
+      LZMatch match = FindMatch(pos, 0);
+      Insert(pos);
+      if (match.length) {
+        AddMatch(match);
+        size_t end = pos + match.length;
+        // long matches (runs) are cheap to find again, skip inserting them
+        if (match.length <= config.nice_length) {
+          for (++pos; pos < end; ++pos) Insert(pos);
+        }
+        pos = end;
+      } else {
+        AddLiteral(data[pos++]);
+      }
+    }
+  }
+
+  void CompressLazy() {
+    size_t pos = 0;
+    // match found at pos - 1 that waits for a longer one at pos
+    LZMatch pending;
+    bool has_pending = false;
+    while (pos < size) {
+      LZMatch match;
+      if (!has_pending || pending.length < config.lazy_length) {
+        match = FindMatch(pos, has_pending ? pending.length : 0);
+      }
+      Insert(pos);
+      if (has_pending && pending.length && !match.length) {
+        AddMatch(pending);
+        size_t end = pos - 1 + pending.length;
+        for (++pos; pos < end; ++pos) Insert(pos);
+        has_pending = false;
+        continue;
+      }
+      if (has_pending) AddLiteral(data[pos - 1]);
+      pending = match;
+      has_pending = true;
+      ++pos;
+    }
+    // a match needs at least HASH_LENGTH bytes, so the last byte is a literal
+    if (has_pending) AddLiteral(data[pos - 1]);
+  }
+
+  FORCE_INLINE void AddLiteral(u8 value) {
+    ++lit_len_freqs[value];
+    symbols[symbol_count++] = {value, 0};
+    ++block_size;
+    if (symbol_count == BLOCK_SYMBOLS) FlushBlock(false);
+  }
+
+  FORCE_INLINE void AddMatch(LZMatch match) {
+    ++lit_len_freqs[FIRST_LENGTH_SYMBOL + length_codes[match.length]];
+    ++dist_freqs[DistCode(match.dist)];
+    symbols[symbol_count++] = {static_cast<u16>(match.length),
+                               static_cast<u16>(match.dist)};
+    block_size += match.length;
+    if (symbol_count == BLOCK_SYMBOLS) FlushBlock(false);
+  }
+
+  // Bits the symbols take with the given codes, extra bits included
+  size_t SymbolBits(const HuffmanCode &lit_len, const HuffmanCode &dist) {
+    size_t bits = 0;
+    for (u32 symbol = 0; symbol < LIT_LEN_SYMBOLS; ++symbol) {
+      bits += static_cast<size_t>(lit_len_freqs[symbol]) *
+              lit_len.lengths[symbol];
+      if (symbol >= FIRST_LENGTH_SYMBOL) {
+        bits += static_cast<size_t>(lit_len_freqs[symbol]) *
+                length_extra_bits[symbol - FIRST_LENGTH_SYMBOL];
+      }
+    }
+    for (u32 symbol = 0; symbol < DIST_SYMBOLS; ++symbol) {
+      bits += static_cast<size_t>(dist_freqs[symbol]) *
+              (dist.lengths[symbol] + dist_extra_bits[symbol]);
+    }
+    return bits;
+  }
+
+  void WriteSymbols(const HuffmanCode &lit_len, const HuffmanCode &dist) {
+    for (u32 idx = 0; idx < symbol_count; ++idx) {
+      auto symbol = symbols[idx];
+      if (!symbol.dist) {
+        writer.WriteBits(lit_len.codes[symbol.value],
+                         lit_len.lengths[symbol.value]);
+        continue;
+      }
+      u32 length_code = length_codes[symbol.value];
+      u32 lit_len_symbol = FIRST_LENGTH_SYMBOL + length_code;
+      writer.WriteBits(lit_len.codes[lit_len_symbol],
+                       lit_len.lengths[lit_len_symbol]);
+      writer.WriteBits(symbol.value - length_base[length_code],
+                       length_extra_bits[length_code]);
+      u32 dist_code = DistCode(symbol.dist);
+      writer.WriteBits(dist.codes[dist_code], dist.lengths[dist_code]);
+      writer.WriteBits(symbol.dist - dist_base[dist_code],
+                       dist_extra_bits[dist_code]);
+    }
+    writer.WriteBits(lit_len.codes[END_OF_BLOCK],
+                     lit_len.lengths[END_OF_BLOCK]);
+  }
+
+  void FlushBlock(bool final) {
+    lit_len_freqs[END_OF_BLOCK] = 1;
+
+    BuildCodeLengths(lit_len_freqs, LIT_LEN_SYMBOLS, MAX_CODE_LENGTH,
+                     lit_len_code);
+    AssignCodes(lit_len_code, LIT_LEN_SYMBOLS);
+    BuildCodeLengths(dist_freqs, DIST_SYMBOLS, MAX_CODE_LENGTH, dist_code);
+    AssignCodes(dist_code, DIST_SYMBOLS);
+
+    u32 lit_len_count = LIT_LEN_SYMBOLS;
+    while (lit_len_count > FIRST_LENGTH_SYMBOL &&
+           !lit_len_code.lengths[lit_len_count - 1]) {
+      --lit_len_count;
+    }
+    u32 dist_count = DIST_SYMBOLS;
+    while (dist_count > 1 && !dist_code.lengths[dist_count - 1]) {
+      --dist_count;
+    }
+
+    // code lengths of both codes are encoded as one sequence
+    u8 lengths[LIT_LEN_SYMBOLS + DIST_SYMBOLS];
+    std::memcpy(lengths, lit_len_code.lengths, lit_len_count);
+    std::memcpy(lengths + lit_len_count, dist_code.lengths, dist_count);
+    CodeLengthSymbol length_symbols[LIT_LEN_SYMBOLS + DIST_SYMBOLS];
+    u32 length_symbol_count =
+        RunLengthEncode(lengths, lit_len_count + dist_count, length_symbols);
+
+    u32 length_freqs[CODE_LENGTH_SYMBOLS] = {};
+    for (u32 idx = 0; idx < length_symbol_count; ++idx) {
+      ++length_freqs[length_symbols[idx].symbol];
+    }
+    BuildCodeLengths(length_freqs, CODE_LENGTH_SYMBOLS,
+                     MAX_CODE_LENGTH_CODE_LENGTH, length_code);
+    AssignCodes(length_code, CODE_LENGTH_SYMBOLS);
+    u32 length_code_count = CODE_LENGTH_SYMBOLS;
+    while (length_code_count > 4 &&
+           !length_code.lengths[code_length_order[length_code_count - 1]]) {
+      --length_code_count;
+    }
+
+    size_t dynamic_bits = 3 + 5 + 5 + 4 + (3 * length_code_count) +
+                          SymbolBits(lit_len_code, dist_code);
+    for (u32 symbol = 0; symbol < CODE_LENGTH_SYMBOLS; ++symbol) {
+      dynamic_bits += static_cast<size_t>(length_freqs[symbol]) *
+                      (length_code.lengths[symbol] +
+                       code_length_extra_bits[symbol]);
+    }
+    size_t fixed_bits = 3 + SymbolBits(FixedLitLenCode(), FixedDistCode());
+    size_t stored_bits = 3 + StoredBlocksBits(block_size);
+
+    if (stored_bits <= std::min(dynamic_bits, fixed_bits)) {
+      WriteStoredBlocks(writer, data + block_start, block_size, final);
+    } else if (fixed_bits <= dynamic_bits) {
+      writer.WriteBits(final ? 1 : 0, 1);
+      writer.WriteBits(1, 2);
+      WriteSymbols(FixedLitLenCode(), FixedDistCode());
+    } else {
+      writer.WriteBits(final ? 1 : 0, 1);
+      writer.WriteBits(2, 2);
+      writer.WriteBits(lit_len_count - FIRST_LENGTH_SYMBOL, 5);
+      writer.WriteBits(dist_count - 1, 5);
+      writer.WriteBits(length_code_count - 4, 4);
+      for (u32 idx = 0; idx < length_code_count; ++idx) {
+        writer.WriteBits(length_code.lengths[code_length_order[idx]], 3);
+      }
+      for (u32 idx = 0; idx < length_symbol_count; ++idx) {
+        auto symbol = length_symbols[idx];
+        writer.WriteBits(length_code.codes[symbol.symbol],
+                         length_code.lengths[symbol.symbol]);
+        writer.WriteBits(symbol.extra,
+                         code_length_extra_bits[symbol.symbol]);
+      }
+      WriteSymbols(lit_len_code, dist_code);
+    }
+
+    block_start += block_size;
+    block_size = 0;
+    symbol_count = 0;
+    std::memset(lit_len_freqs, 0, sizeof(lit_len_freqs));
+    std::memset(dist_freqs, 0, sizeof(dist_freqs));
+  }
+
+  const u8 *data;
+  size_t size;
+  LevelConfig config;
+  BitWriter &writer;
+
+  std::vector<i32> head;
+  std::vector<i32> prev;
+
+  std::vector<LZSymbol> symbols;
+  u32 symbol_count = 0;
+  // input range the collected symbols cover
+  size_t block_start = 0;
+  size_t block_size = 0;
+  u32 lit_len_freqs[LIT_LEN_SYMBOLS] = {};
+  u32 dist_freqs[DIST_SYMBOLS] = {};
+
+  HuffmanCode lit_len_code;
+  HuffmanCode dist_code;
+  HuffmanCode length_code;
+};
+
+//
+// zlib stream
+//
+
+void ZlibCompress(const u8 *data, size_t size, u32 level,
+                  std::vector<u8> &out) {
+  level = std::min(level, DEFLATE_MAX_LEVEL);
+
+  // deflate with a 32K window, FLEVEL as zlib sets it, FCHECK makes the
+  // header a multiple of 31
+  u32 cmf = 0x78;
+  u32 flevel = (level < 2) ? 0 : (level < 6) ? 1 : (level == 6) ? 2 : 3;
+  u32 flg = flevel << 6;
+  flg |= 31 - (((cmf << 8) | flg) % 31);
+  out.push_back(static_cast<u8>(cmf));
+  out.push_back(static_cast<u8>(flg));
+
+  BitWriter writer{out};
+  if (level == 0) {
+    WriteStoredBlocks(writer, data, size, true);
+  } else {
+    DeflateEncoder encoder{data, size, level, writer};
+    encoder.Compress();
+  }
+  writer.AlignToByte();
+
+  u32 adler = Adler32(data, size);
+  for (i32 shift = 24; shift >= 0; shift -= 8) {
+    out.push_back(static_cast<u8>(adler >> shift));
+  }
+}
+
+}  // namespace quixotism
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+
+#include "quixotism_c.hpp"
+
+namespace quixotism {
+
+static constexpr u32 DEFLATE_MAX_LEVEL = 9;
+
+/**
+ * Compresses data into a zlib stream (2 byte header, deflate blocks and the
+ * Adler-32 trailer) that gets appended to 'out'.
+ *
+ * Level 0 only writes stored blocks, which runs at memcpy speed. Levels 1-9
+ * follow zlib's: 1-3 do greedy LZ77 matching with short hash chains, 4-9 lazy
+ * matching with longer and longer chains. Every block is written with a
+ * dynamic huffman code, the fixed code or stored, whichever is smallest.
+ */
+void ZlibCompress(const u8 *data, size_t size, u32 level,
+                  std::vector<u8> &out);
+
+}  // namespace quixotism
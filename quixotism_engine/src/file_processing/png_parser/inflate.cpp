@@ -0,0 +1,617 @@
+#include "inflate.hpp"
+
+#include <emmintrin.h>
+
+#include <algorithm>
+
+#include "checksum.hpp"
+
+namespace quixotism {
+
+struct ExtraLength {
+  u16 val;
+  u16 bits;
+};
+
+static constexpr ExtraLength extra_lengths[] = {
+    {3, 0},    // 257
+    {4, 0},    // 258
+    {5, 0},    // 259
+    {6, 0},    // 260
+    {7, 0},    // 261
+    {8, 0},    // 262
+    {9, 0},    // 263
+    {10, 0},   // 264
+    {11, 1},   // 265
+    {13, 1},   // 266
+    {15, 1},   // 267
+    {17, 1},   // 268
+    {19, 2},   // 269
+    {23, 2},   // 270
+    {27, 2},   // 271
+    {31, 2},   // 272
+    {35, 3},   // 273
+    {43, 3},   // 274
+    {51, 3},   // 275
+    {59, 3},   // 276
+    {67, 4},   // 277
+    {83, 4},   // 278
+    {99, 4},   // 279
+    {115, 4},  // 280
+    {131, 5},  // 281
+    {163, 5},  // 282
+    {195, 5},  // 283
+    {227, 5},  // 284
+    {258, 0},  // 285
+};
+
+static constexpr ExtraLength extra_dist[] = {
+    {1, 0},       // 0
+    {2, 0},       // 1
+    {3, 0},       // 2
+    {4, 0},       // 3
+    {5, 1},       // 4
+    {7, 1},       // 5
+    {9, 2},       // 6
+    {13, 2},      // 7
+    {17, 3},      // 8
+    {25, 3},      // 9
+    {33, 4},      // 10
+    {49, 4},      // 11
+    {65, 5},      // 12
+    {97, 5},      // 13
+    {129, 6},     // 14
+    {193, 6},     // 15
+    {257, 7},     // 16
+    {385, 7},     // 17
+    {513, 8},     // 18
+    {769, 8},     // 19
+    {1025, 9},    // 20
+    {1537, 9},    // 21
+    {2049, 10},   // 22
+    {3073, 10},   // 23
+    {4097, 11},   // 24
+    {6145, 11},   // 25
+    {8193, 12},   // 26
+    {12289, 12},  // 27
+    {16385, 13},  // 28
+    {24577, 13},  // 29
+};
+
+static constexpr u32 END_OF_BLOCK = 256;
+static constexpr u32 MAX_LIT_LEN_SYMBOL = 285;
+static constexpr u32 MAX_DIST_SYMBOL = 29;
+static constexpr u32 LIT_LEN_PRIMARY_BITS = 10;
+static constexpr u32 DIST_PRIMARY_BITS = 8;
+static constexpr u32 CODE_LENGTH_PRIMARY_BITS = 7;
+static constexpr u32 MAX_MATCH_LENGTH = 258;
+// matches reach back at most this far
+static constexpr size_t HISTORY_SIZE = 32768;
+
+inline static constexpr u32 ReverseBits(u32 value, u32 bit_count) {
+  u32 result = 0;
+  for (u32 bit_idx = 0; bit_idx < bit_count; ++bit_idx) {
+    result = (result << 1) | ((value >> bit_idx) & 0x1);
+  }
+  return result;
+}
+
+//
+// BitReader
+//
+
+void BitReader::RefillSlow() {
+  while (bit_count <= 56) {
+    if (ptr == segment_end && !NextSegment()) {
+      // out of input, feed zero bits so the decoder never reads out of bounds,
+      // Overrun() reports if they got used
+      bit_count += 8;
+      ++overrun_bytes;
+      continue;
+    }
+    bit_buffer |= static_cast<u64>(*ptr++) << bit_count;
+    bit_count += 8;
+  }
+}
+
+bool BitReader::NextSegment() {
+  if (segment_idx + 1 < segments.size()) {
+    ++segment_idx;
+    ptr = segments[segment_idx].data;
+    segment_end = ptr + segments[segment_idx].size;
+    return true;
+  }
+  if (!source) return false;
+  auto next = source();
+  if (next.empty()) {
+    source = nullptr;
+    return false;
+  }
+  ptr = next.data();
+  segment_end = ptr + next.size();
+  return true;
+}
+
+bool BitReader::CopyBytes(u8 *dest, size_t size) {
+  Assert(bit_count % 8 == 0);
+  // first hand out the whole bytes that are still in the bit buffer
+  while (size && bit_count) {
+    *dest++ = static_cast<u8>(ReadBits(8));
+    --size;
+  }
+  if (Overrun()) return false;
+  // the buffer may hold bits of bytes that only partially fit, drop them, we
+  // continue reading at ptr
+  if (!bit_count) bit_buffer = 0;
+
+  while (size) {
+    if (ptr == segment_end && !NextSegment()) return false;
+    size_t copy_size = std::min<size_t>(size, segment_end - ptr);
+    std::memcpy(dest, ptr, copy_size);
+    dest += copy_size;
+    ptr += copy_size;
+    size -= copy_size;
+  }
+  return true;
+}
+
+//
+// HuffmanDecoder
+//
+
+bool HuffmanDecoder::Build(const u8 *code_lengths, u32 count,
+                           u32 primary_bits) {
+  Assert(primary_bits <= MAX_PRIMARY_BITS);
+  u32 length_histogram[MAX_CODE_LENGTH + 1] = {};
+  u32 max_length = 0;
+  for (u32 symbol = 0; symbol < count; ++symbol) {
+    Assert(code_lengths[symbol] <= MAX_CODE_LENGTH);
+    ++length_histogram[code_lengths[symbol]];
+    max_length = std::max<u32>(max_length, code_lengths[symbol]);
+  }
+  length_histogram[0] = 0;
+
+  // reject over-subscribed codes, incomplete ones are fine (a distance code
+  // with a single symbol is incomplete by definition)
+  i32 codes_left = 1;
+  for (u32 length = 1; length <= MAX_CODE_LENGTH; ++length) {
+    codes_left <<= 1;
+    codes_left -= static_cast<i32>(length_histogram[length]);
+    if (codes_left < 0) return false;
+  }
+
+  u32 first_code[MAX_CODE_LENGTH + 1] = {};
+  for (u32 length = 1; length <= MAX_CODE_LENGTH; ++length) {
+    first_code[length] =
+        (first_code[length - 1] + length_histogram[length - 1]) << 1;
+  }
+
+  // no point in a primary table wider than the longest code
+  table_bits = std::clamp<u32>(max_length, 1, primary_bits);
+  const u32 primary_size = 1U << table_bits;
+  const u32 primary_mask = primary_size - 1;
+
+  // size the subtables, every primary prefix of a long code gets one subtable
+  // that is wide enough for the longest code with that prefix
+  u8 sub_bits[1U << MAX_PRIMARY_BITS] = {};
+  u32 next_code[MAX_CODE_LENGTH + 1];
+  std::memcpy(next_code, first_code, sizeof(next_code));
+  for (u32 symbol = 0; symbol < count; ++symbol) {
+    u32 length = code_lengths[symbol];
+    if (length <= table_bits) continue;
+    u32 code = ReverseBits(next_code[length]++, length);
+    auto &bits = sub_bits[code & primary_mask];
+    bits = std::max<u8>(bits, static_cast<u8>(length - table_bits));
+  }
+
+  u32 table_size = primary_size;
+  for (u32 prefix = 0; prefix < primary_size; ++prefix) {
+    if (sub_bits[prefix]) table_size += 1U << sub_bits[prefix];
+  }
+  entries.assign(table_size, Entry{INVALID_SYMBOL, 0, 0});
+
+  u32 sub_offset = primary_size;
+  for (u32 prefix = 0; prefix < primary_size; ++prefix) {
+    if (!sub_bits[prefix]) continue;
+    entries[prefix] =
+        Entry{static_cast<u16>(sub_offset), 0, sub_bits[prefix]};
+    sub_offset += 1U << sub_bits[prefix];
+  }
+
+  // fill in the codes, codes shorter than the table index repeat for every
+  // value of the bits they do not use
+  std::memcpy(next_code, first_code, sizeof(next_code));
+  for (u32 symbol = 0; symbol < count; ++symbol) {
+    u32 length = code_lengths[symbol];
+    if (!length) continue;
+    u32 code = ReverseBits(next_code[length]++, length);
+    if (length <= table_bits) {
+      for (u32 idx = code; idx < primary_size; idx += 1U << length) {
+        entries[idx] =
+            Entry{static_cast<u16>(symbol), static_cast<u8>(length), 0};
+      }
+    } else {
+      const auto &link = entries[code & primary_mask];
+      u32 sub_length = length - table_bits;
+      for (u32 idx = code >> table_bits; idx < (1U << link.sub_bits);
+           idx += 1U << sub_length) {
+        entries[link.symbol + idx] = Entry{static_cast<u16>(symbol),
+                                           static_cast<u8>(sub_length), 0};
+      }
+    }
+  }
+  return true;
+}
+
+//
+// Inflate
+//
+
+static bool BuildFixedTables(InflateScratch &scratch) {
+  u8 code_lengths[288 + 32];
+  std::fill(code_lengths, code_lengths + 144, 8);
+  std::fill(code_lengths + 144, code_lengths + 256, 9);
+  std::fill(code_lengths + 256, code_lengths + 280, 7);
+  std::fill(code_lengths + 280, code_lengths + 288, 8);
+  std::fill(code_lengths + 288, code_lengths + 320, 5);
+  return scratch.lit_len.Build(code_lengths, 288, LIT_LEN_PRIMARY_BITS) &&
+         scratch.dist.Build(code_lengths + 288, 32, DIST_PRIMARY_BITS);
+}
+
+static bool BuildDynamicTables(BitReader &reader, InflateScratch &scratch) {
+  reader.Refill();
+  u32 hlit = reader.ReadBits(5) + 257;
+  u32 hdist = reader.ReadBits(5) + 1;
+  // Number of code length codes
+  u32 hclen = reader.ReadBits(4) + 4;
+
+  // Order in which the code length code lengths are stored, specified by the
+  // zlib spec (the codes most likely to be used come first, so trailing
+  // unused ones can be left out)
+  static constexpr u8 hclen_swizzle[] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                         11, 4,  12, 3, 13, 2, 14, 1, 15};
+  u8 hclen_table[ArrayCount(hclen_swizzle)] = {};
+  for (u32 idx = 0; idx < hclen; ++idx) {
+    reader.Refill();
+    hclen_table[hclen_swizzle[idx]] = static_cast<u8>(reader.ReadBits(3));
+  }
+  if (!scratch.code_length.Build(hclen_table, ArrayCount(hclen_table),
+                                 CODE_LENGTH_PRIMARY_BITS)) {
+    return false;
+  }
+
+  // Code lengths of both the literal/length and the distance alphabet, they
+  // are one continuous sequence (repeats can cross from one to the other)
+  u8 code_lengths[288 + 32] = {};
+  u32 code_length_count = hlit + hdist;
+  u32 code_idx = 0;
+  while (code_idx < code_length_count) {
+    reader.Refill();
+    u32 encoded_len = scratch.code_length.Decode(reader);
+    /*
+    0 - 15: Represent code lengths of 0 - 15
+    16: Copy the previous code length 3 - 6 times (2 bits of length)
+    17: Repeat a code length of 0 for 3 - 10 times (3 bits of length)
+    18: Repeat a code length of 0 for 11 - 138 times (7 bits of length)
+    */
+    u32 repeat_count = 1;
+    u8 repeat_val = 0;
+    if (encoded_len <= 15) {
+      repeat_val = static_cast<u8>(encoded_len);
+    } else if (encoded_len == 16) {
+      if (code_idx == 0) return false;
+      repeat_count = reader.ReadBits(2) + 3;
+      repeat_val = code_lengths[code_idx - 1];
+    } else if (encoded_len == 17) {
+      repeat_count = reader.ReadBits(3) + 3;
+    } else if (encoded_len == 18) {
+      repeat_count = reader.ReadBits(7) + 11;
+    } else {
+      return false;
+    }
+    if (code_idx + repeat_count > code_length_count) return false;
+    std::fill_n(code_lengths + code_idx, repeat_count, repeat_val);
+    code_idx += repeat_count;
+  }
+
+  // a block without an end of block code could never end
+  if (!code_lengths[END_OF_BLOCK]) return false;
+  return scratch.lit_len.Build(code_lengths, hlit, LIT_LEN_PRIMARY_BITS) &&
+         scratch.dist.Build(code_lengths + hlit, hdist, DIST_PRIMARY_BITS);
+}
+
+// Copies an LZ77 match of 'length' bytes from 'distance' bytes back. Uses 16
+// byte stores and writes up to INFLATE_OUTPUT_SLACK bytes past the end of the
+// match, the caller makes sure the buffer has room for that.
+static FORCE_INLINE void CopyMatch(u8 *dest, u32 distance, u32 length) {
+  const u8 *src = dest - distance;
+  u8 *end = dest + length;
+  if (distance >= 16) {
+    // every 16 byte load only touches bytes that are already written, even
+    // when the match overlaps itself
+    do {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dest),
+                       _mm_loadu_si128(reinterpret_cast<const __m128i *>(src)));
+      _mm_storeu_si128(
+          reinterpret_cast<__m128i *>(dest + 16),
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 16)));
+      dest += 32;
+      src += 32;
+    } while (dest < end);
+    return;
+  }
+
+  // short distances repeat a pattern, replicate it into a register once and
+  // store that over and over
+  __m128i pattern;
+  u32 step = 16;
+  switch (distance) {
+    case 1: {
+      pattern = _mm_set1_epi8(static_cast<char>(*src));
+    } break;
+    case 2: {
+      u16 value;
+      std::memcpy(&value, src, sizeof(value));
+      pattern = _mm_set1_epi16(static_cast<short>(value));
+    } break;
+    case 4: {
+      u32 value;
+      std::memcpy(&value, src, sizeof(value));
+      pattern = _mm_set1_epi32(static_cast<int>(value));
+    } break;
+    case 8: {
+      u64 value;
+      std::memcpy(&value, src, sizeof(value));
+      pattern = _mm_set1_epi64x(static_cast<long long>(value));
+    } break;
+    default: {
+      // the pattern does not divide 16 bytes, so we only advance by the
+      // whole repetitions that fit into a store, the rest gets overwritten
+      alignas(16) u8 bytes[16];
+      for (u32 idx = 0; idx < 16; ++idx) {
+        bytes[idx] = src[idx % distance];
+      }
+      pattern = _mm_load_si128(reinterpret_cast<const __m128i *>(bytes));
+      step = 16 - (16 % distance);
+    } break;
+  }
+  do {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), pattern);
+    dest += step;
+  } while (dest < end);
+}
+
+enum class HuffmanBlockResult { END_OF_BLOCK, PAUSED, CORRUPT };
+
+// Decodes symbols until the end of the block, or until dest moved past
+// pause_at (pass dest_end to never pause). Decoding can overshoot pause_at by
+// a literal plus a match, the caller has to leave that much room between
+// pause_at and dest_end to not get corrupt data errors for valid streams.
+static HuffmanBlockResult InflateHuffmanBlock(BitReader &reader,
+                                              const u8 *dest_begin, u8 *&dest,
+                                              const u8 *pause_at,
+                                              const u8 *dest_end,
+                                              const InflateScratch &scratch) {
+  constexpr auto CORRUPT = HuffmanBlockResult::CORRUPT;
+  const auto &lit_len = scratch.lit_len;
+  const auto &dist = scratch.dist;
+  for (;;) {
+    if (dest > pause_at) return HuffmanBlockResult::PAUSED;
+    reader.Refill();
+    u32 symbol = lit_len.Decode(reader);
+    if (symbol < 256) {
+      // a refill leaves at least 56 bits in the buffer, which is enough for a
+      // second code plus the extra length bits, so runs of literals only pay
+      // for one refill every two symbols
+      if (dest == dest_end) return CORRUPT;
+      *dest++ = static_cast<u8>(symbol);
+      symbol = lit_len.Decode(reader);
+      if (symbol < 256) {
+        if (dest == dest_end) return CORRUPT;
+        *dest++ = static_cast<u8>(symbol);
+        continue;
+      }
+    }
+    if (symbol == END_OF_BLOCK) return HuffmanBlockResult::END_OF_BLOCK;
+    if (symbol > MAX_LIT_LEN_SYMBOL) return CORRUPT;
+
+    auto len_extra = extra_lengths[symbol - 257];
+    u32 length = len_extra.val + reader.ReadBits(len_extra.bits);
+
+    reader.Refill();
+    u32 dist_symbol = dist.Decode(reader);
+    if (dist_symbol > MAX_DIST_SYMBOL) return CORRUPT;
+    auto dist_extra = extra_dist[dist_symbol];
+    u32 distance = dist_extra.val + reader.ReadBits(dist_extra.bits);
+
+    if (distance > static_cast<size_t>(dest - dest_begin) ||
+        length > static_cast<size_t>(dest_end - dest)) {
+      return CORRUPT;
+    }
+    if (static_cast<size_t>(dest_end - dest) >=
+        length + INFLATE_OUTPUT_SLACK) {
+      CopyMatch(dest, distance, length);
+      dest += length;
+    } else {
+      // too close to the end of the buffer for wide stores, copy one byte at a
+      // time (this way we support overlapping matches (RLE) as well)
+      const u8 *src = dest - distance;
+      while (length--) {
+        *dest++ = *src++;
+      }
+    }
+  }
+}
+
+enum BlockType : u32 {
+  BLOCK_STORED = 0,
+  BLOCK_FIXED = 1,
+  BLOCK_DYNAMIC = 2,
+};
+
+struct BlockHeader {
+  bool final;
+  u32 type;
+  u32 stored_length;
+};
+
+// Reads a block header, for huffman blocks this includes building the decoding
+// tables
+static bool ReadBlockHeader(BitReader &reader, InflateScratch &scratch,
+                            BlockHeader &header) {
+  reader.Refill();
+  // BFINAL bit specifies if this is the last block of the stream
+  header.final = reader.ReadBits(1);
+  // BTYPE specifies how the data is compressed - 2 bits:
+  // 00 - no compression
+  // 01 - compressed with fixed Huffman codes
+  // 10 - compressed with dynamic Huffman codes
+  // 11 - reserved (error)
+  header.type = reader.ReadBits(2);
+  header.stored_length = 0;
+  switch (header.type) {
+    case BLOCK_STORED: {
+      reader.AlignToByte();
+      u32 len = reader.ReadBits(16);
+      u32 nlen = reader.ReadBits(16);
+      header.stored_length = len;
+      return len == (~nlen & 0xFFFF);
+    }
+    case BLOCK_FIXED:
+      return BuildFixedTables(scratch);
+    case BLOCK_DYNAMIC:
+      return BuildDynamicTables(reader, scratch);
+    default:
+      return false;
+  }
+}
+
+std::expected<size_t, InflateError> Inflate(BitReader &reader, u8 *dest,
+                                            size_t dest_size,
+                                            InflateScratch &scratch) {
+  const u8 *dest_begin = dest;
+  const u8 *dest_end = dest + dest_size;
+
+  BlockHeader header;
+  do {
+    if (!ReadBlockHeader(reader, scratch, header)) {
+      return std::unexpected(InflateError{});
+    }
+    if (header.type == BLOCK_STORED) {
+      if (header.stored_length > static_cast<size_t>(dest_end - dest) ||
+          !reader.CopyBytes(dest, header.stored_length)) {
+        return std::unexpected(InflateError{});
+      }
+      dest += header.stored_length;
+    } else if (InflateHuffmanBlock(reader, dest_begin, dest, dest_end,
+                                   dest_end, scratch) !=
+               HuffmanBlockResult::END_OF_BLOCK) {
+      return std::unexpected(InflateError{});
+    }
+  } while (!header.final);
+
+  if (reader.Overrun()) return std::unexpected(InflateError{});
+  return static_cast<size_t>(dest - dest_begin);
+}
+
+//
+// InflateStream
+//
+
+// Minimum output a decode step produces, bigger steps mean fewer history
+// slides
+static constexpr size_t DECODE_STEP_SIZE = 256 * 1024;
+// A huffman block pauses once less than this is left in the window, which
+// covers the overshoot of a literal plus a match
+static constexpr size_t DECODE_STEP_RESERVE =
+    1 + MAX_MATCH_LENGTH + INFLATE_OUTPUT_SLACK;
+
+InflateStream::InflateStream(BitReader &_reader, InflateScratch &_scratch,
+                             size_t _max_read_size, bool _compute_adler)
+    : reader{_reader},
+      scratch{_scratch},
+      max_read_size{_max_read_size},
+      compute_adler{_compute_adler} {
+  window_size =
+      HISTORY_SIZE + max_read_size + DECODE_STEP_SIZE + DECODE_STEP_RESERVE;
+  if (scratch.window.size() < window_size) scratch.window.resize(window_size);
+  window = scratch.window.data();
+}
+
+void InflateStream::SlideWindow() {
+  // keep the match history and everything that was not read yet
+  size_t history_start =
+      (write_pos > HISTORY_SIZE) ? (write_pos - HISTORY_SIZE) : 0;
+  size_t keep_from = std::min(read_pos, history_start);
+  if (keep_from == 0) return;
+  std::memmove(window, window + keep_from, write_pos - keep_from);
+  read_pos -= keep_from;
+  write_pos -= keep_from;
+}
+
+bool InflateStream::DecodeStep() {
+  if (window_size - write_pos < DECODE_STEP_SIZE + DECODE_STEP_RESERVE) {
+    SlideWindow();
+  }
+
+  auto end_block = [this]() {
+    state = final_block ? State::DONE : State::BLOCK_HEADER;
+  };
+  switch (state) {
+    case State::BLOCK_HEADER: {
+      BlockHeader header;
+      if (!ReadBlockHeader(reader, scratch, header)) return false;
+      final_block = header.final;
+      if (header.type == BLOCK_STORED) {
+        stored_remaining = header.stored_length;
+        state = State::STORED_BLOCK;
+      } else {
+        state = State::HUFFMAN_BLOCK;
+      }
+    } break;
+    case State::STORED_BLOCK: {
+      size_t copy_size = std::min<size_t>(stored_remaining, DECODE_STEP_SIZE);
+      if (!reader.CopyBytes(window + write_pos, copy_size)) return false;
+      write_pos += copy_size;
+      stored_remaining -= static_cast<u32>(copy_size);
+      if (!stored_remaining) end_block();
+    } break;
+    case State::HUFFMAN_BLOCK: {
+      u8 *dest = window + write_pos;
+      const u8 *dest_end = window + window_size;
+      auto result = InflateHuffmanBlock(reader, window, dest,
+                                        dest_end - DECODE_STEP_RESERVE,
+                                        dest_end, scratch);
+      write_pos = static_cast<size_t>(dest - window);
+      if (result == HuffmanBlockResult::CORRUPT) return false;
+      if (result == HuffmanBlockResult::END_OF_BLOCK) end_block();
+    } break;
+    case State::DONE: {
+      return false;
+    }
+  }
+  return !reader.Overrun();
+}
+
+std::expected<const u8 *, InflateError> InflateStream::Read(size_t size) {
+  Assert(size <= max_read_size);
+  while (write_pos - read_pos < size) {
+    if (!DecodeStep()) return std::unexpected(InflateError{});
+  }
+  const u8 *result = window + read_pos;
+  read_pos += size;
+  if (compute_adler) adler = Adler32(result, size, adler);
+  return result;
+}
+
+std::expected<void, InflateError> InflateStream::Finish() {
+  while (state != State::DONE) {
+    if (!DecodeStep() || write_pos != read_pos) {
+      return std::unexpected(InflateError{});
+    }
+  }
+  if (write_pos != read_pos) return std::unexpected(InflateError{});
+  return {};
+}
+
+}  // namespace quixotism
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <cstring>
+#include <expected>
+#include <functional>
+#include <span>
+#include <vector>
+
+#include "quixotism_c.hpp"
+#include "quixotism_error.hpp"
+
+namespace quixotism {
+
+class InflateError : public QError {};
+
+/**
+ * LSB first bit reader over a list of input segments (the payloads of the PNG
+ * IDAT chunks).
+ *
+ * Bits are kept in a 64 bit buffer. While the current segment has at least 8
+ * bytes left a refill is a single unaligned 8 byte load that tops the buffer
+ * up to at least 56 bits, only the last few bytes of a segment go through the
+ * byte by byte path. Reading past the end of the input yields zero bits,
+ * Overrun() tells if any of those got consumed.
+ *
+ * Input can also be pulled on demand from a SegmentSource, which gets called
+ * once all added segments are used up.
+ */
+class BitReader {
+ public:
+  // Returns the next piece of input, or an empty span at the end of the input.
+  // The data has to stay valid until the next call.
+  using SegmentSource = std::function<std::span<const u8>()>;
+
+  void SetSegmentSource(SegmentSource _source) { source = std::move(_source); }
+
+  void AddSegment(const u8 *data, size_t size) {
+    if (size == 0) return;
+    segments.push_back({data, size});
+    if (segments.size() == 1) {
+      ptr = data;
+      segment_end = data + size;
+    }
+  }
+
+  // Guarantees at least 56 bits in the bit buffer
+  FORCE_INLINE void Refill() {
+    if (bit_count > 56) return;
+    if (segment_end - ptr >= 8) {
+      u64 word;
+      std::memcpy(&word, ptr, sizeof(word));
+      // bits of the byte that only partially fits stay in the top of the
+      // buffer, the next refill ORs in the same bits again so that is fine
+      bit_buffer |= word << bit_count;
+      ptr += (63 - bit_count) >> 3;
+      bit_count |= 56;
+    } else {
+      RefillSlow();
+    }
+  }
+
+  FORCE_INLINE u32 PeekBits(u32 count) const {
+    return static_cast<u32>(bit_buffer & ((1ULL << count) - 1));
+  }
+
+  FORCE_INLINE void ConsumeBits(u32 count) {
+    bit_buffer >>= count;
+    bit_count -= count;
+  }
+
+  // Caller has to make sure enough bits are buffered (see Refill)
+  FORCE_INLINE u32 ReadBits(u32 count) {
+    auto result = PeekBits(count);
+    ConsumeBits(count);
+    return result;
+  }
+
+  void AlignToByte() { ConsumeBits(bit_count % 8); }
+
+  // Copies byte aligned data (stored blocks), returns false if the input ran
+  // out
+  bool CopyBytes(u8 *dest, size_t size);
+
+  bool Overrun() const { return (overrun_bytes * 8) > bit_count; }
+
+ private:
+  struct Segment {
+    const u8 *data;
+    size_t size;
+  };
+
+  void RefillSlow();
+  bool NextSegment();
+
+  std::vector<Segment> segments;
+  size_t segment_idx = 0;
+  SegmentSource source;
+  const u8 *ptr = nullptr;
+  const u8 *segment_end = nullptr;
+
+  u64 bit_buffer = 0;
+  u32 bit_count = 0;
+  u32 overrun_bytes = 0;
+};
+
+/**
+ * Two level canonical huffman decoding table.
+ *
+ * Codes up to 'primary_bits' long are resolved with a single lookup, longer
+ * codes go through a second lookup in a subtable that is sized for the
+ * longest code sharing the same primary prefix. This keeps the tables small
+ * enough to rebuild cheaply for every dynamic block (the previous single level
+ * table had 32K entries).
+ */
+class HuffmanDecoder {
+ public:
+  static constexpr u32 MAX_CODE_LENGTH = 15;
+  static constexpr u32 MAX_PRIMARY_BITS = 10;
+  static constexpr u16 INVALID_SYMBOL = 0xFFFF;
+
+  // Returns false if the code lengths describe an over-subscribed code
+  bool Build(const u8 *code_lengths, u32 count, u32 primary_bits);
+
+  // Decodes and consumes one symbol, the reader needs MAX_CODE_LENGTH bits
+  // buffered. Returns INVALID_SYMBOL for codes that are not part of the code.
+  FORCE_INLINE u32 Decode(BitReader &reader) const {
+    auto entry = entries[reader.PeekBits(table_bits)];
+    if (entry.sub_bits) {
+      reader.ConsumeBits(table_bits);
+      entry = entries[entry.symbol + reader.PeekBits(entry.sub_bits)];
+    }
+    reader.ConsumeBits(entry.length);
+    return entry.symbol;
+  }
+
+ private:
+  struct Entry {
+    // symbol, or the offset of the subtable if sub_bits is set
+    u16 symbol;
+    // bits the code uses (in this level of the table)
+    u8 length;
+    u8 sub_bits;
+  };
+
+  std::vector<Entry> entries;
+  u32 table_bits = 0;
+};
+
+// Decoding tables (and the InflateStream window) that can be reused between
+// inflate calls, so decoding many images on the same thread does not
+// reallocate them
+struct InflateScratch {
+  HuffmanDecoder lit_len;
+  HuffmanDecoder dist;
+  HuffmanDecoder code_length;
+  std::vector<u8> window;
+};
+
+// Matches get copied with wide stores that can write up to this many bytes
+// past the end of the match. Inflate only does that while there is room left
+// in dest, so give dest this many bytes of extra room to keep the fast copy
+// going till the very end of the stream.
+static constexpr size_t INFLATE_OUTPUT_SLACK = 32;
+
+// Inflates a zlib stream body (the deflate blocks after the 2 byte zlib
+// header) into dest, returns the number of bytes written
+std::expected<size_t, InflateError> Inflate(BitReader &reader, u8 *dest,
+                                            size_t dest_size,
+                                            InflateScratch &scratch);
+
+/**
+ * Incremental inflate for consumers that process the output front to back
+ * (PNG scanlines).
+ *
+ * Output goes into a window that only keeps the 32K of history deflate
+ * matches can reference plus the output that was not read yet. The window is
+ * decoded into in large steps and slid back when it runs full, so the history
+ * copy happens rarely. Reads hand out pointers into the window, no copies. The
+ * window memory lives in the InflateScratch.
+ */
+class InflateStream {
+ public:
+  // max_read_size is the largest Read the caller is going to do, with
+  // compute_adler set the Adler-32 of everything read is kept up to date
+  InflateStream(BitReader &_reader, InflateScratch &_scratch,
+                size_t max_read_size, bool compute_adler = false);
+  CLASS_DELETE_COPY(InflateStream);
+
+  // Returns the next 'size' bytes of output, valid until the next call. Fails
+  // if the stream is corrupt or ends early.
+  std::expected<const u8 *, InflateError> Read(size_t size);
+
+  // Decodes the rest of the stream, fails if it holds more output than was
+  // read or is corrupt
+  std::expected<void, InflateError> Finish();
+
+  // Adler-32 of the output read so far (see compute_adler)
+  u32 GetAdler32() const { return adler; }
+
+ private:
+  enum class State { BLOCK_HEADER, STORED_BLOCK, HUFFMAN_BLOCK, DONE };
+
+  bool DecodeStep();
+  void SlideWindow();
+
+  BitReader &reader;
+  InflateScratch &scratch;
+  size_t max_read_size;
+
+  // points into scratch.window
+  u8 *window = nullptr;
+  size_t window_size = 0;
+  size_t read_pos = 0;
+  size_t write_pos = 0;
+
+  bool compute_adler;
+  u32 adler = 1;
+
+  State state = State::BLOCK_HEADER;
+  bool final_block = false;
+  u32 stored_remaining = 0;
+};
+
+}  // namespace quixotism
@@ -0,0 +1,365 @@
+#include "png_filter.hpp"
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "cpu_features.hpp"
+
+namespace quixotism {
+
+// Loads/stores a single pixel in the low bytes of a register
+template <u32 BPP>
+static FORCE_INLINE __m128i LoadPixel(const u8 *ptr) {
+  if constexpr (BPP <= 4) {
+    u32 value = 0;
+    std::memcpy(&value, ptr, BPP);
+    return _mm_cvtsi32_si128(static_cast<int>(value));
+  } else {
+    u64 value = 0;
+    std::memcpy(&value, ptr, BPP);
+    return _mm_cvtsi64_si128(static_cast<long long>(value));
+  }
+}
+
+template <u32 BPP>
+static FORCE_INLINE void StorePixel(u8 *ptr, __m128i pixel) {
+  if constexpr (BPP <= 4) {
+    u32 value = static_cast<u32>(_mm_cvtsi128_si32(pixel));
+    std::memcpy(ptr, &value, BPP);
+  } else {
+    u64 value = static_cast<u64>(_mm_cvtsi128_si64(pixel));
+    std::memcpy(ptr, &value, BPP);
+  }
+}
+
+//
+// Up: dest = src + up, no dependency between bytes
+//
+
+TARGET_AVX2 static void UnfilterUpAVX2(const u8 *src, const u8 *prev_row,
+                                       u8 *dest, size_t row_size) {
+  size_t idx = 0;
+  for (; idx + 32 <= row_size; idx += 32) {
+    auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + idx));
+    auto b =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(prev_row + idx));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + idx),
+                        _mm256_add_epi8(x, b));
+  }
+  for (; idx < row_size; ++idx) {
+    dest[idx] = src[idx] + prev_row[idx];
+  }
+}
+
+static void UnfilterUp(const u8 *src, const u8 *prev_row, u8 *dest,
+                       size_t row_size) {
+  size_t idx = 0;
+  for (; idx + 16 <= row_size; idx += 16) {
+    auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + idx));
+    auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(prev_row + idx));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + idx),
+                     _mm_add_epi8(x, b));
+  }
+  for (; idx < row_size; ++idx) {
+    dest[idx] = src[idx] + prev_row[idx];
+  }
+}
+
+//
+// Sub: dest = src + left
+//
+
+// Broadcasts the last pixel of a register to all pixels
+template <u32 BPP>
+static FORCE_INLINE __m128i BroadcastLastPixel(__m128i x) {
+  if constexpr (BPP == 1) {
+    auto t = _mm_unpackhi_epi8(x, x);
+    t = _mm_shufflehi_epi16(t, 0xFF);
+    return _mm_unpackhi_epi64(t, t);
+  } else if constexpr (BPP == 2) {
+    auto t = _mm_shufflehi_epi16(x, 0xFF);
+    return _mm_unpackhi_epi64(t, t);
+  } else if constexpr (BPP == 4) {
+    return _mm_shuffle_epi32(x, 0xFF);
+  } else {
+    return _mm_unpackhi_epi64(x, x);
+  }
+}
+
+template <u32 BPP>
+static void UnfilterSub(const u8 *src, u8 *dest, size_t row_size) {
+  size_t idx = 0;
+  if constexpr (BPP == 1 || BPP == 2 || BPP == 4 || BPP == 8) {
+    // pixel sizes that divide 16 bytes: prefix sum over the pixels of a
+    // register in log2(pixels) shift+add steps, then add the last pixel of
+    // the previous register
+    auto carry = _mm_setzero_si128();
+    for (; idx + 16 <= row_size; idx += 16) {
+      auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + idx));
+      if constexpr (BPP <= 1) x = _mm_add_epi8(x, _mm_slli_si128(x, 1));
+      if constexpr (BPP <= 2) x = _mm_add_epi8(x, _mm_slli_si128(x, 2));
+      if constexpr (BPP <= 4) x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+      x = _mm_add_epi8(x, carry);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + idx), x);
+      carry = BroadcastLastPixel<BPP>(x);
+    }
+  } else {
+    // 3 and 6 byte pixels, one pixel per step
+    auto left = _mm_setzero_si128();
+    for (; idx + BPP <= row_size; idx += BPP) {
+      left = _mm_add_epi8(LoadPixel<BPP>(src + idx), left);
+      StorePixel<BPP>(dest + idx, left);
+    }
+  }
+  for (; idx < row_size; ++idx) {
+    dest[idx] = src[idx] + ((idx >= BPP) ? dest[idx - BPP] : 0);
+  }
+}
+
+//
+// Average: dest = src + floor((left + up) / 2)
+//
+
+template <u32 BPP>
+static void UnfilterAverage(const u8 *src, const u8 *prev_row, u8 *dest,
+                            size_t row_size) {
+  const auto one = _mm_set1_epi8(1);
+  auto left = _mm_setzero_si128();
+  for (size_t idx = 0; idx < row_size; idx += BPP) {
+    auto up = LoadPixel<BPP>(prev_row + idx);
+    // pavgb rounds up, subtract the rounding bit to get the floor
+    auto average =
+        _mm_sub_epi8(_mm_avg_epu8(left, up),
+                     _mm_and_si128(_mm_xor_si128(left, up), one));
+    left = _mm_add_epi8(LoadPixel<BPP>(src + idx), average);
+    StorePixel<BPP>(dest + idx, left);
+  }
+}
+
+//
+// Paeth: dest = src + whichever of left, up, up-left is closest to
+// left + up - up-left
+//
+
+template <u32 BPP>
+static void UnfilterPaeth(const u8 *src, const u8 *prev_row, u8 *dest,
+                          size_t row_size) {
+  const auto zero = _mm_setzero_si128();
+  // channels are widened to 16 bits so the predictor math can not overflow
+  auto a = _mm_setzero_si128();
+  auto c = _mm_setzero_si128();
+  for (size_t idx = 0; idx < row_size; idx += BPP) {
+    auto b = _mm_unpacklo_epi8(LoadPixel<BPP>(prev_row + idx), zero);
+
+    auto b_minus_c = _mm_sub_epi16(b, c);
+    auto a_minus_c = _mm_sub_epi16(a, c);
+    auto abs_epi16 = [&zero](__m128i x) {
+      return _mm_max_epi16(x, _mm_sub_epi16(zero, x));
+    };
+    auto pa = abs_epi16(b_minus_c);
+    auto pb = abs_epi16(a_minus_c);
+    auto pc = abs_epi16(_mm_add_epi16(b_minus_c, a_minus_c));
+
+    // pb <= pc ? b : c, then pa <= min(pb, pc) ? a : that
+    auto pick_c = _mm_cmpgt_epi16(pb, pc);
+    auto b_or_c =
+        _mm_or_si128(_mm_andnot_si128(pick_c, b), _mm_and_si128(pick_c, c));
+    auto not_a = _mm_cmpgt_epi16(pa, _mm_min_epi16(pb, pc));
+    auto predictor =
+        _mm_or_si128(_mm_andnot_si128(not_a, a), _mm_and_si128(not_a, b_or_c));
+
+    auto result = _mm_add_epi8(LoadPixel<BPP>(src + idx),
+                               _mm_packus_epi16(predictor, predictor));
+    StorePixel<BPP>(dest + idx, result);
+    a = _mm_unpacklo_epi8(result, zero);
+    c = b;
+  }
+}
+
+template <u32 BPP>
+static bool UnfilterScanlineBPP(u8 filter_type, const u8 *src,
+                                const u8 *prev_row, u8 *dest,
+                                size_t row_size) {
+  switch (filter_type) {
+    case PNG_FILTER_NONE: {
+      std::memcpy(dest, src, row_size);
+    } break;
+    case PNG_FILTER_SUB: {
+      UnfilterSub<BPP>(src, dest, row_size);
+    } break;
+    case PNG_FILTER_UP: {
+      static const bool use_avx2 = GetCPUFeatures().avx2;
+      if (use_avx2) {
+        UnfilterUpAVX2(src, prev_row, dest, row_size);
+      } else {
+        UnfilterUp(src, prev_row, dest, row_size);
+      }
+    } break;
+    case PNG_FILTER_AVERAGE: {
+      UnfilterAverage<BPP>(src, prev_row, dest, row_size);
+    } break;
+    case PNG_FILTER_PAETH: {
+      UnfilterPaeth<BPP>(src, prev_row, dest, row_size);
+    } break;
+    default: {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool UnfilterScanline(u8 filter_type, const u8 *src, const u8 *prev_row,
+                      u8 *dest, size_t row_size, u32 bytes_per_pixel) {
+  Assert(row_size % bytes_per_pixel == 0);
+  switch (bytes_per_pixel) {
+    case 1:
+      return UnfilterScanlineBPP<1>(filter_type, src, prev_row, dest, row_size);
+    case 2:
+      return UnfilterScanlineBPP<2>(filter_type, src, prev_row, dest, row_size);
+    case 3:
+      return UnfilterScanlineBPP<3>(filter_type, src, prev_row, dest, row_size);
+    case 4:
+      return UnfilterScanlineBPP<4>(filter_type, src, prev_row, dest, row_size);
+    case 6:
+      return UnfilterScanlineBPP<6>(filter_type, src, prev_row, dest, row_size);
+    case 8:
+      return UnfilterScanlineBPP<8>(filter_type, src, prev_row, dest, row_size);
+    default:
+      Assert(!"unsupported png pixel size");
+      return false;
+  }
+}
+
+//
+// Filtering (encoder side), every residual only depends on the unfiltered
+// image so all filters vectorize over whole registers
+//
+
+static FORCE_INLINE u8 PaethPredictor(u8 a, u8 b, u8 c) {
+  i32 p = static_cast<i32>(a) + b - c;
+  i32 pa = std::abs(p - a);
+  i32 pb = std::abs(p - b);
+  i32 pc = std::abs(p - c);
+  if (pa <= pb && pa <= pc) return a;
+  return (pb <= pc) ? b : c;
+}
+
+// Residuals of the 16 bit lanes of a Paeth prediction, see UnfilterPaeth
+static FORCE_INLINE __m128i PaethPredict16(__m128i a, __m128i b, __m128i c) {
+  const auto zero = _mm_setzero_si128();
+  auto abs_epi16 = [&zero](__m128i x) {
+    return _mm_max_epi16(x, _mm_sub_epi16(zero, x));
+  };
+  auto b_minus_c = _mm_sub_epi16(b, c);
+  auto a_minus_c = _mm_sub_epi16(a, c);
+  auto pa = abs_epi16(b_minus_c);
+  auto pb = abs_epi16(a_minus_c);
+  auto pc = abs_epi16(_mm_add_epi16(b_minus_c, a_minus_c));
+  auto pick_c = _mm_cmpgt_epi16(pb, pc);
+  auto b_or_c =
+      _mm_or_si128(_mm_andnot_si128(pick_c, b), _mm_and_si128(pick_c, c));
+  auto not_a = _mm_cmpgt_epi16(pa, _mm_min_epi16(pb, pc));
+  return _mm_or_si128(_mm_andnot_si128(not_a, a),
+                      _mm_and_si128(not_a, b_or_c));
+}
+
+// |x| of signed bytes, summed into the two 64 bit lanes
+static FORCE_INLINE __m128i SumAbsResiduals(__m128i sum, __m128i residual) {
+  auto abs_residual = _mm_min_epu8(
+      residual, _mm_sub_epi8(_mm_setzero_si128(), residual));
+  return _mm_add_epi64(sum, _mm_sad_epu8(abs_residual, _mm_setzero_si128()));
+}
+
+static FORCE_INLINE u64 ScalarAbsResidual(u8 residual) {
+  return (residual < 128) ? residual : 256 - residual;
+}
+
+void FilterScanlineAdaptive(const u8 *row, const u8 *prev_row, u8 *dest,
+                            size_t row_size, u32 bytes_per_pixel,
+                            u8 *scratch) {
+  u8 *filtered[5];
+  for (u32 filter = 0; filter < 5; ++filter) {
+    filtered[filter] = scratch + (filter * row_size);
+  }
+  u64 cost[5] = {};
+
+  // left/up-left of the first pixel are zero
+  auto filter_scalar = [&](size_t idx) {
+    u8 x = row[idx];
+    u8 a = (idx >= bytes_per_pixel) ? row[idx - bytes_per_pixel] : 0;
+    u8 b = prev_row[idx];
+    u8 c = (idx >= bytes_per_pixel) ? prev_row[idx - bytes_per_pixel] : 0;
+    u8 residuals[5] = {
+        x,
+        static_cast<u8>(x - a),
+        static_cast<u8>(x - b),
+        static_cast<u8>(x - static_cast<u8>((a + b) >> 1)),
+        static_cast<u8>(x - PaethPredictor(a, b, c)),
+    };
+    for (u32 filter = 0; filter < 5; ++filter) {
+      filtered[filter][idx] = residuals[filter];
+      cost[filter] += ScalarAbsResidual(residuals[filter]);
+    }
+  };
+
+  size_t idx = 0;
+  for (; idx < std::min<size_t>(bytes_per_pixel, row_size); ++idx) {
+    filter_scalar(idx);
+  }
+
+  const auto zero = _mm_setzero_si128();
+  const auto one = _mm_set1_epi8(1);
+  __m128i sums[5] = {zero, zero, zero, zero, zero};
+  auto load = [](const u8 *ptr) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr));
+  };
+  auto store = [](u8 *ptr, __m128i value) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(ptr), value);
+  };
+  for (; idx + 16 <= row_size; idx += 16) {
+    auto x = load(row + idx);
+    auto a = load(row + idx - bytes_per_pixel);
+    auto b = load(prev_row + idx);
+    auto c = load(prev_row + idx - bytes_per_pixel);
+
+    auto average = _mm_sub_epi8(_mm_avg_epu8(a, b),
+                                _mm_and_si128(_mm_xor_si128(a, b), one));
+    auto paeth = _mm_packus_epi16(
+        PaethPredict16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero),
+                       _mm_unpacklo_epi8(c, zero)),
+        PaethPredict16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero),
+                       _mm_unpackhi_epi8(c, zero)));
+
+    __m128i residuals[5] = {
+        x,
+        _mm_sub_epi8(x, a),
+        _mm_sub_epi8(x, b),
+        _mm_sub_epi8(x, average),
+        _mm_sub_epi8(x, paeth),
+    };
+    for (u32 filter = 0; filter < 5; ++filter) {
+      store(filtered[filter] + idx, residuals[filter]);
+      sums[filter] = SumAbsResiduals(sums[filter], residuals[filter]);
+    }
+  }
+  for (; idx < row_size; ++idx) {
+    filter_scalar(idx);
+  }
+
+  u32 best_filter = 0;
+  for (u32 filter = 0; filter < 5; ++filter) {
+    cost[filter] += static_cast<u64>(_mm_cvtsi128_si64(sums[filter])) +
+                    static_cast<u64>(_mm_cvtsi128_si64(
+                        _mm_unpackhi_epi64(sums[filter], sums[filter])));
+    if (cost[filter] < cost[best_filter]) best_filter = filter;
+  }
+  dest[0] = static_cast<u8>(best_filter);
+  std::memcpy(dest + 1, filtered[best_filter], row_size);
+}
+
+}  // namespace quixotism
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "quixotism_c.hpp"
+
+namespace quixotism {
+
+enum PNGFilterType : u8 {
+  PNG_FILTER_NONE = 0,
+  PNG_FILTER_SUB = 1,
+  PNG_FILTER_UP = 2,
+  PNG_FILTER_AVERAGE = 3,
+  PNG_FILTER_PAETH = 4,
+};
+
+// Reverses the PNG filter of one scanline.
+//  src             - filtered scanline (without the filter type byte)
+//  prev_row        - reconstructed previous scanline, all zeros for the first
+//                    scanline of an image (or interlace pass)
+//  dest            - reconstructed scanline, may not alias src or prev_row
+//  row_size        - scanline size in bytes
+//  bytes_per_pixel - filter unit: bytes per complete pixel, rounded up to 1
+//                    for bit depths below 8 (1, 2, 3, 4, 6 or 8)
+// Returns false for an unknown filter type.
+bool UnfilterScanline(u8 filter_type, const u8 *src, const u8 *prev_row,
+                      u8 *dest, size_t row_size, u32 bytes_per_pixel);
+
+// Filters one scanline with every filter type and keeps the one with the
+// smallest sum of absolute (signed) residuals, the usual heuristic for the
+// filter that compresses best.
+//  row      - scanline to filter
+//  prev_row - previous (unfiltered) scanline, all zeros for the first one
+//  dest     - filter type byte followed by row_size filtered bytes
+//  scratch  - room for 5 * row_size bytes
+void FilterScanlineAdaptive(const u8 *row, const u8 *prev_row, u8 *dest,
+                            size_t row_size, u32 bytes_per_pixel,
+                            u8 *scratch);
+
+}  // namespace quixotism
@@ -1,12 +1,24 @@
 #pragma once
 #include <expected>
+#include <functional>
+#include <span>
+#include <vector>
 
 #include "bitmap/bitmap.hpp"
+#include "core/platform_services.hpp"
 #include "quixotism_c.hpp"
 
 namespace quixotism {
 static u8 png_signature[] = {137, 80, 78, 71, 13, 10, 26, 10};
 
+enum PNGColorType : u8 {
+  PNG_COLOR_GRAY = 0,
+  PNG_COLOR_RGB = 2,
+  PNG_COLOR_PALETTE = 3,
+  PNG_COLOR_GRAY_ALPHA = 4,
+  PNG_COLOR_RGBA = 6,
+};
+
 #pragma pack(push, 1)
 struct PNGHeader {
   u8 signature[8];
@@ -56,6 +68,35 @@ struct PNGIDATFooter {
 };
 #pragma pack(pop)
 
-std::expected<Bitmap, BitmapError> ParsePNG(void *data, size_t size);
+struct PNGDecodeOptions {
+  // Chunk CRCs and the zlib Adler-32 are verified by default, both run at
+  // several GB/s. Turning this off is meant for trusted (cooked) assets.
+  bool verify_checksums = true;
+};
+
+// Decodes all standard color types, bit depths and Adam7 interlaced images.
+// Pixels are expanded straight into the smallest BitmapFormat that holds them:
+//  gray                      -> R8
+//  rgb, palette              -> RGB8
+//  gray + alpha, rgba and any
+//  color type with a tRNS key -> RGBA8
+// 16 bit samples are reduced to their high byte.
+std::expected<Bitmap, BitmapError> ParsePNG(
+    void *data, size_t size, const PNGDecodeOptions &options = {});
+
+// Reads up to 'size' bytes of the file into dest, returns how many bytes were
+// read, 0 once the file ended
+using PNGReadFunc = std::function<size_t(u8 *dest, size_t size)>;
+
+// Same as ParsePNG for files that are read in pieces. Only a small part of
+// the file and of the inflated image data is held in memory at a time.
+std::expected<Bitmap, BitmapError> ParsePNGStream(
+    const PNGReadFunc &read, const PNGDecodeOptions &options = {});
+
+// Decodes independent images in parallel on the thread pool, results are in
+// the order of 'files'
+std::vector<std::expected<Bitmap, BitmapError>> ParsePNGBatch(
+    std::span<const ReadFileResult> files,
+    const PNGDecodeOptions &options = {});
 
 }  // namespace quixotism
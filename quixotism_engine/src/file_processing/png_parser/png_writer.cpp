@@ -0,0 +1,106 @@
+#include "png_writer.hpp"
+
+#include <cstring>
+
+#include "checksum.hpp"
+#include "deflate.hpp"
+#include "png_filter.hpp"
+#include "png_parser.hpp"
+
+namespace quixotism {
+
+// IDAT payloads are split into chunks of this size, like other encoders do,
+// so readers never have to take a single huge chunk
+static constexpr size_t IDAT_CHUNK_SIZE = Kilobytes(256);
+
+static void AppendU32BE(std::vector<u8> &out, u32 value) {
+  for (i32 shift = 24; shift >= 0; shift -= 8) {
+    out.push_back(static_cast<u8>(value >> shift));
+  }
+}
+
+static void AppendChunk(std::vector<u8> &out, const char (&type)[5],
+                        const u8 *payload, size_t size) {
+  AppendU32BE(out, static_cast<u32>(size));
+  auto type_bytes = reinterpret_cast<const u8 *>(type);
+  out.insert(out.end(), type_bytes, type_bytes + 4);
+  if (size) out.insert(out.end(), payload, payload + size);
+  u32 crc = CRC32(type_bytes, 4);
+  crc = CRC32(payload, size, crc);
+  AppendU32BE(out, crc);
+}
+
+std::expected<std::vector<u8>, BitmapError> WritePNG(
+    const Bitmap &bitmap, const PNGEncodeOptions &options) {
+  PNGColorType color_type;
+  switch (bitmap.GetBitmapFormat()) {
+    case BitmapFormat::R8:
+      color_type = PNG_COLOR_GRAY;
+      break;
+    case BitmapFormat::RGB8:
+      color_type = PNG_COLOR_RGB;
+      break;
+    case BitmapFormat::RGBA8:
+      color_type = PNG_COLOR_RGBA;
+      break;
+    default:
+      return std::unexpected(BitmapError{});
+  }
+  if (!bitmap.IsValid()) return std::unexpected(BitmapError{});
+
+  u32 width = bitmap.GetWidth();
+  u32 height = bitmap.GetHeight();
+  u32 bytes_per_pixel = static_cast<u32>(bitmap.BytesPerPixel());
+  size_t row_size = static_cast<size_t>(width) * bytes_per_pixel;
+
+  // every scanline gets its filter type byte in front
+  std::vector<u8> filtered((row_size + 1) * height);
+  const u8 *pixels = bitmap.GetBitmapPtr();
+  if (options.level == 0) {
+    for (u32 y = 0; y < height; ++y) {
+      u8 *dest = filtered.data() + (y * (row_size + 1));
+      dest[0] = PNG_FILTER_NONE;
+      std::memcpy(dest + 1, pixels + (y * row_size), row_size);
+    }
+  } else {
+    std::vector<u8> zero_row(row_size, 0);
+    std::vector<u8> scratch(5 * row_size);
+    for (u32 y = 0; y < height; ++y) {
+      const u8 *row = pixels + (y * row_size);
+      const u8 *prev_row = y ? row - row_size : zero_row.data();
+      FilterScanlineAdaptive(row, prev_row,
+                             filtered.data() + (y * (row_size + 1)),
+                             row_size, bytes_per_pixel, scratch.data());
+    }
+  }
+
+  std::vector<u8> image_data;
+  image_data.reserve(filtered.size() / 2 + 1024);
+  ZlibCompress(filtered.data(), filtered.size(), options.level, image_data);
+
+  std::vector<u8> out;
+  out.reserve(image_data.size() + 1024);
+  out.insert(out.end(), png_signature, png_signature + sizeof(png_signature));
+
+  u8 ihdr[13];
+  for (u32 idx = 0; idx < 4; ++idx) {
+    ihdr[idx] = static_cast<u8>(width >> (24 - (8 * idx)));
+    ihdr[4 + idx] = static_cast<u8>(height >> (24 - (8 * idx)));
+  }
+  ihdr[8] = 8;  // bit depth
+  ihdr[9] = color_type;
+  ihdr[10] = 0;  // deflate
+  ihdr[11] = 0;  // adaptive filtering
+  ihdr[12] = 0;  // not interlaced
+  AppendChunk(out, "IHDR", ihdr, sizeof(ihdr));
+
+  for (size_t offset = 0; offset < image_data.size();
+       offset += IDAT_CHUNK_SIZE) {
+    size_t size = std::min(IDAT_CHUNK_SIZE, image_data.size() - offset);
+    AppendChunk(out, "IDAT", image_data.data() + offset, size);
+  }
+  AppendChunk(out, "IEND", nullptr, 0);
+  return out;
+}
+
+}  // namespace quixotism
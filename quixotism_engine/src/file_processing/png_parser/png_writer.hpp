@@ -0,0 +1,25 @@
+#pragma once
+#include <expected>
+#include <vector>
+
+#include "bitmap/bitmap.hpp"
+#include "quixotism_c.hpp"
+
+namespace quixotism {
+
+struct PNGEncodeOptions {
+  // zlib style compression level: 0 stores the image data uncompressed (and
+  // skips filtering), which is the fastest choice for screenshots, 1-9 trade
+  // speed for size. 9 runs at a fraction of the speed of 1 for a few percent.
+  u32 level = 6;
+};
+
+// Encodes the bitmap into a PNG file in memory, ready to be written out with
+// PlatformServices::write_file. R8 bitmaps become gray, RGB8 rgb and RGBA8
+// rgba images, all 8 bits per sample and not interlaced. Rows are written top
+// to bottom in memory order, the same order ParsePNG decodes them in. Fails
+// for the other BitmapFormats.
+std::expected<std::vector<u8>, BitmapError> WritePNG(
+    const Bitmap &bitmap, const PNGEncodeOptions &options = {});
+
+}  // namespace quixotism
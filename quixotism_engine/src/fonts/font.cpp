@@ -1,17 +1,40 @@
 #include "fonts/font.hpp"
 
+#include <atomic>
 #include <cmath>
+#include <cstring>
 #include <expected>
 
 #include "dbg_print.hpp"
+#include "thread_pool.hpp"
 
 #define STB_TRUETYPE_IMPLEMENTATION
 #include "stb_truetype.h"
 
 namespace quixotism {
 
-static std::expected<std::pair<Bitmap, i32>, ParseFontError> GetGlyphFromFont(
-    stbtt_fontinfo *font, char codepoint, float scale) {
+struct FontGlyph {
+  Bitmap bitmap;
+  i32 x_offset;
+  i32 y_offset;
+};
+
+// Copies the stbtt glyph bitmap into our own bitmap, flipping it vertically
+// (stbtt bitmaps are top-down, ours are bottom-up)
+static Bitmap MakeGlyphBitmap(const u8 *stbtt_bitmap, i32 width, i32 height) {
+  Bitmap glyph{(u32)width, (u32)height, BitmapFormat::R8};
+  const u8 *source = stbtt_bitmap;
+  u8 *dest_row = glyph.GetBitmapWritePtr() + ((height - 1) * width);
+  for (i32 y = 0; y < height; ++y) {
+    std::memcpy(dest_row, source, width);
+    source += width;
+    dest_row -= width;
+  }
+  return glyph;
+}
+
+static std::expected<FontGlyph, ParseFontError> GetGlyphFromFont(
+    const stbtt_fontinfo *font, u32 codepoint, float scale) {
   i32 width, height, x_offset, y_offset;
   auto stbtt_bitmap = stbtt_GetCodepointBitmap(
       font, 0, scale, codepoint, &width, &height, &x_offset, &y_offset);
@@ -20,47 +43,64 @@ static std::expected<std::pair<Bitmap, i32>, ParseFontError> GetGlyphFromFont(
     return std::unexpected(ParseFontError{});
   }
 
-  Bitmap glyph{(u32)width, (u32)height, BitmapFormat::R8};
-  u8 *source = stbtt_bitmap;
-  u8 *dest_row = glyph.GetBitmapWritePtr() + ((height - 1) * width);
-  for (i32 y = 0; y < height; ++y) {
-    auto *dest = dest_row;
-    for (i32 x = 0; x < width; ++x) {
-      *dest++ = *source++;
-    }
-    dest_row -= width;
-  }
+  auto glyph = MakeGlyphBitmap(stbtt_bitmap, width, height);
   stbtt_FreeBitmap(stbtt_bitmap, nullptr);
 
-  return std::make_pair(std::move(glyph), y_offset);
+  // bitmap glyphs are drawn right at the pen position
+  return FontGlyph{std::move(glyph), 0, y_offset};
 }
 
-std::expected<FontSet, ParseFontError> TTFMakeASCIIFont(const u8 *ttf_data,
-                                                        const size_t ttf_size) {
-  stbtt_fontinfo font_info{};
-  stbtt_InitFont(&font_info, ttf_data, 0);
-  FontSet result;
+static std::expected<FontGlyph, ParseFontError> GetSDFGlyphFromFont(
+    const stbtt_fontinfo *font, u32 codepoint, float scale) {
+  // distance of SDF_PADDING pixels from the edge maps onto the full
+  // [0, SDF_ONEDGE_VALUE] range
+  constexpr r32 pixel_dist_scale =
+      static_cast<r32>(FontSet::SDF_ONEDGE_VALUE) / FontSet::SDF_PADDING;
+  i32 width, height, x_offset, y_offset;
+  auto stbtt_bitmap = stbtt_GetCodepointSDF(
+      font, scale, codepoint, FontSet::SDF_PADDING, FontSet::SDF_ONEDGE_VALUE,
+      pixel_dist_scale, &width, &height, &x_offset, &y_offset);
 
-  for (u32 idx = 0; idx < ArrayCount(FontSet::font_sizes); ++idx) {
-    std::vector<Bitmap> glyphs;
-    GlyphInfoTable glyph_info_table;
-    glyphs.reserve(Font::CODEPOINT_COUNT);
-    glyph_info_table.reserve(Font::CODEPOINT_COUNT);
-    std::unique_ptr<r32[]> kerning_table = nullptr;
-    size_t kerning_size = Font::CODEPOINT_COUNT * Font::CODEPOINT_COUNT;
-    if (font_info.kern || font_info.gpos) {
-      kerning_table = std::make_unique<r32[]>(kerning_size);
-    }
+  if (stbtt_bitmap == nullptr) {
+    return std::unexpected(ParseFontError{});
+  }
 
-    auto font_size = FontSet::font_sizes[idx];
-    auto font_scale = stbtt_ScaleForPixelHeight(&font_info, font_size);
-    i32 advance, lsb;
-    for (char codepoint_idx = 0; codepoint_idx < Font::CODEPOINT_COUNT;
-         ++codepoint_idx) {
-      char codepoint = Font::CODEPOINT_START + codepoint_idx;
-      auto font_glyph = GetGlyphFromFont(&font_info, codepoint, font_scale);
-      if (font_glyph.has_value()) {
-        glyphs.push_back(std::move((*font_glyph).first));
+  auto glyph = MakeGlyphBitmap(stbtt_bitmap, width, height);
+  stbtt_FreeSDF(stbtt_bitmap, nullptr);
+
+  // the SDF glyph has padding on all sides, shift it left by the padding so
+  // the glyph itself still starts at the pen position
+  return FontGlyph{std::move(glyph), -FontSet::SDF_PADDING, y_offset};
+}
+
+static std::expected<Font, ParseFontError> MakeFont(
+    const stbtt_fontinfo &font_info, r32 font_size, FontRasterMode mode) {
+  std::vector<Bitmap> glyphs(Font::CODEPOINT_COUNT);
+  GlyphInfoTable glyph_info_table(Font::CODEPOINT_COUNT);
+  std::unique_ptr<r32[]> kerning_table = nullptr;
+  size_t kerning_size = Font::CODEPOINT_COUNT * Font::CODEPOINT_COUNT;
+  if (font_info.kern || font_info.gpos) {
+    kerning_table = std::make_unique<r32[]>(kerning_size);
+  }
+
+  auto font_scale = stbtt_ScaleForPixelHeight(&font_info, font_size);
+
+  // glyphs are independent of each other, so we rasterize them (and compute
+  // their kerning rows) in parallel, stbtt only reads from the font info
+  std::atomic<bool> failed = false;
+  ThreadPool::GetThreadPool().ParallelFor(
+      Font::CODEPOINT_COUNT, [&](size_t codepoint_idx, u32) {
+        u32 codepoint = Font::CODEPOINT_START + codepoint_idx;
+        auto font_glyph =
+            (mode == FontRasterMode::SDF)
+                ? GetSDFGlyphFromFont(&font_info, codepoint, font_scale)
+                : GetGlyphFromFont(&font_info, codepoint, font_scale);
+        if (!font_glyph.has_value()) {
+          failed = true;
+          return;
+        }
+
+        i32 advance, lsb;
         stbtt_GetCodepointHMetrics(&font_info, codepoint, &advance, &lsb);
         if (kerning_table) {
           for (u32 other_codepoint_idx = 0;
@@ -75,37 +115,71 @@ std::expected<FontSet, ParseFontError> TTFMakeASCIIFont(const u8 *ttf_data,
           }
         }
 
-        glyph_info_table.emplace_back(
-            glyphs.back().GetWidth(), glyphs.back().GetHeight(),
-            (*font_glyph).second, advance * font_scale);
-      } else {
-        return std::unexpected(ParseFontError{});
-      }
-    }
+        auto &glyph = glyphs[codepoint_idx];
+        glyph = std::move(font_glyph->bitmap);
+        glyph_info_table[codepoint_idx] = {
+            .width = static_cast<i32>(glyph.GetWidth()),
+            .height = static_cast<i32>(glyph.GetHeight()),
+            .baseline_offset = font_glyph->y_offset,
+            .h_advance = advance * font_scale,
+            .x_offset = font_glyph->x_offset};
+      });
+
+  if (failed) {
+    return std::unexpected(ParseFontError{});
+  }
+
+  i32 space_advance, lsb;
+  stbtt_GetCodepointHMetrics(&font_info, ' ', &space_advance, &lsb);
+
+  i32 ascent, descent, line_gap;
+  stbtt_GetFontVMetrics(&font_info, &ascent, &descent, &line_gap);
 
-    i32 space_advance;
-    stbtt_GetCodepointHMetrics(&font_info, ' ', &space_advance, &lsb);
+  auto packed_bitmap = PackBitmaps(glyphs);
+  if (!packed_bitmap) {
+    return std::unexpected(ParseFontError{});
+  }
+
+  auto px_scale = stbtt_ScaleForPixelHeight(&font_info, 1.0);
+
+  return Font{std::move(*packed_bitmap),
+              std::move(glyph_info_table),
+              font_scale,
+              ascent,
+              descent,
+              line_gap,
+              space_advance,
+              px_scale,
+              std::move(kerning_table),
+              kerning_size};
+}
 
-    i32 ascent, descent, line_gap;
-    stbtt_GetFontVMetrics(&font_info, &ascent, &descent, &line_gap);
+std::expected<FontSet, ParseFontError> TTFMakeASCIIFont(const u8 *ttf_data,
+                                                        const size_t ttf_size,
+                                                        FontRasterMode mode) {
+  stbtt_fontinfo font_info{};
+  stbtt_InitFont(&font_info, ttf_data, 0);
+  FontSet result;
+  result.mode = mode;
 
-    auto packed_bitmap = PackBitmaps(glyphs);
-    if (!packed_bitmap) {
+  if (mode == FontRasterMode::SDF) {
+    // a single distance field atlas covers every text size, the renderer
+    // scales the glyph quads and reconstructs the edge in the shader
+    auto font = MakeFont(font_info, FontSet::SDF_FONT_SIZE, mode);
+    if (!font) {
       return std::unexpected(ParseFontError{});
     }
+    result.fonts[0] = std::move(*font);
+    result.font_count = 1;
+    return result;
+  }
 
-    auto px_scale = stbtt_ScaleForPixelHeight(&font_info, 1.0);
-
-    result.fonts[idx] = Font{std::move(*packed_bitmap),
-                             std::move(glyph_info_table),
-                             font_scale,
-                             ascent,
-                             descent,
-                             line_gap,
-                             space_advance,
-                             px_scale,
-                             std::move(kerning_table),
-                             kerning_size};
+  for (u32 idx = 0; idx < ArrayCount(FontSet::font_sizes); ++idx) {
+    auto font = MakeFont(font_info, FontSet::font_sizes[idx], mode);
+    if (!font) {
+      return std::unexpected(ParseFontError{});
+    }
+    result.fonts[idx] = std::move(*font);
   }
   return result;
 }
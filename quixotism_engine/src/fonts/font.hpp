@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "bitmap/bitmap.hpp"
+#include "fonts/glyph_cache.hpp"
 #include "quixotism_c.hpp"
 #include "quixotism_error.hpp"
 
@@ -23,6 +24,9 @@ struct GlyphInfo {
   i32 height;
   i32 baseline_offset;
   r32 h_advance;
+  // horizontal offset of the glyph bitmap from the pen position (SDF glyphs
+  // carry padding around the glyph, bitmap glyphs have none)
+  i32 x_offset = 0;
 };
 
 using GlyphInfoTable = std::vector<GlyphInfo>;
@@ -95,11 +99,23 @@ class Font {
 
 struct FontSet {
   static constexpr r32 font_sizes[5] = {20, 40, 60, 80, 100};
+  // pixel size the SDF glyphs get generated at, and how many pixels of
+  // distance we encode around the glyph edges
+  static constexpr r32 SDF_FONT_SIZE = 32;
+  static constexpr i32 SDF_PADDING = 4;
+  static constexpr u8 SDF_ONEDGE_VALUE = 128;
   Font fonts[5];
+  // number of valid entries in 'fonts' (1 for SDF font sets)
+  u32 font_count = ArrayCount(font_sizes);
+  FontRasterMode mode = FontRasterMode::BITMAP;
   u64 texture_id = 0;
+  // optional on-demand cache for codepoints outside of the baked ASCII range
+  std::unique_ptr<GlyphCache> glyph_cache;
+  u64 glyph_cache_texture_id = 0;
 };
 
-std::expected<FontSet, ParseFontError> TTFMakeASCIIFont(const u8 *ttf_data,
-                                                        const size_t ttf_size);
+std::expected<FontSet, ParseFontError> TTFMakeASCIIFont(
+    const u8 *ttf_data, const size_t ttf_size,
+    FontRasterMode mode = FontRasterMode::BITMAP);
 
 }  // namespace quixotism
@@ -0,0 +1,219 @@
+#include "fonts/glyph_cache.hpp"
+
+#include <cstring>
+
+#include "fonts/font.hpp"
+#include "math/basic.hpp"
+#include "stb_truetype.h"
+
+namespace quixotism {
+
+GlyphCache::GlyphCache(std::unique_ptr<u8[]> &&_ttf_data, r32 _pixel_size,
+                       FontRasterMode _mode, u32 _page_dim)
+    : ttf_data{std::move(_ttf_data)},
+      font_info{std::make_unique<stbtt_fontinfo>()},
+      mode{_mode},
+      pixel_size{_pixel_size},
+      page_dim{_page_dim},
+      page{_page_dim, _page_dim, BitmapFormat::R8} {
+  stbtt_InitFont(font_info.get(), ttf_data.get(), 0);
+  scale = stbtt_ScaleForPixelHeight(font_info.get(), pixel_size);
+  std::memset(page.GetBitmapWritePtr(), 0, page_dim * page_dim);
+  // the gpu side page starts out undefined, so the first upload has to cover
+  // the whole page
+  ClearDirtyRegion();
+  MarkDirty(0, 0, page_dim, page_dim);
+}
+
+GlyphCache::~GlyphCache() = default;
+
+const CachedGlyph *GlyphCache::GetGlyph(u32 codepoint) {
+  if (auto it = glyphs.find(codepoint); it != glyphs.end()) {
+    ++stats.hits;
+    auto &glyph = it->second;
+    if (glyph.shelf_idx != CachedGlyph::NO_SHELF) {
+      shelves[glyph.shelf_idx].last_used = batch_epoch;
+    }
+    return &glyph;
+  }
+  if (auto it = dropped_glyphs.find(codepoint); it != dropped_glyphs.end()) {
+    // only worth rasterizing again once there is room for it
+    auto [width, height] = it->second;
+    auto slot = Allocate(width, height);
+    if (!slot) {
+      ++stats.dropped;
+      return nullptr;
+    }
+    dropped_glyphs.erase(it);
+    ++stats.misses;
+    return Rasterize(codepoint, slot);
+  }
+  ++stats.misses;
+  return Rasterize(codepoint);
+}
+
+r32 GlyphCache::GetKerning(u32 prev_codepoint, u32 codepoint) {
+  if (!font_info->kern && !font_info->gpos) return 0;
+
+  u64 key = (static_cast<u64>(prev_codepoint) << 32) | codepoint;
+  if (auto it = kerning_pairs.find(key); it != kerning_pairs.end()) {
+    return it->second;
+  }
+  auto kerning = stbtt_GetCodepointKernAdvance(font_info.get(),
+                                               prev_codepoint, codepoint) *
+                 scale;
+  kerning_pairs.emplace(key, kerning);
+  return kerning;
+}
+
+const CachedGlyph *GlyphCache::Rasterize(u32 codepoint,
+                                         std::optional<Slot> slot) {
+  auto glyph_idx = stbtt_FindGlyphIndex(font_info.get(), codepoint);
+  i32 advance, lsb;
+  stbtt_GetGlyphHMetrics(font_info.get(), glyph_idx, &advance, &lsb);
+
+  i32 width = 0, height = 0, x_offset = 0, y_offset = 0;
+  u8 *stbtt_bitmap = nullptr;
+  if (mode == FontRasterMode::SDF) {
+    constexpr r32 pixel_dist_scale =
+        static_cast<r32>(FontSet::SDF_ONEDGE_VALUE) / FontSet::SDF_PADDING;
+    stbtt_bitmap = stbtt_GetGlyphSDF(
+        font_info.get(), scale, glyph_idx, FontSet::SDF_PADDING,
+        FontSet::SDF_ONEDGE_VALUE, pixel_dist_scale, &width, &height,
+        &x_offset, &y_offset);
+  } else {
+    stbtt_bitmap = stbtt_GetGlyphBitmap(font_info.get(), 0, scale, glyph_idx,
+                                        &width, &height, &x_offset, &y_offset);
+  }
+
+  CachedGlyph glyph;
+  glyph.h_advance = advance * scale;
+  glyph.x_offset = x_offset;
+  glyph.baseline_offset = y_offset;
+
+  // glyphs without any pixels (whitespace) only carry their advance
+  if (stbtt_bitmap && width > 0 && height > 0) {
+    if (!slot) slot = Allocate(width, height);
+    if (!slot) {
+      ++stats.dropped;
+      dropped_glyphs.emplace(codepoint, std::pair<u32, u32>(width, height));
+      stbtt_FreeBitmap(stbtt_bitmap, nullptr);
+      return nullptr;
+    }
+
+    // stbtt bitmaps are top-down, the page is bottom-up (like every other
+    // bitmap we upload), so we flip the rows while copying
+    const u8 *source = stbtt_bitmap;
+    u8 *dest_row = page.GetBitmapWritePtr() +
+                   ((slot->y + height - 1) * page_dim) + slot->x;
+    for (i32 y = 0; y < height; ++y) {
+      std::memcpy(dest_row, source, width);
+      source += width;
+      dest_row -= page_dim;
+    }
+    MarkDirty(slot->x, slot->y, width, height);
+
+    glyph.width = width;
+    glyph.height = height;
+    glyph.shelf_idx = slot->shelf_idx;
+    glyph.coord.lower_left =
+        Vec2{static_cast<r32>(slot->x), static_cast<r32>(slot->y)} /
+        static_cast<r32>(page_dim);
+    glyph.coord.top_right = Vec2{static_cast<r32>(slot->x + width),
+                                 static_cast<r32>(slot->y + height)} /
+                            static_cast<r32>(page_dim);
+    auto &shelf = shelves[slot->shelf_idx];
+    shelf.codepoints.push_back(codepoint);
+    shelf.last_used = batch_epoch;
+  }
+  if (stbtt_bitmap) stbtt_FreeBitmap(stbtt_bitmap, nullptr);
+
+  auto [it, inserted] = glyphs.emplace(codepoint, glyph);
+  return &it->second;
+}
+
+std::optional<GlyphCache::Slot> GlyphCache::Allocate(u32 width, u32 height) {
+  u32 padded_width = width + GLYPH_PADDING;
+  u32 padded_height = height + GLYPH_PADDING;
+  if (padded_width > page_dim || padded_height > page_dim) return std::nullopt;
+
+  // best fit: the lowest shelf that still has room for the glyph
+  u32 best_idx = CachedGlyph::NO_SHELF;
+  for (u32 idx = 0; idx < shelves.size(); ++idx) {
+    const auto &shelf = shelves[idx];
+    if (shelf.height < padded_height ||
+        shelf.x_cursor + padded_width > page_dim) {
+      continue;
+    }
+    if (best_idx == CachedGlyph::NO_SHELF ||
+        shelf.height < shelves[best_idx].height) {
+      best_idx = idx;
+    }
+  }
+
+  // open a new shelf if nothing fits, or if the best fit would waste more
+  // than half of the shelf height on this glyph
+  u32 shelf_height = ((padded_height + SHELF_HEIGHT_GRANULARITY - 1) /
+                      SHELF_HEIGHT_GRANULARITY) *
+                     SHELF_HEIGHT_GRANULARITY;
+  bool wasteful = best_idx != CachedGlyph::NO_SHELF &&
+                  shelves[best_idx].height > (padded_height * 2);
+  if ((best_idx == CachedGlyph::NO_SHELF || wasteful) &&
+      (next_shelf_y + shelf_height) <= page_dim) {
+    Shelf shelf;
+    shelf.y = next_shelf_y;
+    shelf.height = shelf_height;
+    next_shelf_y += shelf_height;
+    best_idx = static_cast<u32>(shelves.size());
+    shelves.push_back(std::move(shelf));
+  }
+
+  if (best_idx == CachedGlyph::NO_SHELF) {
+    best_idx = EvictShelf(padded_height);
+    if (best_idx == CachedGlyph::NO_SHELF) return std::nullopt;
+  }
+
+  auto &shelf = shelves[best_idx];
+  Slot slot{shelf.x_cursor, shelf.y, best_idx};
+  shelf.x_cursor += padded_width;
+  return slot;
+}
+
+u32 GlyphCache::EvictShelf(u32 min_height) {
+  // pick the least recently used shelf that is tall enough, shelves touched
+  // by the current batch are off limits
+  u32 lru_idx = CachedGlyph::NO_SHELF;
+  for (u32 idx = 0; idx < shelves.size(); ++idx) {
+    const auto &shelf = shelves[idx];
+    if (shelf.height < min_height || shelf.last_used >= batch_epoch) continue;
+    if (lru_idx == CachedGlyph::NO_SHELF ||
+        shelf.last_used < shelves[lru_idx].last_used) {
+      lru_idx = idx;
+    }
+  }
+  if (lru_idx == CachedGlyph::NO_SHELF) return lru_idx;
+
+  auto &shelf = shelves[lru_idx];
+  for (auto codepoint : shelf.codepoints) {
+    glyphs.erase(codepoint);
+  }
+  stats.evicted_glyphs += shelf.codepoints.size();
+  ++stats.evicted_shelves;
+  shelf.codepoints.clear();
+  shelf.x_cursor = 0;
+
+  // clear the shelf so stale pixels dont bleed into the padding of new glyphs
+  std::memset(page.GetBitmapWritePtr() + (shelf.y * page_dim), 0,
+              shelf.height * page_dim);
+  MarkDirty(0, shelf.y, page_dim, shelf.height);
+  return lru_idx;
+}
+
+void GlyphCache::MarkDirty(u32 x, u32 y, u32 width, u32 height) {
+  dirty_min_x = Min(dirty_min_x, x);
+  dirty_min_y = Min(dirty_min_y, y);
+  dirty_max_x = Max(dirty_max_x, x + width);
+  dirty_max_y = Max(dirty_max_y, y + height);
+}
+
+}  // namespace quixotism
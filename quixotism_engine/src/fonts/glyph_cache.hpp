@@ -0,0 +1,149 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "bitmap/bitmap.hpp"
+#include "quixotism_c.hpp"
+
+struct stbtt_fontinfo;
+
+namespace quixotism {
+
+enum class FontRasterMode {
+  // coverage bitmaps rasterized at every size in FontSet::font_sizes
+  BITMAP,
+  // single signed distance field atlas, usable at any scale
+  SDF,
+};
+
+struct CachedGlyph {
+  BitmapCoord coord;
+  i32 width = 0;
+  i32 height = 0;
+  i32 x_offset = 0;
+  i32 baseline_offset = 0;
+  // advance in pixels (at the pixel size of the cache)
+  r32 h_advance = 0;
+  // shelf the glyph lives on, glyphs without pixels (spaces) have none
+  u32 shelf_idx = NO_SHELF;
+
+  static constexpr u32 NO_SHELF = ~0U;
+};
+
+/**
+ * Glyph cache for arbitrary unicode codepoints.
+ *
+ * Unlike 'Font' (which bakes the printable ASCII range up front) the cache
+ * rasterizes glyphs the first time they are requested and stores them in a
+ * single atlas page. The page is split into horizontal shelves, glyphs get
+ * appended to the best fitting shelf. When the page is full we evict the
+ * least recently used shelf (and every glyph on it), glyphs used in the
+ * current batch are never evicted since their UVs are already written out.
+ * Glyphs that did not fit remember their size, later requests only rasterize
+ * them again once a slot for that size could be allocated.
+ *
+ * Kerning is looked up lazily per glyph pair and cached in a sparse map, so
+ * we only ever store pairs that actually show up in text.
+ *
+ * The cache only touches CPU memory, the renderer uploads the dirty region of
+ * the page before drawing.
+ */
+class GlyphCache {
+ public:
+  static constexpr u32 DEFAULT_PAGE_DIM = 1024;
+  static constexpr u32 GLYPH_PADDING = 1;
+  // shelf heights get rounded up to this, so glyphs of similar height share
+  // shelves
+  static constexpr u32 SHELF_HEIGHT_GRANULARITY = 4;
+
+  struct Region {
+    u32 x, y, width, height;
+  };
+
+  struct Stats {
+    u64 hits = 0;
+    u64 misses = 0;
+    u64 evicted_shelves = 0;
+    u64 evicted_glyphs = 0;
+    // requests we could not fit into the page
+    u64 dropped = 0;
+  };
+
+  CLASS_DELETE_COPY(GlyphCache);
+  // takes ownership of the font file data, stbtt keeps pointing into it
+  GlyphCache(std::unique_ptr<u8[]> &&ttf_data, r32 pixel_size,
+             FontRasterMode mode = FontRasterMode::SDF,
+             u32 page_dim = DEFAULT_PAGE_DIM);
+  ~GlyphCache();
+
+  // Marks the start of a new batch of text, glyphs requested from now on are
+  // locked in the page until the next batch starts
+  void BeginBatch() { ++batch_epoch; }
+
+  // Returns the glyph for codepoint, rasterizing it on a miss. Returns
+  // nullptr if the glyph could not be placed in the page.
+  const CachedGlyph *GetGlyph(u32 codepoint);
+  // Kerning between two codepoints in pixels
+  r32 GetKerning(u32 prev_codepoint, u32 codepoint);
+
+  const Bitmap &GetPage() const { return page; }
+  bool HasDirtyRegion() const { return dirty_max_x > dirty_min_x; }
+  Region GetDirtyRegion() const {
+    return {dirty_min_x, dirty_min_y, dirty_max_x - dirty_min_x,
+            dirty_max_y - dirty_min_y};
+  }
+  void ClearDirtyRegion() {
+    dirty_min_x = dirty_min_y = page_dim;
+    dirty_max_x = dirty_max_y = 0;
+  }
+
+  r32 GetScale() const { return scale; }
+  r32 GetPixelSize() const { return pixel_size; }
+  FontRasterMode GetMode() const { return mode; }
+  const Stats &GetStats() const { return stats; }
+
+ private:
+  struct Shelf {
+    u32 y = 0;
+    u32 height = 0;
+    u32 x_cursor = 0;
+    u64 last_used = 0;
+    std::vector<u32> codepoints;
+  };
+
+  struct Slot {
+    u32 x, y;
+    u32 shelf_idx;
+  };
+
+  // slot is allocated here unless the caller already did
+  const CachedGlyph *Rasterize(u32 codepoint,
+                               std::optional<Slot> slot = std::nullopt);
+  std::optional<Slot> Allocate(u32 width, u32 height);
+  u32 EvictShelf(u32 min_height);
+  void MarkDirty(u32 x, u32 y, u32 width, u32 height);
+
+  std::unique_ptr<u8[]> ttf_data;
+  std::unique_ptr<stbtt_fontinfo> font_info;
+  FontRasterMode mode;
+  r32 pixel_size;
+  r32 scale;
+  u32 page_dim;
+  Bitmap page;
+
+  std::unordered_map<u32, CachedGlyph> glyphs;
+  // size of the glyphs that did not fit into the page
+  std::unordered_map<u32, std::pair<u32, u32>> dropped_glyphs;
+  std::unordered_map<u64, r32> kerning_pairs;
+  std::vector<Shelf> shelves;
+  u32 next_shelf_y = 0;
+  u64 batch_epoch = 1;
+
+  u32 dirty_min_x, dirty_min_y, dirty_max_x, dirty_max_y;
+  Stats stats;
+};
+
+}  // namespace quixotism
@@ -0,0 +1,210 @@
+#include "mesh/cooked_mesh.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace quixotism {
+
+static size_t AlignCookedOffset(size_t offset) {
+  return (offset + COOKED_MESH_ALIGNMENT - 1) & ~(COOKED_MESH_ALIGNMENT - 1);
+}
+
+std::vector<u8> CookMesh(const Mesh &mesh, const IndexedMesh &indexed,
+                         const MeshletMesh &meshlets,
+                         const VertexBufferLayout &layout) {
+  const auto &elements = layout.GetLayoutElements();
+  Assert(elements.size() <= COOKED_MESH_MAX_LAYOUT_ELEMENTS);
+  Assert(!indexed.lods.empty());
+
+  auto [vertex_data, vertex_data_size] =
+      SerializeIndexedVertices(mesh, indexed, layout);
+
+  CookedMeshHeader header = {};
+  header.magic = COOKED_MESH_MAGIC;
+  header.version = COOKED_MESH_VERSION;
+  header.vertex_count = indexed.VertexCount();
+  header.vertex_stride = static_cast<u32>(layout.GetStride());
+  header.index_count = indexed.IndexCount();
+  header.lod_count = indexed.LodCount();
+  header.layout_element_count = static_cast<u32>(elements.size());
+  header.meshlet_count = meshlets.MeshletCount();
+  header.meshlet_vertex_count = static_cast<u32>(meshlets.vertices.size());
+  header.meshlet_triangle_count =
+      static_cast<u32>(meshlets.triangles.size() / 3);
+  for (u32 i = 0; i < elements.size(); ++i) {
+    header.layout[i] = {elements[i].type, elements[i].count,
+                        elements[i].normalize, elements[i].binding_slot,
+                        static_cast<u32>(elements[i].encoding)};
+  }
+  for (u32 axis = 0; axis < 3; ++axis) {
+    header.bbox_min[axis] = mesh.bbox.min[axis];
+    header.bbox_max[axis] = mesh.bbox.max[axis];
+  }
+
+  const auto lod_size = indexed.lods.size() * sizeof(MeshLod);
+  const auto index_size = indexed.indices.size() * sizeof(u32);
+  const auto meshlet_size = meshlets.meshlets.size() * sizeof(Meshlet);
+  const auto meshlet_vertex_size = meshlets.vertices.size() * sizeof(u32);
+  const auto meshlet_triangle_size = meshlets.triangles.size();
+  header.lod_offset = AlignCookedOffset(sizeof(CookedMeshHeader));
+  header.vertex_offset = AlignCookedOffset(header.lod_offset + lod_size);
+  header.index_offset =
+      AlignCookedOffset(header.vertex_offset + vertex_data_size);
+  header.meshlet_offset = AlignCookedOffset(header.index_offset + index_size);
+  header.meshlet_vertex_offset =
+      AlignCookedOffset(header.meshlet_offset + meshlet_size);
+  header.meshlet_triangle_offset =
+      AlignCookedOffset(header.meshlet_vertex_offset + meshlet_vertex_size);
+  header.file_size =
+      AlignCookedOffset(header.meshlet_triangle_offset + meshlet_triangle_size);
+
+  const auto name_size = std::min(mesh.ObjectName.size(), COOKED_MESH_MAX_NAME);
+  std::memcpy(header.name, mesh.ObjectName.data(), name_size);
+
+  std::vector<u8> result(header.file_size, 0);
+  std::memcpy(result.data(), &header, sizeof(header));
+  std::memcpy(result.data() + header.lod_offset, indexed.lods.data(), lod_size);
+  std::memcpy(result.data() + header.vertex_offset, vertex_data.get(),
+              vertex_data_size);
+  std::memcpy(result.data() + header.index_offset, indexed.indices.data(),
+              index_size);
+  // small meshes have no meshlets, and memcpy must not get their null data
+  if (!meshlets.meshlets.empty()) {
+    std::memcpy(result.data() + header.meshlet_offset,
+                meshlets.meshlets.data(), meshlet_size);
+    std::memcpy(result.data() + header.meshlet_vertex_offset,
+                meshlets.vertices.data(), meshlet_vertex_size);
+    std::memcpy(result.data() + header.meshlet_triangle_offset,
+                meshlets.triangles.data(), meshlet_triangle_size);
+  }
+  return result;
+}
+
+static bool CookedSectionFits(u64 offset, u64 size, u64 file_size) {
+  return offset % COOKED_MESH_ALIGNMENT == 0 && offset <= file_size &&
+         size <= file_size - offset;
+}
+
+std::expected<CookedMeshView, MeshError> ReadCookedMesh(const u8 *data,
+                                                        size_t size) {
+  if (!data || size < sizeof(CookedMeshHeader)) {
+    return std::unexpected(MeshError{});
+  }
+  Assert(reinterpret_cast<uintptr_t>(data) % COOKED_MESH_ALIGNMENT == 0);
+
+  const auto *header = reinterpret_cast<const CookedMeshHeader *>(data);
+  if (header->magic != COOKED_MESH_MAGIC ||
+      header->version != COOKED_MESH_VERSION || header->file_size > size ||
+      header->layout_element_count > COOKED_MESH_MAX_LAYOUT_ELEMENTS ||
+      header->lod_count == 0 || header->index_count % 3 != 0) {
+    return std::unexpected(MeshError{});
+  }
+
+  const u64 lod_size = u64{header->lod_count} * sizeof(MeshLod);
+  const u64 vertex_data_size =
+      u64{header->vertex_count} * header->vertex_stride;
+  const u64 index_size = u64{header->index_count} * sizeof(u32);
+  const u64 meshlet_size = u64{header->meshlet_count} * sizeof(Meshlet);
+  const u64 meshlet_vertex_size =
+      u64{header->meshlet_vertex_count} * sizeof(u32);
+  const u64 meshlet_triangle_size = u64{header->meshlet_triangle_count} * 3;
+  if (!CookedSectionFits(header->lod_offset, lod_size, header->file_size) ||
+      !CookedSectionFits(header->vertex_offset, vertex_data_size,
+                         header->file_size) ||
+      !CookedSectionFits(header->index_offset, index_size,
+                         header->file_size) ||
+      !CookedSectionFits(header->meshlet_offset, meshlet_size,
+                         header->file_size) ||
+      !CookedSectionFits(header->meshlet_vertex_offset, meshlet_vertex_size,
+                         header->file_size) ||
+      !CookedSectionFits(header->meshlet_triangle_offset,
+                         meshlet_triangle_size, header->file_size)) {
+    return std::unexpected(MeshError{});
+  }
+
+  CookedMeshView view;
+  view.header = header;
+  view.lods = {reinterpret_cast<const MeshLod *>(data + header->lod_offset),
+               header->lod_count};
+  view.vertex_data = {data + header->vertex_offset, vertex_data_size};
+  view.indices = {reinterpret_cast<const u32 *>(data + header->index_offset),
+                  header->index_count};
+  view.meshlets = {
+      reinterpret_cast<const Meshlet *>(data + header->meshlet_offset),
+      header->meshlet_count};
+  view.meshlet_vertices = {
+      reinterpret_cast<const u32 *>(data + header->meshlet_vertex_offset),
+      header->meshlet_vertex_count};
+  view.meshlet_triangles = {data + header->meshlet_triangle_offset,
+                            meshlet_triangle_size};
+  for (const auto &lod : view.lods) {
+    if (lod.index_count % 3 != 0 || lod.first_index > header->index_count ||
+        lod.index_count > header->index_count - lod.first_index) {
+      return std::unexpected(MeshError{});
+    }
+  }
+  // a corrupt or stale file must not make us read or draw past the vertices
+  u32 max_index = 0;
+  for (auto index : view.indices) max_index = std::max(max_index, index);
+  if (!view.indices.empty() && max_index >= header->vertex_count) {
+    return std::unexpected(MeshError{});
+  }
+  // the culler turns meshlet triangles into indices for the same draw
+  max_index = 0;
+  for (auto index : view.meshlet_vertices) {
+    max_index = std::max(max_index, index);
+  }
+  if (!view.meshlet_vertices.empty() && max_index >= header->vertex_count) {
+    return std::unexpected(MeshError{});
+  }
+  for (const auto &meshlet : view.meshlets) {
+    if (meshlet.vertex_count > MESHLET_MAX_VERTICES ||
+        meshlet.triangle_count > MESHLET_MAX_TRIANGLES ||
+        meshlet.vertex_offset > header->meshlet_vertex_count ||
+        meshlet.vertex_count >
+            header->meshlet_vertex_count - meshlet.vertex_offset ||
+        meshlet.triangle_offset > header->meshlet_triangle_count ||
+        meshlet.triangle_count >
+            header->meshlet_triangle_count - meshlet.triangle_offset) {
+      return std::unexpected(MeshError{});
+    }
+    const auto triangles =
+        view.meshlet_triangles.subspan(size_t{meshlet.triangle_offset} * 3,
+                                       size_t{meshlet.triangle_count} * 3);
+    for (auto local_index : triangles) {
+      if (local_index >= meshlet.vertex_count) {
+        return std::unexpected(MeshError{});
+      }
+    }
+  }
+
+  const auto name_end = std::find(header->name,
+                                  header->name + COOKED_MESH_MAX_NAME, '\0');
+  view.name = {header->name, name_end};
+  for (u32 axis = 0; axis < 3; ++axis) {
+    view.bbox.min[axis] = header->bbox_min[axis];
+    view.bbox.max[axis] = header->bbox_max[axis];
+  }
+  return view;
+}
+
+bool CookedLayoutMatches(const CookedMeshHeader &header,
+                         const VertexBufferLayout &layout) {
+  const auto &elements = layout.GetLayoutElements();
+  if (header.layout_element_count != elements.size() ||
+      header.vertex_stride != layout.GetStride()) {
+    return false;
+  }
+  for (u32 i = 0; i < elements.size(); ++i) {
+    const auto &cooked = header.layout[i];
+    if (cooked.type != elements[i].type || cooked.count != elements[i].count ||
+        cooked.normalize != static_cast<u32>(elements[i].normalize) ||
+        cooked.binding_slot != elements[i].binding_slot ||
+        cooked.encoding != static_cast<u32>(elements[i].encoding)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace quixotism
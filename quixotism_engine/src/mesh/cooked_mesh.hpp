@@ -0,0 +1,104 @@
+#pragma once
+#include <expected>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "mesh/indexed_mesh.hpp"
+#include "mesh/meshlet_builder.hpp"
+#include "quixotism_c.hpp"
+#include "quixotism_error.hpp"
+#include "renderer/vertex_buffer_layout.hpp"
+
+namespace quixotism {
+
+class MeshError : public QError {};
+
+static constexpr u32 COOKED_MESH_MAGIC = 0x534D5851;  // "QXMS"
+static constexpr u32 COOKED_MESH_VERSION = 3;
+static constexpr u32 COOKED_MESH_MAX_LAYOUT_ELEMENTS = 8;
+static constexpr size_t COOKED_MESH_ALIGNMENT = 16;
+static constexpr size_t COOKED_MESH_MAX_NAME = 64;
+
+struct CookedLayoutElement {
+  u32 type;
+  u32 count;
+  u32 normalize;
+  u32 binding_slot;
+  u32 encoding;
+};
+
+// A cooked mesh file is the data MakeDrawableStaticMesh uploads, stored so it
+// can be handed to the GPU straight from a mapped file:
+//   CookedMeshHeader
+//   MeshLod[lod_count], the full mesh first
+//   vertex data, vertex_count vertices of vertex_stride bytes interleaved as
+//     the layout in the header says
+//   index data, index_count u32, the levels of detail one after the other
+//   Meshlet[meshlet_count] of the full mesh, none for small meshes
+//   meshlet vertices, meshlet_vertex_count u32 indices into the vertices
+//   meshlet triangles, meshlet_triangle_count * 3 u8 indices into the
+//     vertices of their meshlet
+// Every section starts on a COOKED_MESH_ALIGNMENT boundary. The file is
+// written in the byte order of the machine that cooked it.
+struct CookedMeshHeader {
+  u32 magic;
+  u32 version;
+  u32 vertex_count;
+  u32 vertex_stride;
+  u32 index_count;
+  u32 lod_count;
+  u32 layout_element_count;
+  u32 reserved0;
+  CookedLayoutElement layout[COOKED_MESH_MAX_LAYOUT_ELEMENTS];
+  r32 bbox_min[3];
+  r32 bbox_max[3];
+  u32 meshlet_count;
+  u32 meshlet_vertex_count;
+  u32 meshlet_triangle_count;
+  u32 reserved1;
+  u64 lod_offset;
+  u64 vertex_offset;
+  u64 index_offset;
+  u64 meshlet_offset;
+  u64 meshlet_vertex_offset;
+  u64 meshlet_triangle_offset;
+  u64 file_size;
+  // the object name, zero terminated unless it takes all of the bytes
+  char name[COOKED_MESH_MAX_NAME];
+};
+static_assert(sizeof(CookedMeshHeader) % COOKED_MESH_ALIGNMENT == 0);
+static_assert(std::is_trivially_copyable_v<Meshlet>);
+
+// Points into the bytes of a cooked mesh, valid as long as they are
+struct CookedMeshView {
+  const CookedMeshHeader *header = nullptr;
+  std::span<const MeshLod> lods;
+  std::span<const u8> vertex_data;
+  std::span<const u32> indices;
+  std::span<const Meshlet> meshlets;
+  std::span<const u32> meshlet_vertices;
+  std::span<const u8> meshlet_triangles;
+  std::string_view name;
+  AABB bbox;
+};
+
+// Serializes the indexed mesh with the layout and the meshlets of its full
+// mesh into the cooked format
+std::vector<u8> CookMesh(const Mesh &mesh, const IndexedMesh &indexed,
+                         const MeshletMesh &meshlets,
+                         const VertexBufferLayout &layout);
+
+// Checks the header, the section bounds, that every index names a vertex and
+// that the meshlets stay within their limits and arrays, nothing is copied.
+// data has to be COOKED_MESH_ALIGNMENT aligned, which mapped files and heap
+// blocks are.
+std::expected<CookedMeshView, MeshError> ReadCookedMesh(const u8 *data,
+                                                        size_t size);
+
+// whether the vertices were cooked with the same layout
+bool CookedLayoutMatches(const CookedMeshHeader &header,
+                         const VertexBufferLayout &layout);
+
+}  // namespace quixotism
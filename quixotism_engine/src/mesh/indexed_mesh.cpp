@@ -0,0 +1,123 @@
+#include "mesh/indexed_mesh.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+
+#include "mesh/vertex_quantization.hpp"
+
+namespace quixotism {
+
+static constexpr u32 EMPTY_SLOT = 0xFFFFFFFF;
+
+static FORCE_INLINE u32 HashWord(u32 h, u32 word) {
+  h = (h ^ word) * 0x9E3779B1U;
+  return h ^ (h >> 15);
+}
+
+// at most half full, so probe sequences stay short
+static std::vector<u32> MakeTable(size_t key_count) {
+  return std::vector<u32>(std::bit_ceil(std::max<size_t>(key_count * 2, 16)),
+                          EMPTY_SLOT);
+}
+
+// Index of the first element with the same value, for every element. Values
+// are compared by their bits, with -0 read as 0.
+template <class VEC_TYPE>
+static std::vector<u32> FirstEqualIndices(const std::vector<VEC_TYPE> &data) {
+  constexpr size_t COMPONENTS = sizeof(VEC_TYPE) / sizeof(r32);
+  using Bits = std::array<u32, COMPONENTS>;
+  auto get_bits = [&data](size_t idx) {
+    Bits bits;
+    for (size_t c = 0; c < COMPONENTS; ++c) {
+      bits[c] = std::bit_cast<u32>(data[idx].e[c] + 0.0f);
+    }
+    return bits;
+  };
+
+  std::vector<u32> result(data.size());
+  auto table = MakeTable(data.size());
+  u32 mask = static_cast<u32>(table.size() - 1);
+  for (size_t i = 0; i < data.size(); ++i) {
+    auto bits = get_bits(i);
+    u32 h = 0;
+    for (auto word : bits) h = HashWord(h, word);
+    for (u32 slot = h & mask;; slot = (slot + 1) & mask) {
+      if (table[slot] == EMPTY_SLOT) {
+        table[slot] = static_cast<u32>(i);
+        result[i] = static_cast<u32>(i);
+        break;
+      }
+      if (get_bits(table[slot]) == bits) {
+        result[i] = table[slot];
+        break;
+      }
+    }
+  }
+  return result;
+}
+
+IndexedMesh WeldVertices(const Mesh &mesh) {
+  const auto &corners = mesh.VertexTriangleIndicies;
+  auto corner_count = corners.PosIdx.size();
+  Assert(corners.NormalIdx.size() == corner_count &&
+         corners.TexCoordIdx.size() == corner_count);
+
+  auto pos_remap = FirstEqualIndices(mesh.VertexPosData);
+  auto normal_remap = FirstEqualIndices(mesh.VertexNormalData);
+  auto tex_coord_remap = FirstEqualIndices(mesh.VertexTexCoordData);
+
+  IndexedMesh result;
+  result.indices.resize(corner_count);
+  auto table = MakeTable(corner_count);
+  u32 mask = static_cast<u32>(table.size() - 1);
+  auto &vertices = result.vertices;
+  for (size_t i = 0; i < corner_count; ++i) {
+    // ParseOBJ drops the faces with out of range indices
+    Assert(corners.PosIdx[i] < pos_remap.size() &&
+           corners.NormalIdx[i] < normal_remap.size() &&
+           corners.TexCoordIdx[i] < tex_coord_remap.size());
+    u32 pos = pos_remap[corners.PosIdx[i]];
+    u32 normal = normal_remap[corners.NormalIdx[i]];
+    u32 tex_coord = tex_coord_remap[corners.TexCoordIdx[i]];
+    u32 h = HashWord(HashWord(HashWord(0, pos), normal), tex_coord);
+    for (u32 slot = h & mask;; slot = (slot + 1) & mask) {
+      u32 vertex = table[slot];
+      if (vertex == EMPTY_SLOT) {
+        vertex = static_cast<u32>(vertices.PosIdx.size());
+        vertices.PosIdx.push_back(pos);
+        vertices.NormalIdx.push_back(normal);
+        vertices.TexCoordIdx.push_back(tex_coord);
+        table[slot] = vertex;
+        result.indices[i] = vertex;
+        break;
+      }
+      if (vertices.PosIdx[vertex] == pos &&
+          vertices.NormalIdx[vertex] == normal &&
+          vertices.TexCoordIdx[vertex] == tex_coord) {
+        result.indices[i] = vertex;
+        break;
+      }
+    }
+  }
+  result.lods.push_back({0, result.IndexCount()});
+  return result;
+}
+
+std::pair<std::unique_ptr<u8[]>, size_t> SerializeIndexedVertices(
+    const Mesh &mesh, const IndexedMesh &indexed,
+    const VertexBufferLayout &layout) {
+  if (!layout.IsFloatOnly()) {
+    return SerializeQuantizedVertices(mesh, indexed, layout);
+  }
+  std::vector<const void *> vertex_data_buffers = {
+      mesh.VertexPosData.data(), mesh.VertexNormalData.data(),
+      mesh.VertexTexCoordData.data()};
+  std::vector<const u32 *> vertex_index_buffers = {
+      indexed.vertices.PosIdx.data(), indexed.vertices.NormalIdx.data(),
+      indexed.vertices.TexCoordIdx.data()};
+  return SerializeVertexDataByLayout(vertex_data_buffers, vertex_index_buffers,
+                                     indexed.VertexCount(), layout);
+}
+
+}  // namespace quixotism
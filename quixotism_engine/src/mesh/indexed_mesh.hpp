@@ -0,0 +1,51 @@
+#pragma once
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "file_processing/obj_parser/obj_parser.hpp"
+#include "quixotism_c.hpp"
+#include "renderer/vertex_buffer_layout.hpp"
+
+namespace quixotism {
+
+// Range of the indices of one level of detail
+struct MeshLod {
+  u32 first_index = 0;
+  u32 index_count = 0;
+};
+
+// A mesh with shared vertices, ready for an index buffer
+struct IndexedMesh {
+  // Every unique vertex as indices into the position, normal and texture
+  // coordinate arrays of its Mesh, the layout SerializeVertexDataByLayout
+  // reads
+  TriangleIndices vertices;
+  // three per triangle, into vertices. The levels of detail, if there are
+  // any, follow the full mesh.
+  std::vector<u32> indices;
+  // the full mesh first
+  std::vector<MeshLod> lods;
+
+  u32 VertexCount() const { return static_cast<u32>(vertices.PosIdx.size()); }
+  u32 IndexCount() const { return static_cast<u32>(indices.size()); }
+  u32 LodCount() const { return static_cast<u32>(lods.size()); }
+};
+
+// Welds the face corners of a mesh that have the same position, normal and
+// texture coordinate into one vertex. Equal values are merged first, since
+// exporters often write a normal or texture coordinate per face corner even
+// when its value is shared. Vertices keep the order of their first use, so
+// the result is deterministic. Lookups go through open addressing hash
+// tables. The result has one level of detail, the full mesh. Every corner
+// index has to be in range for its attribute array (ParseOBJ makes sure).
+IndexedMesh WeldVertices(const Mesh &mesh);
+
+// Interleaves the position, normal and texture coordinate of every vertex as
+// the layout says, encoding them if it asks for it, the vertex buffer that
+// goes with the indices
+std::pair<std::unique_ptr<u8[]>, size_t> SerializeIndexedVertices(
+    const Mesh &mesh, const IndexedMesh &indexed,
+    const VertexBufferLayout &layout);
+
+}  // namespace quixotism
@@ -0,0 +1,291 @@
+#include "mesh/mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace quixotism {
+
+static constexpr u32 NO_INDEX = 0xFFFFFFFF;
+
+// size of the LRU cache Forsyth's scoring models, larger than the FIFO the
+// stats assume so that vertices stay attractive a bit longer
+static constexpr u32 FORSYTH_CACHE_SIZE = 32;
+// vertices with more triangles left than this score like it
+static constexpr u32 FORSYTH_MAX_VALENCE = 32;
+
+// clusters of the overdraw pass can also start at a triangle that misses two
+// vertices once they have this many triangles
+static constexpr u32 OVERDRAW_MIN_CLUSTER_SIZE = 64;
+// the cluster order is kept if the cache misses grow by this factor at most
+static constexpr r32 OVERDRAW_MAX_ACMR_GROWTH = 1.05f;
+
+// Lookup tables for the vertex score of Forsyth's paper, with its constants
+struct ForsythScores {
+  r32 cache[FORSYTH_CACHE_SIZE];
+  r32 valence[FORSYTH_MAX_VALENCE + 1];
+
+  ForsythScores() {
+    constexpr r32 LAST_TRIANGLE_SCORE = 0.75f;
+    constexpr r32 CACHE_DECAY_POWER = 1.5f;
+    constexpr r32 VALENCE_BOOST_SCALE = 2.0f;
+    constexpr r32 VALENCE_BOOST_POWER = 0.5f;
+    for (u32 pos = 0; pos < FORSYTH_CACHE_SIZE; ++pos) {
+      // the three vertices of the last triangle score the same on purpose,
+      // the order they went in should not matter
+      cache[pos] = pos < 3 ? LAST_TRIANGLE_SCORE
+                           : std::pow(1.0f - static_cast<r32>(pos - 3) /
+                                                 (FORSYTH_CACHE_SIZE - 3),
+                                      CACHE_DECAY_POWER);
+    }
+    valence[0] = 0;
+    for (u32 count = 1; count <= FORSYTH_MAX_VALENCE; ++count) {
+      valence[count] = VALENCE_BOOST_SCALE *
+                       std::pow(static_cast<r32>(count), -VALENCE_BOOST_POWER);
+    }
+  }
+
+  r32 Score(u32 cache_pos, u32 triangles_left) const {
+    if (triangles_left == 0) return -1.0f;
+    r32 score = cache_pos < FORSYTH_CACHE_SIZE ? cache[cache_pos] : 0.0f;
+    return score + valence[std::min(triangles_left, FORSYTH_MAX_VALENCE)];
+  }
+};
+
+VertexCacheStats AnalyzeVertexCache(std::span<const u32> indices,
+                                    u32 vertex_count, u32 cache_size) {
+  // a vertex is cached while fewer than cache_size misses came after its own
+  std::vector<u32> miss_stamp(vertex_count, 0);
+  u32 misses = 0;
+  for (auto index : indices) {
+    if (miss_stamp[index] == 0 || misses - miss_stamp[index] >= cache_size) {
+      miss_stamp[index] = ++misses;
+    }
+  }
+  VertexCacheStats stats;
+  auto triangle_count = indices.size() / 3;
+  if (triangle_count) stats.acmr = static_cast<r32>(misses) / triangle_count;
+  if (vertex_count) stats.atvr = static_cast<r32>(misses) / vertex_count;
+  return stats;
+}
+
+void OptimizeVertexCache(std::vector<u32> &indices, u32 vertex_count) {
+  static const ForsythScores scores;
+  auto triangle_count = static_cast<u32>(indices.size() / 3);
+  if (triangle_count == 0) return;
+
+  // triangles of every vertex, the ones not emitted yet come first
+  std::vector<u32> triangles_left(vertex_count, 0);
+  for (auto index : indices) ++triangles_left[index];
+  std::vector<u32> adjacency_offset(vertex_count + 1, 0);
+  std::inclusive_scan(triangles_left.begin(), triangles_left.end(),
+                      adjacency_offset.begin() + 1);
+  std::vector<u32> adjacency(indices.size());
+  {
+    std::vector<u32> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+    for (u32 i = 0; i < indices.size(); ++i) {
+      adjacency[fill[indices[i]]++] = i / 3;
+    }
+  }
+
+  std::vector<u32> cache_pos(vertex_count, NO_INDEX);
+  std::vector<r32> vertex_score(vertex_count);
+  for (u32 v = 0; v < vertex_count; ++v) {
+    vertex_score[v] = scores.Score(NO_INDEX, triangles_left[v]);
+  }
+  auto triangle_score = [&](u32 triangle) {
+    const auto *corner = &indices[triangle * 3];
+    return vertex_score[corner[0]] + vertex_score[corner[1]] +
+           vertex_score[corner[2]];
+  };
+
+  u32 best_triangle = 0;
+  r32 best_score = triangle_score(0);
+  for (u32 t = 1; t < triangle_count; ++t) {
+    if (auto score = triangle_score(t); score > best_score) {
+      best_score = score;
+      best_triangle = t;
+    }
+  }
+
+  std::vector<u32> result;
+  result.reserve(indices.size());
+  std::vector<u8> emitted(triangle_count, 0);
+  u32 cache[FORSYTH_CACHE_SIZE + 3];
+  u32 cache_count = 0;
+  // next triangle in input order to try when no cached vertex has any left
+  u32 dead_end_cursor = 0;
+  for (u32 emitted_count = 0; emitted_count < triangle_count;
+       ++emitted_count) {
+    if (best_triangle == NO_INDEX) {
+      while (emitted[dead_end_cursor]) ++dead_end_cursor;
+      best_triangle = dead_end_cursor;
+    }
+    const u32 *corner = &indices[best_triangle * 3];
+    result.insert(result.end(), corner, corner + 3);
+    emitted[best_triangle] = 1;
+
+    // the triangle's vertices move to the front of the LRU cache
+    u32 new_cache[FORSYTH_CACHE_SIZE + 3];
+    u32 new_count = 0;
+    for (u32 c = 0; c < 3; ++c) {
+      u32 v = corner[c];
+      if (std::find(new_cache, new_cache + new_count, v) ==
+          new_cache + new_count) {
+        new_cache[new_count++] = v;
+      }
+      auto *begin = &adjacency[adjacency_offset[v]];
+      auto *end = begin + triangles_left[v];
+      std::swap(*std::find(begin, end, best_triangle), end[-1]);
+      --triangles_left[v];
+    }
+    for (u32 i = 0; i < cache_count; ++i) {
+      u32 v = cache[i];
+      if (v != corner[0] && v != corner[1] && v != corner[2]) {
+        new_cache[new_count++] = v;
+      }
+    }
+    for (u32 i = 0; i < new_count; ++i) {
+      u32 v = new_cache[i];
+      cache_pos[v] = i < FORSYTH_CACHE_SIZE ? i : NO_INDEX;
+      vertex_score[v] = scores.Score(cache_pos[v], triangles_left[v]);
+    }
+
+    // only triangles of cached vertices changed their score
+    best_triangle = NO_INDEX;
+    best_score = -1.0f;
+    for (u32 i = 0; i < new_count; ++i) {
+      u32 v = new_cache[i];
+      const auto *adjacent = &adjacency[adjacency_offset[v]];
+      for (u32 a = 0; a < triangles_left[v]; ++a) {
+        if (auto score = triangle_score(adjacent[a]); score > best_score) {
+          best_score = score;
+          best_triangle = adjacent[a];
+        }
+      }
+    }
+    cache_count = std::min(new_count, FORSYTH_CACHE_SIZE);
+    std::copy(new_cache, new_cache + cache_count, cache);
+  }
+  indices = std::move(result);
+}
+
+void OptimizeOverdraw(std::vector<u32> &indices,
+                      std::span<const Vec3> vertex_positions) {
+  auto triangle_count = static_cast<u32>(indices.size() / 3);
+  if (triangle_count == 0) return;
+
+  std::vector<u32> cluster_start = {0};
+  {
+    std::vector<u32> miss_stamp(vertex_positions.size(), 0);
+    u32 misses = 0;
+    for (u32 t = 0; t < triangle_count; ++t) {
+      u32 triangle_misses = 0;
+      for (u32 c = 0; c < 3; ++c) {
+        u32 v = indices[t * 3 + c];
+        if (miss_stamp[v] == 0 || misses - miss_stamp[v] >= VERTEX_CACHE_SIZE) {
+          miss_stamp[v] = ++misses;
+          ++triangle_misses;
+        }
+      }
+      bool cold_cache =
+          triangle_misses == 3 ||
+          (triangle_misses == 2 &&
+           t - cluster_start.back() >= OVERDRAW_MIN_CLUSTER_SIZE);
+      if (t != 0 && cold_cache) cluster_start.push_back(t);
+    }
+  }
+  auto cluster_count = static_cast<u32>(cluster_start.size());
+  cluster_start.push_back(triangle_count);
+
+  // area weighted centroid and normal of every cluster
+  struct Cluster {
+    Vec3 centroid;
+    Vec3 normal;
+    r32 area;
+    r32 sort_key;
+  };
+  std::vector<Cluster> clusters(cluster_count);
+  Vec3 mesh_centroid{0, 0, 0};
+  r32 mesh_area = 0;
+  for (u32 c = 0; c < cluster_count; ++c) {
+    auto &cluster = clusters[c];
+    cluster.centroid = Vec3{0, 0, 0};
+    cluster.normal = Vec3{0, 0, 0};
+    cluster.area = 0;
+    for (u32 t = cluster_start[c]; t < cluster_start[c + 1]; ++t) {
+      const auto &p0 = vertex_positions[indices[t * 3]];
+      const auto &p1 = vertex_positions[indices[t * 3 + 1]];
+      const auto &p2 = vertex_positions[indices[t * 3 + 2]];
+      auto perpendicular = Cross(p1 - p0, p2 - p0);
+      r32 area = perpendicular.Length();
+      cluster.centroid = cluster.centroid + (p0 + p1 + p2) * (area / 3.0f);
+      cluster.normal = cluster.normal + perpendicular;
+      cluster.area += area;
+    }
+    mesh_centroid = mesh_centroid + cluster.centroid;
+    mesh_area += cluster.area;
+    if (cluster.area > 0) cluster.centroid = cluster.centroid / cluster.area;
+  }
+  if (mesh_area > 0) mesh_centroid = mesh_centroid / mesh_area;
+  for (auto &cluster : clusters) {
+    r32 normal_length = cluster.normal.Length();
+    cluster.sort_key =
+        normal_length > 0
+            ? Dot(cluster.centroid - mesh_centroid, cluster.normal) /
+                  normal_length
+            : 0.0f;
+  }
+
+  std::vector<u32> order(cluster_count);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&clusters](u32 a, u32 b) {
+    return clusters[a].sort_key > clusters[b].sort_key;
+  });
+  std::vector<u32> result;
+  result.reserve(indices.size());
+  for (auto c : order) {
+    result.insert(result.end(), indices.begin() + cluster_start[c] * 3,
+                  indices.begin() + cluster_start[c + 1] * 3);
+  }
+  auto vertex_count = static_cast<u32>(vertex_positions.size());
+  r32 max_acmr = AnalyzeVertexCache(indices, vertex_count).acmr *
+                 OVERDRAW_MAX_ACMR_GROWTH;
+  if (AnalyzeVertexCache(result, vertex_count).acmr <= max_acmr) {
+    indices = std::move(result);
+  }
+}
+
+void OptimizeVertexFetch(IndexedMesh &indexed) {
+  std::vector<u32> remap(indexed.VertexCount(), NO_INDEX);
+  u32 next_vertex = 0;
+  for (auto &index : indexed.indices) {
+    if (remap[index] == NO_INDEX) remap[index] = next_vertex++;
+    index = remap[index];
+  }
+  // vertices no triangle uses are dropped
+  TriangleIndices vertices;
+  vertices.PosIdx.resize(next_vertex);
+  vertices.NormalIdx.resize(next_vertex);
+  vertices.TexCoordIdx.resize(next_vertex);
+  for (u32 v = 0; v < remap.size(); ++v) {
+    if (remap[v] == NO_INDEX) continue;
+    vertices.PosIdx[remap[v]] = indexed.vertices.PosIdx[v];
+    vertices.NormalIdx[remap[v]] = indexed.vertices.NormalIdx[v];
+    vertices.TexCoordIdx[remap[v]] = indexed.vertices.TexCoordIdx[v];
+  }
+  indexed.vertices = std::move(vertices);
+}
+
+void OptimizeIndexedMesh(IndexedMesh &indexed, const Mesh &mesh) {
+  Assert(indexed.LodCount() == 1);
+  OptimizeVertexCache(indexed.indices, indexed.VertexCount());
+  std::vector<Vec3> vertex_positions(indexed.VertexCount());
+  for (u32 v = 0; v < indexed.VertexCount(); ++v) {
+    vertex_positions[v] = mesh.VertexPosData[indexed.vertices.PosIdx[v]];
+  }
+  OptimizeOverdraw(indexed.indices, vertex_positions);
+  OptimizeVertexFetch(indexed);
+}
+
+}  // namespace quixotism
@@ -0,0 +1,50 @@
+#pragma once
+#include <span>
+#include <vector>
+
+#include "math/qmath.hpp"
+#include "mesh/indexed_mesh.hpp"
+#include "quixotism_c.hpp"
+
+namespace quixotism {
+
+// Post-transform cache of the vertex shader outputs, as a FIFO. 16 entries is
+// a conservative guess for current GPUs.
+static constexpr u32 VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStats {
+  // average cache miss ratio, transformed vertices per triangle (0.5 at best
+  // for large regular meshes, 3 at worst)
+  r32 acmr = 0;
+  // average transformed to vertex ratio (1 at best)
+  r32 atvr = 0;
+};
+
+// Simulates a FIFO vertex cache of cache_size entries over the triangle list
+VertexCacheStats AnalyzeVertexCache(std::span<const u32> indices,
+                                    u32 vertex_count,
+                                    u32 cache_size = VERTEX_CACHE_SIZE);
+
+// Reorders the triangles for vertex cache reuse with Forsyth's linear speed
+// algorithm: vertices are scored by their place in a simulated LRU cache and
+// by how many of their triangles are left, and the triangle with the best
+// score is emitted next.
+void OptimizeVertexCache(std::vector<u32> &indices, u32 vertex_count);
+
+// Reorders clusters of a cache optimized triangle list so that the ones
+// facing out from the mesh center get drawn first and occlude the rest.
+// Clusters start where the cache simulation misses all three vertices of a
+// triangle, or two of them once the cluster is large enough, so little cache
+// reuse is lost. The order is only kept if the cache misses grow by 5% at
+// most. vertex_positions holds the position of every vertex.
+void OptimizeOverdraw(std::vector<u32> &indices,
+                      std::span<const Vec3> vertex_positions);
+
+// Renumbers the vertices in the order the triangles first use them, so vertex
+// fetches walk the vertex buffer forward
+void OptimizeVertexFetch(IndexedMesh &indexed);
+
+// All of the above, in order, for a mesh without levels of detail yet
+void OptimizeIndexedMesh(IndexedMesh &indexed, const Mesh &mesh);
+
+}  // namespace quixotism
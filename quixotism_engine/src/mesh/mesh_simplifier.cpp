@@ -0,0 +1,337 @@
+#include "mesh/mesh_simplifier.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+#include "math/qmath.hpp"
+#include "mesh/mesh_optimizer.hpp"
+
+namespace quixotism {
+
+// Sum of squared distances to a set of planes, as the symmetric 4x4 matrix of
+// the plane equations (a, b, c, d)
+struct Quadric {
+  // aa ab ac ad bb bc bd cc cd dd
+  r64 m[10] = {};
+
+  static Quadric FromPlane(r64 a, r64 b, r64 c, r64 d, r64 weight) {
+    Quadric q;
+    r64 plane[4] = {a, b, c, d};
+    u32 k = 0;
+    for (u32 i = 0; i < 4; ++i) {
+      for (u32 j = i; j < 4; ++j) q.m[k++] = plane[i] * plane[j] * weight;
+    }
+    return q;
+  }
+
+  Quadric &operator+=(const Quadric &other) {
+    for (u32 i = 0; i < 10; ++i) m[i] += other.m[i];
+    return *this;
+  }
+
+  r64 Evaluate(const Vec3 &p) const {
+    r64 x = p.x;
+    r64 y = p.y;
+    r64 z = p.z;
+    return m[0] * x * x + 2 * m[1] * x * y + 2 * m[2] * x * z + 2 * m[3] * x +
+           m[4] * y * y + 2 * m[5] * y * z + 2 * m[6] * y + m[7] * z * z +
+           2 * m[8] * z + m[9];
+  }
+};
+
+static FORCE_INLINE u64 EdgeKey(u32 a, u32 b) {
+  return (static_cast<u64>(std::min(a, b)) << 32) | std::max(a, b);
+}
+
+// Compressed lists of the items of each key, built from (key, item) pairs
+struct Adjacency {
+  std::vector<u32> offset;
+  std::vector<u32> items;
+
+  template <class FUNC>
+  void Build(u32 key_count, size_t pair_count, FUNC &&for_each_pair) {
+    offset.assign(key_count + 1, 0);
+    for_each_pair([this](u32 key, u32) { ++offset[key + 1]; });
+    std::partial_sum(offset.begin(), offset.end(), offset.begin());
+    items.resize(pair_count);
+    std::vector<u32> fill(offset.begin(), offset.end() - 1);
+    for_each_pair(
+        [this, &fill](u32 key, u32 item) { items[fill[key]++] = item; });
+  }
+
+  std::span<const u32> Get(u32 key) const {
+    return {items.data() + offset[key], items.data() + offset[key + 1]};
+  }
+};
+
+// Moving position `from` onto position `to`
+struct Collapse {
+  u32 from;
+  u32 to;
+  r64 cost;
+};
+
+class Simplifier {
+ public:
+  Simplifier(std::span<const u32> _indices, const IndexedMesh &indexed,
+             const Mesh &mesh)
+      : indices(_indices.begin(), _indices.end()),
+        vertex_position(indexed.vertices.PosIdx),
+        positions(mesh.VertexPosData),
+        position_count(static_cast<u32>(mesh.VertexPosData.size())),
+        quadrics(position_count),
+        locked(position_count, 0) {
+    std::unordered_map<u64, u32> edge_use;
+    for (u32 t = 0; t < indices.size() / 3; ++t) {
+      u32 p[3];
+      for (u32 c = 0; c < 3; ++c) p[c] = PositionOf(t, c);
+      auto perpendicular = Cross(positions[p[1]] - positions[p[0]],
+                                 positions[p[2]] - positions[p[0]]);
+      r32 length = perpendicular.Length();
+      if (length > 0) {
+        auto normal = perpendicular / length;
+        auto plane = Quadric::FromPlane(normal.x, normal.y, normal.z,
+                                        -Dot(normal, positions[p[0]]),
+                                        0.5 * length);
+        for (auto position : p) quadrics[position] += plane;
+      }
+      for (u32 c = 0; c < 3; ++c) ++edge_use[EdgeKey(p[c], p[(c + 1) % 3])];
+    }
+    // open borders and non-manifold edges stay where they are
+    for (auto [key, use] : edge_use) {
+      if (use != 2) {
+        locked[key >> 32] = 1;
+        locked[key & 0xFFFFFFFF] = 1;
+      }
+    }
+  }
+
+  std::vector<u32> Run(u32 target_index_count) {
+    u32 triangle_count = static_cast<u32>(indices.size() / 3);
+    u32 target_triangles = target_index_count / 3;
+    std::vector<u8> touched(position_count);
+    std::vector<u8> dead(triangle_count);
+    std::vector<Collapse> collapses;
+    // Every pass collects the collapses of all edges, cheapest first, and
+    // applies those whose neighbourhood no earlier collapse of the pass
+    // changed, which keeps their checks valid
+    while (triangle_count > target_triangles) {
+      BuildTrianglesOfPositions();
+      collapses.clear();
+      for (u32 t = 0; t < triangle_count; ++t) {
+        for (u32 c = 0; c < 3; ++c) {
+          u32 a = PositionOf(t, c);
+          u32 b = PositionOf(t, (c + 1) % 3);
+          // interior edges show up once in each direction
+          if (a > b) continue;
+          auto ab = Cost(a, b);
+          auto ba = Cost(b, a);
+          if (ab <= ba && ab < INVALID_COST) collapses.push_back({a, b, ab});
+          if (ba < ab) collapses.push_back({b, a, ba});
+        }
+      }
+      std::sort(collapses.begin(), collapses.end(),
+                [](const Collapse &x, const Collapse &y) {
+                  return x.cost < y.cost;
+                });
+
+      std::fill(touched.begin(), touched.end(), 0);
+      dead.assign(triangle_count, 0);
+      u32 alive_count = triangle_count;
+      for (const auto &collapse : collapses) {
+        if (alive_count <= target_triangles) break;
+        if (touched[collapse.from] || touched[collapse.to]) continue;
+        if (!MapVertices(collapse.from, collapse.to) ||
+            Flips(collapse.from, collapse.to)) {
+          continue;
+        }
+        for (auto t : triangles_of_position.Get(collapse.from)) {
+          for (u32 c = 0; c < 3; ++c) {
+            auto &vertex = indices[t * 3 + c];
+            touched[vertex_position[vertex]] = 1;
+            if (vertex_position[vertex] != collapse.from) continue;
+            vertex = std::find_if(vertex_map.begin(), vertex_map.end(),
+                                  [vertex](auto pair) {
+                                    return pair.first == vertex;
+                                  })->second;
+          }
+          if (PositionOf(t, 0) == PositionOf(t, 1) ||
+              PositionOf(t, 1) == PositionOf(t, 2) ||
+              PositionOf(t, 2) == PositionOf(t, 0)) {
+            dead[t] = 1;
+            --alive_count;
+          }
+        }
+        quadrics[collapse.to] += quadrics[collapse.from];
+      }
+      if (alive_count == triangle_count) break;
+
+      u32 kept = 0;
+      for (u32 t = 0; t < triangle_count; ++t) {
+        if (dead[t]) continue;
+        std::copy_n(&indices[t * 3], 3, &indices[kept * 3]);
+        ++kept;
+      }
+      triangle_count = kept;
+      indices.resize(triangle_count * 3);
+    }
+    return std::move(indices);
+  }
+
+ private:
+  static constexpr r64 INVALID_COST = std::numeric_limits<r64>::infinity();
+
+  u32 PositionOf(u32 triangle, u32 corner) const {
+    return vertex_position[indices[triangle * 3 + corner]];
+  }
+
+  void BuildTrianglesOfPositions() {
+    u32 triangle_count = static_cast<u32>(indices.size() / 3);
+    triangles_of_position.Build(position_count, indices.size(),
+                                [&](auto &&add) {
+                                  for (u32 t = 0; t < triangle_count; ++t) {
+                                    for (u32 c = 0; c < 3; ++c) {
+                                      add(PositionOf(t, c), t);
+                                    }
+                                  }
+                                });
+  }
+
+  r64 Cost(u32 from, u32 to) {
+    if (locked[from] || !MapVertices(from, to) || !IsManifold(from, to)) {
+      return INVALID_COST;
+    }
+    Quadric sum = quadrics[from];
+    sum += quadrics[to];
+    return std::max(sum.Evaluate(positions[to]), 0.0);
+  }
+
+  // Finds the vertex of position `to` every vertex of position `from` turns
+  // into: the one it shares a triangle with. Fails if there is none or more
+  // than one, which means the edge crosses an attribute seam, and for
+  // triangles that use one of the positions twice.
+  bool MapVertices(u32 from, u32 to) {
+    vertex_map.clear();
+    for (auto t : triangles_of_position.Get(from)) {
+      u32 source = 0;
+      u32 target = NO_VERTEX;
+      u32 from_count = 0;
+      u32 to_count = 0;
+      for (u32 c = 0; c < 3; ++c) {
+        u32 vertex = indices[t * 3 + c];
+        if (vertex_position[vertex] == from) {
+          source = vertex;
+          ++from_count;
+        } else if (vertex_position[vertex] == to) {
+          target = vertex;
+          ++to_count;
+        }
+      }
+      if (from_count != 1 || to_count > 1) return false;
+      auto it = std::find_if(
+          vertex_map.begin(), vertex_map.end(),
+          [source](auto pair) { return pair.first == source; });
+      if (it == vertex_map.end()) {
+        vertex_map.emplace_back(source, target);
+      } else if (it->second == NO_VERTEX) {
+        it->second = target;
+      } else if (target != NO_VERTEX && it->second != target) {
+        return false;
+      }
+    }
+    return std::none_of(vertex_map.begin(), vertex_map.end(),
+                        [](auto pair) { return pair.second == NO_VERTEX; });
+  }
+
+  // The link condition: the two positions have no neighbours in common but
+  // the third corners of the edge's two triangles
+  bool IsManifold(u32 a, u32 b) {
+    neighbours.clear();
+    for (auto t : triangles_of_position.Get(a)) {
+      for (u32 c = 0; c < 3; ++c) neighbours.push_back(PositionOf(t, c));
+    }
+    std::sort(neighbours.begin(), neighbours.end());
+    neighbours.erase(std::unique(neighbours.begin(), neighbours.end()),
+                     neighbours.end());
+    u32 shared = 0;
+    for (auto t : triangles_of_position.Get(b)) {
+      for (u32 c = 0; c < 3; ++c) {
+        u32 p = PositionOf(t, c);
+        if (p == a || p == b) continue;
+        auto it = std::lower_bound(neighbours.begin(), neighbours.end(), p);
+        if (it != neighbours.end() && *it == p) {
+          ++shared;
+          // count every shared neighbour once
+          neighbours.erase(it);
+        }
+      }
+    }
+    return shared == 2;
+  }
+
+  // whether moving `from` onto `to` turns a remaining triangle over
+  bool Flips(u32 from, u32 to) const {
+    for (auto t : triangles_of_position.Get(from)) {
+      Vec3 before[3];
+      Vec3 after[3];
+      bool has_to = false;
+      for (u32 c = 0; c < 3; ++c) {
+        u32 p = PositionOf(t, c);
+        has_to |= p == to;
+        before[c] = positions[p];
+        after[c] = positions[p == from ? to : p];
+      }
+      if (has_to) continue;
+      auto normal_before =
+          Cross(before[1] - before[0], before[2] - before[0]);
+      auto normal_after = Cross(after[1] - after[0], after[2] - after[0]);
+      if (Dot(normal_before, normal_after) <= 0) return true;
+    }
+    return false;
+  }
+
+  static constexpr u32 NO_VERTEX = 0xFFFFFFFF;
+
+  std::vector<u32> indices;
+  const std::vector<u32> &vertex_position;
+  const std::vector<VertexPos> &positions;
+  u32 position_count;
+  std::vector<Quadric> quadrics;
+  std::vector<u8> locked;
+  Adjacency triangles_of_position;
+  // scratch space
+  std::vector<std::pair<u32, u32>> vertex_map;
+  std::vector<u32> neighbours;
+};
+
+std::vector<u32> SimplifyMesh(std::span<const u32> indices,
+                              const IndexedMesh &indexed, const Mesh &mesh,
+                              u32 target_index_count) {
+  Simplifier simplifier{indices, indexed, mesh};
+  return simplifier.Run(target_index_count);
+}
+
+void BuildLodChain(IndexedMesh &indexed, const Mesh &mesh) {
+  Assert(indexed.LodCount() == 1);
+  auto full = indexed.lods.front();
+  if (full.index_count / 3 < MESH_LOD_MIN_TRIANGLES) return;
+
+  auto previous = full;
+  for (auto ratio : MESH_LOD_TRIANGLE_RATIOS) {
+    auto target = static_cast<u32>(full.index_count * ratio) / 3 * 3;
+    std::span<const u32> source{indexed.indices.data() + previous.first_index,
+                                previous.index_count};
+    auto lod_indices = SimplifyMesh(source, indexed, mesh, target);
+    size_t min_removed = previous.index_count / 10;
+    if (lod_indices.size() + min_removed > previous.index_count) break;
+    OptimizeVertexCache(lod_indices, indexed.VertexCount());
+    previous = {indexed.IndexCount(), static_cast<u32>(lod_indices.size())};
+    indexed.indices.insert(indexed.indices.end(), lod_indices.begin(),
+                           lod_indices.end());
+    indexed.lods.push_back(previous);
+  }
+}
+
+}  // namespace quixotism
@@ -0,0 +1,35 @@
+#pragma once
+#include <span>
+#include <vector>
+
+#include "mesh/indexed_mesh.hpp"
+#include "quixotism_c.hpp"
+
+namespace quixotism {
+
+// Triangle share of the full mesh each level of detail aims for, level 0 is
+// the full mesh
+static constexpr r32 MESH_LOD_TRIANGLE_RATIOS[] = {0.5f, 0.25f, 0.125f};
+// meshes with fewer triangles get no levels of detail
+static constexpr u32 MESH_LOD_MIN_TRIANGLES = 256;
+
+// Reduces the triangles (indices into the vertices of indexed) to about
+// target_index_count indices with quadric error metric edge collapses. A
+// collapse moves one position onto a neighbouring one, so the result uses a
+// subset of the same vertices and needs no vertex buffer of its own.
+// Positions on open borders are locked, and a position on an attribute seam
+// only moves along the seam, so texture coordinates and normals do not get
+// smeared across it. Collapses that would flip a triangle or make the mesh
+// non-manifold are skipped, which can leave more indices than the target.
+std::vector<u32> SimplifyMesh(std::span<const u32> indices,
+                              const IndexedMesh &indexed, const Mesh &mesh,
+                              u32 target_index_count);
+
+// Builds the levels of detail of MESH_LOD_TRIANGLE_RATIOS, each simplified
+// from the one before and cache optimized, and appends their indices to
+// indexed.indices. Fills indexed.lods, which starts with the full mesh.
+// Levels that remove less than a tenth of the triangles of the one before
+// end the chain.
+void BuildLodChain(IndexedMesh &indexed, const Mesh &mesh);
+
+}  // namespace quixotism
@@ -0,0 +1,227 @@
+#include "mesh/meshlet_builder.hpp"
+
+#include <cmath>
+
+namespace quixotism {
+
+static constexpr u8 NOT_IN_MESHLET = 0xFF;
+// how much a candidate whose normal points away from the meshlet normal costs
+// over its distance, at most 1 + 2 * MESHLET_CONE_WEIGHT times
+static constexpr r32 MESHLET_CONE_WEIGHT = 0.5f;
+// cones whose normals spread wider than this (cosine to the axis) can cull
+// so few viewers that they are not worth testing
+static constexpr r32 MESHLET_MIN_CONE_DOT = 0.1f;
+
+static Vec3 TriangleNormal(const Vec3 &a, const Vec3 &b, const Vec3 &c) {
+  auto normal = Cross(b - a, c - a);
+  auto length = normal.Length();
+  return length > 0 ? normal * (1.0f / length) : Vec3{};
+}
+
+static void ComputeMeshletBounds(Meshlet &meshlet, const MeshletMesh &result,
+                                 std::span<const u32> vertex_position,
+                                 std::span<const Vec3> positions) {
+  const u32 *vertices = result.vertices.data() + meshlet.vertex_offset;
+  const u8 *triangles = result.triangles.data() + meshlet.triangle_offset * 3;
+  auto position_of = [&](u32 local_index) -> const Vec3 & {
+    return positions[vertex_position[vertices[local_index]]];
+  };
+
+  // the sphere around the box of the vertices, close enough to the minimal
+  // one for culling and cheap
+  Vec3 min = position_of(0);
+  Vec3 max = min;
+  for (u32 i = 1; i < meshlet.vertex_count; ++i) {
+    const auto &position = position_of(i);
+    for (u32 axis = 0; axis < 3; ++axis) {
+      min[axis] = Min(min[axis], position[axis]);
+      max[axis] = Max(max[axis], position[axis]);
+    }
+  }
+  meshlet.center = (min + max) * 0.5f;
+  r32 radius_squared = 0;
+  for (u32 i = 0; i < meshlet.vertex_count; ++i) {
+    auto offset = position_of(i) - meshlet.center;
+    radius_squared = Max(radius_squared, Dot(offset, offset));
+  }
+  meshlet.radius = std::sqrt(radius_squared);
+
+  // the cone around the triangle normals, degenerate triangles face nowhere
+  Vec3 normals[MESHLET_MAX_TRIANGLES];
+  Vec3 first_corners[MESHLET_MAX_TRIANGLES];
+  u32 normal_count = 0;
+  Vec3 axis = {};
+  for (u32 i = 0; i < meshlet.triangle_count; ++i) {
+    const auto &a = position_of(triangles[i * 3]);
+    const auto &b = position_of(triangles[i * 3 + 1]);
+    const auto &c = position_of(triangles[i * 3 + 2]);
+    auto normal = TriangleNormal(a, b, c);
+    if (Dot(normal, normal) == 0) continue;
+    normals[normal_count] = normal;
+    first_corners[normal_count] = a;
+    ++normal_count;
+    axis += normal;
+  }
+  meshlet.cone_cutoff = 2.0f;
+  const auto axis_length = axis.Length();
+  if (normal_count == 0 || axis_length == 0) return;
+  axis = axis * (1.0f / axis_length);
+
+  r32 min_dot = 1.0f;
+  for (u32 i = 0; i < normal_count; ++i) {
+    min_dot = Min(min_dot, Dot(normals[i], axis));
+  }
+  if (min_dot <= MESHLET_MIN_CONE_DOT) return;
+
+  // the apex goes back along the axis until it is behind every triangle
+  // plane, then a viewer inside the cone mirrored at the apex sees the back
+  // of every triangle
+  r32 apex_distance = 0;
+  for (u32 i = 0; i < normal_count; ++i) {
+    const r32 center_distance = Dot(meshlet.center - first_corners[i],
+                                    normals[i]);
+    apex_distance = Max(apex_distance, center_distance / Dot(axis, normals[i]));
+  }
+  meshlet.cone_apex = meshlet.center - axis * apex_distance;
+  meshlet.cone_axis = axis;
+  meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+}
+
+MeshletMesh BuildMeshlets(std::span<const u32> indices,
+                          std::span<const u32> vertex_position,
+                          std::span<const Vec3> positions) {
+  MeshletMesh result;
+  const auto triangle_count = static_cast<u32>(indices.size() / 3);
+  const auto vertex_count = static_cast<u32>(vertex_position.size());
+  const auto position_count = static_cast<u32>(positions.size());
+  if (triangle_count == 0) return result;
+
+  // the triangles around every position, so triangles that only share
+  // positions (hard edges, UV seams, flat shading) are still neighbours
+  std::vector<u32> adjacency_offsets(position_count + 1, 0);
+  for (auto index : indices) ++adjacency_offsets[vertex_position[index] + 1];
+  for (u32 p = 0; p < position_count; ++p) {
+    adjacency_offsets[p + 1] += adjacency_offsets[p];
+  }
+  std::vector<u32> adjacency(indices.size());
+  {
+    std::vector<u32> cursors(adjacency_offsets.begin(),
+                             adjacency_offsets.end() - 1);
+    for (u32 i = 0; i < indices.size(); ++i) {
+      adjacency[cursors[vertex_position[indices[i]]]++] = i / 3;
+    }
+  }
+
+  std::vector<Vec3> centroids(triangle_count);
+  std::vector<Vec3> normals(triangle_count);
+  for (u32 t = 0; t < triangle_count; ++t) {
+    const auto &a = positions[vertex_position[indices[t * 3]]];
+    const auto &b = positions[vertex_position[indices[t * 3 + 1]]];
+    const auto &c = positions[vertex_position[indices[t * 3 + 2]]];
+    centroids[t] = (a + b + c) * (1.0f / 3.0f);
+    normals[t] = TriangleNormal(a, b, c);
+  }
+
+  result.meshlets.reserve(triangle_count / MESHLET_MAX_TRIANGLES + 1);
+  result.triangles.reserve(indices.size());
+  std::vector<u8> emitted(triangle_count, 0);
+  std::vector<u8> local_index(vertex_count, NOT_IN_MESHLET);
+  // unemitted triangles touching the meshlet, a triangle is in here once per
+  // vertex it shares with the meshlet at most
+  std::vector<u32> candidates;
+  u32 seed_cursor = 0;
+  Meshlet meshlet;
+  Vec3 centroid_sum = {};
+  Vec3 normal_sum = {};
+
+  auto add_triangle = [&](u32 triangle) {
+    for (u32 corner = 0; corner < 3; ++corner) {
+      const u32 vertex = indices[triangle * 3 + corner];
+      if (local_index[vertex] == NOT_IN_MESHLET) {
+        local_index[vertex] = static_cast<u8>(meshlet.vertex_count++);
+        result.vertices.push_back(vertex);
+        const u32 position = vertex_position[vertex];
+        for (u32 a = adjacency_offsets[position];
+             a < adjacency_offsets[position + 1]; ++a) {
+          if (!emitted[adjacency[a]]) candidates.push_back(adjacency[a]);
+        }
+      }
+      result.triangles.push_back(local_index[vertex]);
+    }
+    emitted[triangle] = 1;
+    ++meshlet.triangle_count;
+    centroid_sum += centroids[triangle];
+    normal_sum += normals[triangle];
+  };
+
+  auto finish_meshlet = [&]() {
+    ComputeMeshletBounds(meshlet, result, vertex_position, positions);
+    result.meshlets.push_back(meshlet);
+    for (u32 i = 0; i < meshlet.vertex_count; ++i) {
+      local_index[result.vertices[meshlet.vertex_offset + i]] = NOT_IN_MESHLET;
+    }
+    meshlet = {};
+    meshlet.vertex_offset = static_cast<u32>(result.vertices.size());
+    meshlet.triangle_offset = static_cast<u32>(result.triangles.size() / 3);
+    candidates.clear();
+    centroid_sum = {};
+    normal_sum = {};
+  };
+
+  for (;;) {
+    if (meshlet.triangle_count == 0) {
+      while (seed_cursor < triangle_count && emitted[seed_cursor]) {
+        ++seed_cursor;
+      }
+      if (seed_cursor == triangle_count) break;
+      add_triangle(seed_cursor);
+    }
+    if (meshlet.triangle_count == MESHLET_MAX_TRIANGLES) {
+      finish_meshlet();
+      continue;
+    }
+
+    const auto center = centroid_sum * (1.0f / meshlet.triangle_count);
+    const auto axis_length = normal_sum.Length();
+    const auto axis =
+        axis_length > 0 ? normal_sum * (1.0f / axis_length) : Vec3{};
+    u32 best = triangle_count;
+    u32 best_new_vertices = 4;
+    r32 best_cost = INFINITY;
+    for (size_t k = 0; k < candidates.size();) {
+      const u32 triangle = candidates[k];
+      u32 new_vertices = 0;
+      for (u32 corner = 0; corner < 3; ++corner) {
+        new_vertices +=
+            local_index[indices[triangle * 3 + corner]] == NOT_IN_MESHLET;
+      }
+      // the meshlet only grows, a triangle that does not fit now never will
+      if (emitted[triangle] ||
+          meshlet.vertex_count + new_vertices > MESHLET_MAX_VERTICES) {
+        candidates[k] = candidates.back();
+        candidates.pop_back();
+        continue;
+      }
+      const auto offset = centroids[triangle] - center;
+      const r32 cost =
+          Dot(offset, offset) *
+          (1.0f + MESHLET_CONE_WEIGHT * (1.0f - Dot(normals[triangle], axis)));
+      if (new_vertices < best_new_vertices ||
+          (new_vertices == best_new_vertices && cost < best_cost)) {
+        best = triangle;
+        best_new_vertices = new_vertices;
+        best_cost = cost;
+      }
+      ++k;
+    }
+
+    if (best == triangle_count) {
+      finish_meshlet();
+    } else {
+      add_triangle(best);
+    }
+  }
+  return result;
+}
+
+}  // namespace quixotism
@@ -0,0 +1,59 @@
+#pragma once
+#include <span>
+#include <vector>
+
+#include "math/qmath.hpp"
+#include "quixotism_c.hpp"
+
+namespace quixotism {
+
+// Limits of a meshlet, the ones mesh shader pipelines commonly use. 124
+// triangles keep the local index data of a meshlet under 384 bytes.
+static constexpr u32 MESHLET_MAX_VERTICES = 64;
+static constexpr u32 MESHLET_MAX_TRIANGLES = 124;
+// meshes with fewer triangles are culled as a whole only
+static constexpr u32 MESHLET_MIN_MESH_TRIANGLES = 4096;
+
+// A cluster of neighbouring triangles with the data to cull it, in the
+// space of the mesh
+struct Meshlet {
+  // into MeshletMesh::vertices and MeshletMesh::triangles (3 per triangle)
+  u32 vertex_offset = 0;
+  u32 vertex_count = 0;
+  u32 triangle_offset = 0;
+  u32 triangle_count = 0;
+  // bounding sphere
+  Vec3 center = {};
+  r32 radius = 0;
+  // Every triangle faces away from a viewer at v when
+  // Dot(Normalize(cone_apex - v), cone_axis) >= cone_cutoff. The cutoff is
+  // above 1 if the normals spread too far for the cone to cull anything.
+  Vec3 cone_apex = {};
+  Vec3 cone_axis = {};
+  r32 cone_cutoff = 2.0f;
+};
+
+struct MeshletMesh {
+  std::vector<Meshlet> meshlets;
+  // the vertices of each meshlet, indices into the vertex buffer
+  std::vector<u32> vertices;
+  // the triangles of each meshlet, indices into the vertices of the meshlet
+  std::vector<u8> triangles;
+
+  u32 MeshletCount() const { return static_cast<u32>(meshlets.size()); }
+};
+
+// Partitions the triangles into meshlets. indices point into the vertices,
+// vertex_position is the index into positions of every vertex, the welded
+// ones of IndexedMesh. Meshlets grow greedily from a seed triangle, each step
+// takes the candidate sharing a position with the meshlet that adds the
+// fewest new vertices, then the one closest to the meshlet center whose
+// normal is closest to the meshlet normal, which keeps the bounding spheres
+// small and the normal cones narrow. A meshlet ends when no neighbouring
+// triangle fits any more, the next one starts at the first triangle left in
+// index order, so a vertex cache optimized order gives neighbouring meshlets.
+MeshletMesh BuildMeshlets(std::span<const u32> indices,
+                          std::span<const u32> vertex_position,
+                          std::span<const Vec3> positions);
+
+}  // namespace quixotism
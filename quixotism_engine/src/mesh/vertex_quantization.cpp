@@ -0,0 +1,210 @@
+#include "mesh/vertex_quantization.hpp"
+
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#include "thread_pool.hpp"
+
+namespace quixotism {
+
+u16 FloatToHalf(r32 value) {
+  const u32 bits = std::bit_cast<u32>(value);
+  const u32 sign = (bits >> 16) & 0x8000;
+  const u32 exponent = (bits >> 23) & 0xFF;
+  u32 mantissa = bits & 0x7FFFFF;
+
+  if (exponent == 0xFF) {
+    // infinity stays infinity, NaN stays a (quiet) NaN
+    return static_cast<u16>(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+  }
+  const i32 half_exponent = static_cast<i32>(exponent) - 127 + 15;
+  if (half_exponent >= 31) return static_cast<u16>(sign | 0x7C00);
+  if (half_exponent <= 0) {
+    // subnormal, the implicit bit joins the mantissa that gets shifted out
+    if (half_exponent < -10) return static_cast<u16>(sign);
+    mantissa |= 0x800000;
+    const u32 shift = static_cast<u32>(14 - half_exponent);
+    u32 half_mantissa = mantissa >> shift;
+    const u32 rest = mantissa & ((1u << shift) - 1);
+    const u32 halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (half_mantissa & 1))) {
+      ++half_mantissa;
+    }
+    return static_cast<u16>(sign | half_mantissa);
+  }
+  u32 half = (static_cast<u32>(half_exponent) << 10) | (mantissa >> 13);
+  const u32 rest = mantissa & 0x1FFF;
+  // a carry out of the mantissa bumps the exponent, up to infinity
+  if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) ++half;
+  return static_cast<u16>(sign | half);
+}
+
+r32 HalfToFloat(u16 value) {
+  const u32 sign = static_cast<u32>(value & 0x8000) << 16;
+  const u32 exponent = (value >> 10) & 0x1F;
+  const u32 mantissa = value & 0x3FF;
+  if (exponent == 0x1F) {
+    return std::bit_cast<r32>(sign | 0x7F800000 | (mantissa << 13));
+  }
+  if (exponent == 0) {
+    // zero or subnormal, mantissa * 2^-24
+    const r32 magnitude = static_cast<r32>(mantissa) * (1.0f / 16777216.0f);
+    return sign ? -magnitude : magnitude;
+  }
+  return std::bit_cast<r32>(sign | ((exponent + 127 - 15) << 23) |
+                            (mantissa << 13));
+}
+
+i16 FloatToSnorm16(r32 value) {
+  const r32 clamped = Max(-1.0f, Min(1.0f, value));
+  return static_cast<i16>(std::lround(clamped * 32767.0f));
+}
+
+r32 Snorm16ToFloat(i16 value) {
+  return Max(static_cast<r32>(value) / 32767.0f, -1.0f);
+}
+
+static Vec3 UnfoldOctahedral(r32 x, r32 y) {
+  Vec3 result{x, y, 1.0f - Abs(x) - Abs(y)};
+  if (result.z < 0) {
+    result.x = (1.0f - Abs(y)) * (x >= 0 ? 1.0f : -1.0f);
+    result.y = (1.0f - Abs(x)) * (y >= 0 ? 1.0f : -1.0f);
+  }
+  const auto length = result.Length();
+  return length > 0 ? result * (1.0f / length) : Vec3{0, 0, 1};
+}
+
+std::array<i16, 2> EncodeOctahedral(const Vec3 &unit) {
+  const r32 l1_norm = Abs(unit.x) + Abs(unit.y) + Abs(unit.z);
+  if (l1_norm == 0) return {0, 0};
+  r32 x = unit.x / l1_norm;
+  r32 y = unit.y / l1_norm;
+  if (unit.z < 0) {
+    const r32 folded_x = (1.0f - Abs(y)) * (x >= 0 ? 1.0f : -1.0f);
+    const r32 folded_y = (1.0f - Abs(x)) * (y >= 0 ? 1.0f : -1.0f);
+    x = folded_x;
+    y = folded_y;
+  }
+
+  // rounding both coordinates to nearest is not always the closest direction,
+  // so pick the best of the four pairs around the exact position. They are
+  // compared by distance, a dot product this close to 1 has no precision left.
+  const auto direction = unit * (1.0f / unit.Length());
+  const r32 floor_x = std::floor(Max(-1.0f, Min(1.0f, x)) * 32767.0f);
+  const r32 floor_y = std::floor(Max(-1.0f, Min(1.0f, y)) * 32767.0f);
+  std::array<i16, 2> best = {};
+  r32 best_distance = INFINITY;
+  for (u32 corner = 0; corner < 4; ++corner) {
+    const r32 qx = Min(32767.0f, floor_x + (corner & 1));
+    const r32 qy = Min(32767.0f, floor_y + (corner >> 1));
+    const auto offset =
+        UnfoldOctahedral(qx / 32767.0f, qy / 32767.0f) - direction;
+    const r32 distance = Dot(offset, offset);
+    if (distance < best_distance) {
+      best_distance = distance;
+      best = {static_cast<i16>(qx), static_cast<i16>(qy)};
+    }
+  }
+  return best;
+}
+
+Vec3 DecodeOctahedral(const std::array<i16, 2> &encoded) {
+  return UnfoldOctahedral(Snorm16ToFloat(encoded[0]),
+                          Snorm16ToFloat(encoded[1]));
+}
+
+QuantizationBox MakeQuantizationBox(const AABB &bbox) {
+  QuantizationBox box;
+  box.center = (bbox.min + bbox.max) * 0.5f;
+  box.half_extent = (bbox.max - bbox.min) * 0.5f;
+  return box;
+}
+
+std::array<i16, 3> EncodeBoxSnorm16(const Vec3 &position,
+                                    const QuantizationBox &box) {
+  std::array<i16, 3> result = {};
+  for (u32 axis = 0; axis < 3; ++axis) {
+    // a flat box has nothing to quantize on that axis
+    if (box.half_extent[axis] > 0) {
+      result[axis] = FloatToSnorm16((position[axis] - box.center[axis]) /
+                                    box.half_extent[axis]);
+    }
+  }
+  return result;
+}
+
+Vec3 DecodeBoxSnorm16(const i16 *encoded, const QuantizationBox &box) {
+  Vec3 result;
+  for (u32 axis = 0; axis < 3; ++axis) {
+    result[axis] = box.center[axis] +
+                   Snorm16ToFloat(encoded[axis]) * box.half_extent[axis];
+  }
+  return result;
+}
+
+std::pair<std::unique_ptr<u8[]>, size_t> SerializeQuantizedVertices(
+    const Mesh &mesh, const IndexedMesh &indexed,
+    const VertexBufferLayout &layout) {
+  const auto &elements = layout.GetLayoutElements();
+  Assert(elements.size() <= 3);
+  const r32 *sources[] = {
+      reinterpret_cast<const r32 *>(mesh.VertexPosData.data()),
+      reinterpret_cast<const r32 *>(mesh.VertexNormalData.data()),
+      reinterpret_cast<const r32 *>(mesh.VertexTexCoordData.data())};
+  const u32 *source_indices[] = {indexed.vertices.PosIdx.data(),
+                                 indexed.vertices.NormalIdx.data(),
+                                 indexed.vertices.TexCoordIdx.data()};
+  const u32 source_counts[] = {3, 3, 2};
+  const auto box = MakeQuantizationBox(mesh.bbox);
+
+  const auto stride = layout.GetStride();
+  const size_t size = stride * indexed.VertexCount();
+  auto buffer = std::make_unique_for_overwrite<u8[]>(size);
+  auto encode_range = [&](size_t begin, size_t end, u32) {
+    for (u32 j = 0; j < elements.size(); ++j) {
+      const auto &element = elements[j];
+      const u32 source_count = source_counts[j];
+      u8 *dst = buffer.get() + begin * stride + element.offset;
+      for (size_t i = begin; i < end; ++i, dst += stride) {
+        const r32 *src =
+            sources[j] + size_t{source_indices[j][i]} * source_count;
+        switch (element.encoding) {
+          case VertexEncoding::FLOAT:
+            std::memcpy(dst, src, element.count * sizeof(r32));
+            break;
+          case VertexEncoding::HALF: {
+            u16 halves[4] = {};
+            for (u32 c = 0; c < element.count; ++c) {
+              halves[c] = FloatToHalf(src[c]);
+            }
+            std::memcpy(dst, halves, element.count * sizeof(u16));
+            break;
+          }
+          case VertexEncoding::OCTAHEDRAL_SNORM16: {
+            Assert(source_count == 3);
+            const auto encoded =
+                EncodeOctahedral(Vec3{src[0], src[1], src[2]});
+            std::memcpy(dst, encoded.data(), sizeof(encoded));
+            break;
+          }
+          case VertexEncoding::BOX_SNORM16: {
+            Assert(source_count == 3);
+            const auto encoded =
+                EncodeBoxSnorm16(Vec3{src[0], src[1], src[2]}, box);
+            const i16 padded[4] = {encoded[0], encoded[1], encoded[2], 0};
+            std::memcpy(dst, padded, sizeof(padded));
+            break;
+          }
+          default:
+            Assert(!"unreachable");
+        }
+      }
+    }
+  };
+  ThreadPool::GetThreadPool().ParallelForBatched(
+      indexed.VertexCount(), SERIALIZE_MIN_BATCH_VERTICES, encode_range);
+  return std::make_pair(std::move(buffer), size);
+}
+
+}  // namespace quixotism
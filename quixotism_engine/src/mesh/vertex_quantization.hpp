@@ -0,0 +1,57 @@
+#pragma once
+#include <array>
+#include <memory>
+#include <utility>
+
+#include "math/qmath.hpp"
+#include "mesh/indexed_mesh.hpp"
+#include "quixotism_c.hpp"
+#include "renderer/vertex_buffer_layout.hpp"
+
+namespace quixotism {
+
+// Worst case errors of the encodings below, what a decode of an encode can
+// be off by. Half floats keep 11 significant bits, so values in the normal
+// half range come back within half an ulp. Octahedral normals are picked from
+// the four neighbouring snorm16 pairs by their decoded error, the bound is
+// the angle between the input and the decoded unit vector in radians. Box
+// positions are off by half a step, a 32767th of the half extent of the box
+// on that axis, plus float rounding.
+static constexpr r32 HALF_MAX_RELATIVE_ERROR = 1.0f / 2048.0f;
+static constexpr r32 OCTAHEDRAL_SNORM16_MAX_ANGLE_ERROR = 0.00005f;
+static constexpr r32 BOX_SNORM16_MAX_STEP_ERROR = 0.51f;
+
+// IEEE 754 binary16, rounded to nearest even. Out of range values become
+// infinity, tiny ones subnormals or zero.
+u16 FloatToHalf(r32 value);
+r32 HalfToFloat(u16 value);
+
+// The snorm16 conversion of OpenGL 4.2 and up, -32767 to 32767 for -1 to 1
+i16 FloatToSnorm16(r32 value);
+r32 Snorm16ToFloat(i16 value);
+
+// Maps a unit vector onto the octahedron and unfolds it into a square. A
+// zero vector encodes as +z.
+std::array<i16, 2> EncodeOctahedral(const Vec3 &unit);
+Vec3 DecodeOctahedral(const std::array<i16, 2> &encoded);
+
+// The space positions are quantized in, the bounding box scaled to -1 to 1
+struct QuantizationBox {
+  Vec3 center = {};
+  Vec3 half_extent = {};
+};
+
+QuantizationBox MakeQuantizationBox(const AABB &bbox);
+std::array<i16, 3> EncodeBoxSnorm16(const Vec3 &position,
+                                    const QuantizationBox &box);
+Vec3 DecodeBoxSnorm16(const i16 *encoded, const QuantizationBox &box);
+
+// SerializeIndexedVertices for layouts with encodings other than FLOAT. The
+// elements take the position, normal and texture coordinate in order,
+// positions are quantized in the box of mesh.bbox. Large meshes are encoded
+// in batches across the thread pool.
+std::pair<std::unique_ptr<u8[]>, size_t> SerializeQuantizedVertices(
+    const Mesh &mesh, const IndexedMesh &indexed,
+    const VertexBufferLayout &layout);
+
+}  // namespace quixotism
@@ -4,7 +4,7 @@
 #include "gl_call.hpp"
 
 namespace quixotism {
-bool GLBufferData(GLBuffer &buffer, void *data, size_t size,
+bool GLBufferData(GLBuffer &buffer, const void *data, size_t size,
                   BufferDataMode mode) {
   if (data && size) {
     GLCall(glNamedBufferData(buffer.id, size, data, mode));
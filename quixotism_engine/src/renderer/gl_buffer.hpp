@@ -21,7 +21,7 @@ struct GLBuffer {
   u32 id = INVALID_BUFFER_ID;
 };
 
-bool GLBufferData(GLBuffer &buffer, void *data, size_t size,
+bool GLBufferData(GLBuffer &buffer, const void *data, size_t size,
                   BufferDataMode mode);
 
 }  // namespace quixotism
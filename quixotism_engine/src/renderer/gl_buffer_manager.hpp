@@ -37,9 +37,9 @@ class GLBufferManager {
     return *this;
   }
 
-  [[no_discard]] GLBufferID Create();
-  [[no_discard]] std::optional<GLBuffer> Get(GLBufferID id) const;
-  [[no_discard]] bool Exists(const GLBufferID id) const;
+  [[nodiscard]] GLBufferID Create();
+  [[nodiscard]] std::optional<GLBuffer> Get(GLBufferID id) const;
+  [[nodiscard]] bool Exists(const GLBufferID id) const;
   void Destroy(const GLBufferID id);
 
   ~GLBufferManager();
@@ -21,5 +21,6 @@ class GLSampler {
 GLSampler CreateSampler();
 GLSampler CreateSampler2();
 GLSampler CreateCubeSampler();
+GLSampler CreateSDFSampler();
 
 }  // namespace quixotism
@@ -12,6 +12,59 @@ void GLTexture::BindUnit(u32 unit) { GLCall(glBindTextureUnit(unit, id)); }
 
 GLTexture::~GLTexture() { GLCall(glDeleteTextures(1, &id)); }
 
+// Client side pixel layout matching a bitmap format
+static GLenum PixelTransferFormat(BitmapFormat format) {
+  switch (format) {
+    case BitmapFormat::R8:
+      return GL_RED;
+    case BitmapFormat::RGB8:
+      return GL_RGB;
+    case BitmapFormat::RGBA8:
+      return GL_RGBA;
+    default:
+      Assert(!"unsupported texture upload format");
+      return GL_RGBA;
+  }
+}
+
+// Uploads one mip level of a 2D texture, or one face of a level of a cube
+// map, block compressed bitmaps go up as they are
+static void UploadLevel(u32 id, TextureType type, u32 level, u32 face,
+                        const Bitmap &bitmap) {
+  auto [width, height] = bitmap.GetDim();
+  auto bitmap_format = bitmap.GetBitmapFormat();
+  if (bitmap.IsBlockCompressed()) {
+    auto size = static_cast<GLsizei>(bitmap.GetDataSize());
+    if (type == TextureType::TEXTURE_CUBE_MAP) {
+      GLCall(glCompressedTextureSubImage3D(id, level, 0, 0, face, width,
+                                           height, 1, bitmap_format, size,
+                                           bitmap.GetBitmapPtr()));
+    } else {
+      GLCall(glCompressedTextureSubImage2D(id, level, 0, 0, width, height,
+                                           bitmap_format, size,
+                                           bitmap.GetBitmapPtr()));
+    }
+    return;
+  }
+  auto format = PixelTransferFormat(bitmap_format);
+  if (type == TextureType::TEXTURE_CUBE_MAP) {
+    GLCall(glTextureSubImage3D(id, level, 0, 0, face, width, height, 1,
+                               format, GL_UNSIGNED_BYTE,
+                               bitmap.GetBitmapPtr()));
+  } else {
+    GLCall(glTextureSubImage2D(id, level, 0, 0, width, height, format,
+                               GL_UNSIGNED_BYTE, bitmap.GetBitmapPtr()));
+  }
+}
+
+// single channel images (grayscale PNGs) sample as gray instead of red
+static void SwizzleSingleChannel(u32 id, BitmapFormat format) {
+  if (format == BitmapFormat::R8 || format == BitmapFormat::BC4) {
+    const GLint swizzle[] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+    GLCall(glTextureParameteriv(id, GL_TEXTURE_SWIZZLE_RGBA, swizzle));
+  }
+}
+
 static inline bool Use3DAllocator(TextureType type) {
   switch (type) {
     case TextureType::TEXTURE_2D:
@@ -30,7 +83,6 @@ static inline void AllocateImmutableStorage(const u32 id,
   } else {
     GLCall(glTextureStorage2D(id, desc.mip_levels, desc.format, desc.width,
                               desc.height));
-    GLCall(glGenerateTextureMipmap(id));
   }
 }
 
@@ -43,35 +95,94 @@ GLTexture CreateTexture(const TextureDesc &desc) {
   return tex;
 }
 
-GLTexture CreateTexture2D(const Bitmap &bitmap) {
+GLTexture CreateTexture2D(const Bitmap &bitmap, const MipOptions &mip_options) {
   TextureDesc desc;
   desc.type = TextureType::TEXTURE_2D;
   desc.format = bitmap.GetBitmapFormat();
   desc.width = bitmap.GetWidth();
   desc.height = bitmap.GetHeight();
-  desc.mip_levels = 6;
+  desc.mip_levels = MipLevelCount(desc.width, desc.height);
+  auto tex = CreateTexture(desc);
+  Assert(tex.Id());
+  auto format = PixelTransferFormat(desc.format);
+  auto mips = GenerateMips(bitmap, mip_options);
+  // R8 and RGB8 rows are not necessarily 4 byte aligned
+  GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+  GLCall(glTextureSubImage2D(tex.Id(), 0, 0, 0, desc.width, desc.height,
+                             format, GL_UNSIGNED_BYTE, bitmap.GetBitmapPtr()));
+  for (const auto &[idx, mip] : Enumerate(mips)) {
+    GLCall(glTextureSubImage2D(tex.Id(), idx + 1, 0, 0, mip.GetWidth(),
+                               mip.GetHeight(), format, GL_UNSIGNED_BYTE,
+                               mip.GetBitmapPtr()));
+  }
+  GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+  SwizzleSingleChannel(tex.Id(), desc.format);
+  return tex;
+}
+
+GLTexture CreateTexture2D(std::span<const Bitmap> levels) {
+  Assert(!levels.empty());
+  TextureDesc desc;
+  desc.type = TextureType::TEXTURE_2D;
+  desc.format = levels[0].GetBitmapFormat();
+  desc.width = levels[0].GetWidth();
+  desc.height = levels[0].GetHeight();
+  desc.mip_levels = static_cast<u32>(levels.size());
   auto tex = CreateTexture(desc);
   Assert(tex.Id());
-  GLCall(
-      glTextureSubImage2D(tex.Id(), 0, 0, 0, desc.width, desc.height,
-                          desc.format == BitmapFormat::RGBA8 ? GL_RGBA : GL_RED,
-                          GL_UNSIGNED_BYTE, bitmap.GetBitmapPtr()));
-  GLCall(glGenerateTextureMipmap(tex.Id()));
+  GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+  for (const auto &[idx, level] : Enumerate(levels)) {
+    Assert(level.GetBitmapFormat() == desc.format);
+    UploadLevel(tex.Id(), desc.type, idx, 0, level);
+  }
+  GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+  SwizzleSingleChannel(tex.Id(), desc.format);
   return tex;
 }
 
-GLTexture CreateCubeTexture(CubeBitmap &bitmaps) {
+GLTexture CreateCubeTexture(CubeBitmap &bitmaps,
+                            const MipOptions &mip_options) {
   u32 id = 0;
   auto [width, height] = bitmaps[0].GetDim();
-  auto internal_format = GL_RGBA8;
-  auto format = GL_RGBA;
+  auto bitmap_format = bitmaps[0].GetBitmapFormat();
+  auto format = PixelTransferFormat(bitmap_format);
+  u32 level_count = MipLevelCount(width, height);
   GLCall(glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &id));
-  GLCall(glTextureStorage2D(id, 1, internal_format, width, height));
+  GLCall(glTextureStorage2D(id, level_count, bitmap_format, width, height));
+  auto mips = GenerateCubeMips(bitmaps, mip_options);
+  GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
   for (const auto &[idx, bitmap] : Enumerate(bitmaps)) {
     Assert(width == bitmap.GetWidth() && height == bitmap.GetHeight());
+    Assert(bitmap.GetBitmapFormat() == bitmap_format);
     GLCall(glTextureSubImage3D(id, 0, 0, 0, idx, width, height, 1, format,
                                GL_UNSIGNED_BYTE, bitmaps[idx].GetBitmapPtr()));
+    for (const auto &[level_idx, mip] : Enumerate(mips[idx])) {
+      GLCall(glTextureSubImage3D(id, level_idx + 1, 0, 0, idx, mip.GetWidth(),
+                                 mip.GetHeight(), 1, format, GL_UNSIGNED_BYTE,
+                                 mip.GetBitmapPtr()));
+    }
   }
+  GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+  return id;
+}
+
+GLTexture CreateCubeTexture(const std::array<std::vector<Bitmap>, 6> &levels) {
+  u32 id = 0;
+  const auto &base = levels[0][0];
+  auto [width, height] = base.GetDim();
+  auto bitmap_format = base.GetBitmapFormat();
+  auto level_count = static_cast<u32>(levels[0].size());
+  GLCall(glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &id));
+  GLCall(glTextureStorage2D(id, level_count, bitmap_format, width, height));
+  GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+  for (const auto &[face, face_levels] : Enumerate(levels)) {
+    Assert(face_levels.size() == level_count);
+    for (const auto &[level_idx, level] : Enumerate(face_levels)) {
+      Assert(level.GetBitmapFormat() == bitmap_format);
+      UploadLevel(id, TextureType::TEXTURE_CUBE_MAP, level_idx, face, level);
+    }
+  }
+  GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
   return id;
 }
 
@@ -106,4 +217,35 @@ GLTexture CreateTextureArray(const Bitmap **bitmap, size_t count, bool r8) {
   return texture;
 }
 
+GLTexture CreateAtlasTexture(const TextureAtlas &atlas) {
+  TextureDesc desc;
+  desc.type = TextureType::TEXTURE_2D_ARRAY;
+  desc.width = atlas.GetLayerWidth();
+  desc.height = atlas.GetLayerHeight();
+  desc.format = atlas.GetFormat();
+  desc.count = atlas.GetMaxLayers();
+  desc.mip_levels = 1;
+  return CreateTexture(desc);
+}
+
+void UploadTextureAtlas(GLTexture &texture, TextureAtlas &atlas) {
+  GLenum format = PixelTransferFormat(atlas.GetFormat());
+  GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+  GLCall(glPixelStorei(GL_UNPACK_ROW_LENGTH, atlas.GetLayerWidth()));
+  for (u32 layer = 0; layer < atlas.GetLayerCount(); ++layer) {
+    if (!atlas.HasDirtyRegion(layer)) continue;
+    auto region = atlas.GetDirtyRegion(layer);
+    const auto &bitmap = atlas.GetLayer(layer).bitmap;
+    const auto *src =
+        bitmap.GetBitmapPtr() +
+        (((region.y * bitmap.GetWidth()) + region.x) * bitmap.BytesPerPixel());
+    GLCall(glTextureSubImage3D(texture.Id(), 0, region.x, region.y, layer,
+                               region.width, region.height, 1, format,
+                               GL_UNSIGNED_BYTE, src));
+    atlas.ClearDirtyRegion(layer);
+  }
+  GLCall(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
+  GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+}
+
 }  // namespace quixotism
@@ -1,5 +1,10 @@
 #pragma once
+#include <span>
+#include <vector>
+
 #include "bitmap/bitmap.hpp"
+#include "bitmap/mipmap.hpp"
+#include "bitmap/texture_atlas.hpp"
 #include "quixotism_c.hpp"
 
 namespace quixotism {
@@ -43,9 +48,21 @@ class GLTexture {
 };
 
 GLTexture CreateTexture(const TextureDesc &desc);
-GLTexture CreateTexture2D(const Bitmap &bitmap);
+// Uploads the bitmap with a full mip chain generated on the CPU
+GLTexture CreateTexture2D(const Bitmap &bitmap,
+                          const MipOptions &mip_options = {});
+// Uploads prepared mip levels, level 0 first, e.g. from CompressMipChain.
+// Levels may be block compressed.
+GLTexture CreateTexture2D(std::span<const Bitmap> levels);
 GLTexture CreateTexture(const Bitmap &bitmap, bool r8);
 GLTexture CreateTextureArray(const Bitmap **bitmap, size_t count, bool r8);
-GLTexture CreateCubeTexture(std::array<Bitmap, 6> &bitmaps);
+GLTexture CreateCubeTexture(std::array<Bitmap, 6> &bitmaps,
+                            const MipOptions &mip_options = {});
+// Cube map from prepared mip levels of every face, level 0 first
+GLTexture CreateCubeTexture(const std::array<std::vector<Bitmap>, 6> &levels);
+// Array texture with room for every layer the atlas can grow to
+GLTexture CreateAtlasTexture(const TextureAtlas &atlas);
+// Uploads the regions of the atlas layers that changed since the last upload
+void UploadTextureAtlas(GLTexture &texture, TextureAtlas &atlas);
 
 }  // namespace quixotism
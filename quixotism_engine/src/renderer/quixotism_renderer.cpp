@@ -1,5 +1,7 @@
 #include "quixotism_renderer.hpp"
 
+#include <span>
+
 #include "GL/glew.h"
 #include "GLM/glm.hpp"
 #include "GLM/gtc/type_ptr.hpp"
@@ -8,6 +10,9 @@
 #include "dbg_print.hpp"
 #include "file_processing/obj_parser/obj_parser.hpp"
 #include "gl_call.hpp"
+#include "mesh/cooked_mesh.hpp"
+#include "mesh/vertex_quantization.hpp"
+#include "utf8.hpp"
 #include "vertex_buffer_layout.hpp"
 
 namespace quixotism {
@@ -34,6 +39,16 @@ static ShaderID CreateBasicXYZAxesSader(ShaderManager &shader_mgr) {
   return shader_mgr.CreateShader("xyz_axes", shader_spec);
 }
 
+static std::pair<u32, u32> GetFontLayerDim(const FontSet &font_set) {
+  u32 width = 0, height = 0;
+  for (u32 idx = 0; idx < font_set.font_count; ++idx) {
+    const auto &bitmap = font_set.fonts[idx].GetBitmap();
+    width = Max(width, bitmap.GetWidth());
+    height = Max(height, bitmap.GetHeight());
+  }
+  return {width, height};
+}
+
 QuixotismRenderer::QuixotismRenderer() {
   auto dim = QuixotismEngine::GetEngine().GetWindowDim();
   GLCall(glViewport(0, 0, dim.width, dim.height));
@@ -51,10 +66,12 @@ QuixotismRenderer::QuixotismRenderer() {
   GLCall(glClearStencil(0));
   DBG_PRINT("Specified clear colors");
 
+  // static meshes: box quantized position, octahedral normal, half float
+  // texture coordinates, 16 bytes a vertex
   VertexBufferLayout layout;
-  layout.AddLayoutElementF(3, false, 0);
-  layout.AddLayoutElementF(3, false, 0);
-  layout.AddLayoutElementF(2, false, 0);
+  layout.AddLayoutElementBoxSnorm16(0);
+  layout.AddLayoutElementOctahedral(0);
+  layout.AddLayoutElementHF(2, 0);
   if (auto new_vao = vertex_array_mgr.Create(layout)) {
     vao_id = *new_vao;
   } else {
@@ -107,26 +124,34 @@ QuixotismRenderer::QuixotismRenderer() {
   screen_quad_shader_id = shader_mgr.CreateShader("screen_quad", shader_spec);
 
   CompileTextShader();
+  draw_text_queue.reserve(TEXT_QUEUE_INITIAL_CAPACITY);
   auto sampler = CreateSampler();
   sampler_id = sampler_mgr.Add(std::move(sampler));
   sampler_id2 = sampler_mgr.Add(CreateSampler2());
   cube_sampler = sampler_mgr.Add(CreateCubeSampler());
+  sdf_sampler = sampler_mgr.Add(CreateSDFSampler());
 
   for (auto &font_set : QuixotismEngine::GetEngine().font_mgr) {
-    auto [max_width, max_height] = font_set.fonts[4].GetBitmap().GetDim();
-    Bitmap bitmap_arr[4];
-    const Bitmap *bitmap_ptr_arr[5] = {};
-    bitmap_ptr_arr[4] = &font_set.fonts[4].GetBitmap();
-    for (u32 idx = 0; idx < (ArrayCount(FontSet::font_sizes) - 1); ++idx) {
-      auto &font = font_set.fonts[idx];
-      auto &bitmap = font.GetBitmap();
-      Bitmap tmp_bitmap{(u32)max_width, (u32)max_height, BitmapFormat::R8};
+    // every font of the set goes into one layer of the texture array, layers
+    // are sized to fit the biggest font bitmap (the packed bitmaps do not
+    // have to be square, so width and height are tracked separately)
+    auto [max_width, max_height] = GetFontLayerDim(font_set);
+    Bitmap bitmap_arr[ArrayCount(FontSet::font_sizes)];
+    const Bitmap *bitmap_ptr_arr[ArrayCount(FontSet::font_sizes)] = {};
+    for (u32 idx = 0; idx < font_set.font_count; ++idx) {
+      auto &bitmap = font_set.fonts[idx].GetBitmap();
+      if (bitmap.GetWidth() == max_width && bitmap.GetHeight() == max_height) {
+        bitmap_ptr_arr[idx] = &bitmap;
+        continue;
+      }
+      Bitmap tmp_bitmap{max_width, max_height, BitmapFormat::R8};
       CopyBitmap(bitmap, tmp_bitmap);
       bitmap_arr[idx] = std::move(tmp_bitmap);
       bitmap_ptr_arr[idx] = &bitmap_arr[idx];
     }
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    auto font_texture = CreateTextureArray(&bitmap_ptr_arr[0], 5, true);
+    auto font_texture =
+        CreateTextureArray(&bitmap_ptr_arr[0], font_set.font_count, true);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
     font_set.texture_id = texture_mgr.Add(std::move(font_texture));
   }
@@ -295,22 +320,26 @@ void QuixotismRenderer::CompileTextShader() {
   font_shader_id = shader_mgr.CreateShader("font_basic", shader_spec);
 }
 
-void QuixotismRenderer::PushText(std::string &&text, Vec2 position, r32 scale,
-                                 u32 layer, FontID font_id) {
-  PushText(std::move(text), position, Color::WHITE, scale, layer, font_id);
+void QuixotismRenderer::PushText(std::string_view text, Vec2 position,
+                                 r32 scale, u32 layer, FontID font_id) {
+  PushText(text, position, Color::WHITE, scale, layer, font_id);
 }
 
-void QuixotismRenderer::PushText(std::string &&text, Vec2 position, Vec3 color,
-                                 r32 scale, u32 layer, FontID font_id) {
+void QuixotismRenderer::PushText(std::string_view text, Vec2 position,
+                                 Vec3 color, r32 scale, u32 layer,
+                                 FontID font_id) {
   TextDrawInfo info;
-  info.text = std::move(text);
+  info.text = text;
   info.position = position;
   info.color = color;
   info.scale = scale;
   info.layer = layer;
   if (!font_id) font_id = QuixotismEngine::GetEngine().font_mgr.GetDefault();
   info.font_id = font_id;
-  draw_text_queue[font_id].push_back(std::move(info));
+  if (draw_text_queue.size() == draw_text_queue.capacity()) {
+    CountTextBufferGrowth();
+  }
+  draw_text_queue.push_back(info);
 }
 
 struct GlyphVert {
@@ -319,78 +348,160 @@ struct GlyphVert {
   r32 color[3];
 };
 
+// Writes the 6 verts (2 triangles) of a glyph quad, returns the vert past the
+// ones we wrote
+static GlyphVert *EmitGlyphQuad(GlyphVert *vert, r32 x, r32 y, r32 width,
+                                r32 height, const BitmapCoord &coord,
+                                const Vec2 &uv_adjust, r32 texture_layer,
+                                const Vec3 &color) {
+  const r32 u0 = coord.lower_left.x * uv_adjust.x;
+  const r32 v0 = coord.lower_left.y * uv_adjust.y;
+  const r32 u1 = coord.top_right.x * uv_adjust.x;
+  const r32 v1 = coord.top_right.y * uv_adjust.y;
+  // x, y, u, v per corner, tri1 then tri2
+  const r32 corners[6][4] = {
+      {x, y, u0, v0},
+      {x + width, y, u1, v0},
+      {x, y + height, u0, v1},
+      {x + width, y, u1, v0},
+      {x + width, y + height, u1, v1},
+      {x, y + height, u0, v1},
+  };
+  for (const auto &corner : corners) {
+    vert->pos[0] = corner[0];
+    vert->pos[1] = corner[1];
+    vert->coord[0] = corner[2];
+    vert->coord[1] = corner[3];
+    vert->coord[2] = texture_layer;
+    vert->color[0] = color[0];
+    vert->color[1] = color[1];
+    vert->color[2] = color[2];
+    ++vert;
+  }
+  return vert;
+}
+
 void QuixotismRenderer::DrawText(u32 layer) {
+  // we issue one draw per font, the batch for a font is drawn when we hit the
+  // first queued text that uses it
+  for (size_t idx = 0; idx < draw_text_queue.size(); ++idx) {
+    const auto &text_info = draw_text_queue[idx];
+    if (text_info.layer != layer) continue;
+    bool font_drawn = false;
+    for (size_t prev_idx = 0; prev_idx < idx; ++prev_idx) {
+      if (draw_text_queue[prev_idx].layer == layer &&
+          draw_text_queue[prev_idx].font_id == text_info.font_id) {
+        font_drawn = true;
+        break;
+      }
+    }
+    if (!font_drawn) DrawTextBatch(text_info.font_id, layer, idx);
+  }
+}
+
+void QuixotismRenderer::DrawTextBatch(FontID font_id, u32 layer,
+                                      size_t first_info_idx) {
   // for now we hard code that we use 6 verts per character (quad = 2
   // triangles) with 8 floats per vertex (x, y, u, v, z, r, g, b)
   static constexpr size_t vertex_size = 8 * sizeof(r32);
   static constexpr size_t verts_per_triangle = 3;
-  for (const auto &[font_id, text_queue] : draw_text_queue) {
-    // first compute the buffer size needed to store vertex data or all
-    // characters
-    // for all text to render
-    size_t char_count = 0;
-    auto count_characters_no_space = [](const std::string &str) {
-      size_t count = 0;
-      for (const auto &c : str) {
-        if (c != ' ') ++count;
-      }
-      return count;
-    };
-
-    for (const auto &text_info : text_queue) {
-      if (text_info.layer != layer) continue;
-      char_count += count_characters_no_space(text_info.text);
+  auto text_queue = std::span{draw_text_queue}.subspan(first_info_idx);
+  auto in_batch = [&](const TextDrawInfo &text_info) {
+    return text_info.layer == layer && text_info.font_id == font_id;
+  };
+  // first compute the buffer size needed to store vertex data or all
+  // characters
+  // for all text to render
+  size_t char_count = 0;
+  auto count_characters_no_space = [](std::string_view str) {
+    size_t count = 0;
+    for (const auto &c : str) {
+      if (c != ' ') ++count;
     }
+    return count;
+  };
 
-    size_t triangle_count = char_count * 2;
-    size_t vertex_count = triangle_count * verts_per_triangle;
-    size_t required_buffer_size = vertex_count * vertex_size;
-    if (required_buffer_size == 0) {
-      return;
-    }
+  for (const auto &text_info : text_queue) {
+    if (!in_batch(text_info)) continue;
+    char_count += count_characters_no_space(text_info.text);
+  }
 
-    if (cached_text_vert_buffer_size < required_buffer_size) {
-      size_t buffer_size = 512;
-      while (buffer_size < required_buffer_size) {
-        buffer_size <<= 1;
-      }
-      cached_text_vert_buffer = std::make_unique<u8[]>(buffer_size);
-      cached_text_vert_buffer_size = buffer_size;
+  size_t triangle_count = char_count * 2;
+  size_t vertex_count = triangle_count * verts_per_triangle;
+  size_t required_buffer_size = vertex_count * vertex_size;
+  if (required_buffer_size == 0) {
+    return;
+  }
+
+  if (cached_text_vert_buffer_size < required_buffer_size) {
+    size_t buffer_size = 512;
+    while (buffer_size < required_buffer_size) {
+      buffer_size <<= 1;
     }
+    cached_text_vert_buffer = std::make_unique<u8[]>(buffer_size);
+    cached_text_vert_buffer_size = buffer_size;
+    CountTextBufferGrowth();
+  }
 
-    Assert(cached_text_vert_buffer &&
-           cached_text_vert_buffer_size >= required_buffer_size);
-
-    // now we fill the vertex data buffer
-    auto *vert = reinterpret_cast<GlyphVert *>(cached_text_vert_buffer.get());
-    auto window_dim = QuixotismEngine::GetEngine().GetWindowDim();
-    for (const auto &text_info : text_queue) {
-      if (text_info.layer != layer) continue;
-      auto *font = QuixotismEngine::GetEngine().font_mgr.GetByFontScale(
-          text_info.font_id, text_info.scale);
-      auto font_idx = QuixotismEngine::GetEngine().font_mgr.GetFontIdxByScale(
-          text_info.font_id, text_info.scale);
-      r32 scale_adjust = text_info.scale / font->GetScale();
-      r32 position_x = text_info.position.x;
-      u32 codepoint = 0, prev_codepoint = 0;
-      r32 screen_scale_x = 2.0f / static_cast<r32>(window_dim.width);
-      r32 screen_scale_y = 2.0f / static_cast<r32>(window_dim.height);
-
-      // hardcoded for now becuase I am lazy...
-      r32 uv_adjust = font->GetBitmap().GetHeight() / 512.0f;
-
-      auto space_advance = font->GetSpaceAdvance() * text_info.scale;
-      for (const auto &c : text_info.text) {
-        codepoint = c;
-        if (codepoint == ' ') {
-          position_x += space_advance * screen_scale_x;
-          continue;
-        }
+  Assert(cached_text_vert_buffer &&
+         cached_text_vert_buffer_size >= required_buffer_size);
+
+  // now we fill the vertex data buffer
+  auto *vert_begin =
+      reinterpret_cast<GlyphVert *>(cached_text_vert_buffer.get());
+  auto *vert = vert_begin;
+  auto window_dim = QuixotismEngine::GetEngine().GetWindowDim();
+  r32 screen_scale_x = 2.0f / static_cast<r32>(window_dim.width);
+  r32 screen_scale_y = 2.0f / static_cast<r32>(window_dim.height);
+  auto *font_set = QuixotismEngine::GetEngine().font_mgr.Get(font_id);
+  Assert(font_set);
+  // the baked ASCII atlas draws '!'..'~', font sets with a glyph cache draw
+  // every other codepoint from the cache page. Atlas quads fill the buffer
+  // from the front and cache quads from the back, so each source is one
+  // range we draw with its own texture.
+  auto *glyph_cache = font_set->glyph_cache.get();
+  if (glyph_cache) glyph_cache->BeginBatch();
+  auto *const vert_end = vert_begin + vertex_count;
+  auto *cached_vert = vert_end;
+  // texture array layers are sized to fit the biggest font bitmap of the set,
+  // smaller fonts only cover part of their layer
+  auto [layer_width, layer_height] = GetFontLayerDim(*font_set);
+  for (const auto &text_info : text_queue) {
+    if (!in_batch(text_info)) continue;
+    auto *font = QuixotismEngine::GetEngine().font_mgr.GetByFontScale(
+        text_info.font_id, text_info.scale);
+    auto font_idx = QuixotismEngine::GetEngine().font_mgr.GetFontIdxByScale(
+        text_info.font_id, text_info.scale);
+    r32 scale_adjust = text_info.scale / font->GetScale();
+    r32 cache_scale_adjust =
+        glyph_cache ? text_info.scale / glyph_cache->GetScale() : 0.0F;
+    // origin of the previous glyph, advances are added once we know the next
+    // codepoint so atlas pairs can use their kerning table
+    r32 position_x = text_info.position.x;
+    u32 prev_codepoint = 0;
+    bool prev_cached = false;
+    r32 prev_advance = 0;
+
+    auto [font_width, font_height] = font->GetBitmap().GetDim();
+    Vec2 uv_adjust{static_cast<r32>(font_width) / layer_width,
+                   static_cast<r32>(font_height) / layer_height};
+
+    auto space_advance = font->GetSpaceAdvance() * text_info.scale;
+    const char *it = text_info.text.data();
+    const char *end = it + text_info.text.size();
+    while (it != end) {
+      auto codepoint = DecodeUTF8(it, end);
+      if (codepoint == ' ') {
+        position_x += space_advance * screen_scale_x;
+        continue;
+      }
+      if (codepoint >= Font::CODEPOINT_START &&
+          codepoint <= Font::CODEPOINT_END) {
         auto &coord = font->GetCodepointBitmapCoord(codepoint);
-
         auto &glyph_info = font->GetGlyphInfo(codepoint);
-        auto glyph_width = (static_cast<r32>(glyph_info.width) * scale_adjust) *
-                           screen_scale_x;
+        auto glyph_width =
+            (static_cast<r32>(glyph_info.width) * scale_adjust) *
+            screen_scale_x;
         auto glyph_height =
             (static_cast<r32>(glyph_info.height) * scale_adjust) *
             screen_scale_y;
@@ -398,129 +509,174 @@ void QuixotismRenderer::DrawText(u32 layer) {
             (static_cast<r32>(glyph_info.height + glyph_info.baseline_offset) *
              scale_adjust);
 
-        position_x = position_x +
-                     ((font->GetHorizontalAdvance(codepoint, prev_codepoint) *
-                       scale_adjust) *
-                      screen_scale_x);
+        if (prev_codepoint && !prev_cached) {
+          position_x +=
+              (font->GetHorizontalAdvance(codepoint, prev_codepoint) *
+               scale_adjust) *
+              screen_scale_x;
+        } else {
+          position_x += prev_advance;
+        }
         auto position_y =
             text_info.position.y - (baseline_offset * screen_scale_y);
-        // tri1
-        vert[0].pos[0] = position_x;
-        vert[0].pos[1] = position_y;
-        vert[0].coord[0] = coord.lower_left.x * uv_adjust;
-        vert[0].coord[1] = coord.lower_left.y * uv_adjust;
-        vert[0].coord[2] = font_idx;
-        vert[0].color[0] = text_info.color[0];
-        vert[0].color[1] = text_info.color[1];
-        vert[0].color[2] = text_info.color[2];
-
-        vert[1].pos[0] = position_x + glyph_width;
-        vert[1].pos[1] = position_y;
-        vert[1].coord[0] = coord.top_right.x * uv_adjust;
-        vert[1].coord[1] = coord.lower_left.y * uv_adjust;
-        vert[1].coord[2] = font_idx;
-        vert[1].color[0] = text_info.color[0];
-        vert[1].color[1] = text_info.color[1];
-        vert[1].color[2] = text_info.color[2];
-
-        vert[2].pos[0] = position_x;
-        vert[2].pos[1] = position_y + glyph_height;
-        vert[2].coord[0] = coord.lower_left.x * uv_adjust;
-        vert[2].coord[1] = coord.top_right.y * uv_adjust;
-        vert[2].coord[2] = font_idx;
-        vert[2].color[0] = text_info.color[0];
-        vert[2].color[1] = text_info.color[1];
-        vert[2].color[2] = text_info.color[2];
-
-        // tri2
-        vert[3].pos[0] = position_x + glyph_width;
-        vert[3].pos[1] = position_y;
-        vert[3].coord[0] = coord.top_right.x * uv_adjust;
-        vert[3].coord[1] = coord.lower_left.y * uv_adjust;
-        vert[3].coord[2] = font_idx;
-        vert[3].color[0] = text_info.color[0];
-        vert[3].color[1] = text_info.color[1];
-        vert[3].color[2] = text_info.color[2];
-
-        vert[4].pos[0] = position_x + glyph_width;
-        vert[4].pos[1] = position_y + glyph_height;
-        vert[4].coord[0] = coord.top_right.x * uv_adjust;
-        vert[4].coord[1] = coord.top_right.y * uv_adjust;
-        vert[4].coord[2] = font_idx;
-        vert[4].color[0] = text_info.color[0];
-        vert[4].color[1] = text_info.color[1];
-        vert[4].color[2] = text_info.color[2];
-
-        vert[5].pos[0] = position_x;
-        vert[5].pos[1] = position_y + glyph_height;
-        vert[5].coord[0] = coord.lower_left.x * uv_adjust;
-        vert[5].coord[1] = coord.top_right.y * uv_adjust;
-        vert[5].coord[2] = font_idx;
-        vert[5].color[0] = text_info.color[0];
-        vert[5].color[1] = text_info.color[1];
-        vert[5].color[2] = text_info.color[2];
-
-        prev_codepoint = codepoint;
-        vert += 6;  // go over the 6 verticies we just wrote
-      }
-    }
-
-    // potentially create buffer on gpu (if we did not have one already)
-    if (!text_vbo_id) {
-      if (auto id = gl_buffer_mgr.Create()) {
-        text_vbo_id = id;
-      } else {
-        Assert(0);
-      }
-    }
-
-    // if no font vao, create one
-    if (!text_vao) {
-      VertexBufferLayout font_vao_layout;
-      font_vao_layout.AddLayoutElementF(2, false, 0);
-      font_vao_layout.AddLayoutElementF(3, false, 0);
-      font_vao_layout.AddLayoutElementF(3, false, 0);
-      if (auto vao_id = vertex_array_mgr.Create(font_vao_layout)) {
-        text_vao = *vao_id;
+        auto glyph_x = position_x + ((static_cast<r32>(glyph_info.x_offset) *
+                                      scale_adjust) *
+                                     screen_scale_x);
+        vert = EmitGlyphQuad(vert, glyph_x, position_y, glyph_width,
+                             glyph_height, coord, uv_adjust,
+                             static_cast<r32>(font_idx), text_info.color);
+        prev_advance = (glyph_info.h_advance * scale_adjust) * screen_scale_x;
+        prev_cached = false;
+      } else if (glyph_cache) {
+        auto *glyph = glyph_cache->GetGlyph(codepoint);
+        if (!glyph) continue;
+        position_x += prev_advance;
+        if (prev_cached) {
+          position_x += glyph_cache->GetKerning(prev_codepoint, codepoint) *
+                        cache_scale_adjust * screen_scale_x;
+        }
+        if (glyph->shelf_idx != CachedGlyph::NO_SHELF) {
+          auto glyph_x = position_x + ((static_cast<r32>(glyph->x_offset) *
+                                        cache_scale_adjust) *
+                                       screen_scale_x);
+          auto baseline_offset =
+              static_cast<r32>(glyph->height + glyph->baseline_offset) *
+              cache_scale_adjust;
+          auto position_y =
+              text_info.position.y - (baseline_offset * screen_scale_y);
+          cached_vert -= 6;
+          EmitGlyphQuad(cached_vert, glyph_x, position_y,
+                        (static_cast<r32>(glyph->width) * cache_scale_adjust) *
+                            screen_scale_x,
+                        (static_cast<r32>(glyph->height) *
+                         cache_scale_adjust) *
+                            screen_scale_y,
+                        glyph->coord, Vec2{1.0F, 1.0F}, 0.0F,
+                        text_info.color);
+        }
+        prev_advance =
+            (glyph->h_advance * cache_scale_adjust) * screen_scale_x;
+        prev_cached = true;
       } else {
-        Assert(0);
+        // no glyph for it
+        continue;
       }
+      prev_codepoint = codepoint;
     }
+  }
+  Assert(vert <= cached_vert);
+  // multi byte codepoints, whitespace and dropped glyphs leave a gap between
+  // the two ranges
+  const auto atlas_vertex_count = static_cast<size_t>(vert - vert_begin);
+  const auto cached_first_vertex =
+      static_cast<size_t>(cached_vert - vert_begin);
+  const auto cached_vertex_count = static_cast<size_t>(vert_end - cached_vert);
+  if (atlas_vertex_count == 0 && cached_vertex_count == 0) {
+    return;
+  }
 
-    auto vbo = gl_buffer_mgr.Get(text_vbo_id);
-    if (!vbo) {
+  // potentially create buffer on gpu (if we did not have one already)
+  if (!text_vbo_id) {
+    if (auto id = gl_buffer_mgr.Create()) {
+      text_vbo_id = id;
+    } else {
       Assert(0);
     }
-    // send vert data to gpu
-    GLBufferData(*vbo, cached_text_vert_buffer.get(),
-                 cached_text_vert_buffer_size, BufferDataMode::STATIC_DRAW);
+  }
 
-    // bind vert buffer
-    auto vao = vertex_array_mgr.Get(text_vao);
-    if (!vao) {
+  // if no font vao, create one
+  if (!text_vao) {
+    VertexBufferLayout font_vao_layout;
+    font_vao_layout.AddLayoutElementF(2, false, 0);
+    font_vao_layout.AddLayoutElementF(3, false, 0);
+    font_vao_layout.AddLayoutElementF(3, false, 0);
+    if (auto vao_id = vertex_array_mgr.Create(font_vao_layout)) {
+      text_vao = *vao_id;
+    } else {
       Assert(0);
     }
+  }
 
-    BindVertexBufferToVertexArray(*vao, *vbo, 0);
-    BindVertexArray(*vao);
-    // setup shader
-    auto *font_shader = shader_mgr.Get(font_shader_id);
-    Assert(font_shader);
-    GLCall(glUseProgram((*font_shader).id));
-    auto *font_texture = texture_mgr.Get(
-        QuixotismEngine::GetEngine().font_mgr.Get(font_id)->texture_id);
+  auto vbo = gl_buffer_mgr.Get(text_vbo_id);
+  if (!vbo) {
+    Assert(0);
+  }
+  // send vert data to gpu
+  GLBufferData(*vbo, cached_text_vert_buffer.get(),
+               cached_text_vert_buffer_size, BufferDataMode::STATIC_DRAW);
+
+  // bind vert buffer
+  auto vao = vertex_array_mgr.Get(text_vao);
+  if (!vao) {
+    Assert(0);
+  }
+
+  BindVertexBufferToVertexArray(*vao, *vbo, 0);
+  BindVertexArray(*vao);
+  // setup shader
+  auto *font_shader = shader_mgr.Get(font_shader_id);
+  Assert(font_shader);
+  GLCall(glUseProgram((*font_shader).id));
+  font_shader->SetUniform("tex_sampler", 0);
+  auto draw_range = [&](GLTextureID texture_id, FontRasterMode mode,
+                        size_t first, size_t count) {
+    auto *font_texture = texture_mgr.Get(texture_id);
+    Assert(font_texture);
     font_texture->BindUnit(0);
-    auto *sampler = sampler_mgr.Get(sampler_id);
-    font_shader->SetUniform("tex_sampler", 0);
+    bool sdf = mode == FontRasterMode::SDF;
+    // distance fields need filtering to reconstruct the glyph edge
+    auto *sampler = sampler_mgr.Get(sdf ? sdf_sampler : sampler_id);
+    font_shader->SetUniform("sdf", sdf ? 1 : 0);
     GLCall(glBindSampler(0, sampler->Id()));
+    GLCall(glDrawArrays(GL_TRIANGLES, static_cast<GLint>(first),
+                        static_cast<GLsizei>(count)));
+  };
+
+  // draw call
+  // disable depth testing for screen text rendering
+  GLCall(glDepthMask(GL_FALSE));
+  if (atlas_vertex_count) {
+    draw_range(font_set->texture_id, font_set->mode, 0, atlas_vertex_count);
+  }
+  if (cached_vertex_count) {
+    draw_range(UploadGlyphCachePage(*font_set), glyph_cache->GetMode(),
+               cached_first_vertex, cached_vertex_count);
+  }
+  // enable depth testing back again
+  GLCall(glDepthMask(GL_TRUE));
+}
 
-    // draw call
-    // disable depth testing for screen text rendering
-    GLCall(glDepthMask(GL_FALSE));
-    GLCall(glDrawArrays(GL_TRIANGLES, 0, vertex_count));
-    // enable depth testing back again
-    GLCall(glDepthMask(GL_TRUE));
+GLTextureID QuixotismRenderer::UploadGlyphCachePage(FontSet &font_set) {
+  auto &glyph_cache = *font_set.glyph_cache;
+  const auto &page = glyph_cache.GetPage();
+  if (!font_set.glyph_cache_texture_id) {
+    TextureDesc desc;
+    desc.type = TextureType::TEXTURE_2D_ARRAY;
+    desc.width = page.GetWidth();
+    desc.height = page.GetHeight();
+    desc.format = BitmapFormat::R8;
+    desc.count = 1;
+    desc.mip_levels = 1;
+    font_set.glyph_cache_texture_id = texture_mgr.CreateTexture(desc);
   }
+  auto *texture = texture_mgr.Get(font_set.glyph_cache_texture_id);
+  Assert(texture);
+
+  // only the part of the page that changed since the last upload gets sent
+  if (glyph_cache.HasDirtyRegion()) {
+    auto region = glyph_cache.GetDirtyRegion();
+    const auto *src =
+        page.GetBitmapPtr() + (region.y * page.GetWidth()) + region.x;
+    GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+    GLCall(glPixelStorei(GL_UNPACK_ROW_LENGTH, page.GetWidth()));
+    GLCall(glTextureSubImage3D(texture->Id(), 0, region.x, region.y, 0,
+                               region.width, region.height, 1, GL_RED,
+                               GL_UNSIGNED_BYTE, src));
+    GLCall(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
+    GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+    glyph_cache.ClearDirtyRegion();
+  }
+  return font_set.glyph_cache_texture_id;
 }
 
 void QuixotismRenderer::PrepareDrawStaticMeshes() {
@@ -620,11 +776,48 @@ void QuixotismRenderer::DrawAABB(const StaticMeshId sm_id,
 void QuixotismRenderer::DrawStaticMesh(const StaticMeshId sm_id,
                                        const MaterialID mat_id,
                                        const Transform &transform,
-                                       bool selected) {
+                                       bool selected, u32 lod) {
   auto &engine = QuixotismEngine::GetEngine();
   auto *sm = engine.static_mesh_mgr.Get(sm_id);
+  Assert(sm);
+  auto ebo = gl_buffer_mgr.Get(sm->ebo_id);
+  Assert(ebo);
+  const auto &indexed = sm->GetIndexedMesh();
+  auto range = indexed.lods[Min(lod, indexed.LodCount() - 1)];
+  DrawStaticMeshIndices(*sm, mat_id, transform, selected, *ebo,
+                        range.first_index, range.index_count);
+}
+
+void QuixotismRenderer::DrawStaticMeshTriangles(
+    const StaticMeshId sm_id, const MaterialID mat_id,
+    const Transform &transform, bool selected, std::span<const u32> indices) {
+  auto &engine = QuixotismEngine::GetEngine();
+  auto *sm = engine.static_mesh_mgr.Get(sm_id);
+  Assert(sm);
+  if (!streamed_ebo_id) {
+    streamed_ebo_id = gl_buffer_mgr.Create();
+    Assert(streamed_ebo_id);
+  }
+  auto ebo = gl_buffer_mgr.Get(streamed_ebo_id);
+  Assert(ebo);
+  // a new data store each draw, so the driver does not have to wait for the
+  // previous draw to finish reading the old one
+  GLBufferData(*ebo, indices.data(), indices.size_bytes(),
+               BufferDataMode::STREAM_DRAW);
+  DrawStaticMeshIndices(*sm, mat_id, transform, selected, *ebo, 0,
+                        static_cast<u32>(indices.size()));
+}
+
+void QuixotismRenderer::DrawStaticMeshIndices(StaticMesh &sm,
+                                              const MaterialID mat_id,
+                                              const Transform &transform,
+                                              bool selected,
+                                              const GLBuffer &ebo,
+                                              u32 first_index,
+                                              u32 index_count) {
+  auto &engine = QuixotismEngine::GetEngine();
   auto *mat = engine.material_mgr.Get(mat_id);
-  Assert(sm && mat);
+  Assert(mat);
 
   auto shader = shader_mgr.Get(mat->GetShaderId());
   if (!shader) {
@@ -641,24 +834,25 @@ void QuixotismRenderer::DrawStaticMesh(const StaticMeshId sm_id,
   GLCall(glBindSampler(0, sampler->Id()));
 
   shader->SetUniform("model", transform.GetTransformMatrix());
+  auto box = MakeQuantizationBox(sm.GetMeshData().bbox);
+  shader->SetUniform("position_center", box.center);
+  shader->SetUniform("position_half_extent", box.half_extent);
 
-  auto vao = vertex_array_mgr.Get(sm->vao_id);
-  auto vbo = gl_buffer_mgr.Get(sm->vbo_id);
-  auto ebo = gl_buffer_mgr.Get(sm->ebo_id);
-  if (!vbo || !ebo || !vao) {
+  auto vao = vertex_array_mgr.Get(sm.vao_id);
+  auto vbo = gl_buffer_mgr.Get(sm.vbo_id);
+  if (!vbo || !vao) {
     Assert(0);
   }
   BindVertexArray(*vao);
-  BindVertexBufferToVertexArray(*vao, *vbo, *ebo, 0);
+  BindVertexBufferToVertexArray(*vao, *vbo, ebo, 0);
 
   if (selected) {
     GLCall(glEnable(GL_STENCIL_TEST));
     GLCall(glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE));
     GLCall(glStencilFunc(GL_ALWAYS, 1, 0xFF));
   }
-  GLCall(glDrawElements(GL_TRIANGLES,
-                        sm->GetMeshData().VertexTriangleIndicies.PosIdx.size(),
-                        GL_UNSIGNED_INT, 0));
+  GLCall(glDrawElements(GL_TRIANGLES, index_count, GL_UNSIGNED_INT,
+                        reinterpret_cast<void *>(first_index * sizeof(u32))));
   GLCall(glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP));
 }
 
@@ -866,45 +1060,55 @@ void QuixotismRenderer::MakeDrawableStaticMesh(StaticMeshId id) {
   auto sm_mesh = engine.static_mesh_mgr.Get(id);
   if (!sm_mesh) return;
 
+  auto vao = *vertex_array_mgr.Get(vao_id);
+  auto &indexed = sm_mesh->GetIndexedMesh();
+  auto [vertex_buffer, vertex_buffer_size] =
+      SerializeIndexedVertices(sm_mesh->GetMeshData(), indexed, vao.layout);
+  UploadStaticMesh(*sm_mesh, vertex_buffer.get(), vertex_buffer_size,
+                   indexed.indices.data(), indexed.IndexCount() * sizeof(u32));
+}
+
+bool QuixotismRenderer::MakeDrawableStaticMesh(StaticMeshId id,
+                                               const CookedMeshView &cooked) {
+  auto &engine = QuixotismEngine::GetEngine();
+  auto sm_mesh = engine.static_mesh_mgr.Get(id);
+  if (!sm_mesh) return false;
+
+  auto vao = *vertex_array_mgr.Get(vao_id);
+  if (!CookedLayoutMatches(*cooked.header, vao.layout)) return false;
+  UploadStaticMesh(*sm_mesh, cooked.vertex_data.data(),
+                   cooked.vertex_data.size(), cooked.indices.data(),
+                   cooked.indices.size_bytes());
+  return true;
+}
+
+void QuixotismRenderer::UploadStaticMesh(StaticMesh &sm_mesh,
+                                         const void *vertices,
+                                         size_t vertices_size,
+                                         const void *indices,
+                                         size_t indices_size) {
   auto vbo_id = gl_buffer_mgr.Create();
   auto bb_vbo_id = gl_buffer_mgr.Create();
   auto ebo_id = gl_buffer_mgr.Create();
   if (vbo_id && ebo_id && bb_vbo_id) {
-    sm_mesh->vbo_id = vbo_id;
-    sm_mesh->ebo_id = ebo_id;
-    sm_mesh->bb_vbo_id = bb_vbo_id;
+    sm_mesh.vbo_id = vbo_id;
+    sm_mesh.ebo_id = ebo_id;
+    sm_mesh.bb_vbo_id = bb_vbo_id;
   } else {
     Assert(0);
   }
+  sm_mesh.vao_id = vao_id;
 
-  auto vao = *vertex_array_mgr.Get(vao_id);
-  sm_mesh->vao_id = vao_id;
-
-  auto &mesh = sm_mesh->GetMeshData();
-  std::vector<void *> vertex_data_buffers = {mesh.VertexPosData.data(),
-                                             mesh.VertexNormalData.data(),
-                                             mesh.VertexTexCoordData.data()};
-  std::vector<u32 *> vertex_index_buffers = {
-      mesh.VertexTriangleIndicies.PosIdx.data(),
-      mesh.VertexTriangleIndicies.NormalIdx.data(),
-      mesh.VertexTriangleIndicies.TexCoordIdx.data()};
-  auto vertex_count = mesh.VertexTriangleIndicies.PosIdx.size();
-
-  auto [vertex_buffer, vertex_buffer_size] = SerializeVertexDataByLayout(
-      vertex_data_buffers, vertex_index_buffers, vertex_count, vao.layout);
-  auto index_buffer = GenerateSerialIndexBuffer(vertex_count);
-  size_t index_buffer_size = vertex_count * sizeof(u32);
-
-  auto [bb_buffer, bb_buffer_size] = CreateAABBVertexBuffer(mesh.bbox);
+  auto [bb_buffer, bb_buffer_size] =
+      CreateAABBVertexBuffer(sm_mesh.GetMeshData().bbox);
 
-  auto vbo_buf = gl_buffer_mgr.Get(sm_mesh->vbo_id);
-  auto ebo_buf = gl_buffer_mgr.Get(sm_mesh->ebo_id);
-  auto bb_vbo_buf = gl_buffer_mgr.Get(sm_mesh->bb_vbo_id);
+  auto vbo_buf = gl_buffer_mgr.Get(sm_mesh.vbo_id);
+  auto ebo_buf = gl_buffer_mgr.Get(sm_mesh.ebo_id);
+  auto bb_vbo_buf = gl_buffer_mgr.Get(sm_mesh.bb_vbo_id);
   if (vbo_buf && ebo_buf && bb_vbo_buf) {
-    GLBufferData(*vbo_buf, vertex_buffer.get(), vertex_buffer_size,
-                 BufferDataMode::STATIC_DRAW);
-    GLBufferData(*ebo_buf, index_buffer.get(), index_buffer_size,
+    GLBufferData(*vbo_buf, vertices, vertices_size,
                  BufferDataMode::STATIC_DRAW);
+    GLBufferData(*ebo_buf, indices, indices_size, BufferDataMode::STATIC_DRAW);
     GLBufferData(*bb_vbo_buf, bb_buffer.get(), bb_buffer_size,
                  BufferDataMode::STATIC_DRAW);
   } else {
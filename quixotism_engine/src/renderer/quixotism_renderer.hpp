@@ -1,6 +1,8 @@
 #pragma once
 #include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "core/font_manager.hpp"
@@ -19,8 +21,12 @@
 
 namespace quixotism {
 
+struct CookedMeshView;
+
 struct TextDrawInfo {
-  std::string text;
+  // points into the engines per-frame text arena, only valid until the text
+  // buffer gets cleared at the end of the frame
+  std::string_view text;
   Vec2 position;
   Vec3 color;
   r32 scale;
@@ -28,6 +34,14 @@ struct TextDrawInfo {
   FontID font_id;
 };
 
+struct TextRenderStats {
+  // times the text draw queue or the text vertex buffer had to grow during
+  // the last finished frame, should be 0 in steady state. Only these two
+  // buffers are counted, not every heap allocation on the text path.
+  u32 frame_buffer_growths = 0;
+  u64 total_buffer_growths = 0;
+};
+
 class QuixotismRenderer {
  public:
   CLASS_DELETE_COPY(QuixotismRenderer);
@@ -39,19 +53,30 @@ class QuixotismRenderer {
 
   void ClearFramebuffer();
 
-  void PushText(std::string&& text, Vec2 position, r32 scale, u32 layer,
+  void PushText(std::string_view text, Vec2 position, r32 scale, u32 layer,
                 FontID font_id);
-  void PushText(std::string&& text, Vec2 position, Vec3 color, r32 scale,
+  void PushText(std::string_view text, Vec2 position, Vec3 color, r32 scale,
                 u32 layer, FontID font_id);
   void DrawText(u32 layer);
 
   void DrawSkybox();
 
   void PrepareDrawStaticMeshes();
+  // Draws the triangles of one level of detail, 0 is the full mesh
   void DrawStaticMesh(const StaticMeshId sm_id, const MaterialID mat_id,
-                      const Transform& transform, bool selected = false);
+                      const Transform& transform, bool selected = false,
+                      u32 lod = 0);
+  // Draws the given triangles of the full mesh, indices into its vertex
+  // buffer, streamed to the GPU for this draw only (see core/meshlet_culler)
+  void DrawStaticMeshTriangles(const StaticMeshId sm_id,
+                               const MaterialID mat_id,
+                               const Transform& transform, bool selected,
+                               std::span<const u32> indices);
 
   void MakeDrawableStaticMesh(StaticMeshId id);
+  // Uploads the buffers of a cooked mesh as they are, false if they were
+  // cooked with another vertex layout
+  bool MakeDrawableStaticMesh(StaticMeshId id, const CookedMeshView& cooked);
   void MakeDrawableStaticMesh2(StaticMeshId id, VertexArrayID vao_id);
 
   void DrawXYZAxesOverlay();
@@ -60,7 +85,12 @@ class QuixotismRenderer {
   void DrawTerminal(const StaticMeshId sm_id, const MaterialID mat_id,
                     const Transform& transform);
 
-  void ClearTextBuffer() { draw_text_queue.clear(); }
+  void ClearTextBuffer() {
+    draw_text_queue.clear();
+    text_stats.frame_buffer_growths = frame_text_buffer_growths;
+    frame_text_buffer_growths = 0;
+  }
+  const TextRenderStats& GetTextStats() const { return text_stats; }
 
   void BindScreenFramebuffer();
 
@@ -75,9 +105,11 @@ class QuixotismRenderer {
 
   VertexArrayID vao_id = 0, text_vao = 0;
   GLBufferID text_vbo_id = 0;
+  // index buffer for the triangles DrawStaticMeshTriangles gets each frame
+  GLBufferID streamed_ebo_id = 0;
   ShaderID shader_id, font_shader_id, screen_quad_shader_id;
   SamplerID sampler_id;
-  SamplerID sampler_id2, cube_sampler;
+  SamplerID sampler_id2, cube_sampler, sdf_sampler;
 
   ShaderManager shader_mgr;
   GLTextureManager texture_mgr;
@@ -89,8 +121,29 @@ class QuixotismRenderer {
   QuixotismRenderer();
 
   void CompileTextShader();
+  void DrawStaticMeshIndices(StaticMesh& sm, const MaterialID mat_id,
+                             const Transform& transform, bool selected,
+                             const GLBuffer& ebo, u32 first_index,
+                             u32 index_count);
+  void UploadStaticMesh(StaticMesh& sm_mesh, const void* vertices,
+                        size_t vertices_size, const void* indices,
+                        size_t indices_size);
+  void DrawTextBatch(FontID font_id, u32 layer, size_t first_info_idx);
+  // uploads the dirty part of the glyph cache page (creating the texture on
+  // first use) and returns the texture
+  GLTextureID UploadGlyphCachePage(FontSet& font_set);
+  void CountTextBufferGrowth() {
+    ++frame_text_buffer_growths;
+    ++text_stats.total_buffer_growths;
+  }
+
+  static constexpr size_t TEXT_QUEUE_INITIAL_CAPACITY = 256;
 
-  std::unordered_map<u64, std::vector<TextDrawInfo>> draw_text_queue;
+  // flat queue (instead of a per-font map) so that clearing it every frame
+  // keeps the capacity around
+  std::vector<TextDrawInfo> draw_text_queue;
+  TextRenderStats text_stats;
+  u32 frame_text_buffer_growths = 0;
 
   std::unique_ptr<u8[]> cached_text_vert_buffer;
   size_t cached_text_vert_buffer_size = 0;
@@ -65,7 +65,7 @@ class ShaderManager : public BucketArray<Shader> {
 
   ShaderID CreateShader(const std::string &name, const ShaderStageSpec &spec);
 
-  [[no_discard]] ShaderID GetByName(const std::string &name);
+  [[nodiscard]] ShaderID GetByName(const std::string &name);
 
  private:
   struct GLStage {
@@ -37,10 +37,10 @@ class VertexArrayManager {
     return *this;
   }
 
-  [[no_discard]] std::optional<VertexArrayID> Create(
+  [[nodiscard]] std::optional<VertexArrayID> Create(
       const VertexBufferLayout &layout);
-  [[no_discard]] std::optional<VertexArray> Get(VertexArrayID id) const;
-  [[no_discard]] bool Exists(const VertexArrayID id) const;
+  [[nodiscard]] std::optional<VertexArray> Get(VertexArrayID id) const;
+  [[nodiscard]] bool Exists(const VertexArrayID id) const;
   void Destroy(const VertexArrayID id);
 
   ~VertexArrayManager();
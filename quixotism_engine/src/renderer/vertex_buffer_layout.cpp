@@ -2,6 +2,12 @@
 
 #include <GL/glew.h>
 
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "thread_pool.hpp"
+
 namespace quixotism {
 
 void VertexBufferLayout::AddLayoutElementF(u32 count, bool normalize,
@@ -9,34 +15,124 @@ void VertexBufferLayout::AddLayoutElementF(u32 count, bool normalize,
   AddLayoutElement(count, normalize, GL_FLOAT, sizeof(GLfloat), binding_slot);
 }
 
+void VertexBufferLayout::AddLayoutElementHF(u32 count, u32 binding_slot) {
+  AddLayoutElement(count, false, GL_HALF_FLOAT, sizeof(GLhalf), binding_slot,
+                   VertexEncoding::HALF);
+}
+
+void VertexBufferLayout::AddLayoutElementOctahedral(u32 binding_slot) {
+  AddLayoutElement(2, true, GL_SHORT, sizeof(GLshort), binding_slot,
+                   VertexEncoding::OCTAHEDRAL_SNORM16);
+}
+
+void VertexBufferLayout::AddLayoutElementBoxSnorm16(u32 binding_slot) {
+  AddLayoutElement(4, true, GL_SHORT, sizeof(GLshort), binding_slot,
+                   VertexEncoding::BOX_SNORM16);
+}
+
+bool VertexBufferLayout::IsFloatOnly() const {
+  return std::ranges::all_of(elements, [](const auto &element) {
+    return element.encoding == VertexEncoding::FLOAT;
+  });
+}
+
 void VertexBufferLayout::AddLayoutElement(u32 count, bool normalize, u32 type,
-                                          size_t type_size, u32 binding_slot) {
+                                          size_t type_size, u32 binding_slot,
+                                          VertexEncoding encoding) {
   elements.emplace_back(type, type_size, count, stride, normalize,
-                        binding_slot);
+                        binding_slot, encoding);
   stride += type_size * count;
 }
 
-std::pair<std::unique_ptr<u8[]>, size_t> SerializeVertexDataByLayout(
-    const std::vector<void *> &vertex_data_buffers,
-    const std::vector<u32 *> &vertex_index_buffers, u32 vertex_count,
-    const VertexBufferLayout &layout) {
-  size_t vert_size = 0;
-  for (const auto &element : layout.GetLayoutElements()) {
-    vert_size += element.count * element.type_size;
+// Interleaves the vertices [begin, end) for a float layout with the element
+// counts COUNTS, known at compile time so every copy is a fixed number of
+// loads and stores the compiler unrolls
+template <u32... COUNTS>
+static void InterleaveFloats(const void *const *vertex_data_buffers,
+                             const u32 *const *vertex_index_buffers,
+                             size_t begin, size_t end, u8 *dst) {
+  constexpr u32 counts[] = {COUNTS...};
+  constexpr u32 stride = (COUNTS + ...) * sizeof(r32);
+  dst += begin * stride;
+  for (size_t i = begin; i < end; ++i, dst += stride) {
+    u8 *element_dst = dst;
+    [&]<size_t... J>(std::index_sequence<J...>) {
+      ((std::memcpy(element_dst,
+                    static_cast<const r32 *>(vertex_data_buffers[J]) +
+                        size_t{vertex_index_buffers[J][i]} * counts[J],
+                    counts[J] * sizeof(r32)),
+        element_dst += counts[J] * sizeof(r32)),
+       ...);
+    }(std::make_index_sequence<sizeof...(COUNTS)>{});
   }
-  size_t size = vert_size * vertex_count;
-  auto buffer = std::make_unique<u8[]>(size);
-  auto dst = buffer.get();
-  auto &elements = layout.GetLayoutElements();
-  for (u32 i = 0; i < vertex_count; ++i) {
-    for (auto j = 0; j < layout.GetLayoutElements().size(); ++j) {
-      auto src = (static_cast<r32 *>(vertex_data_buffers[j])) +
-                 (*(vertex_index_buffers[j] + i) * elements[j].count);
+}
+
+// any other float layout, element by element
+static void InterleaveFloats(const void *const *vertex_data_buffers,
+                             const u32 *const *vertex_index_buffers,
+                             const VertexBufferLayout &layout, size_t begin,
+                             size_t end, u8 *dst) {
+  const auto &elements = layout.GetLayoutElements();
+  const auto stride = layout.GetStride();
+  dst += begin * stride;
+  for (size_t i = begin; i < end; ++i) {
+    for (size_t j = 0; j < elements.size(); ++j) {
+      auto src = static_cast<const r32 *>(vertex_data_buffers[j]) +
+                 size_t{vertex_index_buffers[j][i]} * elements[j].count;
       size_t copy_size = elements[j].count * sizeof(r32);
       std::memcpy(dst, src, copy_size);
       dst += copy_size;
     }
   }
+}
+
+using InterleaveKernel = void (*)(const void *const *, const u32 *const *,
+                                  size_t, size_t, u8 *);
+
+// the kernel specialized for the element counts of the layout, if there is one
+static InterleaveKernel GetInterleaveKernel(const VertexBufferLayout &layout) {
+  struct KernelEntry {
+    std::vector<u32> counts;
+    InterleaveKernel kernel;
+  };
+  // position, normal, texture coordinate / position, normal / position
+  static const KernelEntry kernels[] = {
+      {{3, 3, 2}, InterleaveFloats<3, 3, 2>},
+      {{3, 3}, InterleaveFloats<3, 3>},
+      {{3}, InterleaveFloats<3>},
+  };
+  const auto &elements = layout.GetLayoutElements();
+  for (const auto &entry : kernels) {
+    if (std::ranges::equal(entry.counts, elements, {}, {},
+                           &LayoutElement::count)) {
+      return entry.kernel;
+    }
+  }
+  return nullptr;
+}
+
+std::pair<std::unique_ptr<u8[]>, size_t> SerializeVertexDataByLayout(
+    const std::vector<const void *> &vertex_data_buffers,
+    const std::vector<const u32 *> &vertex_index_buffers, u32 vertex_count,
+    const VertexBufferLayout &layout) {
+  Assert(layout.IsFloatOnly());
+  size_t size = layout.GetStride() * vertex_count;
+  auto buffer = std::make_unique_for_overwrite<u8[]>(size);
+  auto *dst = buffer.get();
+  const auto *data_buffers = vertex_data_buffers.data();
+  const auto *index_buffers = vertex_index_buffers.data();
+
+  auto kernel = GetInterleaveKernel(layout);
+  ThreadPool::GetThreadPool().ParallelForBatched(
+      vertex_count, SERIALIZE_MIN_BATCH_VERTICES,
+      [&](size_t begin, size_t end, u32) {
+        if (kernel) {
+          kernel(data_buffers, index_buffers, begin, end, dst);
+        } else {
+          InterleaveFloats(data_buffers, index_buffers, layout, begin, end,
+                           dst);
+        }
+      });
 
   return std::make_pair(std::move(buffer), size);
 }
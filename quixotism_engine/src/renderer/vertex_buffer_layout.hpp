@@ -8,6 +8,18 @@
 
 namespace quixotism {
 
+// How the float attributes of a mesh are stored in a layout element, see
+// mesh/vertex_quantization.hpp
+enum class VertexEncoding : u32 {
+  FLOAT,
+  HALF,
+  // a unit vector of 3 floats, octahedral mapped into 2 snorm16
+  OCTAHEDRAL_SNORM16,
+  // a position of 3 floats relative to the mesh bounding box as 4 snorm16, the
+  // last one padding, so the shader has to scale and offset it back
+  BOX_SNORM16,
+};
+
 struct LayoutElement {
   u32 type = 0;
   size_t type_size = 0;
@@ -15,6 +27,7 @@ struct LayoutElement {
   size_t offset = 0;
   bool normalize = 0;
   u32 binding_slot = 0;
+  VertexEncoding encoding = VertexEncoding::FLOAT;
 };
 
 class VertexBufferLayout {
@@ -23,24 +36,37 @@ class VertexBufferLayout {
   VertexBufferLayout() = default;
 
   void AddLayoutElementF(u32 count, bool normalize, u32 binding_slot);
+  void AddLayoutElementHF(u32 count, u32 binding_slot);
+  void AddLayoutElementOctahedral(u32 binding_slot);
+  void AddLayoutElementBoxSnorm16(u32 binding_slot);
 
-  [[no_discard]] const std::vector<LayoutElement> &GetLayoutElements() const {
+  // whether every element holds plain floats
+  [[nodiscard]] bool IsFloatOnly() const;
+
+  [[nodiscard]] const std::vector<LayoutElement> &GetLayoutElements() const {
     return elements;
   }
 
-  [[no_discard]] size_t GetStride() const { return stride; }
+  [[nodiscard]] size_t GetStride() const { return stride; }
 
  private:
   std::vector<LayoutElement> elements;
   size_t stride = 0;
 
   void AddLayoutElement(u32 count, bool normalize, u32 type, size_t type_size,
-                        u32 binding_slot);
+                        u32 binding_slot,
+                        VertexEncoding encoding = VertexEncoding::FLOAT);
 };
 
+// Vertex serialization splits meshes into batches of at least this many
+// vertices across the thread pool, smaller meshes stay on one thread
+static constexpr size_t SERIALIZE_MIN_BATCH_VERTICES = 16384;
+
+// Interleaves float attributes, the layout has to be float only. Common
+// layouts (3+3+2, 3+3 and 3 floats) get kernels specialized for them.
 std::pair<std::unique_ptr<u8[]>, size_t> SerializeVertexDataByLayout(
-    const std::vector<void *> &vertex_data_buffers,
-    const std::vector<u32 *> &vertex_index_buffers, u32 vertex_count,
+    const std::vector<const void *> &vertex_data_buffers,
+    const std::vector<const u32 *> &vertex_index_buffers, u32 vertex_count,
     const VertexBufferLayout &layout);
 
 std::unique_ptr<u32[]> GenerateSerialIndexBuffer(u32 vertex_count);
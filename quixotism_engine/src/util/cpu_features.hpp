@@ -0,0 +1,77 @@
+#pragma once
+#include "quixotism_c.hpp"
+
+#if COMPILER_MSVC
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+// lets GCC compile single functions for an instruction set the rest of the
+// binary does not target, MSVC allows any intrinsic anywhere
+#if COMPILER_GCC
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_PCLMUL __attribute__((target("pclmul,sse4.1")))
+#else
+#define TARGET_AVX2
+#define TARGET_PCLMUL
+#endif
+
+namespace quixotism {
+
+/**
+ * Instruction set extensions beyond the x64 baseline (SSE2) that hot loops
+ * dispatch on. Queried once, code paths that use these must be guarded by the
+ * matching flag.
+ */
+struct CPUFeatures {
+  bool ssse3 = false;
+  bool sse41 = false;
+  bool pclmul = false;
+  bool avx2 = false;
+};
+
+inline const CPUFeatures &GetCPUFeatures() {
+  static const CPUFeatures features = [] {
+    CPUFeatures result;
+    u32 regs[4] = {};
+    auto cpuid = [&regs](u32 leaf, u32 subleaf) {
+#if COMPILER_MSVC
+      __cpuidex(reinterpret_cast<int *>(regs), leaf, subleaf);
+#else
+      __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    };
+
+    cpuid(0, 0);
+    u32 max_leaf = regs[0];
+    if (max_leaf < 1) return result;
+
+    cpuid(1, 0);
+    u32 ecx1 = regs[2];
+    result.ssse3 = ecx1 & (1U << 9);
+    result.sse41 = ecx1 & (1U << 19);
+    result.pclmul = ecx1 & (1U << 1);
+
+    // AVX state has to be enabled by the OS (OSXSAVE + XCR0 bits) as well
+    bool os_avx = false;
+    if (ecx1 & (1U << 27)) {
+#if COMPILER_MSVC
+      u64 xcr0 = _xgetbv(0);
+#else
+      u32 xcr0_lo, xcr0_hi;
+      __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+      u64 xcr0 = (static_cast<u64>(xcr0_hi) << 32) | xcr0_lo;
+#endif
+      os_avx = (xcr0 & 0x6) == 0x6;
+    }
+    if (os_avx && max_leaf >= 7) {
+      cpuid(7, 0);
+      result.avx2 = regs[1] & (1U << 5);
+    }
+    return result;
+  }();
+  return features;
+}
+
+}  // namespace quixotism
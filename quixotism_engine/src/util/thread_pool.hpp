@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "quixotism_c.hpp"
+
+namespace quixotism {
+
+/**
+ * Simple fork-join pool for data parallel work (glyph rasterization, image
+ * decoding, mesh processing...).
+ *
+ * ParallelFor hands out indices one by one from a shared atomic counter, the
+ * calling thread takes part in the work and the call blocks until every index
+ * got processed. Every call gets a thread_idx in [0, GetThreadCount()) which
+ * is stable for that thread, so callers can keep per-thread scratch memory in
+ * a plain array indexed by it.
+ *
+ * Calling ParallelFor from inside a job runs the nested work inline on the
+ * current thread (with the current thread_idx), so nesting never deadlocks.
+ */
+class ThreadPool {
+ public:
+  CLASS_DELETE_COPY(ThreadPool);
+  CLASS_DELETE_MOVE(ThreadPool);
+
+  static ThreadPool &GetThreadPool() {
+    static ThreadPool pool{};
+    return pool;
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard lock{mutex};
+      shutdown = true;
+    }
+    wake.notify_all();
+    for (auto &worker : workers) {
+      worker.join();
+    }
+  }
+
+  // worker threads + the thread calling ParallelFor
+  u32 GetThreadCount() const { return static_cast<u32>(workers.size()) + 1; }
+
+  // Calls func(idx, thread_idx) for every idx in [0, count)
+  template <typename FUNC>
+  void ParallelFor(size_t count, FUNC &&func) {
+    if (count == 0) return;
+    if (workers.empty() || count == 1 || in_job) {
+      for (size_t idx = 0; idx < count; ++idx) {
+        func(idx, current_thread_idx);
+      }
+      return;
+    }
+
+    std::lock_guard submit_lock{submit_mutex};
+    {
+      std::unique_lock lock{mutex};
+      // A worker that woke for the previous job after its caller returned
+      // may still be in RunJob, reading the job without the lock. It finds
+      // no index left and leaves, the job must not change under it before.
+      finished.wait(lock, [&] { return active_workers == 0; });
+      job.invoke = [](void *context, size_t idx, u32 thread_idx) {
+        (*static_cast<std::remove_reference_t<FUNC> *>(context))(idx,
+                                                                 thread_idx);
+      };
+      job.context = &func;
+      job.count = count;
+      job.next_idx.store(0);
+      job.done_count.store(0);
+      ++generation;
+    }
+    wake.notify_all();
+
+    in_job = true;
+    RunJob(0);
+    in_job = false;
+
+    std::unique_lock lock{mutex};
+    finished.wait(lock, [&] {
+      return job.done_count.load() == job.count && active_workers == 0;
+    });
+  }
+
+  // Splits [0, count) into batches of at least min_batch_size elements and
+  // calls func(begin, end, thread_idx) for each batch, use this for fine
+  // grained work where handing out single indices would be too costly
+  template <typename FUNC>
+  void ParallelForBatched(size_t count, size_t min_batch_size, FUNC &&func) {
+    if (count == 0) return;
+    min_batch_size = std::max<size_t>(min_batch_size, 1);
+    // aim for a few batches per thread so uneven batches balance out
+    size_t batch_size = std::max(
+        min_batch_size, (count + (GetThreadCount() * 4) - 1) /
+                            (static_cast<size_t>(GetThreadCount()) * 4));
+    size_t batch_count = (count + batch_size - 1) / batch_size;
+    ParallelFor(batch_count, [&](size_t batch_idx, u32 thread_idx) {
+      size_t begin = batch_idx * batch_size;
+      size_t end = std::min(begin + batch_size, count);
+      func(begin, end, thread_idx);
+    });
+  }
+
+ private:
+  struct Job {
+    void (*invoke)(void *, size_t, u32) = nullptr;
+    void *context = nullptr;
+    size_t count = 0;
+    std::atomic<size_t> next_idx = 0;
+    std::atomic<size_t> done_count = 0;
+  };
+
+  ThreadPool() {
+    u32 hw_threads = std::thread::hardware_concurrency();
+    u32 worker_count = (hw_threads > 1) ? (hw_threads - 1) : 0;
+    workers.reserve(worker_count);
+    for (u32 idx = 0; idx < worker_count; ++idx) {
+      workers.emplace_back([this, idx] { WorkerLoop(idx + 1); });
+    }
+  }
+
+  void RunJob(u32 thread_idx) {
+    for (;;) {
+      auto idx = job.next_idx.fetch_add(1);
+      if (idx >= job.count) break;
+      job.invoke(job.context, idx, thread_idx);
+      job.done_count.fetch_add(1);
+    }
+  }
+
+  void WorkerLoop(u32 thread_idx) {
+    current_thread_idx = thread_idx;
+    u64 seen_generation = 0;
+    for (;;) {
+      {
+        std::unique_lock lock{mutex};
+        wake.wait(lock,
+                  [&] { return shutdown || generation != seen_generation; });
+        if (shutdown) return;
+        seen_generation = generation;
+        ++active_workers;
+      }
+      in_job = true;
+      RunJob(thread_idx);
+      in_job = false;
+      {
+        std::lock_guard lock{mutex};
+        --active_workers;
+      }
+      finished.notify_all();
+    }
+  }
+
+  static inline thread_local u32 current_thread_idx = 0;
+  static inline thread_local bool in_job = false;
+
+  std::vector<std::thread> workers;
+  std::mutex submit_mutex;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable finished;
+  Job job;
+  u64 generation = 0;
+  u32 active_workers = 0;
+  bool shutdown = false;
+};
+
+}  // namespace quixotism
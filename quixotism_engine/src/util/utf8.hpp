@@ -0,0 +1,49 @@
+#pragma once
+
+#include "quixotism_c.hpp"
+
+namespace quixotism {
+
+static constexpr u32 UTF8_REPLACEMENT_CHARACTER = 0xFFFD;
+
+// Decodes the codepoint at 'it' and advances 'it' past it. Malformed sequences
+// (truncated, overlong, surrogates, out of range) decode to U+FFFD and consume
+// a single byte, so decoding always makes progress.
+inline u32 DecodeUTF8(const char *&it, const char *end) {
+  auto lead = static_cast<u8>(*it++);
+  if (lead < 0x80) return lead;
+
+  u32 length = 0, codepoint = 0, min_codepoint = 0;
+  if ((lead & 0xE0) == 0xC0) {
+    length = 2;
+    codepoint = lead & 0x1F;
+    min_codepoint = 0x80;
+  } else if ((lead & 0xF0) == 0xE0) {
+    length = 3;
+    codepoint = lead & 0x0F;
+    min_codepoint = 0x800;
+  } else if ((lead & 0xF8) == 0xF0) {
+    length = 4;
+    codepoint = lead & 0x07;
+    min_codepoint = 0x10000;
+  } else {
+    return UTF8_REPLACEMENT_CHARACTER;
+  }
+
+  if (end - it < static_cast<ptrdiff_t>(length - 1)) {
+    return UTF8_REPLACEMENT_CHARACTER;
+  }
+  for (u32 idx = 1; idx < length; ++idx) {
+    auto continuation = static_cast<u8>(it[idx - 1]);
+    if ((continuation & 0xC0) != 0x80) return UTF8_REPLACEMENT_CHARACTER;
+    codepoint = (codepoint << 6) | (continuation & 0x3F);
+  }
+  if (codepoint < min_codepoint || codepoint > 0x10FFFF ||
+      (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+    return UTF8_REPLACEMENT_CHARACTER;
+  }
+  it += length - 1;
+  return codepoint;
+}
+
+}  // namespace quixotism
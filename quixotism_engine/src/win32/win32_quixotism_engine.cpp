@@ -28,6 +28,8 @@ static PlatformServices InitPlatformServices() {
   PlatformServices platform_services{};
   platform_services.read_file = Win32ReadFile;
   platform_services.write_file = Win32WriteFile;
+  platform_services.map_file = Win32MapFile;
+  platform_services.unmap_file = Win32UnmapFile;
   platform_services.get_file_metadata = Win32GetFileMetadata;
   platform_services.get_world_timestamp = Win32GetWorldTimestamp;
   return platform_services;
@@ -45,6 +45,37 @@ ReadFileResult Win32ReadFile(const char *file_path) {
   return result;
 }
 
+MappedFile Win32MapFile(const char *file_path) {
+  MappedFile result = {};
+  HANDLE file_handle =  // NOLINT
+      CreateFileA(file_path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                  OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file_handle == INVALID_HANDLE_VALUE) return result;  // NOLINT
+
+  LARGE_INTEGER file_size;
+  // empty files can not be mapped
+  if (GetFileSizeEx(file_handle, &file_size) && file_size.QuadPart > 0) {
+    HANDLE mapping_handle = CreateFileMappingA(file_handle, nullptr,
+                                               PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_handle) {
+      // the view keeps the mapping alive, both handles can be closed
+      auto *view = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+      if (view) {
+        result.data = static_cast<const u8 *>(view);
+        result.size = static_cast<size_t>(file_size.QuadPart);
+      }
+      CloseHandle(mapping_handle);
+    }
+  }
+  CloseHandle(file_handle);
+  return result;
+}
+
+void Win32UnmapFile(MappedFile &file) {
+  if (file.data) UnmapViewOfFile(file.data);
+  file = {};
+}
+
 FileMetadata Win32GetFileMetadata(const char *file_path) {
   FileMetadata result = {};
   // Find file and get its data
@@ -7,6 +7,10 @@ namespace quixotism::win32 {
 
 [[nodiscard]] bool Win32WriteFile(const char *file_path, u8 *data, size_t size);
 
+[[nodiscard]] MappedFile Win32MapFile(const char *file_path);
+
+void Win32UnmapFile(MappedFile &file);
+
 [[nodiscard]] FileMetadata Win32GetFileMetadata(const char *file_path);
 
 }  // namespace quixotism::win32
@@ -0,0 +1,166 @@
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "bitmap/block_compression.hpp"
+#include "file_processing/png_parser/png_parser.hpp"
+#include "test.hpp"
+
+namespace quixotism {
+
+static constexpr BitmapFormat compressed_formats[] = {BC1, BC3, BC4, BC7};
+
+// Every size from 1x1 up, so partial edge blocks get covered, with smooth
+// content (which has to come back close) and noise (which only has to
+// decode)
+QTEST(block_compression, RoundTrip) {
+  std::mt19937 rng{5};
+  constexpr BitmapFormat source_formats[] = {R8, RGB8, RGBA8};
+  for (u32 round = 0; round < 150; ++round) {
+    u32 width = 1 + (rng() % 40);
+    u32 height = 1 + (rng() % 40);
+    auto source_format = source_formats[round % 3];
+    bool smooth = round % 2 == 0;
+    Bitmap bitmap{width, height, source_format};
+    auto channels = static_cast<u32>(bitmap.BytesPerPixel());
+    u8 *pixels = bitmap.GetBitmapWritePtr();
+    for (u32 y = 0; y < height; ++y) {
+      for (u32 x = 0; x < width; ++x) {
+        for (u32 channel = 0; channel < channels; ++channel) {
+          pixels[(((y * width) + x) * channels) + channel] =
+              smooth ? static_cast<u8>((x * 7) + (y * 3) + (channel * 50))
+                     : static_cast<u8>(rng());
+        }
+      }
+    }
+
+    for (auto format : compressed_formats) {
+      auto compressed = CompressBitmap(bitmap, format);
+      REQUIRE(compressed.has_value());
+      CHECK(compressed->GetDataSize() == ((width + 3) / 4) *
+                                             ((height + 3) / 4) *
+                                             Bitmap::FormatBlockBytes(format));
+      auto decoded = DecompressBitmap(*compressed);
+      REQUIRE(decoded.has_value());
+      REQUIRE(decoded->GetWidth() == width && decoded->GetHeight() == height);
+      // BC4 keeps only the first channel, so it is only compared for R8
+      if (smooth && (format != BC4 || channels == 1)) {
+        CHECK(ComputePSNR(bitmap, *decoded) >= 30.0);
+      }
+    }
+  }
+}
+
+QTEST(block_compression, SolidColors) {
+  for (u32 value = 0; value < 256; ++value) {
+    Bitmap bitmap{4, 4, RGBA8};
+    for (u32 texel = 0; texel < 16; ++texel) {
+      u8 *rgba = bitmap.GetBitmapWritePtr() + (texel * 4);
+      rgba[0] = static_cast<u8>(value);
+      rgba[1] = static_cast<u8>(255 - value);
+      rgba[2] = static_cast<u8>(value * 7);
+      rgba[3] = static_cast<u8>(value);
+    }
+    for (auto format : {BC1, BC3, BC7}) {
+      auto compressed = CompressBitmap(bitmap, format);
+      REQUIRE(compressed.has_value());
+      auto decoded = DecompressBitmap(*compressed);
+      REQUIRE(decoded.has_value());
+      // BC1 solid blocks use the single color tables, so they are off by at
+      // most one step of the interpolated color
+      CHECK(ComputePSNR(bitmap, *decoded) >= 45.0);
+    }
+  }
+}
+
+// The numbers given when the compressor went in, with a little margin
+QTEST(block_compression, ContainerPSNR) {
+  auto file = test::ReadDataFile("textures/container.png");
+  REQUIRE(!file.empty());
+  auto bitmap = ParsePNG(file.data(), file.size());
+  REQUIRE(bitmap.has_value());
+  struct {
+    BitmapFormat format;
+    r64 min_psnr;
+  } expectations[] = {{BC1, 38.0}, {BC3, 39.3}, {BC7, 46.5}};
+  for (const auto &expectation : expectations) {
+    auto compressed = CompressBitmap(*bitmap, expectation.format);
+    REQUIRE(compressed.has_value());
+    auto decoded = DecompressBitmap(*compressed);
+    REQUIRE(decoded.has_value());
+    CHECK(ComputePSNR(*bitmap, *decoded) >= expectation.min_psnr);
+  }
+}
+
+// Hand made blocks that use every palette entry, against the palettes the
+// BC1 and BC4 specs give
+QTEST(block_compression, DecodesKnownBlocks) {
+  {
+    // red and blue endpoints, c0 > c1 so four colors, indices 0 1 2 3 ...
+    Bitmap bitmap{4, 4, BC1};
+    constexpr u8 block[8] = {0x00, 0xF8, 0x1F, 0x00, 0xE4, 0xE4, 0xE4, 0xE4};
+    std::memcpy(bitmap.GetBitmapWritePtr(), block, sizeof(block));
+    auto decoded = DecompressBitmap(bitmap);
+    REQUIRE(decoded.has_value());
+    REQUIRE(decoded->GetBitmapFormat() == RGB8);
+    constexpr u8 palette[4][3] = {
+        {255, 0, 0}, {0, 0, 255}, {170, 0, 85}, {85, 0, 170}};
+    for (u32 texel = 0; texel < 16; ++texel) {
+      CHECK(std::memcmp(decoded->GetBitmapPtr() + (texel * 3),
+                        palette[texel % 4], 3) == 0);
+    }
+  }
+  {
+    // a0 > a1, eight values, indices 0 1 2 ... 7 0 1 ...
+    Bitmap bitmap{4, 4, BC4};
+    u8 block[8] = {200, 100};
+    u64 packed_indices = 0;
+    for (u32 texel = 0; texel < 16; ++texel) {
+      packed_indices |= static_cast<u64>(texel % 8) << (3 * texel);
+    }
+    for (u32 byte = 0; byte < 6; ++byte) {
+      block[2 + byte] = static_cast<u8>(packed_indices >> (8 * byte));
+    }
+    std::memcpy(bitmap.GetBitmapWritePtr(), block, sizeof(block));
+    auto decoded = DecompressBitmap(bitmap);
+    REQUIRE(decoded.has_value());
+    REQUIRE(decoded->GetBitmapFormat() == R8);
+    constexpr u8 palette[8] = {200, 100, 186, 171, 157, 143, 129, 114};
+    for (u32 texel = 0; texel < 16; ++texel) {
+      CHECK(decoded->GetBitmapPtr()[texel] == palette[texel % 8]);
+    }
+  }
+  {
+    // BC7 blocks in other modes than 6 are rejected
+    Bitmap bitmap{4, 4, BC7};
+    std::memset(bitmap.GetBitmapWritePtr(), 0, bitmap.GetDataSize());
+    bitmap.GetBitmapWritePtr()[0] = 0x01;
+    CHECK(!DecompressBitmap(bitmap).has_value());
+  }
+}
+
+// Arbitrary block bytes, including BC1 three color blocks, must decode
+// without reading or writing outside the bitmaps (run under ASan)
+QTEST(block_compression, RandomBlocks) {
+  std::mt19937 rng{9};
+  for (u32 round = 0; round < 200; ++round) {
+    u32 width = 1 + (rng() % 33);
+    u32 height = 1 + (rng() % 33);
+    auto format = compressed_formats[round % 4];
+    Bitmap bitmap{width, height, format};
+    u8 *data = bitmap.GetBitmapWritePtr();
+    for (size_t idx = 0; idx < bitmap.GetDataSize(); ++idx) {
+      data[idx] = static_cast<u8>(rng());
+    }
+    if (format == BC7) {
+      for (size_t idx = 0; idx < bitmap.GetDataSize(); idx += 16) {
+        data[idx] = static_cast<u8>((data[idx] & 0x80) | 0x40);
+      }
+    }
+    auto decoded = DecompressBitmap(bitmap);
+    REQUIRE(decoded.has_value());
+    CHECK(decoded->GetWidth() == width && decoded->GetHeight() == height);
+  }
+}
+
+}  // namespace quixotism
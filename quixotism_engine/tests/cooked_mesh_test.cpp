@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+#include <string>
+#include <vector>
+
+#include "core/static_mesh.hpp"
+#include "mesh/cooked_mesh.hpp"
+#include "mesh/vertex_quantization.hpp"
+#include "test.hpp"
+
+namespace quixotism {
+
+// A torus as OBJ text, rings * sides * 2 triangles with normals and texture
+// coordinates
+static std::string MakeTorusOBJ(u32 rings, u32 sides) {
+  constexpr r32 tau = 2.0f * std::numbers::pi_v<r32>;
+  std::string obj = "o torus\n";
+  for (u32 ring = 0; ring <= rings; ++ring) {
+    for (u32 side = 0; side <= sides; ++side) {
+      r32 u = tau * static_cast<r32>(ring) / static_cast<r32>(rings);
+      r32 v = tau * static_cast<r32>(side) / static_cast<r32>(sides);
+      r32 nx = std::cos(u) * std::cos(v);
+      r32 ny = std::sin(u) * std::cos(v);
+      r32 nz = std::sin(v);
+      obj += "v " + std::to_string((2.0f * std::cos(u)) + (0.5f * nx)) + " " +
+             std::to_string((2.0f * std::sin(u)) + (0.5f * ny)) + " " +
+             std::to_string(0.5f * nz) + "\n";
+      obj += "vn " + std::to_string(nx) + " " + std::to_string(ny) + " " +
+             std::to_string(nz) + "\n";
+      obj += "vt " + std::to_string(static_cast<r32>(ring) / rings) + " " +
+             std::to_string(static_cast<r32>(side) / sides) + "\n";
+    }
+  }
+  auto corner = [&](u32 ring, u32 side) {
+    auto idx = std::to_string((ring * (sides + 1)) + side + 1);
+    return " " + idx + "/" + idx + "/" + idx;
+  };
+  for (u32 ring = 0; ring < rings; ++ring) {
+    for (u32 side = 0; side < sides; ++side) {
+      obj += "f" + corner(ring, side) + corner(ring + 1, side) +
+             corner(ring + 1, side + 1) + "\n";
+      obj += "f" + corner(ring, side) + corner(ring + 1, side + 1) +
+             corner(ring, side + 1) + "\n";
+    }
+  }
+  return obj;
+}
+
+// The layout MakeDrawableStaticMesh cooks with
+static VertexBufferLayout MakeCookLayout() {
+  VertexBufferLayout layout;
+  layout.AddLayoutElementBoxSnorm16(0);
+  layout.AddLayoutElementOctahedral(0);
+  layout.AddLayoutElementHF(2, 0);
+  return layout;
+}
+
+static std::vector<StaticMesh> LoadTestMeshes() {
+  std::vector<StaticMesh> meshes;
+  // big enough for meshlets
+  auto torus = MakeTorusOBJ(64, 40);
+  for (auto &mesh : ParseOBJ(torus.data(), torus.size())) {
+    meshes.emplace_back(std::move(mesh));
+  }
+  auto sphere = test::ReadDataFile("meshes/sphere64.obj");
+  for (auto &mesh : ParseOBJ(sphere.data(), sphere.size())) {
+    meshes.emplace_back(std::move(mesh));
+  }
+  for (auto &mesh : meshes) mesh.BuildIndexedMesh();
+  return meshes;
+}
+
+// Cooks meshes and reads them back, the view has to give what the renderer
+// uploads without cooking and a StaticMesh made from it the same positions,
+// levels of detail and meshlets
+QTEST(cooked_mesh, RoundTrip) {
+  auto layout = MakeCookLayout();
+  auto meshes = LoadTestMeshes();
+  REQUIRE(meshes.size() == 2);
+  CHECK(meshes[0].GetMeshlets().MeshletCount() > 0);
+  for (auto &static_mesh : meshes) {
+    const auto &mesh = static_mesh.GetMeshData();
+    const auto &indexed = static_mesh.GetIndexedMesh();
+    const auto &meshlets = static_mesh.GetMeshlets();
+    auto cooked = CookMesh(mesh, indexed, meshlets, layout);
+    auto view = ReadCookedMesh(cooked.data(), cooked.size());
+    REQUIRE(view.has_value());
+
+    auto [vertex_data, vertex_data_size] =
+        SerializeIndexedVertices(mesh, indexed, layout);
+    CHECK(view->vertex_data.size() == vertex_data_size);
+    CHECK(std::memcmp(view->vertex_data.data(), vertex_data.get(),
+                      vertex_data_size) == 0);
+    CHECK(std::ranges::equal(view->indices, indexed.indices));
+    REQUIRE(view->lods.size() == indexed.lods.size());
+    for (size_t lod = 0; lod < view->lods.size(); ++lod) {
+      CHECK(view->lods[lod].first_index == indexed.lods[lod].first_index);
+      CHECK(view->lods[lod].index_count == indexed.lods[lod].index_count);
+    }
+    CHECK(view->name == mesh.ObjectName);
+    for (u32 axis = 0; axis < 3; ++axis) {
+      CHECK(view->bbox.min[axis] == mesh.bbox.min[axis]);
+      CHECK(view->bbox.max[axis] == mesh.bbox.max[axis]);
+    }
+    CHECK(CookedLayoutMatches(*view->header, layout));
+    REQUIRE(view->meshlets.size() == meshlets.meshlets.size());
+    CHECK(view->meshlets.empty() ||
+          std::memcmp(view->meshlets.data(), meshlets.meshlets.data(),
+                      view->meshlets.size_bytes()) == 0);
+    CHECK(std::ranges::equal(view->meshlet_vertices, meshlets.vertices));
+    CHECK(std::ranges::equal(view->meshlet_triangles, meshlets.triangles));
+
+    StaticMesh loaded{*view};
+    auto &loaded_mesh = loaded.GetMeshData();
+    const auto &lod0 = indexed.lods.front();
+    CHECK(std::equal(loaded_mesh.VertexTriangleIndicies.PosIdx.begin(),
+                     loaded_mesh.VertexTriangleIndicies.PosIdx.end(),
+                     indexed.indices.begin() + lod0.first_index,
+                     indexed.indices.begin() + lod0.first_index +
+                         lod0.index_count));
+    REQUIRE(loaded_mesh.VertexPosData.size() == indexed.VertexCount());
+    auto box = MakeQuantizationBox(mesh.bbox);
+    for (u32 vertex = 0; vertex < indexed.VertexCount(); ++vertex) {
+      const auto &original =
+          mesh.VertexPosData[indexed.vertices.PosIdx[vertex]];
+      const auto &decoded = loaded_mesh.VertexPosData[vertex];
+      for (u32 axis = 0; axis < 3; ++axis) {
+        r32 step = box.half_extent[axis] / 32767.0f;
+        r32 bound = (step * BOX_SNORM16_MAX_STEP_ERROR) + 1e-6f;
+        CHECK(std::fabs(decoded[axis] - original[axis]) <= bound);
+      }
+    }
+    CHECK(loaded.GetIndexedMesh().lods.size() == indexed.lods.size());
+    CHECK(loaded.GetMeshlets().vertices == meshlets.vertices);
+    CHECK(loaded.GetMeshlets().triangles == meshlets.triangles);
+  }
+}
+
+template <typename T>
+static T &At(std::vector<u8> &bytes, u64 offset, size_t idx = 0) {
+  return reinterpret_cast<T *>(bytes.data() + offset)[idx];
+}
+
+static bool Accepts(const std::vector<u8> &bytes) {
+  return ReadCookedMesh(bytes.data(), bytes.size()).has_value();
+}
+
+// Every check ReadCookedMesh makes, one broken file at a time
+QTEST(cooked_mesh, RejectsCorruptFiles) {
+  auto layout = MakeCookLayout();
+  auto meshes = LoadTestMeshes();
+  REQUIRE(!meshes.empty());
+  auto &static_mesh = meshes[0];
+  auto cooked = CookMesh(static_mesh.GetMeshData(),
+                         static_mesh.GetIndexedMesh(),
+                         static_mesh.GetMeshlets(), layout);
+  REQUIRE(Accepts(cooked));
+  const auto header = At<CookedMeshHeader>(cooked, 0);
+  REQUIRE(header.meshlet_count > 0);
+
+  CHECK(!ReadCookedMesh(cooked.data(), cooked.size() - 16).has_value());
+  CHECK(!ReadCookedMesh(cooked.data(), 100).has_value());
+
+  auto bad = cooked;
+  bad[0] ^= 1;
+  CHECK(!Accepts(bad));
+
+  bad = cooked;
+  At<CookedMeshHeader>(bad, 0).version += 1;
+  CHECK(!Accepts(bad));
+
+  bad = cooked;
+  At<CookedMeshHeader>(bad, 0).index_offset += 4;
+  CHECK(!Accepts(bad));
+
+  bad = cooked;
+  At<MeshLod>(bad, header.lod_offset).index_count = header.index_count + 3;
+  CHECK(!Accepts(bad));
+
+  // the last vertex is fine, one past it is not
+  bad = cooked;
+  At<u32>(bad, header.index_offset, header.index_count - 1) =
+      header.vertex_count - 1;
+  CHECK(Accepts(bad));
+  At<u32>(bad, header.index_offset, header.index_count - 1) =
+      header.vertex_count;
+  CHECK(!Accepts(bad));
+
+  bad = cooked;
+  At<u32>(bad, header.meshlet_vertex_offset) = header.vertex_count;
+  CHECK(!Accepts(bad));
+
+  bad = cooked;
+  At<Meshlet>(bad, header.meshlet_offset).vertex_count =
+      MESHLET_MAX_VERTICES + 1;
+  CHECK(!Accepts(bad));
+
+  bad = cooked;
+  At<Meshlet>(bad, header.meshlet_offset, header.meshlet_count - 1)
+      .triangle_offset = header.meshlet_triangle_count;
+  CHECK(!Accepts(bad));
+
+  bad = cooked;
+  bad[header.meshlet_triangle_offset] = MESHLET_MAX_VERTICES;
+  CHECK(!Accepts(bad));
+
+  VertexBufferLayout float_layout;
+  float_layout.AddLayoutElementF(3, false, 0);
+  CHECK(!CookedLayoutMatches(header, float_layout));
+}
+
+}  // namespace quixotism
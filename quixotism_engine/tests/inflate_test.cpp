@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include "file_processing/png_parser/deflate.hpp"
+#include "file_processing/png_parser/inflate.hpp"
+#include "test.hpp"
+
+namespace quixotism {
+
+// LSB first bit writer for hand made deflate streams
+class StreamWriter {
+ public:
+  void Write(u32 value, u32 count) {
+    for (u32 bit = 0; bit < count; ++bit) {
+      if (bit_count % 8 == 0) bytes.push_back(0);
+      bytes.back() |= static_cast<u8>(((value >> bit) & 1) << (bit_count % 8));
+      ++bit_count;
+    }
+  }
+
+  // huffman codes go out most significant bit first
+  void WriteCode(u32 code, u32 length) {
+    for (u32 bit = length; bit-- > 0;) Write((code >> bit) & 1, 1);
+  }
+
+  std::vector<u8> bytes;
+
+ private:
+  u64 bit_count = 0;
+};
+
+static constexpr u16 length_base[] = {
+    3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static constexpr u8 length_extra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                      1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                      4, 4, 4, 4, 5, 5, 5, 5, 0};
+static constexpr u16 dist_base[] = {
+    1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+    33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145,  8193,  12289, 16385, 24577};
+static constexpr u8 dist_extra[] = {0, 0, 0, 0, 1, 1, 2,  2,  3,  3,
+                                    4, 4, 5, 5, 6, 6, 7,  7,  8,  8,
+                                    9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Literal/length code of the fixed huffman block (RFC 1951 3.2.6)
+static void WriteFixedSymbol(StreamWriter &writer, u32 symbol) {
+  if (symbol < 144) {
+    writer.WriteCode(0x30 + symbol, 8);
+  } else if (symbol < 256) {
+    writer.WriteCode(0x190 + symbol - 144, 9);
+  } else if (symbol < 280) {
+    writer.WriteCode(symbol - 256, 7);
+  } else {
+    writer.WriteCode(0xC0 + symbol - 280, 8);
+  }
+}
+
+static void WriteFixedMatch(StreamWriter &writer, u32 length, u32 distance) {
+  // 258 has a symbol of its own, 284 with all extra bits set is not valid
+  u32 length_code = 28;
+  if (length < 258) {
+    length_code = static_cast<u32>(std::upper_bound(std::begin(length_base),
+                                                    std::end(length_base) - 1,
+                                                    length) -
+                                   std::begin(length_base)) -
+                  1;
+  }
+  WriteFixedSymbol(writer, 257 + length_code);
+  writer.Write(length - length_base[length_code], length_extra[length_code]);
+  u32 dist_code = static_cast<u32>(std::upper_bound(std::begin(dist_base),
+                                                    std::end(dist_base),
+                                                    distance) -
+                                   std::begin(dist_base)) -
+                  1;
+  writer.WriteCode(dist_code, 5);
+  writer.Write(distance - dist_base[dist_code], dist_extra[dist_code]);
+}
+
+static std::expected<std::vector<u8>, InflateError> InflateAll(
+    const std::vector<u8> &stream, size_t output_size, size_t slack) {
+  BitReader reader;
+  reader.AddSegment(stream.data(), stream.size());
+  InflateScratch scratch;
+  std::vector<u8> output(output_size + slack);
+  auto written = Inflate(reader, output.data(), output.size(), scratch);
+  if (!written) return std::unexpected(written.error());
+  output.resize(*written);
+  return output;
+}
+
+// Fixed huffman blocks with random matches, the output is compared with a
+// byte by byte LZ77 copy, the way the inflater copied matches before the
+// wide stores. Short distances (the pattern cases) get extra weight.
+QTEST(inflate, MatchesByteCopy) {
+  std::mt19937 rng{42};
+  for (u32 round = 0; round < 200; ++round) {
+    StreamWriter writer;
+    writer.Write(1, 1);  // final block
+    writer.Write(1, 2);  // fixed huffman codes
+    std::vector<u8> expected;
+    u32 target_size = 1 + (rng() % 65536);
+    while (expected.size() < target_size) {
+      if (expected.empty() || rng() % 4 == 0) {
+        u32 literal_count = 1 + (rng() % 16);
+        for (u32 idx = 0; idx < literal_count; ++idx) {
+          auto literal = static_cast<u8>(rng() % ((round % 2) ? 4 : 256));
+          WriteFixedSymbol(writer, literal);
+          expected.push_back(literal);
+        }
+        continue;
+      }
+      auto history = static_cast<u32>(std::min<size_t>(expected.size(), 32768));
+      u32 distance = (rng() % 3 == 0) ? 1 + (rng() % std::min(history, 20U))
+                                      : 1 + (rng() % history);
+      u32 length = 3 + (rng() % 256);
+      WriteFixedMatch(writer, length, distance);
+      for (u32 idx = 0; idx < length; ++idx) {
+        expected.push_back(expected[expected.size() - distance]);
+      }
+    }
+    WriteFixedSymbol(writer, 256);
+
+    // with slack every match takes the wide path, without it the last ones
+    // fall back to the byte loop
+    for (size_t slack : {INFLATE_OUTPUT_SLACK, size_t{0}}) {
+      auto output = InflateAll(writer.bytes, expected.size(), slack);
+      REQUIRE(output.has_value());
+      CHECK(*output == expected);
+    }
+  }
+}
+
+static std::vector<u8> MakeCompressibleData(std::mt19937 &rng, size_t size) {
+  std::vector<u8> data;
+  data.reserve(size);
+  while (data.size() < size) {
+    switch (rng() % 3) {
+      case 0: {
+        // noise
+        for (u32 idx = 0; idx < 64; ++idx) data.push_back(rng() & 0xFF);
+      } break;
+      case 1: {
+        // a short repeating pattern
+        u32 period = 1 + (rng() % 12);
+        for (u32 idx = 0; idx < 300; ++idx) {
+          data.push_back(static_cast<u8>((idx % period) * 17));
+        }
+      } break;
+      default: {
+        // a copy of earlier data
+        if (data.empty()) break;
+        size_t from = rng() % data.size();
+        size_t length = std::min<size_t>(1 + (rng() % 400), data.size() - from);
+        for (size_t idx = 0; idx < length; ++idx) {
+          data.push_back(data[from + idx]);
+        }
+      } break;
+    }
+  }
+  data.resize(size);
+  return data;
+}
+
+// Stored, fixed and dynamic blocks from ZlibCompress at every level
+QTEST(inflate, ZlibRoundTrip) {
+  std::mt19937 rng{7};
+  for (u32 level = 0; level <= DEFLATE_MAX_LEVEL; ++level) {
+    for (size_t size : {size_t{0}, size_t{1}, size_t{1000}, size_t{200000}}) {
+      auto data = MakeCompressibleData(rng, size);
+      std::vector<u8> compressed;
+      ZlibCompress(data.data(), data.size(), level, compressed);
+      REQUIRE(compressed.size() >= 6);
+      // Inflate takes the deflate blocks after the 2 byte zlib header
+      std::vector<u8> body(compressed.begin() + 2, compressed.end() - 4);
+      auto output = InflateAll(body, data.size(), INFLATE_OUTPUT_SLACK);
+      REQUIRE(output.has_value());
+      CHECK(*output == data);
+    }
+  }
+}
+
+// Corrupt streams must fail or decode to something, never write out of
+// bounds (run under ASan to check that)
+QTEST(inflate, CorruptStreams) {
+  std::mt19937 rng{11};
+  auto data = MakeCompressibleData(rng, 50000);
+  std::vector<u8> compressed;
+  ZlibCompress(data.data(), data.size(), 6, compressed);
+  std::vector<u8> body(compressed.begin() + 2, compressed.end() - 4);
+  for (u32 round = 0; round < 2000; ++round) {
+    auto corrupt = body;
+    u32 flips = 1 + (rng() % 4);
+    for (u32 flip = 0; flip < flips; ++flip) {
+      corrupt[rng() % corrupt.size()] ^= static_cast<u8>(1 << (rng() % 8));
+    }
+    if (round % 3 == 0) corrupt.resize(rng() % corrupt.size());
+    auto output = InflateAll(corrupt, data.size(), 0);
+    if (output) CHECK(output->size() <= data.size());
+  }
+}
+
+}  // namespace quixotism
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "quixotism_c.hpp"
+
+namespace quixotism::test {
+
+using TestFunction = void (*)();
+
+struct TestCase {
+  const char *suite;
+  const char *name;
+  TestFunction function;
+};
+
+// Every test of the executable, in the order the static initializers ran
+std::vector<TestCase> &GetTestCases();
+
+// Records a failed CHECK, the test keeps running
+void ReportFailure(const char *file, i32 line, const char *expression);
+
+// Reads a file below the repo's data directory, empty if that fails
+std::vector<u8> ReadDataFile(const std::string &relative_path);
+
+struct TestRegistrar {
+  TestRegistrar(const char *suite, const char *name, TestFunction function) {
+    GetTestCases().push_back({suite, name, function});
+  }
+};
+
+}  // namespace quixotism::test
+
+// Defines a test, SUITE is what ctest and the command line select tests by
+#define QTEST(SUITE, NAME)                                          \
+  static void SUITE##_##NAME();                                     \
+  static const quixotism::test::TestRegistrar SUITE##_##NAME##_reg{ \
+      #SUITE, #NAME, SUITE##_##NAME};                               \
+  static void SUITE##_##NAME()
+
+#define CHECK(Expression)                                              \
+  do {                                                                 \
+    if (!(Expression)) {                                               \
+      quixotism::test::ReportFailure(__FILE__, __LINE__, #Expression); \
+    }                                                                  \
+  } while (0)
+
+// Checks and leaves the test, for conditions the rest of it depends on
+#define REQUIRE(Expression)                                            \
+  do {                                                                 \
+    if (!(Expression)) {                                               \
+      quixotism::test::ReportFailure(__FILE__, __LINE__, #Expression); \
+      return;                                                          \
+    }                                                                  \
+  } while (0)
@@ -0,0 +1,53 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "test.hpp"
+
+namespace quixotism::test {
+
+static u32 failure_count = 0;
+
+std::vector<TestCase> &GetTestCases() {
+  static std::vector<TestCase> test_cases;
+  return test_cases;
+}
+
+void ReportFailure(const char *file, i32 line, const char *expression) {
+  std::printf("%s(%d): CHECK failed: %s\n", file, line, expression);
+  ++failure_count;
+}
+
+std::vector<u8> ReadDataFile(const std::string &relative_path) {
+  std::ifstream file{std::string{QUIXOTISM_TEST_DATA_DIR} + "/" + relative_path,
+                     std::ios::binary};
+  if (!file) return {};
+  return {std::istreambuf_iterator<char>(file), {}};
+}
+
+}  // namespace quixotism::test
+
+// Runs every test, or only the suites named on the command line
+int main(int argc, char **argv) {
+  using namespace quixotism::test;
+  u32 run_count = 0;
+  u32 failed_tests = 0;
+  for (const auto &test_case : GetTestCases()) {
+    bool selected = argc < 2;
+    for (int arg = 1; arg < argc; ++arg) {
+      selected |= std::strcmp(argv[arg], test_case.suite) == 0;
+    }
+    if (!selected) continue;
+
+    auto failures_before = failure_count;
+    test_case.function();
+    bool passed = failure_count == failures_before;
+    std::printf("[%s] %s.%s\n", passed ? "  OK  " : "FAILED", test_case.suite,
+                test_case.name);
+    ++run_count;
+    failed_tests += !passed;
+  }
+  std::printf("%u tests, %u failed\n", run_count, failed_tests);
+  return (run_count == 0 || failed_tests) ? 1 : 0;
+}
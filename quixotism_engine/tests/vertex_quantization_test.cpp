@@ -0,0 +1,217 @@
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "mesh/indexed_mesh.hpp"
+#include "mesh/vertex_quantization.hpp"
+#include "test.hpp"
+
+namespace quixotism {
+
+// The half nearest to value as a double, ties to even, infinity from the
+// first value that rounds past the largest half (65504)
+static r64 ReferenceHalf(r32 value) {
+  r64 magnitude = std::fabs(static_cast<r64>(value));
+  if (magnitude >= 65520.0) {
+    return std::copysign(std::numeric_limits<r64>::infinity(), value);
+  }
+  if (magnitude == 0.0) return value;
+  // 10 mantissa bits, subnormals share the step of the smallest exponent
+  i32 exponent = std::max(std::ilogb(magnitude), -14);
+  r64 step = std::ldexp(1.0, exponent - 10);
+  return std::copysign(std::nearbyint(magnitude / step) * step, value);
+}
+
+// Angle between two unit vectors, atan2 stays accurate where acos of the dot
+// product does not
+static r64 AngleBetween(const Vec3 &a, const Vec3 &b) {
+  return std::atan2(static_cast<r64>(Cross(a, b).Length()),
+                    static_cast<r64>(Dot(a, b)));
+}
+
+QTEST(vertex_quantization, HalfDecode) {
+  for (u32 bits = 0; bits < 0x10000; ++bits) {
+    auto half = static_cast<u16>(bits);
+    r32 value = HalfToFloat(half);
+    u32 exponent = (bits >> 10) & 0x1F;
+    u32 mantissa = bits & 0x3FF;
+    if (exponent == 0x1F) {
+      CHECK(mantissa ? std::isnan(value) : std::isinf(value));
+      continue;
+    }
+    r64 expected = std::ldexp(mantissa + (exponent ? 1024.0 : 0.0),
+                              static_cast<i32>(std::max(exponent, 1U)) - 25);
+    if (bits & 0x8000) expected = -expected;
+    CHECK(static_cast<r64>(value) == expected);
+    CHECK(std::signbit(value) == ((bits & 0x8000) != 0));
+    CHECK(FloatToHalf(value) == half);
+  }
+}
+
+// Floats just below, on and just above the midpoint between every pair of
+// neighbouring halves, where the rounding decides
+QTEST(vertex_quantization, HalfEncodeRounding) {
+  for (u32 half = 0; half < 0x7C00; ++half) {
+    r32 low = HalfToFloat(static_cast<u16>(half));
+    // one step past the largest half is where infinity starts
+    r32 high = (half == 0x7BFF) ? 65536.0f
+                                 : HalfToFloat(static_cast<u16>(half + 1));
+    r32 mid = (low + high) / 2.0f;
+    u32 tie = (half & 1) ? half + 1 : half;
+    for (u32 sign : {0U, 0x8000U}) {
+      r32 direction = sign ? -1.0f : 1.0f;
+      auto below = std::nextafter(mid, 0.0f);
+      auto above =
+          std::nextafter(mid, std::numeric_limits<r32>::infinity());
+      CHECK(FloatToHalf(direction * below) == (sign | half));
+      CHECK(FloatToHalf(direction * mid) == (sign | tie));
+      CHECK(FloatToHalf(direction * above) == (sign | (half + 1)));
+    }
+  }
+}
+
+QTEST(vertex_quantization, HalfEncodeMatchesReference) {
+  std::mt19937 rng{1};
+  for (u32 round = 0; round < 1000000; ++round) {
+    u32 bits = rng();
+    // every other value near the half range, the rest anywhere
+    if (round % 2) bits = (bits & 0x807FFFFF) | ((97 + (rng() % 48)) << 23);
+    auto value = std::bit_cast<r32>(bits);
+    r32 decoded = HalfToFloat(FloatToHalf(value));
+    if (std::isnan(value)) {
+      CHECK(std::isnan(decoded));
+      continue;
+    }
+    auto expected = static_cast<r32>(ReferenceHalf(value));
+    CHECK(std::bit_cast<u32>(decoded) == std::bit_cast<u32>(expected));
+  }
+}
+
+QTEST(vertex_quantization, HalfRelativeError) {
+  std::mt19937 rng{2};
+  std::uniform_real_distribution<r32> distribution{-64.0f, 64.0f};
+  for (u32 round = 0; round < 1000000; ++round) {
+    r32 value = distribution(rng);
+    // below the normal half range the error is absolute, not relative
+    if (std::fabs(value) < 6.104e-5f) continue;
+    r32 decoded = HalfToFloat(FloatToHalf(value));
+    CHECK(std::fabs(decoded - value) <=
+          std::fabs(value) * HALF_MAX_RELATIVE_ERROR);
+  }
+}
+
+QTEST(vertex_quantization, OctahedralErrorBound) {
+  std::mt19937 rng{3};
+  std::normal_distribution<r32> distribution;
+  std::vector<Vec3> normals = {
+      {1, 0, 0},  {-1, 0, 0}, {0, 1, 0},
+      {0, -1, 0}, {0, 0, 1},  {0, 0, -1},
+      // on the folded edges of the octahedron
+      {0.70710678f, 0, -0.70710678f},
+      {0, -0.70710678f, -0.70710678f}};
+  while (normals.size() < 1000000) {
+    Vec3 normal{distribution(rng), distribution(rng), distribution(rng)};
+    if (normal.Length() == 0) continue;
+    normals.push_back(normal.Normalize());
+  }
+  for (const auto &normal : normals) {
+    auto decoded = DecodeOctahedral(EncodeOctahedral(normal));
+    CHECK(std::fabs(decoded.Length() - 1.0f) < 1e-5f);
+    CHECK(AngleBetween(decoded, normal) <= OCTAHEDRAL_SNORM16_MAX_ANGLE_ERROR);
+  }
+}
+
+// A box with one flat axis, which has to come back exactly
+QTEST(vertex_quantization, BoxErrorBound) {
+  AABB bbox;
+  bbox.min = {-3.0f, -1000.0f, 0.5f};
+  bbox.max = {7.0f, 1000.0f, 0.5f};
+  auto box = MakeQuantizationBox(bbox);
+  std::mt19937 rng{4};
+  std::uniform_real_distribution<r32> unit{0.0f, 1.0f};
+  for (u32 round = 0; round < 1000000; ++round) {
+    Vec3 position{bbox.min.x + ((bbox.max.x - bbox.min.x) * unit(rng)),
+                  bbox.min.y + ((bbox.max.y - bbox.min.y) * unit(rng)), 0.5f};
+    // the corners first
+    if (round < 4) {
+      position.x = (round & 1) ? bbox.max.x : bbox.min.x;
+      position.y = (round & 2) ? bbox.max.y : bbox.min.y;
+    }
+    auto encoded = EncodeBoxSnorm16(position, box);
+    auto decoded = DecodeBoxSnorm16(encoded.data(), box);
+    for (u32 axis = 0; axis < 2; ++axis) {
+      r32 step = box.half_extent[axis] / 32767.0f;
+      CHECK(std::fabs(decoded[axis] - position[axis]) <=
+            step * BOX_SNORM16_MAX_STEP_ERROR);
+    }
+    CHECK(decoded.z == position.z);
+  }
+}
+
+// The quantized vertex buffer of a mesh against the float one, every
+// attribute within the bound of its encoding
+QTEST(vertex_quantization, SerializedVerticesWithinBounds) {
+  auto file = test::ReadDataFile("meshes/sphere64.obj");
+  auto meshes = ParseOBJ(file.data(), file.size());
+  REQUIRE(!meshes.empty());
+  const auto &mesh = meshes[0];
+  auto indexed = WeldVertices(mesh);
+  REQUIRE(indexed.VertexCount() > 0);
+
+  VertexBufferLayout float_layout;
+  float_layout.AddLayoutElementF(3, false, 0);
+  float_layout.AddLayoutElementF(3, false, 0);
+  float_layout.AddLayoutElementF(2, false, 0);
+  VertexBufferLayout quantized_layout;
+  quantized_layout.AddLayoutElementBoxSnorm16(0);
+  quantized_layout.AddLayoutElementOctahedral(0);
+  quantized_layout.AddLayoutElementHF(2, 0);
+  auto [float_data, float_size] =
+      SerializeIndexedVertices(mesh, indexed, float_layout);
+  auto [quantized_data, quantized_size] =
+      SerializeIndexedVertices(mesh, indexed, quantized_layout);
+  REQUIRE(float_size == indexed.VertexCount() * float_layout.GetStride());
+  REQUIRE(quantized_size ==
+          indexed.VertexCount() * quantized_layout.GetStride());
+
+  const auto &elements = quantized_layout.GetLayoutElements();
+  auto box = MakeQuantizationBox(mesh.bbox);
+  for (u32 vertex = 0; vertex < indexed.VertexCount(); ++vertex) {
+    r32 floats[8];
+    std::memcpy(floats, float_data.get() + (vertex * float_layout.GetStride()),
+                sizeof(floats));
+    const u8 *quantized =
+        quantized_data.get() + (vertex * quantized_layout.GetStride());
+
+    i16 position[4];
+    std::memcpy(position, quantized + elements[0].offset, sizeof(position));
+    auto decoded_position = DecodeBoxSnorm16(position, box);
+    for (u32 axis = 0; axis < 3; ++axis) {
+      r32 step = box.half_extent[axis] / 32767.0f;
+      CHECK(std::fabs(decoded_position[axis] - floats[axis]) <=
+            (step * BOX_SNORM16_MAX_STEP_ERROR) + 1e-6f);
+    }
+
+    std::array<i16, 2> normal;
+    std::memcpy(normal.data(), quantized + elements[1].offset, sizeof(normal));
+    Vec3 float_normal{floats[3], floats[4], floats[5]};
+    float_normal.Normalize();
+    CHECK(AngleBetween(DecodeOctahedral(normal), float_normal) <=
+          OCTAHEDRAL_SNORM16_MAX_ANGLE_ERROR);
+
+    u16 tex_coord[2];
+    std::memcpy(tex_coord, quantized + elements[2].offset, sizeof(tex_coord));
+    for (u32 axis = 0; axis < 2; ++axis) {
+      r32 value = floats[6 + axis];
+      // plus half the subnormal step for values close to 0
+      CHECK(std::fabs(HalfToFloat(tex_coord[axis]) - value) <=
+            (std::fabs(value) * HALF_MAX_RELATIVE_ERROR) + 0x1p-25f);
+    }
+  }
+}
+
+}  // namespace quixotism